@@ -0,0 +1,292 @@
+/// \file benchB3.cc
+/// \brief Microbenchmarks of the per-event hot paths of exampleB3
+///
+/// The per-event user code (B3SensitiveDetector::ProcessHits, the B3Hits
+/// allocator and B3Run::RecordEvent) is driven here with synthetic G4Step,
+/// hits-map and G4HCofThisEvent fixtures, without starting the Geant4 kernel.
+/// For every benchmark the time per call (ns) and the number of heap
+/// allocations per call are reported.
+///
+/// Usage: benchB3 [nEvents] [stepsPerEvent] [crystalsPerEvent]
+
+#include "B3Run.hh"
+#include "B3Hits.hh"
+#include "B3SensitiveDetector.hh"
+
+#include "G4Event.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4THitsMap.hh"
+#include "G4SDManager.hh"
+#include "G4MultiFunctionalDetector.hh"
+#include "G4PSEnergyDeposit.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include "B3Analysis.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <vector>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+// Global allocation counter: every operator new of the process goes through
+// here, so the G4Allocator pages, the hits-map nodes and the analysis buffers
+// are all accounted for.
+
+namespace {
+  unsigned long long gAllocations = 0;
+}
+
+void* operator new(std::size_t size)
+{
+  ++gAllocations;
+  void* p = std::malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](std::size_t size)
+{
+  ++gAllocations;
+  void* p = std::malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace {
+
+typedef std::chrono::steady_clock BenchClock;
+
+/// Measurement of one benchmark: wall time and allocations over nCalls
+struct BenchResult
+{
+  G4String name;
+  G4long nCalls;
+  G4double nanoseconds;
+  unsigned long long allocations;
+};
+
+void PrintResult(const BenchResult& r)
+{
+  G4cout << std::setw(34) << std::left << r.name << std::right
+         << std::setw(12) << r.nCalls
+         << std::setw(14) << std::fixed << std::setprecision(1)
+         << r.nanoseconds/r.nCalls
+         << std::setw(14) << std::setprecision(3)
+         << G4double(r.allocations)/r.nCalls << G4endl;
+}
+
+/// Synthetic per-event content at a given hit multiplicity: the energy
+/// deposits and positions of the steps in the sensitive volume, and the
+/// per-crystal sums that the G4PSEnergyDeposit scorer would produce.
+struct SyntheticEvent
+{
+  std::vector<G4double> stepEdep;
+  std::vector<G4double> stepZ;
+  std::vector<G4int>    crystal;
+  std::vector<G4double> crystalEdep;
+};
+
+std::vector<SyntheticEvent> MakeEvents(G4int nEvents, G4int stepsPerEvent,
+                                       G4int crystalsPerEvent)
+{
+  std::vector<SyntheticEvent> events(nEvents);
+  for (G4int i = 0; i < nEvents; i++) {
+    SyntheticEvent& evt = events[i];
+    for (G4int s = 0; s < stepsPerEvent; s++) {
+      // about one step in five deposits nothing (transportation steps)
+      G4double edep = (G4UniformRand() < 0.2) ? 0. : 511*keV*G4UniformRand()/stepsPerEvent;
+      evt.stepEdep.push_back(edep);
+      evt.stepZ.push_back((G4UniformRand()-0.5)*9*mm);
+    }
+    for (G4int c = 0; c < crystalsPerEvent; c++) {
+      evt.crystal.push_back(G4int(9*G4UniformRand()));
+      evt.crystalEdep.push_back(511*keV*G4UniformRand()/crystalsPerEvent);
+    }
+  }
+  return events;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Bare B3Hits new/delete through the thread-local HitAllocator
+BenchResult BenchHitAllocator(G4int nEvents, G4int stepsPerEvent)
+{
+  std::vector<B3Hits*> hits(stepsPerEvent);
+  BenchResult r = { "B3Hits new/delete", 0, 0., 0 };
+
+  unsigned long long allocs0 = gAllocations;
+  BenchClock::time_point t0 = BenchClock::now();
+  for (G4int i = 0; i < nEvents; i++) {
+    for (G4int s = 0; s < stepsPerEvent; s++) hits[s] = new B3Hits();
+    for (G4int s = 0; s < stepsPerEvent; s++) delete hits[s];
+  }
+  BenchClock::time_point t1 = BenchClock::now();
+
+  r.nCalls = G4long(nEvents)*stepsPerEvent;
+  r.nanoseconds = std::chrono::duration<G4double, std::nano>(t1-t0).count();
+  r.allocations = gAllocations - allocs0;
+  return r;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// B3SensitiveDetector::ProcessHits on a synthetic G4Step. The collection is
+/// created by Initialize() at each event, as the kernel would do; only the
+/// ProcessHits calls are timed, the event set-up is reported separately.
+void BenchSensitiveDetector(const std::vector<SyntheticEvent>& events,
+                            BenchResult& processHits, BenchResult& eventCycle)
+{
+  G4SDManager* sdManager = G4SDManager::GetSDMpointer();
+  B3SensitiveDetector* sd = new B3SensitiveDetector("benchSD");
+  sdManager->AddNewDetector(sd);
+
+  G4Step step;
+  G4StepPoint* postPoint = step.GetPostStepPoint();
+
+  processHits.name = "B3SensitiveDetector::ProcessHits";
+  processHits.nCalls = 0; processHits.nanoseconds = 0.; processHits.allocations = 0;
+  eventCycle.name = "  Initialize + HC deletion";
+  eventCycle.nCalls = 0; eventCycle.nanoseconds = 0.; eventCycle.allocations = 0;
+
+  for (size_t i = 0; i < events.size(); i++) {
+    const SyntheticEvent& evt = events[i];
+
+    unsigned long long allocs0 = gAllocations;
+    BenchClock::time_point t0 = BenchClock::now();
+    G4HCofThisEvent* hce = new G4HCofThisEvent(sdManager->GetCollectionCapacity());
+    sd->Initialize(hce);
+    BenchClock::time_point t1 = BenchClock::now();
+    unsigned long long allocs1 = gAllocations;
+
+    for (size_t s = 0; s < evt.stepEdep.size(); s++) {
+      step.SetTotalEnergyDeposit(evt.stepEdep[s]);
+      postPoint->SetPosition(G4ThreeVector(0., 0., evt.stepZ[s]));
+      sd->ProcessHits(&step, 0);
+    }
+    BenchClock::time_point t2 = BenchClock::now();
+    unsigned long long allocs2 = gAllocations;
+
+    delete hce;
+    BenchClock::time_point t3 = BenchClock::now();
+
+    processHits.nCalls += evt.stepEdep.size();
+    processHits.nanoseconds += std::chrono::duration<G4double, std::nano>(t2-t1).count();
+    processHits.allocations += allocs2 - allocs1;
+    eventCycle.nCalls++;
+    eventCycle.nanoseconds += std::chrono::duration<G4double, std::nano>((t1-t0)+(t3-t2)).count();
+    eventCycle.allocations += (allocs1 - allocs0) + (gAllocations - allocs2);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// B3Run::RecordEvent on an event carrying a filled "crystal/edep" hits map,
+/// with the ntuple and the histogram booked as in B3RunAction.
+BenchResult BenchRecordEvent(const std::vector<SyntheticEvent>& events)
+{
+  G4SDManager* sdManager = G4SDManager::GetSDMpointer();
+  G4MultiFunctionalDetector* cryst = new G4MultiFunctionalDetector("crystal");
+  cryst->RegisterPrimitive(new G4PSEnergyDeposit("edep"));
+  sdManager->AddNewDetector(cryst);
+  G4int collID = sdManager->GetCollectionID("crystal/edep");
+
+  G4AnalysisManager* analysisManager = G4AnalysisManager::Instance();
+  analysisManager->SetVerboseLevel(0);
+  analysisManager->SetFirstNtupleId(1);
+  analysisManager->SetFirstHistoId(1);
+  analysisManager->CreateNtuple("B3", "Energy");
+  for (G4int i = 0; i < 9; i++) {
+    std::ostringstream column;
+    column << "crystal" << i;
+    analysisManager->CreateNtupleDColumn(column.str());
+  }
+  analysisManager->FinishNtuple();
+  analysisManager->CreateH1("h1","energy", 100, 0., 1000.);
+  analysisManager->OpenFile("benchB3");
+
+  // Event ID 1 keeps RecordEvent away from its print-out every fPrintModulo
+  G4Event* event = new G4Event(1);
+  G4HCofThisEvent* hce = new G4HCofThisEvent(sdManager->GetCollectionCapacity());
+  G4THitsMap<G4double>* evtMap = new G4THitsMap<G4double>("crystal", "edep");
+  hce->AddHitsCollection(collID, evtMap);
+  event->SetHCofThisEvent(hce);
+
+  B3Run* run = new B3Run;
+  BenchResult r = { "B3Run::RecordEvent", 0, 0., 0 };
+
+  for (size_t i = 0; i < events.size(); i++) {
+    const SyntheticEvent& evt = events[i];
+    evtMap->clear();
+    for (size_t c = 0; c < evt.crystal.size(); c++) {
+      G4double edep = evt.crystalEdep[c];
+      evtMap->add(evt.crystal[c], edep);
+    }
+
+    unsigned long long allocs0 = gAllocations;
+    BenchClock::time_point t0 = BenchClock::now();
+    run->RecordEvent(event);
+    BenchClock::time_point t1 = BenchClock::now();
+
+    r.nCalls++;
+    r.nanoseconds += std::chrono::duration<G4double, std::nano>(t1-t0).count();
+    r.allocations += gAllocations - allocs0;
+  }
+
+  analysisManager->Write();
+  analysisManager->CloseFile();
+  delete event;
+  delete run;
+  return r;
+}
+
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  G4int nEvents          = (argc > 1) ? std::atoi(argv[1]) : 100000;
+  G4int stepsPerEvent    = (argc > 2) ? std::atoi(argv[2]) : 12;
+  G4int crystalsPerEvent = (argc > 3) ? std::atoi(argv[3]) : 3;
+
+  G4Random::setTheSeed(12345);
+  std::vector<SyntheticEvent> events
+    = MakeEvents(nEvents, stepsPerEvent, crystalsPerEvent);
+
+  G4cout << "\n benchB3: " << nEvents << " events, "
+         << stepsPerEvent << " steps/event in the sensitive volume, "
+         << crystalsPerEvent << " crystals fired/event\n" << G4endl;
+
+  std::vector<BenchResult> results;
+  results.push_back(BenchHitAllocator(nEvents, stepsPerEvent));
+  BenchResult processHits, eventCycle;
+  BenchSensitiveDetector(events, processHits, eventCycle);
+  results.push_back(processHits);
+  results.push_back(eventCycle);
+  results.push_back(BenchRecordEvent(events));
+
+  G4cout << std::setw(34) << std::left << " benchmark" << std::right
+         << std::setw(12) << "calls"
+         << std::setw(14) << "ns/call"
+         << std::setw(14) << "allocs/call" << G4endl;
+  for (size_t i = 0; i < results.size(); i++) PrintResult(results[i]);
+  G4cout << G4endl;
+
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
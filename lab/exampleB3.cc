@@ -39,6 +39,25 @@
 #include "B3DetectorConstruction.hh"
 #include "B3PhysicsList.hh"
 #include "B3ActionInitialization.hh"
+#include "B3PhiloxEngine.hh"
+#include "B3RandomStreams.hh"
+#include "B3EventOutput.hh"
+#include "B3ListModeOutput.hh"
+#include "B3SinogramOutput.hh"
+#include "B3BeamScan.hh"
+#include "B3DoseOutput.hh"
+#include "B3ShardManager.hh"
+#include "B3Trigger.hh"
+#include "B3Biasing.hh"
+#include "B3PhaseSpace.hh"
+#include "B3PrimaryLibrary.hh"
+#include "B3Batching.hh"
+#include "B3ThreadPlacement.hh"
+#include "B3Sweep.hh"
+#include "B3PhysicsTableCache.hh"
+#ifdef G4MULTITHREADED
+#include "B3WorkerThreadInitialization.hh"
+#endif
 
 #ifdef G4VIS_USE
 #include "G4VisExecutive.hh"
@@ -53,16 +72,88 @@
 int main(int argc,char** argv)
 {
   //
-  // Choose the Random engine
+  // Startup timer and cache of the physics tables
+  //
+  B3PhysicsTableCache* tableCache = B3PhysicsTableCache::Instance();
+
   //
-  G4Random::setTheEngine(new CLHEP::RanecuEngine);
+  // Options before the macro: -p <n> processes the shards of the macro
+  // (/B3/shard/run) in n processes forked from a sequential kernel (see
+  // B3ShardManager); -a <policy> pins the worker threads when they start
+  // (see B3ThreadPlacement); -c <dir> stores the physics tables in the
+  // cache dir, or retrieves them from it (see B3PhysicsTableCache); -b
+  // wraps the processes of the photons for the forced interactions (see
+  // B3Biasing)
+  //
+  G4int iMacro = 1;
+  G4String nbProcesses;
+  G4String affinityPolicy;
+  G4bool biasing = false;
+  while (iMacro < argc && argv[iMacro][0] == '-') {
+    G4String option = argv[iMacro++];
+    if (option == "-b") {
+      biasing = true;
+      continue;
+    }
+    if (iMacro == argc) option = "";
+    if (option == "-p") nbProcesses = argv[iMacro];
+    else if (option == "-c") tableCache->SetDirectory(argv[iMacro]);
+    else if (option == "-a") affinityPolicy = argv[iMacro];
+    else {
+      G4cerr << "Usage: exampleB3 [-p <processes>] [-a <affinity policy>] "
+             << "[-c <table cache>] [-b] [<macro>]" << G4endl;
+      return 1;
+    }
+    iMacro++;
+  }
+
+  //
+  // Choose the Random engine: a counter-based engine, with one stream
+  // per event (see B3RandomStreams)
+  //
+  G4Random::setTheEngine(new B3PhiloxEngine);
+  B3RandomStreams::Instance();
+
+  // Output settings, list mode, sinogram, beam scan, dose map, trigger,
+  // biasing, phase space, primary event library, batching, sharded runs,
+  // thread placement and parameter sweeps (and their /B3/ commands)
+  //
+  B3EventOutput::Instance();
+  B3ListModeOutput::Instance();
+  B3SinogramOutput::Instance();
+  B3BeamScan::Instance();
+  B3DoseOutput::Instance();
+  B3Trigger::Instance();
+  B3Biasing::Instance()->SetPhysics(biasing);
+  B3PhaseSpace::Instance();
+  B3PrimaryLibrary::Instance();
+  B3Batching::Instance();
+  B3ShardManager::Instance();
+  B3ThreadPlacement* threadPlacement = B3ThreadPlacement::Instance();
+  if (!affinityPolicy.empty()) {
+    // through the command, which checks the policy
+    if (G4UImanager::GetUIpointer()->ApplyCommand("/B3/affinity/policy " + affinityPolicy)
+        != fCommandSucceeded) {
+      G4cerr << "exampleB3: the affinity policy is none, compact or scatter" << G4endl;
+      return 1;
+    }
+  }
+  B3Sweep::Instance();
      
   // Construct the default run manager. Pick the proper run 
   // manager depending if the multi-threading option is 
   // active or not.
   //
 #ifdef G4MULTITHREADED
-  G4MTRunManager* runManager = new G4MTRunManager;
+  // the processes of -p are forked from a kernel without worker threads:
+  // each of them runs its events in one thread
+  G4RunManager* runManager = 0;
+  if (nbProcesses.empty()) {
+    G4MTRunManager* mtRunManager = new G4MTRunManager;
+    mtRunManager->SetUserInitialization(new B3WorkerThreadInitialization);
+    runManager = mtRunManager;
+  }
+  else runManager = new G4RunManager;
 #else
   G4RunManager* runManager = new G4RunManager;
 #endif  
@@ -80,6 +171,7 @@ int main(int argc,char** argv)
   // Initialize G4 kernel
   //
   runManager->Initialize();
+  tableCache->EndOfInitialization();
   
 #ifdef G4VIS_USE
   // Initialize visualization
@@ -93,12 +185,15 @@ int main(int argc,char** argv)
   G4UImanager* UImanager = G4UImanager::GetUIpointer();
 
   // if an argument is given after the name of the executable 
-  // (i.e. argc > 1), then take the argument as a Geant4 macro 
+  // (and its options), then take the argument as a Geant4 macro 
   // and execute it
-  if (argc!=1)   // batch mode
+  if (iMacro < argc)   // batch mode
     {
+      if (!nbProcesses.empty()) {
+        UImanager->ApplyCommand("/B3/shard/processes " + nbProcesses);
+      }
       G4String command = "/control/execute ";
-      G4String fileName = argv[1];
+      G4String fileName = argv[iMacro];
       UImanager->ApplyCommand(command+fileName);
     }
   // otherwise (only the executable is given), start a user 
@@ -130,6 +225,21 @@ int main(int argc,char** argv)
   delete visManager;
 #endif
   delete runManager;
+  delete B3Sweep::Instance();
+  delete threadPlacement;
+  delete B3ShardManager::Instance();
+  delete B3Batching::Instance();
+  delete B3PrimaryLibrary::Instance();
+  delete B3PhaseSpace::Instance();
+  delete B3Biasing::Instance();
+  delete B3Trigger::Instance();
+  delete B3DoseOutput::Instance();
+  delete B3BeamScan::Instance();
+  delete B3SinogramOutput::Instance();
+  delete B3ListModeOutput::Instance();
+  delete B3EventOutput::Instance();
+  delete B3RandomStreams::Instance();
+  delete tableCache;
 
   return 0;
 }
@@ -0,0 +1,160 @@
+/// \file B3AsyncEventWriter.hh
+/// \brief Definition of the B3AsyncEventWriter class
+
+#ifndef B3AsyncEventWriter_h
+#define B3AsyncEventWriter_h 1
+
+#include "B3EventFormat.hh"
+
+class B3EventFileWriter;
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Asynchronous writer of B3 event files
+///
+/// Each producer (one per simulation thread and event file) appends rows
+/// to its own lock-free ring buffer and never waits for the disk. Two
+/// threads owned by the writer do the rest:
+///  - the packer drains the rings, packs chunks of kChunkRows rows and
+///    compresses them;
+///  - the I/O thread writes the packed chunks to the files.
+/// They exchange two chunk buffers, so that packing and compression of a
+/// chunk overlap with the write of the previous one.
+///
+/// A producer only blocks when its ring is full; these stalls, and the
+/// waits of the packer for a free buffer, are counted in the statistics
+/// (back-pressure) so that the ring size can be chosen.
+///
+/// A file can also be shared by all the threads (OpenShared()): they then
+/// fill their own batches of kChunkRows rows and hand them whole to the
+/// packer through a bounded multi-producer queue (Submit()); each batch
+/// becomes one chunk of the file.
+/// It does not depend on Geant4.
+
+class B3AsyncEventWriter
+{
+  public:
+    struct Statistics
+    {
+      uint64_t rows;
+      uint64_t chunks;
+      uint64_t rawBytes;
+      uint64_t storedBytes;
+      uint64_t stalls;           // pushes that found a ring full
+      double   stallSeconds;     // time the producers waited
+      uint64_t ringHighWater;    // largest number of rows waiting in a ring
+      uint64_t ringCapacity;
+      uint64_t batches;          // batches submitted to shared files
+      uint64_t queueHighWater;   // largest number of batches waiting
+      uint64_t queueCapacity;
+      uint64_t bufferWaits;      // chunks that waited for a free buffer
+      double   packSeconds;      // packing and compression
+      double   writeSeconds;
+      uint64_t writeErrors;
+    };
+
+    class Producer;
+    class SharedFile;
+
+    B3AsyncEventWriter(uint32_t ringRows, int compressionLevel,
+                       uint32_t queueBatches = 64);
+    /// Closes the remaining producers and waits for all the data
+    ~B3AsyncEventWriter();
+
+    /// Opens an event file (see B3EventFileWriter::Open) fed by the
+    /// calling thread; returns 0 if the file cannot be opened
+    Producer* Open(const std::string& fileName, bool append);
+    /// Adds a row; waits only if the ring of the producer is full
+    void Push(Producer* producer, const B3EventFormat::EventRecord& record);
+    /// Does not wait: the producer must not be used afterwards. Its rows
+    /// are written, and its file closed, in the background.
+    void Close(Producer* producer);
+    /// Opens an event file fed by whole batches from any thread; returns 0
+    /// if the file cannot be opened
+    SharedFile* OpenShared(const std::string& fileName, bool append);
+    /// Queues the rows (at most kChunkRows) as one chunk of the file; the
+    /// vector is swapped with an empty recycled one. Waits only if the
+    /// queue is full.
+    void Submit(SharedFile* file, std::vector<B3EventFormat::EventRecord>& rows);
+    /// Does not wait; to be called once no thread submits to the file
+    void Close(SharedFile* file);
+
+    /// Waits until the files of all the closed producers and shared files
+    /// are complete
+    void Sync();
+
+    /// zlib level (1-9) of the chunks packed from now on, 0 for raw chunks
+    void SetCompressionLevel(int level) { fCompressionLevel = level; }
+    /// Ring size (rows) of the producers opened from now on
+    void SetRingRows(uint32_t rows) { fRingRows = rows; }
+
+    Statistics GetStatistics() const;
+    void ResetStatistics();
+
+  private:
+    B3AsyncEventWriter(const B3AsyncEventWriter&);
+    B3AsyncEventWriter& operator=(const B3AsyncEventWriter&);
+
+    /// Packed chunk on its way to the I/O thread; with close set, the file
+    /// is closed after it and its owner deleted
+    struct Block
+    {
+      B3EventFileWriter* file;
+      Producer*   producer;
+      SharedFile* shared;
+      B3EventFormat::ChunkHeader header;
+      std::vector<char> payload;
+      bool close;
+    };
+
+    /// Rows of a shared file, or its closing if shared is set and rows empty
+    struct Batch
+    {
+      SharedFile* shared;
+      bool close;
+      std::vector<B3EventFormat::EventRecord> rows;
+    };
+
+    void PackLoop();
+    bool PackBatches();
+    void WriteLoop();
+    void EmitChunk(B3EventFileWriter* file, const B3EventFormat::EventRecord* rows,
+                   uint32_t nRows, bool close, Producer* producer, SharedFile* shared);
+
+    std::atomic<uint32_t> fRingRows;
+    std::atomic<int> fCompressionLevel;
+
+    mutable std::mutex fMutex;          // producers, statistics
+    std::condition_variable fWake;      // packer: rows are waiting
+    std::condition_variable fSynced;    // a closed producer is complete
+    std::vector<Producer*> fProducers;
+    int  fClosing;
+    bool fStop;
+    Statistics fStatistics;
+
+    std::mutex fBatchMutex;             // batch queue
+    std::condition_variable fBatchSpace;
+    std::deque<Batch> fBatches;
+    std::vector<std::vector<B3EventFormat::EventRecord> > fFreeRows;
+    uint32_t fQueueBatches;
+
+    std::mutex fIOMutex;                // blocks
+    std::condition_variable fIOReady;
+    std::condition_variable fBlockFree;
+    std::deque<Block*> fIOQueue;
+    std::vector<Block*> fFreeBlocks;
+    Block fBlocks[2];
+    bool fIOStop;
+
+    std::vector<char> fWork;            // compression buffer (packer)
+    std::thread fPacker;
+    std::thread fWriter;
+};
+
+#endif
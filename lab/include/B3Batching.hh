@@ -0,0 +1,76 @@
+/// \file B3Batching.hh
+/// \brief Definition of the B3Batching class
+
+#ifndef B3Batching_h
+#define B3Batching_h 1
+
+#include "globals.hh"
+
+class G4GenericMessenger;
+
+/// Several independent primaries per event
+///
+/// For the 511 keV photons of the point source, the per-event work (hits
+/// collections, scorers, B3Run::RecordEvent) costs as much as the
+/// tracking. With
+///   /B3/batch/primaries 16
+/// each event of the point source carries 16 primaries. Every track knows
+/// the index of its primary (B3TrackInformation, set by
+/// B3TrackingAction). The crystal scorers keep the deposits of each
+/// primary apart, at key primary*9 + copyNb, and B3Run records each
+/// primary as a sub-event of its own. The tallies, the trigger and the
+/// event, list-mode and sinogram outputs are therefore those of
+/// 16 separate events. In the event file, sub-event k of the event of
+/// global number n (B3RandomStreams) is numbered 2^62 + n*2^16 + k (see
+/// SubEventNumber): apart from the numbers of the events that are not
+/// batched, and the same whatever the number of primaries per event, so
+/// that the runs of a job, or of several jobs, never share a number.
+///
+/// The dose in the phantom is summed over the primaries. The beam scan,
+/// the phase-space replay and the primary event library keep one source
+/// event per event, and the forced interactions (B3Biasing) need one
+/// primary per event.
+///
+/// There is a single instance, configured by the master and read by all
+/// the threads.
+
+class B3Batching
+{
+  public:
+    static B3Batching* Instance();
+    ~B3Batching();
+
+    /// Primaries per event of the point source
+    G4int GetNbPrimaries() const { return fNbPrimaries; }
+
+    /// Called by the master at the beginning of a run: checks the settings
+    void BeginOfRun();
+
+    /// Primaries of the current event of the thread, set by the primary
+    /// generator (1 for the sources that are not batched)
+    static G4int GetEventPrimaries() { return fgEventPrimaries; }
+    static void SetEventPrimaries(G4int n) { fgEventPrimaries = n; }
+
+    /// Number in the outputs of primary k of the event of global number n
+    static G4long SubEventNumber(G4long n, G4int k)
+    { return kSubEventFlag | (n << kPrimaryBits) | G4long(k); }
+
+    /// Bits of the primary index in a sub-event number, hence at most
+    /// 2^16 primaries per event, and at most 2^46 events
+    static const G4int  kPrimaryBits = 16;
+    static const G4long kSubEventFlag = G4long(1) << 62;
+
+  private:
+    B3Batching();
+    void DefineCommands();
+
+    static B3Batching* fgInstance;
+    static G4ThreadLocal G4int fgEventPrimaries;
+
+    G4GenericMessenger* fMessenger;
+    G4int fNbPrimaries;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,101 @@
+/// \file B3BeamScan.hh
+/// \brief Definition of the B3BeamScan class
+
+#ifndef B3BeamScan_h
+#define B3BeamScan_h 1
+
+#include "B3ResponseMatrix.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+#include <set>
+
+class G4GenericMessenger;
+class G4Run;
+
+/// Beam-scan mode, generating the detector response matrix of the crystals
+///
+/// With /B3/scan/file <base>, the primary generator shoots a pencil beam
+/// over the grid of entry points, angles and energies of a B3ResponseMatrix
+/// on the face of the crystals (taken from the crystal table of
+/// B3DetectorConstruction), eventsPerPoint events per grid point, instead
+/// of the point source. Event i of the run is at grid point
+/// i / eventsPerPoint (modulo the number of points).
+///
+///   /B3/scan/file response
+///   /B3/scan/nY 12
+///   /B3/scan/nZ 9
+///   /B3/scan/nTheta 4
+///   /B3/scan/maxTheta 30 deg
+///   /B3/scan/nPhi 8
+///   /B3/scan/nEnergies 3
+///   /B3/scan/minEnergy 200 keV
+///   /B3/scan/maxEnergy 511 keV
+///   /B3/scan/eventsPerPoint 1000
+///   /B3/scan/nBins 128
+///   /B3/scan/binWidth 5 keV
+///   /run/beamOn <points x eventsPerPoint>
+///
+/// Each grid point is an independent work item: the master sets the event
+/// modulo of the run to eventsPerPoint, so that the workers take whole
+/// points (the previous modulo is restored at the end of the run), and
+/// every event has its own random stream (B3RandomStreams), so the matrix
+/// does not depend on the scheduling. The energy deposits of the
+/// crystals are histogrammed into the response matrix of the run of each
+/// thread (B3Run), which B3Run::Merge adds on the master. At the end of the
+/// run, the master writes it to <base>.b3rm; the next runs of the job are
+/// added to the file. In a shard, the file is <base>_shard<i>.b3rm, which
+/// is checkpointed with the shard (see B3ShardManager).
+
+class B3BeamScan
+{
+  public:
+    static B3BeamScan* Instance();
+    ~B3BeamScan();
+
+    G4bool IsEnabled() const { return !fFileBase.empty() && fFileBase != "none"; }
+
+    /// Called by the master at the beginning of a run: sets the grid from
+    /// the crystal table, and the event modulo
+    void BeginOfRun(const G4Run* run);
+    /// Vertex, direction and energy of the beam of an event of the run
+    void GetBeam(G4int eventID, G4ThreeVector& position, G4ThreeVector& direction,
+                 G4double& energy) const;
+    /// Adds the energy deposits (Geant4 units) of the nCrystals crystals of
+    /// an event to a response matrix, initialised with the grid of the run
+    /// the first time
+    void Fill(B3ResponseMatrix& response, G4int eventID, const G4double* edep,
+              G4int nCrystals) const;
+    /// Called by the master at the end of a run with the merged matrix:
+    /// writes it, and restores the event modulo
+    void EndOfRun(const B3ResponseMatrix& response);
+
+  private:
+    B3BeamScan();
+    void DefineCommands();
+    size_t PointOfEvent(G4int eventID) const
+    { return size_t(eventID/fEventsPerPoint) % fEmpty.NbPoints(); }
+
+    static B3BeamScan* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fFileBase;
+    G4int    fNbY;
+    G4int    fNbZ;
+    G4int    fNbTheta;
+    G4double fMaxTheta;
+    G4int    fNbPhi;
+    G4int    fNbEnergies;
+    G4double fMinEnergy;
+    G4double fMaxEnergy;
+    G4int    fEventsPerPoint;
+    G4int    fNbBins;
+    G4double fBinWidth;
+    B3ResponseMatrix fEmpty;
+    std::set<G4String> fWrittenFiles;
+    G4int    fSavedModulo;        // event modulo of the job, -1 if not changed
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,89 @@
+/// \file B3Biasing.hh
+/// \brief Definition of the B3Biasing class
+
+#ifndef B3Biasing_h
+#define B3Biasing_h 1
+
+#include "globals.hh"
+
+class G4GenericMessenger;
+struct B3Tally;
+struct B3WeightedTally;
+
+/// Forced interaction of the photons in the crystals
+///
+/// With /B3/bias/forceInteraction true, the primary photon entering a
+/// crystal before any interaction in it is split by the generic biasing
+/// (B3ForcedInteraction): the photon crosses the crystal without
+/// interacting, with the weight of the probability not to interact, and a
+/// copy is forced to interact in the crystal, with the complementary
+/// weight. Every event then contributes to the photopeak, with a weight,
+/// instead of one event in a few: the efficiency is known to a given
+/// precision in far fewer events.
+///
+/// A photon that interacted is not split again, so the branches of an
+/// event (the copy forced in each crystal entered, with its descendants)
+/// are disjoint histories with their own weights. The crystal energies of
+/// each branch are scored apart (B3PSBranchEnergy) and filled with its
+/// weight into a B3WeightedTally.
+/// The per-event outputs (ntuple, event and list-mode files, trigger, beam
+/// scan) need analog events and are not filled in the biased runs; the dose
+/// in the phantom is weighted.
+///
+///   /B3/bias/forceInteraction true
+///   /run/reinitializeGeometry
+///   /B3/bias/peakLow 460 keV
+///   /B3/bias/peakHigh 562 keV
+///
+/// The processes of the photons are wrapped by G4GenericBiasingPhysics only
+/// in the jobs started with
+///   exampleB3 -b <macro>
+/// since the physics is built before the macro: the other jobs keep the
+/// plain processes, and ignore /B3/bias/forceInteraction with a warning.
+///
+/// At the end of the runs, the master prints the photopeak efficiency (the
+/// fraction of the events with a total energy in [peakLow, peakHigh], in
+/// whole bins of the spectrum) with its error, analog or weighted (see
+/// bias.mac).
+///
+/// There is a single instance, configured by the master and read by all
+/// the threads.
+
+class B3Biasing
+{
+  public:
+    static B3Biasing* Instance();
+    ~B3Biasing();
+
+    /// Wraps the processes of the photons for the biasing (exampleB3 -b):
+    /// set before the physics list is built
+    void SetPhysics(G4bool physics) { fPhysics = physics; }
+    G4bool HasPhysics() const { return fPhysics; }
+    /// True if the crystals of the next geometry force the interactions
+    G4bool IsEnabled() const { return fForceInteraction && fPhysics; }
+    /// Warns if the forcing is set in a job without the biasing physics
+    void CheckPhysics() const;
+    /// Photopeak window of the efficiency, in Geant4 units
+    G4double GetPeakLow() const { return fPeakLow; }
+    G4double GetPeakHigh() const { return fPeakHigh; }
+
+    /// Prints the photopeak efficiency of a run, weighted if the tally has
+    /// events, analog otherwise
+    void Print(const B3Tally& tally, const B3WeightedTally& weighted) const;
+
+  private:
+    B3Biasing();
+    void DefineCommands();
+
+    static B3Biasing* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4bool   fPhysics;
+    G4bool   fForceInteraction;
+    G4double fPeakLow;
+    G4double fPeakHigh;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -32,14 +32,65 @@
 #define B3DetectorConstruction_h 1
 
 #include "G4VUserDetectorConstruction.hh"
+#include "G4ThreeVector.hh"
 #include "globals.hh"
 
+#include <list>
+#include <ostream>
+#include <vector>
+
 class G4VPhysicalVolume;
 class G4LogicalVolume;
+class G4GenericMessenger;
+class G4Material;
+class G4Region;
+class G4MultiFunctionalDetector;
+class G4VPrimitiveScorer;
+class B3WoodcockModel;
+class B3ForcedInteraction;
 
 /// Detector construction class to define materials (with their physical properties) and detector geometry.
 ///
-/// This set up consists of a single scillating crystal
+/// This set up consists of a single scillating crystal, and an optional
+/// voxelised patient phantom around the source (at the origin).
+///
+/// The array is 3 x 3 crystals in the y-z plane, 3.8 cm from the source:
+///   /B3/crystal/size 22 4 3 mm
+///   /B3/crystal/pitch 0 mm          (centre to centre; 0: side by side)
+///   /run/reinitializeGeometry
+/// The world is enlarged to contain the array.
+///
+/// The phantom is a grid of nX x nY x nZ voxels, read from a raw file of
+/// one byte per voxel (x fastest, then y and z): the index of its material
+/// in the list set with /B3/phantom/material. It is built as a
+/// G4PhantomParameterisation inside the "Patient" box, navigated with
+/// G4RegularNavigation, which skips the boundaries between voxels of the
+/// same material: the memory used is one index per voxel, whatever the
+/// number of voxels.
+///
+///   /B3/phantom/file phantom.raw
+///   /B3/phantom/nX 256
+///   /B3/phantom/nY 256
+///   /B3/phantom/nZ 256
+///   /B3/phantom/voxelSize 0.2 0.2 0.2 mm
+///   /B3/phantom/material 0 G4_AIR
+///   /B3/phantom/material 1 G4_TISSUE_SOFT_ICRP
+///   /run/reinitializeGeometry
+///
+/// The world is enlarged in y and z to contain the phantom, which must not
+/// reach the crystals along x.
+///
+/// The dose in the voxels is scored by B3DoseSD (see B3DoseOutput).
+///
+/// The patient is the envelope of the "Patient" region: with
+///   /B3/phantom/woodcock true
+/// the photons in it are transported with Woodcock tracking
+/// (B3WoodcockModel), which does not stop at the voxel boundaries.
+///
+/// With /B3/bias/forceInteraction true, in a job started with exampleB3 -b,
+/// the crystals get the biasing operator of the forced interactions
+/// (B3ForcedInteraction) and their energy deposits are also scored per
+/// branch of the event (see B3Biasing).
 
 class B3DetectorConstruction : public G4VUserDetectorConstruction
 {
@@ -55,11 +106,61 @@ class B3DetectorConstruction : public G4VUserDetectorConstruction
     /// Register some of the detector's volumes as "sensitive"
     virtual void ConstructSDandField();
                
+    /// Sets the NIST material of the voxels of an index of the phantom file
+    void SetPhantomMaterial(G4int index, G4String name);
+
+    /// True if the settings (including the forced interactions of
+    /// B3Biasing) differ from those of the geometry built, which has to be
+    /// reinitialized (see B3Sweep). When only the crystals change, the
+    /// phantom of the previous geometry is placed again.
+    G4bool IsGeometryModified() const;
+    /// False, with the reason, if the pitch set is smaller than the
+    /// crystals: Construct() would fail, B3Sweep skips the point instead
+    G4bool CheckCrystals(std::ostream& reason) const;
+
   private:
     /// Defines all the materials the detector is made of.
     void DefineMaterials();
+    /// Reads the phantom file and places the voxels in the world
+    void ConstructPhantom(G4LogicalVolume* logicWorld);
+    G4VPhysicalVolume* PlacePatient(G4LogicalVolume* logicWorld,
+                                    G4LogicalVolume* logicPatient);
+    /// Settings of the phantom, and of the whole geometry
+    G4String PhantomDescription() const;
+    G4String GeometryDescription() const;
+    void DefineCommands();
 
     G4bool  fCheckOverlaps;
+
+    G4GenericMessenger* fMessenger;
+    G4GenericMessenger* fCrystalMessenger;
+    G4ThreeVector fCrystalSize;
+    G4double      fCrystalPitch;
+    G4String      fPhantomFile;
+    G4int         fPhantomNbX;
+    G4int         fPhantomNbY;
+    G4int         fPhantomNbZ;
+    G4ThreeVector fVoxelSize;
+    std::vector<G4String> fPhantomMaterials;
+    /// Material index of each voxel, used by the parameterisation
+    std::vector<size_t> fMaterialIndices;
+    /// Material indices of the previous phantoms, kept alive since their
+    /// parameterisations, which are not deleted, still refer to them
+    std::list<std::vector<size_t> > fRetiredIndices;
+    std::vector<G4Material*> fVoxelMaterials;
+    G4double          fPhantomMass;
+    G4bool            fWoodcock;
+    G4LogicalVolume*  fLogicPatient;
+    G4Region*         fPatientRegion;
+    G4LogicalVolume*  fLogicCrystal;
+    /// Settings of the geometry and of the phantom built last
+    G4String          fBuiltGeometry;
+    G4String          fBuiltPhantom;
+
+    static G4ThreadLocal G4MultiFunctionalDetector* fgCrystalDetector;
+    static G4ThreadLocal G4VPrimitiveScorer* fgBranchScorer;
+    static G4ThreadLocal B3WoodcockModel* fgWoodcockModel;
+    static G4ThreadLocal B3ForcedInteraction* fgForcedInteraction;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,69 @@
+/// \file B3DoseMap.hh
+/// \brief Definition of the B3DoseMap structure
+
+#ifndef B3DoseMap_h
+#define B3DoseMap_h 1
+
+#include <stdint.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/// Dose in the voxels of the phantom, written to a .b3dm file
+///
+/// For each of the nX x nY x nZ voxels (x fastest), the sum over the events
+/// of the dose of the event (Gy), and the sum of its squares, in single
+/// precision: the dose of the run in a voxel is dose[v], with the
+/// statistical uncertainty Error(v) from the event-by-event spread. The
+/// energy deposited in the whole phantom and its mass give the total dose
+/// of the patient.
+///
+/// The arrays are flat, so that maps of the same phantom are added with
+/// plain vectorised loops. It does not depend on Geant4, so that the tools
+/// can read it.
+
+struct B3DoseMap
+{
+  B3DoseMap();
+
+  /// Sets the phantom and clears the sums
+  void Init(uint32_t x, uint32_t y, uint32_t z, const float voxel[3], double phantomMass);
+  bool IsInitialized() const { return !dose.empty(); }
+  void Clear();
+
+  size_t NbVoxels() const { return size_t(nX)*nY*nZ; }
+
+  /// Adds the dose (Gy) of an event to a voxel; an event must add each
+  /// voxel once
+  void Fill(size_t voxel, float eventDose)
+  {
+    dose[voxel] += eventDose;
+    dose2[voxel] += eventDose*eventDose;
+  }
+  /// Statistical uncertainty (Gy) of the dose of a voxel
+  double Error(size_t voxel) const
+  {
+    if (events == 0) return 0.;
+    double variance = dose2[voxel] - double(dose[voxel])*dose[voxel]/events;
+    return variance > 0. ? std::sqrt(variance) : 0.;
+  }
+  /// Energy over mass of the whole phantom (Gy)
+  double TotalDose() const;
+
+  /// Adds a map of the same phantom; returns false otherwise
+  bool Add(const B3DoseMap& other);
+
+  /// Writes to a temporary file renamed at the end, like B3Snapshot
+  bool Write(const std::string& fileName) const;
+  bool Read(const std::string& fileName);
+
+  uint32_t nX, nY, nZ;
+  float    voxelSize[3];    // mm
+  double   mass;            // kg, of the phantom
+  uint64_t events;
+  double   energy;          // keV, deposited in the phantom
+  std::vector<float> dose;  // Gy, per voxel
+  std::vector<float> dose2; // Gy^2, per voxel
+};
+
+#endif
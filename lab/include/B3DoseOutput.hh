@@ -0,0 +1,50 @@
+/// \file B3DoseOutput.hh
+/// \brief Definition of the B3DoseOutput class
+
+#ifndef B3DoseOutput_h
+#define B3DoseOutput_h 1
+
+#include "B3DoseMap.hh"
+#include "globals.hh"
+
+#include <set>
+
+class G4GenericMessenger;
+
+/// Dose map of the phantom
+///
+/// The doses scored in the voxels by B3DoseSD are accumulated in the dose
+/// map of the run of each thread (B3Run), which B3Run::Merge adds on the
+/// master. With /B3/dose/file <base>, the master writes it at the end of
+/// the run to <base>.b3dm; the next runs of the job are added to the file.
+/// In a shard, the file is <base>_shard<i>.b3dm, which is checkpointed
+/// with the shard (see B3ShardManager). The memory used is two floats per
+/// voxel per thread.
+///
+///   /B3/dose/file dose
+
+class B3DoseOutput
+{
+  public:
+    static B3DoseOutput* Instance();
+    ~B3DoseOutput();
+
+    G4bool IsEnabled() const { return !fFileBase.empty() && fFileBase != "none"; }
+
+    /// Called by the master at the end of a run with the merged map
+    void EndOfRun(const B3DoseMap& map);
+
+  private:
+    B3DoseOutput();
+    void DefineCommands();
+
+    static B3DoseOutput* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fFileBase;
+    std::set<G4String> fWrittenFiles;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
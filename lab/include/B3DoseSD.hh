@@ -0,0 +1,64 @@
+/// \file B3DoseSD.hh
+/// \brief Definition of the B3DoseSD class
+
+#ifndef B3DoseSD_h
+#define B3DoseSD_h 1
+
+#include "G4VSensitiveDetector.hh"
+#include "G4ThreeVector.hh"
+#include "B3DoseMap.hh"
+
+#include <utility>
+#include <vector>
+
+class G4Step;
+class G4HCofThisEvent;
+
+/// Dose scorer of the phantom voxels
+///
+/// Attached to the voxels of the patient (B3DetectorConstruction), one per
+/// thread. The dose of each step, its energy deposit over the mass of the
+/// voxel (from the density of its material), is kept in a short list of
+/// the event, without hits collection; at the end of the event B3Run
+/// sorts it by voxel and adds the dose of each touched voxel, and its
+/// square, to the flat arrays of its B3DoseMap. Nothing of the size of the
+/// phantom is allocated per event, and no map is searched per step.
+///
+/// A step of the regular navigation may cross several voxels of the same
+/// material (SetSkipEqualMaterials): its deposit is then split over them
+/// in proportion to the lengths of the step in each.
+
+class B3DoseSD : public G4VSensitiveDetector
+{
+  public:
+    B3DoseSD(const G4String& name);
+    virtual ~B3DoseSD();
+
+    /// Scorer of the thread, 0 before the first phantom
+    static B3DoseSD* Instance() { return fgInstance; }
+
+    /// Sets the phantom: nb[3] voxels of voxelSize, of total mass
+    void SetPhantom(const G4int nb[3], const G4ThreeVector& voxelSize, G4double mass);
+
+    virtual void Initialize(G4HCofThisEvent*);
+    virtual G4bool ProcessHits(G4Step* step, G4TouchableHistory*);
+
+    /// Adds the doses of the event to a dose map, initialised with the
+    /// phantom the first time, and clears them
+    void Flush(B3DoseMap& map);
+
+  private:
+    static G4ThreadLocal B3DoseSD* fgInstance;
+
+    G4int fNb[3];
+    G4ThreeVector fVoxelSize;
+    G4double fVoxelVolume;
+    G4double fMass;
+    /// (voxel, dose) of the steps of the event
+    std::vector<std::pair<G4int, G4double> > fDeposits;
+    G4double fEventEnergy;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
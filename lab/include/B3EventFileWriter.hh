@@ -0,0 +1,61 @@
+/// \file B3EventFileWriter.hh
+/// \brief Definition of the B3EventFileWriter class
+
+#ifndef B3EventFileWriter_h
+#define B3EventFileWriter_h 1
+
+#include "B3EventFormat.hh"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// Writer of a B3 event file (see B3EventFormat.hh)
+///
+/// Rows are buffered and written as one chunk every chunkRows rows, or when
+/// Flush() is called. A file opened in append mode keeps its content and
+/// gets new chunks after it; since chunks are only written whole, a file
+/// truncated at a size returned by GetSize() after a Flush() is valid.
+/// With a compression level (1-9), payloads are zlib-compressed.
+/// Chunks packed elsewhere (B3AsyncEventWriter) are added with
+/// WritePackedChunk().
+
+class B3EventFileWriter
+{
+  public:
+    B3EventFileWriter(uint32_t chunkRows = B3EventFormat::kChunkRows,
+                      int compressionLevel = 0);
+    ~B3EventFileWriter();
+
+    /// Opens (append = false: creates or truncates) the file.
+    /// Returns false if it cannot be opened or is not a B3 event file.
+    bool Open(const std::string& fileName, bool append);
+    /// Writes the pending rows and closes the file
+    void Close();
+    bool IsOpen() const { return fFile != 0; }
+    const std::string& GetFileName() const { return fFileName; }
+
+    void AddRow(const B3EventFormat::EventRecord& row);
+    /// Writes the pending rows as a (possibly short) chunk
+    void Flush();
+    /// Writes a chunk packed (and possibly compressed) by the caller;
+    /// returns false on a write error
+    bool WritePackedChunk(const B3EventFormat::ChunkHeader& header,
+                          const std::vector<char>& payload);
+    /// Size of the file including the chunks written so far
+    uint64_t GetSize() const { return fSize; }
+
+  private:
+    void WriteChunk();
+
+    std::FILE*  fFile;
+    std::string fFileName;
+    uint32_t    fChunkRows;
+    int         fCompressionLevel;
+    uint64_t    fSize;
+    std::vector<B3EventFormat::EventRecord> fRows;
+    std::vector<char> fPayload;
+    std::vector<char> fWork;
+};
+
+#endif
@@ -0,0 +1,106 @@
+/// \file B3EventFormat.hh
+/// \brief Layout of the B3 event files (.b3e)
+
+#ifndef B3EventFormat_h
+#define B3EventFormat_h 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Binary columnar event file written by the simulation (B3EventOutput)
+/// and read by the stand-alone tools. It does not depend on Geant4.
+///
+/// A file is a FileHeader followed by a sequence of chunks. Each chunk is a
+/// ChunkHeader followed by its payload: the columns of the chunk one after
+/// the other (column-major), each nRows values wide. The chunk header keeps
+/// the minimum and maximum of every column so that readers can skip chunks.
+/// All structures are 8-byte aligned so that an mmap-ed raw chunk can be
+/// read in place. Values are stored in the native (little-endian) order.
+/// A chunk payload is either raw or zlib-compressed; stored payloads are
+/// padded to a multiple of 8 bytes.
+
+namespace B3EventFormat
+{
+  const uint32_t kFileMagic  = 0x56453342;   // "B3EV"
+  const uint32_t kChunkMagic = 0x4B484342;   // "BCHK"
+  const uint32_t kVersion    = 1;
+
+  const int kNbCrystals = 9;
+
+  /// Columns: global event number, total energy and energy of each crystal
+  /// (keV)
+  enum Column { kEvent = 0, kTotal = 1, kCrystal0 = 2 };
+  const int kNbColumns = 2 + kNbCrystals;
+
+  enum ColumnType { kUInt64 = 0, kFloat32 = 1 };
+
+  /// Encoding of the chunk payload
+  enum Codec { kRaw = 0, kZlib = 1 };
+
+  /// Default number of rows per chunk
+  const uint32_t kChunkRows = 4096;
+
+  struct ColumnDesc
+  {
+    char     name[16];
+    uint32_t type;
+    uint32_t width;     // bytes per value
+  };
+
+  struct FileHeader
+  {
+    uint32_t   magic;
+    uint32_t   version;
+    uint32_t   nColumns;
+    uint32_t   reserved;
+    ColumnDesc columns[kNbColumns];
+  };
+
+  struct ChunkHeader
+  {
+    uint32_t magic;
+    uint32_t codec;
+    uint32_t nRows;
+    uint32_t reserved;
+    uint64_t rawBytes;      // payload size once decoded
+    uint64_t storedBytes;   // payload size in the file
+    double   min[kNbColumns];
+    double   max[kNbColumns];
+  };
+
+  /// One event, in row form, as produced by the simulation
+  struct EventRecord
+  {
+    uint64_t event;
+    float    total;
+    float    edep[kNbCrystals];
+  };
+
+  /// Fills the header describing the columns above
+  void InitFileHeader(FileHeader& header);
+  /// True if the header is a B3 event file header this code can read
+  bool CheckFileHeader(const FileHeader& header);
+
+  /// Byte offset of a column inside a decoded payload of nRows rows
+  size_t ColumnOffset(int column, uint32_t nRows);
+  /// Size of a decoded payload of nRows rows
+  size_t RawPayloadBytes(uint32_t nRows);
+
+  /// Transposes rows into a raw (column-major) payload and fills the
+  /// row count, sizes and column statistics of the chunk header
+  void PackChunk(const EventRecord* rows, uint32_t nRows,
+                 ChunkHeader& header, std::vector<char>& payload);
+
+  /// Compresses a raw payload with zlib at the given level (1-9) if this
+  /// makes it smaller, and updates the codec and stored size of the header.
+  /// The work buffer is reused between calls.
+  void CompressChunk(ChunkHeader& header, std::vector<char>& payload,
+                     int level, std::vector<char>& work);
+  /// Decodes a stored payload into raw (column-major) form; returns false
+  /// if the codec is unknown or the data is corrupted
+  bool DecodeChunk(const ChunkHeader& header, const char* stored,
+                   std::vector<char>& raw);
+}
+
+#endif
@@ -0,0 +1,102 @@
+/// \file B3EventOutput.hh
+/// \brief Definition of the B3EventOutput class
+
+#ifndef B3EventOutput_h
+#define B3EventOutput_h 1
+
+#include "B3AsyncEventWriter.hh"
+#include "B3EventFormat.hh"
+#include "B3Snapshot.hh"
+#include "globals.hh"
+
+#include <set>
+#include <vector>
+
+class B3EventFileWriter;
+class G4GenericMessenger;
+
+/// Output settings of the example and per-event binary output
+///
+/// - the name of the analysis (ntuple and histogram) file, "B3" by default;
+/// - an optional B3 event file (.b3e, see B3EventFormat.hh) that receives one
+///   row per event: with /B3/output/eventFile <base>, the events of the
+///   sequential run manager go to <base>.b3e and those of each worker thread
+///   to <base>_t<thread>.b3e.
+///
+/// By default the event files are written asynchronously: the simulation
+/// threads only append rows to ring buffers, and a B3AsyncEventWriter packs,
+/// compresses (zlib, /B3/output/compression) and writes them. The master
+/// waits for the files at the end of the run and prints the back-pressure
+/// statistics used to size the rings (/B3/output/ringSize). With the ROOT
+/// ntuple switched off (/B3/output/ntuple false), which is filled
+/// synchronously by each thread, no file I/O is left in the event loop.
+///
+/// With /B3/output/singleFile true, all the threads write to the one file
+/// <base>.b3e, owned by the master: each thread fills batches of kChunkRows
+/// rows and hands them whole to the writer through a queue. The file grows
+/// during the run, and their number does not grow with the threads.
+///
+/// There is a single instance, configured by the master; the writers are
+/// thread-local.
+
+class B3EventOutput
+{
+  public:
+    static B3EventOutput* Instance();
+    ~B3EventOutput();
+
+    void SetAnalysisFileName(const G4String& name) { fAnalysisFileName = name; }
+    const G4String& GetAnalysisFileName() const { return fAnalysisFileName; }
+
+    /// Base name of the event files, empty for no event file
+    void SetEventFileBase(const G4String& base) { fEventFileBase = base; }
+    const G4String& GetEventFileBase() const { return fEventFileBase; }
+    G4bool IsEventFileEnabled() const
+    { return !fEventFileBase.empty() && fEventFileBase != "none"; }
+
+    /// If set, the rows are also filled in the ROOT ntuple
+    G4bool IsNtupleEnabled() const { return fNtuple; }
+
+    /// If set, existing event files are appended to instead of being
+    /// replaced the first time they are opened in the job
+    void SetAppend(G4bool append) { fAppend = append; }
+
+    /// Adds one event to the event file of the current thread
+    void AddEvent(const B3EventFormat::EventRecord& record);
+    /// Called by each thread at the end of a run: writes the pending rows
+    /// and closes the event file of the thread. In asynchronous mode only
+    /// the master waits, for the files of all the threads.
+    void EndOfRun();
+
+    /// Event files of a base name on disk, with their sizes
+    static std::vector<B3OutputOffset> ListEventFiles(const G4String& base);
+
+  private:
+    B3EventOutput();
+    void DefineCommands();
+    G4String ThreadFileName() const;
+    G4bool OpenWriter();
+    void PrintStatistics() const;
+
+    static B3EventOutput* fgInstance;
+    static G4ThreadLocal B3EventFileWriter* fgWriter;
+    static G4ThreadLocal B3AsyncEventWriter::Producer* fgProducer;
+    static G4ThreadLocal std::vector<B3EventFormat::EventRecord>* fgBatch;
+
+    G4GenericMessenger* fMessenger;
+    G4String fAnalysisFileName;
+    G4String fEventFileBase;
+    G4bool   fAppend;
+    G4bool   fNtuple;
+    G4bool   fAsync;
+    G4bool   fSingleFile;
+    G4int    fCompressionLevel;
+    G4int    fRingSize;
+    B3AsyncEventWriter* fAsyncWriter;
+    B3AsyncEventWriter::SharedFile* fSharedFile;
+    std::set<G4String> fOpenedFiles;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
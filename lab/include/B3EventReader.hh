@@ -0,0 +1,131 @@
+/// \file B3EventReader.hh
+/// \brief Definition of the B3EventReader class
+
+#ifndef B3EventReader_h
+#define B3EventReader_h 1
+
+#include "B3EventFormat.hh"
+#include "B3MappedFile.hh"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Read-only view of nRows values of a column, valid until the next batch
+template <class T>
+struct B3Span
+{
+  const T* data;
+  size_t   size;
+
+  const T* begin() const { return data; }
+  const T* end() const { return data + size; }
+  const T& operator[](size_t i) const { return data[i]; }
+};
+
+/// Reader of B3 event files (see B3EventFormat.hh) without ROOT
+///
+/// The file is mmap-ed and read one chunk at a time. Each chunk is a batch
+/// of up to kChunkRows rows whose columns are contiguous arrays: for raw
+/// chunks the spans point into the mapping (no copy), compressed chunks are
+/// decoded once into a buffer of the reader.
+///
+/// Range conditions on columns are pushed down: chunks whose min/max
+/// statistics exclude a condition are skipped without being read, and the
+/// batches of the other chunks carry a selection mask computed with
+/// branch-free loops. For example, to read the photopeak events only:
+///
+///   B3EventReader reader;
+///   reader.Open("B3.b3e");
+///   reader.AddRange(B3EventFormat::kTotal, 350., 650.);
+///   B3EventReader::Batch batch;
+///   while (reader.Next(batch)) {
+///     B3Span<float> total = batch.Column(B3EventFormat::kTotal);
+///     for (size_t i = 0; i < batch.nRows; i++) sum += batch.mask[i]*total[i];
+///   }
+///
+/// It does not depend on Geant4.
+
+class B3EventReader
+{
+  public:
+    struct Batch
+    {
+      uint32_t nRows;
+      uint32_t nSelected;
+      /// 1 for the rows that pass all the ranges, 0 otherwise
+      const uint8_t* mask;
+
+      B3Span<uint64_t> Events() const;
+      /// Energy columns (kTotal, kCrystal0 + i), keV
+      B3Span<float> Column(int column) const;
+
+      const char* payload;   // decoded, column-major
+    };
+
+    struct Statistics
+    {
+      uint64_t chunks;
+      uint64_t chunksSkipped;
+      uint64_t rowsRead;
+      uint64_t rowsSelected;
+      uint64_t bytesRead;       // stored bytes of the chunks read
+      uint64_t chunksDecoded;   // compressed chunks
+    };
+
+    B3EventReader();
+    ~B3EventReader();
+
+    /// Maps the file and indexes its chunks; returns false if it is not a
+    /// B3 event file. A chunk cut at the end of the file is ignored. The
+    /// statistics and the error state are reset.
+    bool Open(const std::string& fileName);
+    void Close();
+    const std::string& GetFileName() const { return fFile.GetFileName(); }
+
+    /// Rows and chunks of the file (complete chunks only)
+    uint64_t GetNbRows() const { return fNbRows; }
+    size_t GetNbChunks() const { return fChunks.size(); }
+    /// Column index from its name ("event", "total", "crystal0"...), -1 if
+    /// unknown
+    int FindColumn(const std::string& name) const;
+
+    /// Keeps the rows with lo <= column <= hi; conditions are combined with
+    /// a logical and
+    void AddRange(int column, double lo, double hi);
+    void ClearRanges() { fRanges.clear(); }
+
+    /// Goes back to the first chunk
+    void Rewind() { fNextChunk = 0; fError = false; }
+    /// Reads the next chunk that may contain selected rows; returns false
+    /// at the end of the file or on a corrupted chunk (see HasError)
+    bool Next(Batch& batch);
+    /// True if Next stopped on a chunk that could not be decoded, and not
+    /// at the end of the file
+    bool HasError() const { return fError; }
+
+    const Statistics& GetStatistics() const { return fStatistics; }
+
+  private:
+    B3EventReader(const B3EventReader&);
+    B3EventReader& operator=(const B3EventReader&);
+
+    struct Range { int column; double lo, hi; };
+
+    bool MayPass(const B3EventFormat::ChunkHeader& header) const;
+    uint32_t Select(const Batch& batch);
+
+    B3MappedFile fFile;
+    B3EventFormat::FileHeader fHeader;
+    std::vector<uint64_t> fChunks;      // offsets of the chunk headers
+    uint64_t fNbRows;
+    size_t   fNextChunk;
+    bool     fError;
+    std::vector<Range> fRanges;
+    std::vector<char> fDecoded;
+    std::vector<uint8_t> fMask;
+    Statistics fStatistics;
+};
+
+#endif
@@ -0,0 +1,76 @@
+/// \file B3ForcedInteraction.hh
+/// \brief Definition of the B3ForcedInteraction class
+
+#ifndef B3ForcedInteraction_h
+#define B3ForcedInteraction_h 1
+
+#include "G4VBiasingOperator.hh"
+
+#include <set>
+
+class G4BOptrForceCollision;
+
+/// Biasing operator of the crystals: forced first interaction of the
+/// primary photons (see B3Biasing)
+///
+/// The forcing is done by a G4BOptrForceCollision, which splits a photon
+/// entering the volume into a copy forced to interact and the photon,
+/// which crosses the volume with the weight of no interaction. Applied to
+/// every photon, it would split again the photons scattered in a crystal,
+/// whose first deposit is already scored with their weight. This operator
+/// hands it only the photons that did not interact yet in the crystals:
+/// the primary and the copies made by its splits, until their forced
+/// interaction. The other particles are tracked without biasing.
+///
+/// Each split starts new branches of the event: the copy, and the photon
+/// which goes on with another weight, are given new branch numbers
+/// (B3TrackInformation), passed on to their secondaries, by which
+/// B3PSBranchEnergy groups the energy deposits.
+
+class B3ForcedInteraction : public G4VBiasingOperator
+{
+  public:
+    B3ForcedInteraction(const G4String& particleName,
+                        const G4String& name = "B3ForcedInteraction");
+    virtual ~B3ForcedInteraction();
+
+    virtual void StartTracking(const G4Track* track);
+
+  private:
+    virtual G4VBiasingOperation*
+    ProposeOccurenceBiasingOperation(const G4Track* track,
+                                     const G4BiasingProcessInterface* callingProcess);
+    virtual G4VBiasingOperation*
+    ProposeFinalStateBiasingOperation(const G4Track* track,
+                                      const G4BiasingProcessInterface* callingProcess);
+    virtual G4VBiasingOperation*
+    ProposeNonPhysicsBiasingOperation(const G4Track* track,
+                                      const G4BiasingProcessInterface* callingProcess);
+
+    virtual void OperationApplied(const G4BiasingProcessInterface* callingProcess,
+                                  G4BiasingAppliedCase biasingCase,
+                                  G4VBiasingOperation* operationApplied,
+                                  const G4VParticleChange* particleChangeProduced);
+    virtual void OperationApplied(const G4BiasingProcessInterface* callingProcess,
+                                  G4BiasingAppliedCase biasingCase,
+                                  G4VBiasingOperation* occurenceOperationApplied,
+                                  G4double weightForOccurenceInteraction,
+                                  G4VBiasingOperation* finalStateOperationApplied,
+                                  const G4VParticleChange* particleChangeProduced);
+    virtual void ExitBiasing(const G4Track* track,
+                             const G4BiasingProcessInterface* callingProcess);
+
+    G4BOptrForceCollision* fForceCollision;
+    /// Current track, and whether it is handed to the forcing
+    const G4Track* fTrack;
+    G4bool fEligible;
+    /// Branches of the event so far, the first one being that of the
+    /// primary
+    G4int fNbBranches;
+    /// Copies made by the splits, not tracked yet
+    std::set<const G4Track*> fCopies;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
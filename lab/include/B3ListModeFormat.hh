@@ -0,0 +1,137 @@
+/// \file B3ListModeFormat.hh
+/// \brief Layout of the B3 list-mode files (.b3lm)
+
+#ifndef B3ListModeFormat_h
+#define B3ListModeFormat_h 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// List-mode file of coincidences (lines of response) written by the
+/// simulation (B3ListModeOutput) and read by the reconstruction tools.
+/// It does not depend on Geant4.
+///
+/// A file is a FileHeader, the crystal table (nCrystals CrystalEntry, in
+/// crystal ID order), a sequence of blocks and, once the file is closed,
+/// a block index followed by a Trailer. Each block is a BlockHeader and up
+/// to blockRecords packed records, zlib-compressed or raw. The index gives
+/// the offset and first record of every block, for random access; a file
+/// without trailer (interrupted job) can still be read block by block.
+///
+/// A record is one 64-bit word:
+///   bits  0-19  crystal pair ID (see PairId)
+///   bits 20-35  time of the second crystal minus time of the first, in
+///               timeBin units, two's complement
+///   bits 36-43  energy of the first crystal, in energyBin units
+///   bits 44-51  energy of the second crystal, in energyBin units
+///   bits 52-63  reserved (0)
+/// Values out of range saturate.
+
+namespace B3ListModeFormat
+{
+  const uint32_t kFileMagic    = 0x4D4C3342;   // "B3LM"
+  const uint32_t kBlockMagic   = 0x4B4C4D42;   // "BMLK"
+  const uint32_t kTrailerMagic = 0x58444E49;   // "INDX"
+  const uint32_t kVersion      = 1;
+
+  /// Default number of records per block
+  const uint32_t kBlockRecords = 65536;
+  /// Quantisation of the time difference (ps) and of the energies (keV)
+  const float kTimeBin   = 10.f;
+  const float kEnergyBin = 4.f;
+
+  const int kPairBits   = 20;
+  const int kTimeBits   = 16;
+  const int kEnergyBits = 8;
+  /// Largest number of crystals whose pairs fit in kPairBits
+  const uint32_t kMaxCrystals = 1448;
+
+  /// Encoding of the block payload
+  enum Codec { kRaw = 0, kZlib = 1 };
+
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nCrystals;
+    uint32_t blockRecords;
+    float    timeBin;       // ps
+    float    energyBin;     // keV
+    uint32_t reserved[2];
+  };
+
+  /// Crystal of the scanner, in mm, in the world frame
+  struct CrystalEntry
+  {
+    float center[3];
+    float halfSize[3];
+  };
+
+  struct BlockHeader
+  {
+    uint32_t magic;
+    uint32_t codec;
+    uint32_t nRecords;
+    uint32_t reserved;
+    uint64_t firstRecord;
+    uint64_t storedBytes;
+  };
+
+  struct IndexEntry
+  {
+    uint64_t offset;        // of the block header
+    uint64_t firstRecord;
+    uint32_t nRecords;
+    uint32_t reserved;
+  };
+
+  struct Trailer
+  {
+    uint64_t indexOffset;
+    uint32_t nBlocks;
+    uint32_t magic;
+  };
+
+  /// Unpacked record
+  struct Coincidence
+  {
+    uint32_t pair;
+    int32_t  timeDiff;      // timeBin units
+    uint32_t energy1;       // energyBin units
+    uint32_t energy2;
+  };
+
+  /// Symmetric ID of the pair of two different crystals
+  inline uint32_t PairId(uint32_t a, uint32_t b)
+  {
+    if (a > b) { uint32_t c = a; a = b; b = c; }
+    return b*(b-1)/2 + a;
+  }
+  /// Crystals of a pair, first < second
+  void PairCrystals(uint32_t pair, uint32_t& first, uint32_t& second);
+  /// Number of pairs of n crystals
+  inline uint32_t NbPairs(uint32_t nCrystals) { return nCrystals*(nCrystals-1)/2; }
+
+  /// Record of the coincidence of crystals a and b (any order), with their
+  /// times (ps) and energies (keV)
+  uint64_t Pack(uint32_t a, double timeA, double energyA,
+                uint32_t b, double timeB, double energyB);
+  uint64_t Pack(const Coincidence& coincidence);
+  Coincidence Unpack(uint64_t record);
+
+  void InitFileHeader(FileHeader& header, uint32_t nCrystals);
+  bool CheckFileHeader(const FileHeader& header);
+  /// Size of the header and crystal table, where the first block starts
+  size_t BlocksOffset(uint32_t nCrystals);
+
+  /// Fills the header of a block of records and compresses them with zlib
+  /// at the given level (0 for raw) if this makes them smaller
+  void PackBlock(const uint64_t* records, uint32_t nRecords, uint64_t firstRecord,
+                 int level, BlockHeader& header, std::vector<char>& payload);
+  /// Decodes a block payload; returns false if it is corrupted
+  bool DecodeBlock(const BlockHeader& header, const char* stored,
+                   std::vector<uint64_t>& records);
+}
+
+#endif
@@ -0,0 +1,100 @@
+/// \file B3ListModeOutput.hh
+/// \brief Definition of the B3ListModeOutput class
+
+#ifndef B3ListModeOutput_h
+#define B3ListModeOutput_h 1
+
+#include "B3ListModeFormat.hh"
+#include "globals.hh"
+
+#include <set>
+#include <vector>
+
+class B3ListModeWriter;
+class G4GenericMessenger;
+
+/// List-mode output of the coincidences (lines of response)
+///
+/// Each event is reduced to at most one coincidence: the crystals with a
+/// nonzero deposit of at least energyThreshold are the singles; if there
+/// are two or more, the two most energetic ones form a coincidence when
+/// their first-hit times (B3PSHitTime) differ by at most timeWindow. With
+/// /B3/listmode/file <base>, the coincidence of each persisted event (see
+/// B3Trigger) is written as one packed 8-byte record (crystal pair, time
+/// difference, energies, see B3ListModeFormat.hh) to <base>.b3lm or, for
+/// each worker thread, <base>_t<thread>.b3lm, in compressed blocks with an
+/// index. In a shard, the files carry the tag _shard<i> and are truncated
+/// back to their size at the checkpoint the shard is resumed from (see
+/// B3ShardManager), then continued.
+///
+/// The crystal IDs are the copy numbers of the crystals; their table is set
+/// by B3DetectorConstruction and stored in the header of the files.
+///
+///   /B3/listmode/file pet
+///   /B3/listmode/energyThreshold 100 keV
+///   /B3/listmode/timeWindow 4 ns
+///
+/// The coincidence finder also feeds the sinogram (B3SinogramOutput), with
+/// the coincidences of all the events; the counters printed at the end of
+/// the run also count all the events.
+///
+/// There is a single instance, configured by the master; the writers and
+/// counters are thread-local and the master prints the counters of the run.
+
+class B3ListModeOutput
+{
+  public:
+    static B3ListModeOutput* Instance();
+    ~B3ListModeOutput();
+
+    /// Crystal table of the scanner, indexed by copy number
+    void SetCrystals(const std::vector<B3ListModeFormat::CrystalEntry>& crystals)
+    { fCrystals = crystals; }
+    const std::vector<B3ListModeFormat::CrystalEntry>& GetCrystals() const
+    { return fCrystals; }
+
+    G4bool IsEnabled() const { return !fFileBase.empty() && fFileBase != "none"; }
+
+    /// Looks for a coincidence in the energies and first-hit times of the
+    /// nCrystals crystals of an event (Geant4 units). If there is one, it is
+    /// written to the list-mode file (if switched on and the event is
+    /// persisted) and its crystals are returned, the most energetic first.
+    G4bool AddEvent(const G4double* edep, const G4double* time, G4int nCrystals,
+                    G4bool persist, G4int& first, G4int& second);
+    /// Called by each thread at the end of a run: closes the file of the
+    /// thread; the master prints the counters of all the threads
+    void EndOfRun();
+
+  private:
+    /// Events seen by the coincidence finder
+    struct Counters
+    {
+      G4long events;
+      G4long singles;        // exactly one crystal above threshold
+      G4long coincidences;
+      G4long multiples;      // coincidences from more than two crystals
+      G4long outOfWindow;    // two or more crystals, too far apart in time
+    };
+
+    B3ListModeOutput();
+    void DefineCommands();
+    G4String ThreadFileName() const;
+    G4bool OpenWriter();
+
+    static B3ListModeOutput* fgInstance;
+    static G4ThreadLocal B3ListModeWriter* fgWriter;
+    static G4ThreadLocal Counters* fgCounters;
+
+    G4GenericMessenger* fMessenger;
+    G4String fFileBase;
+    G4double fEnergyThreshold;
+    G4double fTimeWindow;
+    G4int    fCompressionLevel;
+    std::vector<B3ListModeFormat::CrystalEntry> fCrystals;
+    std::set<G4String> fOpenedFiles;
+    Counters fRunCounters;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,51 @@
+/// \file B3ListModeReader.hh
+/// \brief Definition of the B3ListModeReader class
+
+#ifndef B3ListModeReader_h
+#define B3ListModeReader_h 1
+
+#include "B3ListModeFormat.hh"
+#include "B3MappedFile.hh"
+
+#include <string>
+#include <vector>
+
+/// Reader of B3 list-mode files (see B3ListModeFormat.hh)
+///
+/// The file is mmap-ed; the block index comes from the trailer or, for a
+/// file that was not closed, from a scan of the block headers. Blocks are
+/// decoded one at a time, in any order.
+
+class B3ListModeReader
+{
+  public:
+    B3ListModeReader();
+
+    /// Returns false if the file is not a B3 list-mode file
+    bool Open(const std::string& fileName);
+    void Close();
+
+    const B3ListModeFormat::FileHeader& GetHeader() const { return fHeader; }
+    /// Crystal table of the scanner, indexed by crystal ID
+    const std::vector<B3ListModeFormat::CrystalEntry>& GetCrystals() const
+    { return fCrystals; }
+
+    uint64_t GetNbRecords() const { return fNbRecords; }
+    size_t GetNbBlocks() const { return fIndex.size(); }
+    const B3ListModeFormat::IndexEntry& GetBlock(size_t block) const { return fIndex[block]; }
+
+    /// Decodes a block; returns false if it is corrupted
+    bool ReadBlock(size_t block, std::vector<uint64_t>& records) const;
+    /// Decodes the records [first, first+count) (fewer at the end of the
+    /// file); returns false on a corrupted block
+    bool Read(uint64_t first, uint64_t count, std::vector<uint64_t>& records) const;
+
+  private:
+    B3MappedFile fFile;
+    B3ListModeFormat::FileHeader fHeader;
+    std::vector<B3ListModeFormat::CrystalEntry> fCrystals;
+    std::vector<B3ListModeFormat::IndexEntry> fIndex;
+    uint64_t fNbRecords;
+};
+
+#endif
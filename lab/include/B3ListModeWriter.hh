@@ -0,0 +1,61 @@
+/// \file B3ListModeWriter.hh
+/// \brief Definition of the B3ListModeWriter class
+
+#ifndef B3ListModeWriter_h
+#define B3ListModeWriter_h 1
+
+#include "B3ListModeFormat.hh"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// Writer of a B3 list-mode file (see B3ListModeFormat.hh)
+///
+/// Records are buffered and written as one block every blockRecords
+/// records; Close() writes the last block, the index and the trailer.
+/// A closed file opened again in append mode is continued: its index is
+/// read back and the new blocks overwrite it.
+
+class B3ListModeWriter
+{
+  public:
+    B3ListModeWriter(int compressionLevel = 1,
+                     uint32_t blockRecords = B3ListModeFormat::kBlockRecords);
+    ~B3ListModeWriter();
+
+    /// Opens (append = false: creates or truncates) the file with the
+    /// crystal table of the scanner. Returns false if it cannot be opened,
+    /// or if the file to append to has another crystal table.
+    bool Open(const std::string& fileName, bool append,
+              const std::vector<B3ListModeFormat::CrystalEntry>& crystals);
+    /// Writes the pending records, the index and the trailer. Returns
+    /// false if a block, the index or the trailer could not be written.
+    bool Close();
+    bool IsOpen() const { return fFile != 0; }
+    const std::string& GetFileName() const { return fFileName; }
+
+    void Add(uint64_t record)
+    {
+      fRecords.push_back(record);
+      if (fRecords.size() >= fBlockRecords) WriteBlock();
+    }
+    uint64_t GetNbRecords() const { return fNbRecords + fRecords.size(); }
+
+  private:
+    bool ReadIndex(std::FILE* file, const std::vector<B3ListModeFormat::CrystalEntry>& crystals);
+    void WriteBlock();
+
+    std::FILE* fFile;
+    std::string fFileName;
+    int        fCompressionLevel;
+    uint32_t   fBlockRecords;
+    uint64_t   fOffset;          // end of the last block
+    uint64_t   fNbRecords;       // records in the blocks written
+    bool       fError;           // a block could not be written
+    std::vector<uint64_t> fRecords;
+    std::vector<B3ListModeFormat::IndexEntry> fIndex;
+    std::vector<char> fPayload;
+};
+
+#endif
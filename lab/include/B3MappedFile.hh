@@ -0,0 +1,43 @@
+/// \file B3MappedFile.hh
+/// \brief Definition of the B3MappedFile class
+
+#ifndef B3MappedFile_h
+#define B3MappedFile_h 1
+
+#include <stdint.h>
+#include <string>
+
+/// Read-only memory mapping of a whole file (POSIX mmap)
+
+class B3MappedFile
+{
+  public:
+    enum Access { kNormal, kSequential, kRandom };
+
+    B3MappedFile();
+    ~B3MappedFile();
+
+    /// Maps the file; returns false (and leaves the object closed) if the
+    /// file cannot be opened or mapped. An empty file maps to no data.
+    bool Open(const std::string& fileName, Access access = kNormal);
+    void Close();
+
+    bool IsOpen() const { return fOpen; }
+    const char* Data() const { return fData; }
+    uint64_t Size() const { return fSize; }
+    const std::string& GetFileName() const { return fFileName; }
+
+    /// Asks the kernel to read a range ahead of its use
+    void WillNeed(uint64_t offset, uint64_t length) const;
+
+  private:
+    B3MappedFile(const B3MappedFile&);
+    B3MappedFile& operator=(const B3MappedFile&);
+
+    std::string fFileName;
+    const char* fData;
+    uint64_t    fSize;
+    bool        fOpen;
+};
+
+#endif
@@ -0,0 +1,102 @@
+/// \file B3Osem.hh
+/// \brief Definition of the B3Osem class
+
+#ifndef B3Osem_h
+#define B3Osem_h 1
+
+#include "B3Siddon.hh"
+
+#include <vector>
+
+class B3SystemMatrix;
+
+/// Multithreaded OSEM reconstruction with a Siddon projector
+///
+/// The scanner is described by its lines of response (AddLine): crystal
+/// pairs for list-mode data, sinogram bins for sinograms, each with the
+/// weight it has in the sensitivity image (e.g. the number of crystal
+/// pairs of a sinogram bin). The data are events on these lines (AddEvent)
+/// with their counts and, optionally, the time-of-flight position of the
+/// annihilation along the line.
+///
+/// The events are split into subsets by key (key % nSubsets: the event
+/// number for list-mode data, the angle for sinograms). Each subset update
+/// is spread over the threads by contiguous ranges of events, each thread
+/// back-projecting into its own image; the images are then added over
+/// ranges of voxels. With a TOF resolution, the projections along a line
+/// are weighted by a Gaussian kernel centred on the TOF position.
+///
+/// The rows of the lines are traced on the fly or, with a system matrix of
+/// the same lines and grid (SetSystemMatrix), read from it: the projections
+/// are then sparse matrix-vector products.
+///
+/// It does not depend on Geant4.
+
+class B3Osem
+{
+  public:
+    struct Statistics
+    {
+      unsigned int iterations;
+      double   seconds;           // in Iterate()
+      double   sensitivitySeconds;
+      uint64_t linesTraced;
+    };
+
+    B3Osem(const B3ImageGrid& grid);
+
+    void SetThreads(unsigned int nThreads) { fNbThreads = nThreads ? nThreads : 1; }
+    void SetSubsets(unsigned int nSubsets) { fNbSubsets = nSubsets ? nSubsets : 1; }
+    /// FWHM of the coincidence time resolution (ps), 0 for no TOF
+    void SetTofResolution(double fwhm) { fTofFwhm = fwhm; }
+    /// Precomputed rows of the lines, 0 to trace them
+    void SetSystemMatrix(const B3SystemMatrix* matrix) { fMatrix = matrix; }
+
+    /// Adds a line of response from start to end (mm); returns its index
+    uint32_t AddLine(const double start[3], const double end[3], float weight);
+    /// Adds counts on a line; tofCenter is the position of the annihilation
+    /// from the middle of the line towards its end (mm)
+    void AddEvent(uint32_t line, float counts, float tofCenter, uint32_t key);
+    size_t GetNbLines() const { return fLines.size(); }
+    size_t GetNbEvents() const { return fEvents.size(); }
+
+    /// Computes the sensitivity image and sets a uniform starting image
+    void Initialize();
+    /// One iteration: one update per subset
+    void Iterate();
+
+    const B3ImageGrid& GetGrid() const { return fGrid; }
+    const std::vector<float>& GetImage() const { return fImage; }
+    const std::vector<float>& GetSensitivity() const { return fSensitivity; }
+    const Statistics& GetStatistics() const { return fStatistics; }
+
+  private:
+    struct Line { double start[3], end[3]; float weight; };
+    struct Event { uint32_t line; float counts; float tofCenter; uint32_t key; };
+    /// Trace of a line in a thread, with the TOF weights applied
+    struct Trace
+    {
+      std::vector<uint32_t> voxels;
+      std::vector<float> lengths;
+    };
+
+    /// Row of a line, TOF-weighted if tof is set
+    void TraceLine(uint32_t line, float tofCenter, bool tof, Trace& trace) const;
+    void UpdateSubset(size_t begin, size_t end);
+    void AddImages(std::vector<float>& sum);
+
+    B3ImageGrid fGrid;
+    unsigned int fNbThreads;
+    unsigned int fNbSubsets;
+    double fTofFwhm;
+    const B3SystemMatrix* fMatrix;
+    std::vector<Line> fLines;
+    std::vector<Event> fEvents;
+    std::vector<size_t> fSubsetBegin;        // events sorted by subset
+    std::vector<float> fImage;
+    std::vector<float> fSensitivity;
+    std::vector<std::vector<float> > fThreadImages;
+    Statistics fStatistics;
+};
+
+#endif
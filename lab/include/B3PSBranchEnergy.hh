@@ -0,0 +1,46 @@
+/// \file B3PSBranchEnergy.hh
+/// \brief Definition of the B3PSBranchEnergy class
+
+#ifndef B3PSBranchEnergy_h
+#define B3PSBranchEnergy_h 1
+
+#include "G4VPrimitiveScorer.hh"
+#include "G4THitsMap.hh"
+
+#include <vector>
+
+/// Primitive scorer of the energy deposit per branch of a biased event
+///
+/// With the forced interactions (B3Biasing), the tracks of an event carry
+/// the number of their branch (B3ForcedInteraction, B3TrackInformation)
+/// and its weight. The steps are grouped by branch number, in the order
+/// the branches appear: the energy deposited (not weighted) by
+/// branch b in copy number c is at key b*nbCopies + c, and the weight of
+/// branch b at key -1-b. Steps of zero weight (the photon crossing a
+/// crystal while its forced copy interacts) do not score.
+
+class B3PSBranchEnergy : public G4VPrimitiveScorer
+{
+  public:
+    B3PSBranchEnergy(G4String name, G4int nbCopies, G4int depth = 0);
+    virtual ~B3PSBranchEnergy();
+
+    virtual void Initialize(G4HCofThisEvent*);
+    virtual void EndOfEvent(G4HCofThisEvent*);
+    virtual void clear();
+    virtual void DrawAll();
+    virtual void PrintAll();
+
+  protected:
+    virtual G4bool ProcessHits(G4Step*, G4TouchableHistory*);
+
+  private:
+    G4int fHCID;
+    G4int fNbCopies;
+    G4THitsMap<G4double>* fEvtMap;
+    std::vector<G4int> fBranchIds;      // of the branches of the event
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,30 @@
+/// \file B3PSEnergyDeposit.hh
+/// \brief Definition of the B3PSEnergyDeposit class
+
+#ifndef B3PSEnergyDeposit_h
+#define B3PSEnergyDeposit_h 1
+
+#include "G4PSEnergyDeposit.hh"
+
+/// Primitive scorer of the energy deposit per primary
+///
+/// G4PSEnergyDeposit, with the deposits of primary p (see B3Batching) in
+/// copy number c at key p*nbCopies + c: the key is the copy number in the
+/// events with one primary.
+
+class B3PSEnergyDeposit : public G4PSEnergyDeposit
+{
+  public:
+    B3PSEnergyDeposit(G4String name, G4int nbCopies, G4int depth = 0);
+    virtual ~B3PSEnergyDeposit();
+
+  protected:
+    virtual G4int GetIndex(G4Step*);
+
+  private:
+    G4int fNbCopies;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
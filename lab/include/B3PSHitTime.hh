@@ -0,0 +1,41 @@
+/// \file B3PSHitTime.hh
+/// \brief Definition of the B3PSHitTime class
+
+#ifndef B3PSHitTime_h
+#define B3PSHitTime_h 1
+
+#include "G4VPrimitiveScorer.hh"
+#include "G4THitsMap.hh"
+
+/// Primitive scorer of the time of the first energy deposit
+///
+/// For each copy number, the smallest global time of the steps that
+/// deposit energy in the volume: the time stamp of the crystal for the
+/// list-mode output (B3ListModeOutput). The time of primary p (see
+/// B3Batching) in copy number c is at key p*nbCopies + c.
+
+class B3PSHitTime : public G4VPrimitiveScorer
+{
+  public:
+    B3PSHitTime(G4String name, G4int nbCopies, G4int depth = 0);
+    virtual ~B3PSHitTime();
+
+    virtual void Initialize(G4HCofThisEvent*);
+    virtual void EndOfEvent(G4HCofThisEvent*);
+    virtual void clear();
+    virtual void DrawAll();
+    virtual void PrintAll();
+
+  protected:
+    virtual G4bool ProcessHits(G4Step*, G4TouchableHistory*);
+    virtual G4int GetIndex(G4Step*);
+
+  private:
+    G4int fHCID;
+    G4int fNbCopies;
+    G4THitsMap<G4double>* fEvtMap;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
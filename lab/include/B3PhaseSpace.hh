@@ -0,0 +1,126 @@
+/// \file B3PhaseSpace.hh
+/// \brief Definition of the B3PhaseSpace class
+
+#ifndef B3PhaseSpace_h
+#define B3PhaseSpace_h 1
+
+#include "B3PhaseSpaceFormat.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+#include <cmath>
+#include <set>
+#include <vector>
+
+class B3MappedFile;
+class B3PhaseSpaceWriter;
+class G4Event;
+class G4GenericMessenger;
+class G4Run;
+class G4Step;
+
+/// Phase space at a surface around the crystals: recording and replay
+///
+/// The surface is a box (not a volume) around the crystal array. With
+///   /B3/phasespace/record <base>
+/// every particle entering the box is written (particle, kinetic energy,
+/// position and time of the crossing point, direction, weight, global event
+/// number) to <base>.b3ps or, for each worker thread, <base>_t<thread>.b3ps
+/// (see B3PhaseSpaceFormat.hh), and killed: the secondaries born inside the
+/// box are killed by B3StackingAction, so that nothing inside the box is
+/// transported. The source must be outside the box; particles going out of
+/// the box and back in are lost with it. In a shard, the files carry the
+/// tag _shard<i> and are truncated back to their size at the checkpoint
+/// the shard is resumed from (see B3ShardManager), then continued.
+///
+/// With
+///   /B3/phasespace/replay <base>
+/// the files <base>.b3ps, <base>_t*.b3ps and <base>_shard*.b3ps (shards,
+/// see B3ShardManager), whose records must be in the order of the events,
+/// are mapped in memory and each event starts with the particles recorded
+/// for one source event, at their crossing points
+/// (B3PrimaryGeneratorAction): the source and the phantom are not
+/// simulated again, only the detector inside the box, whose geometry may
+/// have changed. The event of global number i (see
+/// B3RandomStreams) replays the source event firstEvent + i of the files,
+/// events without particles included, so the tallies are normalised to the
+/// source events; the phase space is reused from the start once all its
+/// events are replayed.
+///
+///   /B3/phasespace/center 38 0 0 mm
+///   /B3/phasespace/halfSize 12 7 5.5 mm
+///
+/// There is a single instance, configured by the master; the writers are
+/// thread-local and the mapped files are shared by the threads.
+
+class B3PhaseSpace
+{
+  public:
+    static B3PhaseSpace* Instance();
+    ~B3PhaseSpace();
+
+    G4bool IsRecording() const { return !fRecordBase.empty() && fRecordBase != "none"; }
+    G4bool IsReplaying() const { return !fReplayBase.empty() && fReplayBase != "none"; }
+    /// True if a point is inside the box of the surface
+    G4bool IsInside(const G4ThreeVector& position) const
+    {
+      G4ThreeVector local = position - fCenter;
+      return std::fabs(local.x()) < fHalfSize.x() && std::fabs(local.y()) < fHalfSize.y()
+          && std::fabs(local.z()) < fHalfSize.z();
+    }
+
+    /// Called by the master at the beginning of a run: event range of the
+    /// recording, mapping of the files of the replay
+    void BeginOfRun(const G4Run* run);
+    /// Called by each thread at the end of a run: closes the file of the
+    /// thread
+    void EndOfRun();
+
+    /// Records the track of a step entering the box, and kills it
+    void RecordStep(const G4Step* step);
+    /// Adds the particles recorded for the source event of an event
+    void GeneratePrimaries(G4Event* event);
+
+  private:
+    /// A mapped phase-space file
+    struct ReplayFile
+    {
+      B3MappedFile* file;
+      const B3PhaseSpaceFormat::Record* begin;
+      const B3PhaseSpaceFormat::Record* end;
+    };
+
+    B3PhaseSpace();
+    void DefineCommands();
+    G4String ThreadFileName() const;
+    G4bool OpenWriter();
+    void OpenReplayFiles();
+    void CloseReplayFiles();
+    /// Parameter of the point where the segment start + t*move enters the
+    /// box, if it does for t in [0, 1]; start relative to the centre
+    G4bool Enters(const G4ThreeVector& start, const G4ThreeVector& move, G4double& t) const;
+
+    static B3PhaseSpace* fgInstance;
+    static G4ThreadLocal B3PhaseSpaceWriter* fgWriter;
+    /// Position of the replay of the thread in each file
+    static G4ThreadLocal std::vector<size_t>* fgCursors;
+
+    G4GenericMessenger* fMessenger;
+    G4String      fRecordBase;
+    G4String      fReplayBase;
+    G4ThreeVector fCenter;
+    G4ThreeVector fHalfSize;
+    // recording
+    G4long fRunFirstEvent;
+    G4long fRunEndEvent;
+    std::set<G4String> fOpenedFiles;
+    // replay
+    std::vector<ReplayFile> fReplayFiles;
+    G4long fSourceFirstEvent;
+    G4long fNbSourceEvents;
+    G4bool fRecycleWarned;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,60 @@
+/// \file B3PhaseSpaceFormat.hh
+/// \brief Layout of the B3 phase-space files (.b3ps)
+
+#ifndef B3PhaseSpaceFormat_h
+#define B3PhaseSpaceFormat_h 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Phase-space file of the particles entering the surface around the
+/// crystals, written and replayed by the simulation (B3PhaseSpace). It
+/// does not depend on Geant4.
+///
+/// A file is a FileHeader followed by nRecords fixed-size records, sorted
+/// by event (the events of a thread are processed in increasing order), so
+/// that the mmap-ed records are read in place and the particles of an
+/// event are found by a binary search. The header gives the range of the
+/// global event numbers of the recorded runs, events without particles
+/// included. Values are stored in the native (little-endian) order.
+
+namespace B3PhaseSpaceFormat
+{
+  const uint32_t kFileMagic = 0x53503342;   // "B3PS"
+  const uint32_t kVersion   = 1;
+
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordBytes;
+    uint32_t reserved;
+    uint64_t firstEvent;        // global event numbers [firstEvent, endEvent)
+    uint64_t endEvent;
+    uint64_t nRecords;
+    float    center[3];         // box of the surface, mm, world frame
+    float    halfSize[3];
+  };
+
+  /// A particle crossing the surface, at the crossing point
+  struct Record
+  {
+    uint64_t event;             // global event number
+    int32_t  pdg;
+    float    energy;            // kinetic, keV
+    float    position[3];       // mm
+    float    direction[3];
+    float    time;              // global, ns
+    float    weight;
+  };
+
+  /// Fills the magic, version and record size of a header
+  void InitFileHeader(FileHeader& header);
+  /// True if the header is a B3 phase-space header this code can read
+  bool CheckFileHeader(const FileHeader& header);
+
+  /// First record of an event or of a later one, in records sorted by event
+  const Record* LowerBound(const Record* begin, const Record* end, uint64_t event);
+}
+
+#endif
@@ -0,0 +1,56 @@
+/// \file B3PhaseSpaceWriter.hh
+/// \brief Definition of the B3PhaseSpaceWriter class
+
+#ifndef B3PhaseSpaceWriter_h
+#define B3PhaseSpaceWriter_h 1
+
+#include "B3PhaseSpaceFormat.hh"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// Writer of a B3 phase-space file (see B3PhaseSpaceFormat.hh)
+///
+/// Records are buffered and written bufferRecords at a time; Close() writes
+/// the last ones and the number of records in the header. A file opened
+/// again in append mode is continued with the events of the new run; the
+/// readers take the number of records from the size of the file, so that
+/// the file of an interrupted job can be read.
+
+class B3PhaseSpaceWriter
+{
+  public:
+    B3PhaseSpaceWriter(uint32_t bufferRecords = 4096);
+    ~B3PhaseSpaceWriter();
+
+    /// Opens (append = false: creates or truncates) the file for the events
+    /// [firstEvent, endEvent) of the header, which gives the surface.
+    /// Returns false if it cannot be opened, or if the file to append to
+    /// has another surface.
+    bool Open(const std::string& fileName, bool append,
+              const B3PhaseSpaceFormat::FileHeader& header);
+    /// Writes the pending records and the header. Returns false if
+    /// records or the header could not be written.
+    bool Close();
+    bool IsOpen() const { return fFile != 0; }
+    const std::string& GetFileName() const { return fFileName; }
+
+    void Add(const B3PhaseSpaceFormat::Record& record)
+    {
+      fRecords.push_back(record);
+      if (fRecords.size() >= fBufferRecords) Flush();
+    }
+
+  private:
+    void Flush();
+
+    std::FILE*  fFile;
+    std::string fFileName;
+    uint32_t    fBufferRecords;
+    bool        fError;          // records could not be written
+    B3PhaseSpaceFormat::FileHeader fHeader;
+    std::vector<B3PhaseSpaceFormat::Record> fRecords;
+};
+
+#endif
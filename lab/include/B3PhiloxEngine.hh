@@ -0,0 +1,57 @@
+/// \file B3PhiloxEngine.hh
+/// \brief Definition of the B3PhiloxEngine class
+
+#ifndef B3PhiloxEngine_h
+#define B3PhiloxEngine_h 1
+
+#include "CLHEP/Random/RandomEngine.h"
+
+#include <stdint.h>
+
+/// Counter-based random engine (Philox-4x32-10, Salmon et al., SC'11)
+///
+/// The numbers are a pure function of a 64-bit key and a 128-bit counter:
+/// the key is the run seed, the upper half of the counter is the stream
+/// (the global event number, see B3RandomStreams) and the lower half counts
+/// the draws inside the stream. Any event can therefore be reproduced from
+/// (seed, event number) alone, whatever the thread that processes it.
+
+class B3PhiloxEngine : public CLHEP::HepRandomEngine
+{
+  public:
+    B3PhiloxEngine(long seed = 19780503);
+    virtual ~B3PhiloxEngine();
+
+    /// Positions the engine at the beginning of the stream of the given key
+    void SetStream(uint64_t key, uint64_t stream);
+    uint64_t GetKey() const    { return fKey; }
+    uint64_t GetStream() const { return fStream; }
+
+    // Interface of CLHEP::HepRandomEngine
+    virtual double flat();
+    virtual void flatArray(const int size, double* vect);
+    virtual void setSeed(long seed, int dum = 0);
+    virtual void setSeeds(const long* seeds, int dum = 0);
+    virtual void saveStatus(const char filename[] = "B3Philox.conf") const;
+    virtual void restoreStatus(const char filename[] = "B3Philox.conf");
+    virtual void showStatus() const;
+    virtual std::string name() const;
+    virtual std::ostream& put(std::ostream& os) const;
+    virtual std::istream& get(std::istream& is);
+
+    static std::string engineName() { return "B3PhiloxEngine"; }
+
+  private:
+    /// Generates the next block of four 32-bit words
+    void NextBlock();
+
+    uint64_t fKey;
+    uint64_t fStream;
+    uint64_t fCounter;
+    uint32_t fBlock[4];
+    int      fBlockIndex;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
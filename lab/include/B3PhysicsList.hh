@@ -39,6 +39,17 @@
 /// - G4DecayPhysics
 /// - G4RadioactiveDecayPhysics
 /// - G4EmStandardPhysics
+///
+/// and the fast simulation process of the photons, for the Woodcock
+/// tracking in the phantom (B3WoodcockModel). In the jobs started with
+/// exampleB3 -b, the processes of the photons are wrapped by
+/// G4GenericBiasingPhysics, for the forced interactions in the crystals
+/// (B3Biasing); without a biasing operator in the volume, the wrapped
+/// processes are applied unchanged.
+///
+/// The physics tables can be stored in a cache directory and retrieved by
+/// the later jobs with the same materials, cuts and builders
+/// (B3PhysicsTableCache).
 
 class B3PhysicsList: public G4VModularPhysicsList
 {
@@ -48,7 +59,9 @@ public:
   /// destructor
   virtual ~B3PhysicsList();
 
-  /// Set user cuts
+  /// Adds the fast simulation to the processes of the builders
+  virtual void ConstructProcess();
+  /// Set user cuts, and prepares the cache of the physics tables
   virtual void SetCuts();
 };
 
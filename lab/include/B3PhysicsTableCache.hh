@@ -0,0 +1,86 @@
+/// \file B3PhysicsTableCache.hh
+/// \brief Definition of the B3PhysicsTableCache class
+
+#ifndef B3PhysicsTableCache_h
+#define B3PhysicsTableCache_h 1
+
+#include "G4Timer.hh"
+#include "globals.hh"
+
+class G4GenericMessenger;
+class G4VModularPhysicsList;
+
+/// Cache of the physics tables, and startup timing
+///
+/// With
+///   exampleB3 -c cache <macro>
+/// the physics tables built by the first run of a job are stored in
+/// cache/<key>, and the later jobs with the same key retrieve them instead
+/// of building them again. The key is a hash of the description of the
+/// configuration: the Geant4 version, the physics constructors, the
+/// materials (with their elements) and the production cuts of the
+/// regions. The description is stored with the tables, in
+/// cache/<key>/key.txt, and compared before they are retrieved. The tables
+/// are written to a temporary directory which is then renamed: concurrent
+/// jobs store them once, and a partial set is never retrieved. The tables
+/// of the processes which do not store them are built as usual.
+///
+/// The cache is prepared by the physics list when the kernel is
+/// initialized and when the cuts are set (B3PhysicsList::SetCuts); the
+/// cuts of the regions changed after that are checked by Geant4 when the
+/// tables are retrieved. The tables can only be retrieved before they are
+/// built: G4MTRunManager builds those of the master in Initialize(), and
+/// the sequential kernel at the first run. Set after that, with
+///   /B3/physics/tableCache cache
+/// the cache only stores the tables built, with a warning.
+///
+/// At the beginning of the first run, the master prints the time taken by
+/// the initialization of the kernel and by the whole startup (up to the
+/// first run, the physics tables included), and where the tables come
+/// from.
+
+class B3PhysicsTableCache
+{
+  public:
+    static B3PhysicsTableCache* Instance();
+    ~B3PhysicsTableCache();
+
+    /// Directory of the cache, "none" to build the tables
+    void SetDirectory(G4String directory);
+    G4bool IsEnabled() const { return fDirectory != "none"; }
+
+    /// Called by the physics list on the master when the cuts are set:
+    /// retrieves the tables at the next build if they are in the cache
+    void Prepare(G4VModularPhysicsList* physicsList);
+    /// Called by main() after the initialization of the kernel, which has
+    /// built the tables if it is multi-threaded
+    void EndOfInitialization();
+    /// Called by the master at the beginning of a run, after the tables
+    /// are built: stores them, and reports the startup at the first run
+    void BeginOfRun();
+
+  private:
+    B3PhysicsTableCache();
+    void DefineCommands();
+    G4String Describe() const;
+    G4String CachePath(const G4String& description) const;
+    void Store();
+
+    static B3PhysicsTableCache* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fDirectory;
+    G4VModularPhysicsList* fPhysicsList;
+    G4String fPath;
+    G4bool   fBuilt;            // the tables, retrieved or not
+    G4bool   fRetrieved;
+    G4bool   fStored;
+    G4bool   fReported;
+    G4Timer  fStartupTimer;
+    G4Timer  fInitializationTimer;
+    G4double fInitializationTime;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
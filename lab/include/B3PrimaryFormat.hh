@@ -0,0 +1,78 @@
+/// \file B3PrimaryFormat.hh
+/// \brief Layout of the B3 primary event files (.b3p)
+
+#ifndef B3PrimaryFormat_h
+#define B3PrimaryFormat_h 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Library of primary events generated outside the simulation (e.g. by a
+/// tracer kinetics model), made by primariesB3 and read in place from the
+/// mmap-ed file by B3PrimaryLibrary. It does not depend on Geant4.
+///
+/// A file is a FileHeader followed by three arrays:
+///   uint64_t eventVertex[nEvents+1]  first vertex of each event; the last
+///                                    entry is nVertices
+///   Vertex   vertices[nVertices]     in event order
+///   Particle particles[nParticles]   in vertex order
+/// so that the vertices of event i are [eventVertex[i], eventVertex[i+1])
+/// and the particles of a vertex are [firstParticle, firstParticle +
+/// nParticles). All the arrays are 8-byte aligned. Values are stored in
+/// the native (little-endian) order.
+
+namespace B3PrimaryFormat
+{
+  const uint32_t kFileMagic = 0x45503342;   // "B3PE"
+  const uint32_t kVersion   = 1;
+
+  struct FileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexBytes;
+    uint32_t particleBytes;
+    uint64_t nEvents;
+    uint64_t nVertices;
+    uint64_t nParticles;
+    uint64_t reserved;
+  };
+
+  struct Vertex
+  {
+    double   time;              // ns
+    float    position[3];       // mm, world frame
+    float    weight;
+    uint64_t firstParticle;
+    uint32_t nParticles;
+    uint32_t reserved;
+  };
+
+  struct Particle
+  {
+    int32_t  pdg;
+    float    energy;            // kinetic, keV
+    float    direction[3];      // unit vector
+    float    reserved;
+  };
+
+  /// The arrays of a file in memory
+  struct Sections
+  {
+    const FileHeader* header;
+    const uint64_t*   eventVertex;
+    const Vertex*     vertices;
+    const Particle*   particles;
+  };
+
+  /// Fills the magic, version and record sizes of a header
+  void InitFileHeader(FileHeader& header);
+  /// Size of a file of the numbers of the header
+  uint64_t FileBytes(const FileHeader& header);
+  /// Points the sections into a file in memory; false if it is not a
+  /// primary event file of the expected size, or if its event index does
+  /// not go up to the number of vertices
+  bool MapSections(const char* data, uint64_t size, Sections& sections);
+}
+
+#endif
@@ -40,7 +40,10 @@ class G4Event;
 
 /// The primary generator action class with particle gun.
 
-///Point source with 511 keV gamma
+///Point source with 511 keV gamma (several per event, see B3Batching), the
+///pencil beam of the beam scan (see B3BeamScan), the particles of a phase
+///space (see B3PhaseSpace), or the events of a primary event library (see
+///B3PrimaryLibrary)
 
 
 class B3PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
@@ -0,0 +1,65 @@
+/// \file B3PrimaryLibrary.hh
+/// \brief Definition of the B3PrimaryLibrary class
+
+#ifndef B3PrimaryLibrary_h
+#define B3PrimaryLibrary_h 1
+
+#include "B3PrimaryFormat.hh"
+#include "globals.hh"
+
+class B3MappedFile;
+class G4Event;
+class G4GenericMessenger;
+
+/// Source of precomputed primary events
+///
+/// With
+///   /B3/primaries/file tracer.b3p
+/// the primary event file (see B3PrimaryFormat.hh, made by primariesB3)
+/// is mapped in memory by the master at the beginning of the run, and each
+/// event takes its vertices and particles from the library event of its
+/// global event number (see B3RandomStreams), read in place: the replay
+/// does not depend on the threads, and no lock is taken per event. The
+/// library is reused from the start once all its events are used.
+///
+/// The threads get contiguous blocks of event numbers (/run/eventModulo):
+/// when a thread starts a new block of prefetch events, the kernel is
+/// asked to read the vertices and particles of the block ahead.
+///
+/// There is a single instance, configured by the master; the mapped file
+/// is shared by the threads.
+
+class B3PrimaryLibrary
+{
+  public:
+    static B3PrimaryLibrary* Instance();
+    ~B3PrimaryLibrary();
+
+    G4bool IsEnabled() const { return !fFileName.empty() && fFileName != "none"; }
+
+    /// Called by the master at the beginning of a run: maps the file
+    void BeginOfRun();
+    /// Adds the vertices of the library event of an event
+    void GeneratePrimaries(G4Event* event);
+
+  private:
+    B3PrimaryLibrary();
+    void DefineCommands();
+    void Prefetch(G4long block);
+
+    static B3PrimaryLibrary* fgInstance;
+    /// Last block of events prefetched by the thread
+    static G4ThreadLocal G4long fgPrefetched;
+
+    G4GenericMessenger* fMessenger;
+    G4String fFileName;
+    G4int    fPrefetchEvents;
+    B3MappedFile* fFile;
+    B3PrimaryFormat::Sections fSections;
+    G4long   fNbEvents;
+    G4bool   fRecycleWarned;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,68 @@
+/// \file B3RandomStreams.hh
+/// \brief Definition of the B3RandomStreams class
+
+#ifndef B3RandomStreams_h
+#define B3RandomStreams_h 1
+
+#include "globals.hh"
+
+class G4Event;
+class G4GenericMessenger;
+
+/// Per-event random streams
+///
+/// Every event is given its own stream of the counter-based B3PhiloxEngine,
+/// keyed by (run seed, global event number). The global event number is the
+/// Geant4 event ID plus an offset that follows the events of the previous
+/// runs of the job, so that the sequence does not repeat between runs.
+/// Results are thus independent of the number of threads and of the way the
+/// events are split between jobs, and any single event can be re-run:
+///
+///   /B3/random/replayEvent 1234
+///   /run/beamOn 1
+///
+/// The run seed is the key of the master engine, set with /random/setSeeds.
+/// If another engine is installed, this class does nothing.
+///
+/// There is a single instance, shared by the master and the workers; it is
+/// modified by the master only, outside of the event loop.
+
+class B3RandomStreams
+{
+  public:
+    static B3RandomStreams* Instance();
+    ~B3RandomStreams();
+
+    /// Called by the master at the beginning of a run: takes the run seed
+    void BeginOfRun();
+    /// Called at the beginning of each event, before any random number is
+    /// drawn: positions the engine of the current thread on the event stream
+    void BeginOfEvent(G4Event* event);
+    /// Called by the master at the end of a run: moves the offset past the
+    /// events of the run
+    void EndOfRun(G4int nofEvents);
+
+    /// Global event number of the first event of the next run
+    void SetEventOffset(G4long offset) { fEventOffset = offset; }
+    G4long GetEventOffset() const { return fEventOffset; }
+    G4long GetGlobalEventNumber(G4int eventID) const { return fEventOffset + eventID; }
+
+    G4bool IsActive() const { return fActive; }
+    G4long GetRunSeed() const { return fRunSeed; }
+
+  private:
+    B3RandomStreams();
+    void DefineCommands();
+    void ReplayEvent(G4long eventNumber);
+
+    static B3RandomStreams* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4bool fActive;
+    G4long fRunSeed;
+    G4long fEventOffset;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
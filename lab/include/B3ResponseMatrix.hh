@@ -0,0 +1,86 @@
+/// \file B3ResponseMatrix.hh
+/// \brief Definition of the B3ResponseMatrix structure
+
+#ifndef B3ResponseMatrix_h
+#define B3ResponseMatrix_h 1
+
+#include "B3ListModeFormat.hh"
+
+#include <string>
+#include <vector>
+
+/// Detector response matrix of a beam scan, written to a .b3rm file
+///
+/// A pencil beam enters the crystal face (the plane x = faceX, the lowest
+/// x of the crystals) at the points of a grid, described by
+///  - the entry point (y, z): nY x nZ cells covering [yMin, yMax] x
+///    [zMin, zMax] (mm), the beam entering at the cell centres;
+///  - the polar angle theta to the x axis, nTheta values from 0 to
+///    maxTheta included, and the azimuth phi around it, nPhi values over
+///    360 degrees (the nPhi directions of theta = 0 are the same);
+///  - the energy, nEnergies values from energyMin to energyMax included
+///    (keV).
+/// The points are numbered with y fastest, then z, phi, theta and energy.
+///
+/// For each point, the number of events and, for each crystal, the
+/// histogram of its energy deposits (nBins bins of binWidth keV, the last
+/// one also collecting the overflow) are kept; the events without deposit
+/// in a crystal are not in its histogram.
+///
+/// Matrices of the same grid can be added. It does not depend on Geant4,
+/// so that the tools can read it.
+
+struct B3ResponseMatrix
+{
+  B3ResponseMatrix();
+
+  /// Sets the grid on the face of a crystal table and clears the counts
+  void Init(const std::vector<B3ListModeFormat::CrystalEntry>& scanner,
+            uint32_t nY, uint32_t nZ, uint32_t nTheta, float maxTheta, uint32_t nPhi,
+            uint32_t nEnergies, float energyMin, float energyMax,
+            uint32_t nBins, float binWidth);
+  bool IsInitialized() const { return !counts.empty(); }
+  void Clear();
+
+  size_t NbPoints() const { return size_t(nY)*nZ*nPhi*nTheta*nEnergies; }
+  size_t Index(size_t point, uint32_t crystal, uint32_t bin) const
+  { return (point*crystals.size() + crystal)*nBins + bin; }
+
+  /// Entry point (mm), unit direction and energy (keV) of the beam of a
+  /// grid point
+  void Point(size_t point, double position[3], double direction[3], double& energy) const;
+
+  /// Adds the energy deposits (keV) of the nCrystals crystals of an event
+  /// of a grid point
+  void Fill(size_t point, const double* edep, uint32_t nCrystals)
+  {
+    events[point]++;
+    uint32_t* histograms = &counts[Index(point, 0, 0)];
+    for (uint32_t c = 0; c < nCrystals; c++) {
+      if (edep[c] <= 0.) continue;
+      double bin = edep[c]/binWidth;
+      histograms[c*nBins + (bin < nBins - 1 ? uint32_t(bin) : nBins - 1)]++;
+    }
+  }
+
+  /// Adds a matrix with the same grid; returns false otherwise
+  bool Add(const B3ResponseMatrix& other);
+
+  /// Writes to a temporary file renamed at the end, like B3Snapshot
+  bool Write(const std::string& fileName) const;
+  bool Read(const std::string& fileName);
+
+  uint32_t nY, nZ, nTheta, nPhi, nEnergies;
+  float    faceX;                 // mm
+  float    yMin, yMax, zMin, zMax;  // mm
+  float    maxTheta;              // rad
+  float    energyMin, energyMax;  // keV
+  uint32_t nBins;
+  float    binWidth;              // keV
+  /// Crystal table of the scanner
+  std::vector<B3ListModeFormat::CrystalEntry> crystals;
+  std::vector<uint64_t> events;   // per point
+  std::vector<uint32_t> counts;   // [point][crystal][bin]
+};
+
+#endif
@@ -0,0 +1,82 @@
+/// \file B3RingBuffer.hh
+/// \brief Definition of the B3RingBuffer class
+
+#ifndef B3RingBuffer_h
+#define B3RingBuffer_h 1
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+/// Bounded lock-free queue with one producer thread and one consumer thread
+///
+/// The capacity is rounded up to a power of two. The producer and the
+/// consumer indices live on separate cache lines, and each side keeps a
+/// cached copy of the index of the other side so that the shared index is
+/// only read when the cached one says the queue is full (or empty).
+
+template <class T>
+class B3RingBuffer
+{
+  public:
+    explicit B3RingBuffer(size_t capacity)
+     : fHead(0), fTailCache(0), fTail(0), fHeadCache(0)
+    {
+      size_t size = 2;
+      while (size < capacity) size *= 2;
+      fItems.resize(size);
+      fMask = size - 1;
+    }
+
+    /// Producer side: returns false if the queue is full
+    bool Push(const T& item)
+    {
+      size_t tail = fTail.load(std::memory_order_relaxed);
+      if (tail - fHeadCache > fMask) {
+        fHeadCache = fHead.load(std::memory_order_acquire);
+        if (tail - fHeadCache > fMask) return false;
+      }
+      fItems[tail & fMask] = item;
+      fTail.store(tail+1, std::memory_order_release);
+      return true;
+    }
+
+    /// Consumer side: moves up to maxItems items to items, returns how many
+    size_t Pop(T* items, size_t maxItems)
+    {
+      size_t head = fHead.load(std::memory_order_relaxed);
+      if (fTailCache - head < maxItems) fTailCache = fTail.load(std::memory_order_acquire);
+      size_t n = fTailCache - head;
+      if (n > maxItems) n = maxItems;
+      for (size_t i = 0; i < n; i++) items[i] = fItems[(head+i) & fMask];
+      fHead.store(head+n, std::memory_order_release);
+      return n;
+    }
+
+    /// Number of items waiting (exact from the producer side, a lower
+    /// bound from any other thread)
+    size_t Size() const
+    {
+      return fTail.load(std::memory_order_acquire) - fHead.load(std::memory_order_acquire);
+    }
+    size_t Capacity() const { return fMask + 1; }
+
+  private:
+    B3RingBuffer(const B3RingBuffer&);
+    B3RingBuffer& operator=(const B3RingBuffer&);
+
+    std::vector<T> fItems;
+    size_t fMask;
+
+    // consumer side, then producer side, on separate cache lines (padding
+    // rather than alignas, which new does not honour before C++17)
+    char   fPad0[64];
+    std::atomic<size_t> fHead;
+    size_t fTailCache;
+    char   fPad1[64];
+    std::atomic<size_t> fTail;
+    size_t fHeadCache;
+    char   fPad2[64];
+};
+
+#endif
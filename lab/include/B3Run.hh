@@ -32,7 +32,16 @@
 #define B3Run_h 1
 
 #include "G4Run.hh"
+#include "G4THitsMap.hh"
 #include "globals.hh"
+#include "B3Tally.hh"
+#include "B3WeightedTally.hh"
+#include "B3Sinogram.hh"
+#include "B3ResponseMatrix.hh"
+#include "B3DoseMap.hh"
+#include "B3Trigger.hh"
+
+#include <vector>
 
 /// Run class
 ///
@@ -49,12 +58,45 @@ class B3Run : public G4Run
 
     virtual void RecordEvent(const G4Event*);
     virtual void Merge(const G4Run*);
-    
+
+    /// Accumulated crystal energy deposits of the run
+    const B3Tally& GetTally() const { return fTally; }
+    /// Weighted events of the run with forced interactions (see B3Biasing)
+    const B3WeightedTally& GetWeightedTally() const { return fWeightedTally; }
+    /// Trigger decisions of the run, and rejected events kept by the prescale
+    const G4long* GetTriggerCounts() const { return fTriggerCounts; }
+    G4long GetNbPrescaled() const { return fNbPrescaled; }
+    /// Sinogram of the coincidences of the run (see B3SinogramOutput)
+    const B3Sinogram& GetSinogram() const { return fSinogram; }
+    /// Response matrix of the beam scan of the run (see B3BeamScan)
+    const B3ResponseMatrix& GetResponse() const { return fResponse; }
+    /// Dose in the phantom voxels of the run (see B3DoseSD)
+    const B3DoseMap& GetDose() const { return fDose; }
     
 private:
+  /// Fills the weighted tally with the branches of a biased event
+  void RecordBranches(G4THitsMap<G4double>* branchMap);
+  /// Fills the run with a primary of the event, from its crystal energies
+  /// and first-hit times (0 if the coincidences are not recorded)
+  void RecordPrimary(G4int evtNb, G4long globalEvtNb, G4int primary,
+                     const G4double* edep_arr, const G4double* time_arr);
+
   G4int fCollID_cryst;
+  G4int fCollID_time;
+  G4int fCollID_branch;
   G4int fPrintModulo;
   G4int fGoodEvents;        
+  B3Tally fTally;
+  B3WeightedTally fWeightedTally;
+  std::vector<G4double> fBranchWeights;
+  std::vector<G4double> fBranchEdep;     // [branch][crystal], keV
+  std::vector<G4double> fPrimaryEdep;    // [primary][crystal]
+  std::vector<G4double> fPrimaryTime;    // [primary][crystal]
+  G4long fTriggerCounts[B3Trigger::kNbDecisions];
+  G4long fNbPrescaled;
+  B3Sinogram fSinogram;
+  B3ResponseMatrix fResponse;
+  B3DoseMap fDose;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -32,6 +32,7 @@
 #define B3RunAction_h 1
 
 #include "G4UserRunAction.hh"
+#include "G4Timer.hh"
 #include "globals.hh"
 
 class G4Run;
@@ -51,6 +52,10 @@ class B3RunAction : public G4UserRunAction
     virtual void BeginOfRunAction(const G4Run*);
   /// Called at the end of each run
     virtual void   EndOfRunAction(const G4Run*);
+
+  private:
+  /// Wall time of the run of the thread, for the throughput per node
+    G4Timer fTimer;
 };
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
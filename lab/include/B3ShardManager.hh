@@ -0,0 +1,116 @@
+/// \file B3ShardManager.hh
+/// \brief Definition of the B3ShardManager class
+
+#ifndef B3ShardManager_h
+#define B3ShardManager_h 1
+
+#include "B3Snapshot.hh"
+#include "globals.hh"
+
+#include <map>
+#include <set>
+
+class B3Run;
+class G4GenericMessenger;
+
+/// Sharded, checkpointed and resumable runs
+///
+/// A run of N events is split into shardCount shards with disjoint ranges of
+/// global event numbers; with the per-event random streams (B3RandomStreams)
+/// each shard produces exactly the events a single long run would produce in
+/// its range. A shard is processed as a sequence of runs of checkpointEvery
+/// events; after each of them the accumulated tally and the sizes of the
+/// event files and of the other outputs are saved in <dir>/shard<i>.ckpt,
+/// and the outputs rewritten at each run (e.g. the sinogram) are copied to
+/// <file>.<event>.ckpt. Starting the same shard again resumes from the last
+/// checkpoint: the files are truncated back to the checkpointed sizes or
+/// copied back, and the remaining events are processed and added to them.
+///
+///   /B3/shard/index 3
+///   /B3/shard/count 16
+///   /B3/shard/dir shards
+///   /B3/shard/checkpointEvery 100000
+///   /B3/shard/run 1000000000
+///
+/// The outputs of a shard are <dir>/shard<i>*.b3e (events), the per-run
+/// analysis files and <dir>/shard<i>.b3s (final tally), which mergeB3 adds
+/// into the result of the full run. The files of the other outputs carry
+/// the tag _shard<i> (e.g. sino.b3sg becomes sino_shard3.b3sg), so that the
+/// shards of a run can share a directory.
+///
+/// With
+///   exampleB3 -p 8 <macro>
+/// the shard is processed by 8 processes forked from the job when it is
+/// started. A process forked from a multi-threaded job would have none of
+/// its worker threads, which G4MTRunManager starts when the kernel is
+/// initialized: with -p, the job has a sequential kernel instead
+/// (G4RunManager), and each process runs its events in one thread. The
+/// geometry and the physics tables are built before the fork, and the
+/// processes share them copy-on-write instead of building them again.
+/// Process p runs the part p of the event range of the shard as the shard
+/// <dir>/shard<i>_p<p> (with its own checkpoints). The job waits for the
+/// processes, adds their tallies into <dir>/shard<i>.b3s, and its next
+/// runs follow the event range of the shard. The other files of a process
+/// carry the tag _shard<i>_p<p> (e.g. list.b3lm becomes
+/// list_shard0_p3_t0.b3lm), to be merged with mergeB3. /B3/shard/processes
+/// (set by -p) is ignored by a multi-threaded kernel: the shard is
+/// processed in the job.
+
+class B3ShardManager
+{
+  public:
+    static B3ShardManager* Instance();
+    ~B3ShardManager();
+
+    /// Processes the shard of a run of nofEvents events
+    void Run(G4long nofEvents);
+
+    /// Called by the master at the end of each run: checkpoints if a shard
+    /// is being processed
+    void EndOfRun(const B3Run* run);
+
+    G4bool IsActive() const { return fActive; }
+
+    /// Tag of the output files of the shard being processed, from its base
+    /// name (_shard<i> or _shard<i>_p<p>), empty out of a shard
+    static const G4String& GetOutputTag() { return fgOutputTag; }
+
+    /// Called by the outputs for the files they write while a shard is
+    /// processed, to checkpoint them: an accumulated file is rewritten at
+    /// each run and copied, the others are appended to and truncated
+    void AddOutput(const G4String& fileName, G4bool accumulated);
+    /// True if the file was restored from the checkpoint of the shard: it
+    /// holds the events before it and is continued, not replaced
+    G4bool IsRestored(const G4String& fileName) const
+    { return fRestored.count(fileName) > 0; }
+
+  private:
+    B3ShardManager();
+    void DefineCommands();
+    G4String ShardName() const;
+    G4String ShardBase() const;
+    void ProcessShard(G4long nofEvents);
+    G4bool CanFork() const;
+    void ForkProcesses(G4long nofEvents);
+    G4bool Resume();
+    void RestoreOutputs();
+
+    static B3ShardManager* fgInstance;
+    static G4String fgOutputTag;
+
+    G4GenericMessenger* fMessenger;
+    G4int    fIndex;
+    G4int    fCount;
+    G4String fDirectory;
+    G4int    fCheckpointEvery;
+    G4int    fNbProcesses;
+    G4int    fProcess;          // in a forked process, -1 in the job
+    G4bool   fActive;
+    B3Snapshot fCheckpoint;
+    std::map<G4String, G4bool> fOutputs;   // accumulated or not
+    std::set<G4String> fRestored;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
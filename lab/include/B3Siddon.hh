@@ -0,0 +1,45 @@
+/// \file B3Siddon.hh
+/// \brief Definition of the image grid and of the Siddon ray tracer
+
+#ifndef B3Siddon_h
+#define B3Siddon_h 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// Image of nx x ny x nz voxels, x fastest, centred on a point (mm)
+struct B3ImageGrid
+{
+  uint32_t n[3];
+  float    voxelSize[3];   // mm
+  float    center[3];      // mm
+
+  size_t NbVoxels() const { return size_t(n[0])*n[1]*n[2]; }
+  size_t Index(uint32_t i, uint32_t j, uint32_t k) const
+  { return (size_t(k)*n[1] + j)*n[0] + i; }
+  /// Lower edge of the image along an axis
+  double Lower(int axis) const { return center[axis] - 0.5*n[axis]*voxelSize[axis]; }
+};
+
+/// Siddon ray tracer: the voxels crossed by a segment and the lengths of
+/// the segment in them.
+///
+/// The incremental form of the algorithm is used (the next crossing along
+/// each axis is updated rather than all the crossings sorted). The result
+/// goes to two contiguous arrays, so that the projections over them are
+/// plain gather loops that the compiler vectorises.
+///
+/// It does not depend on Geant4.
+
+namespace B3Siddon
+{
+  /// Traces the segment from start to end (mm) through the grid: replaces
+  /// the contents of voxels and lengths (mm) and returns their size. If
+  /// given, entry is set to the distance from start to the first voxel.
+  size_t Trace(const B3ImageGrid& grid, const double start[3], const double end[3],
+               std::vector<uint32_t>& voxels, std::vector<float>& lengths,
+               double* entry = 0);
+}
+
+#endif
@@ -0,0 +1,78 @@
+/// \file B3Sinogram.hh
+/// \brief Definition of the B3Sinogram structure
+
+#ifndef B3Sinogram_h
+#define B3Sinogram_h 1
+
+#include "B3ListModeFormat.hh"
+
+#include <string>
+#include <vector>
+
+/// 3D sinogram of the coincidences, written to a .b3sg file
+///
+/// The line of response (LOR) between two crystal centres is binned by
+///  - its angle phi in [0, pi) in the transaxial (x, y) plane, nAngles bins;
+///  - its signed distance s to the axis, nRadial bins of radialBin mm
+///    centred on 0;
+///  - the rings of its two crystals, a Michelogram plane r1*nRings + r2
+///    (r1 the ring of the crystal the LOR starts from, in direction phi).
+/// The rings are the distinct axial (z) positions of the crystals. Planes
+/// with |r1 - r2| > maxRingDifference (if >= 0) are not filled.
+///
+/// The crystal table of the scanner is kept with the sinogram, for the
+/// normalisation of the reconstruction (B3Osem).
+///
+/// The size of the counts does not depend on the number of events, and
+/// sinograms with the same binning can be added. It does not depend on
+/// Geant4, so that the tools can read it.
+
+struct B3Sinogram
+{
+  B3Sinogram();
+
+  /// Sets the binning, with the rings of a crystal table, and clears the
+  /// counts
+  void Init(const std::vector<B3ListModeFormat::CrystalEntry>& scanner,
+            uint32_t nRadial, uint32_t nAngles, float radialBin,
+            int32_t maxRingDifference);
+  bool IsInitialized() const { return !counts.empty(); }
+  void Clear();
+
+  size_t NbPlanes() const { return ringZ.size()*ringZ.size(); }
+  size_t NbBins() const { return NbPlanes()*nAngles*nRadial; }
+  size_t Index(uint32_t plane, uint32_t angle, uint32_t radial) const
+  { return (size_t(plane)*nAngles + angle)*nRadial + radial; }
+
+  /// Bin of the LOR between the centres of two crystals, -1 if it is
+  /// outside the sinogram (or the crystals are on the same axial line)
+  int64_t Bin(const B3ListModeFormat::CrystalEntry& a,
+              const B3ListModeFormat::CrystalEntry& b) const;
+  /// Bins of all the crystal pairs, indexed by pair ID
+  void BuildLookup(const std::vector<B3ListModeFormat::CrystalEntry>& table,
+                   std::vector<int64_t>& lookup) const;
+
+  /// End points (mm) of the LOR at the centre of a bin, on the cylinder of
+  /// the given radius around the axis
+  void BinLine(size_t bin, double radius, double start[3], double end[3]) const;
+
+  /// Adds a sinogram with the same binning; returns false otherwise
+  bool Add(const B3Sinogram& other);
+
+  /// Writes to a temporary file renamed at the end, like B3Snapshot
+  bool Write(const std::string& fileName) const;
+  bool Read(const std::string& fileName);
+
+  uint32_t nRadial;
+  uint32_t nAngles;
+  float    radialBin;            // mm
+  int32_t  maxRingDifference;    // < 0: all
+  std::vector<float> ringZ;      // mm, increasing
+  /// Crystal table of the scanner (empty in version 1 files)
+  std::vector<B3ListModeFormat::CrystalEntry> crystals;
+  uint64_t nCoincidences;        // binned
+  uint64_t nOutside;             // outside the sinogram
+  std::vector<uint32_t> counts;
+};
+
+#endif
@@ -0,0 +1,82 @@
+/// \file B3SinogramOutput.hh
+/// \brief Definition of the B3SinogramOutput class
+
+#ifndef B3SinogramOutput_h
+#define B3SinogramOutput_h 1
+
+#include "B3Sinogram.hh"
+#include "globals.hh"
+
+#include <set>
+#include <vector>
+
+class G4GenericMessenger;
+
+/// Sinogram accumulated during the simulation
+///
+/// With /B3/sinogram/file <base>, the coincidences found at the end of each
+/// event (see B3ListModeOutput, whose coincidence finder and crystal table
+/// are used) are binned into the sinogram of the run of each
+/// thread (B3Run), which B3Run::Merge adds on the master. At the end of the
+/// run, the master writes it to <base>.b3sg; the next runs of the job are
+/// added to the file. In a shard, the file is <base>_shard<i>.b3sg, which
+/// is checkpointed with the shard (see B3ShardManager). The memory used
+/// depends on the binning only:
+/// nRings^2 x nAngles x nRadial 32-bit counts per thread. All the events
+/// are binned, whatever the trigger (B3Trigger), which only selects the
+/// list-mode records: the sensitivity of the sinogram is that of the
+/// scanner.
+///
+///   /B3/sinogram/file pet
+///   /B3/sinogram/nAngles 96
+///   /B3/sinogram/nRadial 128
+///   /B3/sinogram/radialBin 1 mm
+///   /B3/sinogram/maxRingDifference -1
+///
+/// The bin of every crystal pair is looked up in a table built by the master
+/// at the beginning of the run, so the binning costs one load per event.
+
+class B3SinogramOutput
+{
+  public:
+    static B3SinogramOutput* Instance();
+    ~B3SinogramOutput();
+
+    G4bool IsEnabled() const { return !fFileBase.empty() && fFileBase != "none"; }
+
+    /// Called by the master at the beginning of a run: sets the binning
+    /// from the crystal table of the scanner
+    void BeginOfRun();
+    /// Adds the coincidence of two crystals to a sinogram, initialised
+    /// with the binning of the run the first time
+    void Fill(B3Sinogram& sinogram, G4int first, G4int second) const
+    {
+      if (!sinogram.IsInitialized()) sinogram = fEmpty;
+      G4long bin = fLookup[B3ListModeFormat::PairId(first, second)];
+      if (bin < 0) { sinogram.nOutside++; return; }
+      sinogram.counts[bin]++;
+      sinogram.nCoincidences++;
+    }
+    /// Called by the master at the end of a run with the merged sinogram
+    void EndOfRun(const B3Sinogram& sinogram);
+
+  private:
+    B3SinogramOutput();
+    void DefineCommands();
+
+    static B3SinogramOutput* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4String fFileBase;
+    G4int    fNbAngles;
+    G4int    fNbRadial;
+    G4double fRadialBin;
+    G4int    fMaxRingDifference;
+    B3Sinogram fEmpty;
+    std::vector<int64_t> fLookup;
+    std::set<G4String> fWrittenFiles;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
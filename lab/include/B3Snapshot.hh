@@ -0,0 +1,47 @@
+/// \file B3Snapshot.hh
+/// \brief Definition of the B3Snapshot structure
+
+#ifndef B3Snapshot_h
+#define B3Snapshot_h 1
+
+#include "B3Tally.hh"
+
+#include <string>
+#include <vector>
+
+/// Snapshot of the accumulators of a (part of a) run, written to a .b3s file
+///
+/// It is the checkpoint of a shard (see B3ShardManager): the event range of
+/// the shard, the events done so far, the tally and the size of each output
+/// file at that point. Snapshots of disjoint event ranges can be added.
+/// It does not depend on Geant4, so that the tools can read it.
+
+struct B3OutputOffset
+{
+  std::string name;
+  uint64_t    size;
+};
+
+struct B3Snapshot
+{
+  B3Snapshot();
+
+  /// Writes to a temporary file renamed at the end, so that an existing
+  /// snapshot is only replaced by a complete one
+  bool Write(const std::string& fileName) const;
+  bool Read(const std::string& fileName);
+
+  /// Adds a snapshot of another event range
+  void Add(const B3Snapshot& other);
+
+  uint32_t shardIndex;
+  uint32_t shardCount;
+  uint64_t firstEvent;      // event range assigned: [firstEvent, endEvent)
+  uint64_t endEvent;
+  uint64_t nextEvent;       // first event not yet done
+  uint64_t seed;
+  B3Tally  tally;
+  std::vector<B3OutputOffset> outputs;
+};
+
+#endif
@@ -38,6 +38,9 @@
 ///
 /// One wishes do not track secondary neutrino.Therefore one kills it 
 /// immediately, before created particles will  put in a stack.
+///
+/// While the phase space is recorded (B3PhaseSpace), the secondaries born
+/// inside its surface are killed as well.
 
 class B3StackingAction : public G4UserStackingAction
 {
@@ -0,0 +1,57 @@
+/// \file B3Statistics.hh
+/// \brief Definition of the B3Statistics namespace
+
+#ifndef B3Statistics_h
+#define B3Statistics_h 1
+
+#include "globals.hh"
+
+#include <vector>
+
+/// Two-sample statistical tests used to check that two runs of the example
+/// are physics-equivalent (see validateB3).
+
+namespace B3Statistics
+{
+  /// Outcome of a single test: the statistic, its degrees of freedom (if
+  /// any) and the p-value under the hypothesis that both samples come from
+  /// the same distribution
+  struct TestResult
+  {
+    G4double statistic;
+    G4int    ndf;
+    G4double pValue;
+  };
+
+  /// Regularised upper incomplete gamma function Q(a,x)
+  G4double GammaQ(G4double a, G4double x);
+
+  /// Chi-square probability: P(chi2 > x) for ndf degrees of freedom
+  G4double ChiSquareProb(G4double chi2, G4int ndf);
+
+  /// Kolmogorov distribution: P(sqrt(n) D > lambda) in the large n limit
+  G4double KolmogorovProb(G4double lambda);
+
+  /// Chi-square comparison of two unweighted histograms with the same
+  /// binning, allowing for different total numbers of entries.
+  /// Bins empty in both histograms do not contribute to ndf.
+  TestResult ChiSquareTest(const std::vector<G4double>& counts1,
+                           const std::vector<G4double>& counts2);
+
+  /// Two-sample Kolmogorov-Smirnov test on unbinned data.
+  /// The samples are sorted in place.
+  TestResult KolmogorovTest(std::vector<G4double>& sample1,
+                            std::vector<G4double>& sample2);
+
+  /// Binomial efficiency k/n and its standard deviation
+  void Efficiency(G4double k, G4double n, G4double& eff, G4double& error);
+
+  /// Two-proportion z-test of k1/n1 against k2/n2 (pooled variance);
+  /// the statistic is the z score and the p-value is two-sided
+  TestResult EfficiencyTest(G4double k1, G4double n1,
+                            G4double k2, G4double n2);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
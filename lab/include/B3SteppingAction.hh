@@ -0,0 +1,29 @@
+/// \file B3SteppingAction.hh
+/// \brief Definition of the B3SteppingAction class
+
+#ifndef B3SteppingAction_h
+#define B3SteppingAction_h 1
+
+#include "G4UserSteppingAction.hh"
+#include "globals.hh"
+
+class B3PhaseSpace;
+
+/// Stepping action class : records the particles entering the phase-space
+/// surface around the crystals (see B3PhaseSpace)
+
+class B3SteppingAction : public G4UserSteppingAction
+{
+  public:
+    B3SteppingAction();
+    virtual ~B3SteppingAction();
+
+    virtual void UserSteppingAction(const G4Step*);
+
+  private:
+    B3PhaseSpace* fPhaseSpace;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
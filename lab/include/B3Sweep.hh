@@ -0,0 +1,91 @@
+/// \file B3Sweep.hh
+/// \brief Definition of the B3Sweep class
+
+#ifndef B3Sweep_h
+#define B3Sweep_h 1
+
+#include "B3Snapshot.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class B3Run;
+class G4GenericMessenger;
+
+/// Parameter sweep in one job
+///
+/// The points of a design study (crystal size and pitch, source energy...)
+/// are run one after the other in the job, with the kernel initialized
+/// once:
+///   /B3/sweep/events 100000
+///   /B3/sweep/dir sweep
+///   /B3/sweep/run points.txt
+/// The sweep file is a list of points, each a tag followed by the commands
+/// of the point:
+///   point dy4
+///   /B3/crystal/size 22 4 3 mm
+///   point dy5
+///   /B3/crystal/size 22 5 3 mm
+///   /gun/energy 662 keV
+/// (# starts a comment). The commands of a point apply on top of those of
+/// the previous points; a point whose command fails, or whose pitch is
+/// smaller than its crystals, is skipped. The geometry is reinitialized
+/// only if the commands of the point change it
+/// (B3DetectorConstruction::IsGeometryModified), and then without the
+/// phantom if it is unchanged; the physics tables are kept.
+///
+/// Every point runs the same events (global event numbers 0 to events-1),
+/// so that the differences between the points are not blurred by
+/// different random streams. The analysis and event files of a point, and
+/// the other outputs, carry the tag _<tag> (e.g. B3_dy4.root). The tally of
+/// each point is written to <dir>/<tag>.b3s (as the tally of a shard),
+/// and one line per point to <dir>/sweep.txt: the events, whether the
+/// geometry was rebuilt, the time, the events in the photopeak window
+/// (/B3/bias/peakLow, peakHigh) and the mean energy deposit of each
+/// crystal.
+
+class B3Sweep
+{
+  public:
+    static B3Sweep* Instance();
+    ~B3Sweep();
+
+    /// Runs the points of a sweep file
+    void Run(G4String fileName);
+
+    /// Called by the master at the end of each run: adds the tally of the
+    /// point
+    void EndOfRun(const B3Run* run);
+
+    G4bool IsActive() const { return fActive; }
+
+    /// Tag of the output files of the point being run, empty outside of a
+    /// sweep
+    static const G4String& GetPointTag() { return fgPointTag; }
+
+  private:
+    B3Sweep();
+    void DefineCommands();
+
+    struct Point
+    {
+      G4String tag;
+      std::vector<G4String> commands;
+    };
+
+    G4bool ReadPoints(const G4String& fileName, std::vector<Point>& points) const;
+    G4bool RunPoint(const Point& point, std::ostream& summary);
+
+    static B3Sweep* fgInstance;
+    static G4String fgPointTag;
+
+    G4GenericMessenger* fMessenger;
+    G4int    fNbEvents;
+    G4String fDirectory;
+    G4bool   fActive;
+    B3Snapshot fResult;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,127 @@
+/// \file B3SystemMatrix.hh
+/// \brief Definition of the B3SystemMatrix class
+
+#ifndef B3SystemMatrix_h
+#define B3SystemMatrix_h 1
+
+#include "B3ListModeFormat.hh"
+#include "B3MappedFile.hh"
+#include "B3Siddon.hh"
+
+#include <string>
+#include <vector>
+
+/// Precomputed system matrix of a scanner and image grid (.b3sm file)
+///
+/// Row l holds the voxels crossed by line of response l and the lengths
+/// crossed in them (B3Siddon). When the lines are the crystal pairs of the
+/// crystal table (line = pair ID), the symmetries of the scanner that also
+/// map the image grid onto itself are used: the 8 rotations/reflections of
+/// the square in the transaxial plane (x and y flips, x/y swap) and the
+/// translations by the ring pitch along z. Only one row per orbit is stored,
+/// and each line refers to it with the symmetry that maps it to the line.
+/// A sample of expanded rows is checked against a direct trace when the file
+/// is built; if they differ, no symmetry is used.
+///
+/// The file is a FileHeader, the line table (row, symmetry, z shift), the
+/// row offsets, the column (voxel) indices and the values, in CSR form. It
+/// is mmap-ed for use: the projections read it in place, the symmetry
+/// being applied with a permutation table of the voxels. Its name is the
+/// key, a hash of the crystal table, the image grid and the kind of lines,
+/// so that the files of a cache directory are found again by later jobs.
+///
+/// It does not depend on Geant4.
+
+class B3SystemMatrix
+{
+  public:
+    struct Statistics
+    {
+      uint64_t nLines;
+      uint64_t nRows;             // stored
+      uint64_t nonZeros;          // stored
+      uint64_t fullNonZeros;      // without the symmetries
+      uint32_t nTransaxial;       // transaxial symmetries used, 1 for none
+      bool     axial;             // axial translations used
+      double   buildSeconds;
+    };
+
+    B3SystemMatrix();
+    ~B3SystemMatrix();
+
+    /// Key of a matrix: FNV-1a hash of the crystal table, the grid and a
+    /// description of the lines (e.g. "pairs", or the sinogram binning)
+    static uint64_t Key(const std::vector<B3ListModeFormat::CrystalEntry>& crystals,
+                        const B3ImageGrid& grid, const std::string& lines);
+    static std::string FileName(const std::string& directory, uint64_t key);
+
+    /// Computes the matrix of the given lines (start and end points in mm,
+    /// 6 values per line) and writes it; crystals is the crystal table if the
+    /// lines are its pairs (symmetries searched), empty otherwise
+    bool Build(const std::string& fileName, uint64_t key, const B3ImageGrid& grid,
+               const std::vector<double>& lines,
+               const std::vector<B3ListModeFormat::CrystalEntry>& crystals,
+               unsigned int nThreads);
+    /// Maps a matrix file; returns false if it is not one, has another key,
+    /// or indexes out of its rows or of the grid
+    bool Open(const std::string& fileName, uint64_t key);
+    void Close();
+
+    const B3ImageGrid& GetGrid() const { return fGrid; }
+    uint64_t GetNbLines() const { return fNbLines; }
+    const Statistics& GetStatistics() const { return fStatistics; }
+
+    /// Row of a line: its voxels and values, appended to the vectors
+    void GetRow(uint64_t line, std::vector<uint32_t>& voxels, std::vector<float>& values) const
+    {
+      const LineEntry& entry = fLineTable[line];
+      const uint32_t* permutation = &fPermutations[size_t(entry.symmetry)*fNbVoxels];
+      int64_t offset = int64_t(entry.shift)*fGrid.n[0]*fGrid.n[1];
+      uint64_t begin = fRowOffsets[entry.row], end = fRowOffsets[entry.row + 1];
+      for (uint64_t n = begin; n < end; n++) {
+        voxels.push_back(uint32_t(permutation[fColumns[n]] + offset));
+        values.push_back(fValues[n]);
+      }
+    }
+
+  private:
+    struct FileHeader
+    {
+      uint32_t magic;
+      uint32_t version;
+      uint64_t key;
+      uint64_t nLines;
+      uint64_t nRows;
+      uint64_t nonZeros;
+      uint64_t fullNonZeros;
+      uint32_t n[3];
+      float    voxelSize[3];
+      float    center[3];
+      uint32_t nSymmetries;       // transaxial, 1 for none
+      uint32_t axial;
+      uint32_t codes[8];          // of the transaxial symmetries
+      uint32_t reserved;
+    };
+    struct LineEntry
+    {
+      uint32_t row;
+      uint16_t symmetry;          // index of the transaxial symmetry
+      int16_t  shift;             // z shift, in voxels
+    };
+
+    /// Permutation of the voxels by each transaxial symmetry code
+    void BuildPermutations(const std::vector<uint32_t>& codes);
+
+    B3MappedFile fFile;
+    B3ImageGrid  fGrid;
+    uint64_t     fNbLines;
+    size_t       fNbVoxels;
+    const LineEntry* fLineTable;
+    const uint64_t*  fRowOffsets;
+    const uint32_t*  fColumns;
+    const float*     fValues;
+    std::vector<uint32_t> fPermutations;
+    Statistics   fStatistics;
+};
+
+#endif
@@ -0,0 +1,48 @@
+/// \file B3Tally.hh
+/// \brief Definition of the B3Tally structure
+
+#ifndef B3Tally_h
+#define B3Tally_h 1
+
+#include <stdint.h>
+
+/// Run accumulators of the crystal energy deposits
+///
+/// Everything is kept in integers (energies in eV, 128-bit sums of squares)
+/// so that adding tallies is exact and independent of the order: a run split
+/// into threads, shards or processes gives the same tally as a single run.
+
+struct B3Tally
+{
+  static const int kNbCrystals = 9;
+  /// Spectra: kNbBins bins of kBinWidth keV from 0, plus one overflow bin
+  /// (same binning as the "h1" histogram)
+  static const int kNbBins = 100;
+  static const double kBinWidth;
+
+  B3Tally();
+  void Reset();
+
+  /// Adds one event; energies in keV
+  void Fill(const double edep[kNbCrystals]);
+  /// Adds another tally
+  void Add(const B3Tally& other);
+
+  /// Mean and standard deviation of the energy deposit of a crystal over
+  /// the events where it fired (keV)
+  double MeanEdep(int crystal) const;
+  double RmsEdep(int crystal) const;
+  /// Number of events with a total energy in [lo, hi) keV, using whole
+  /// bins of the total spectrum
+  uint64_t CountTotal(double lo, double hi) const;
+
+  uint64_t nEvents;
+  uint64_t nFired[kNbCrystals];
+  uint64_t sumEdep[kNbCrystals];        // eV
+  uint64_t sumEdep2Hi[kNbCrystals];     // eV^2, high and low 64 bits
+  uint64_t sumEdep2Lo[kNbCrystals];
+  uint64_t totalSpectrum[kNbBins+1];
+  uint64_t crystalSpectrum[kNbCrystals][kNbBins+1];
+};
+
+#endif
@@ -0,0 +1,98 @@
+/// \file B3ThreadPlacement.hh
+/// \brief Definition of the B3ThreadPlacement class
+
+#ifndef B3ThreadPlacement_h
+#define B3ThreadPlacement_h 1
+
+#include "B3Topology.hh"
+#include "globals.hh"
+
+#include <vector>
+
+#include <sched.h>
+
+class G4GenericMessenger;
+
+/// Placement of the worker threads on the CPUs and NUMA nodes
+///
+/// With
+///   exampleB3 -a compact <macro>     (or scatter; none by default)
+/// each worker thread is pinned to one CPU when it starts, before it
+/// allocates anything (B3WorkerThreadInitialization): G4MTRunManager
+/// starts the threads when the kernel is initialized, before the macro.
+/// Compact fills the NUMA nodes one after the other, and scatter deals the
+/// threads to the nodes in turn (see B3Topology). The pages of the
+/// thread-local pools (the hits, tracks and steps allocators, the event
+/// buffers of the outputs) are then first touched, and so placed, on the
+/// node of their thread. The policy can be changed later with
+///   /B3/affinity/policy scatter
+/// the threads being pinned again (or released, with none) at the
+/// beginning of the next run; the pools they allocated already stay where
+/// they are. The processes forked by B3ShardManager, of one thread each,
+/// take the CPUs after each other.
+///
+/// At the end of each run of more than one thread, the master prints the
+/// events and the throughput of the threads of each node. The node of an
+/// unpinned thread is that of the CPU it ends the run on.
+///
+/// There is a single instance, configured by the master; the threads
+/// report to it under a lock once per run.
+
+class B3ThreadPlacement
+{
+  public:
+    static B3ThreadPlacement* Instance();
+    ~B3ThreadPlacement();
+
+    /// Sets the policy (none, compact or scatter), reading the topology
+    void SetPolicy(G4String policy);
+
+    /// Called by each worker thread when it starts: pins it to its CPU
+    void PinWorker();
+    /// Index of the first thread of the process among the threads placed,
+    /// for the forked processes (see B3ShardManager)
+    void SetFirstThread(G4int index) { fFirstThread = index; }
+
+    /// Called by the master at the beginning of a run
+    void BeginOfRun();
+    /// Called by every thread at the beginning of a run, after the master:
+    /// pins the worker threads (or the thread of a sequential kernel) again
+    /// if the policy changed since they were pinned
+    void BeginOfThreadRun();
+    /// Called by each worker thread at the end of a run
+    void AddWorkerRun(G4int nofEvents, G4double seconds);
+    /// Called by the master at the end of a run: prints the throughput per
+    /// node
+    void EndOfRun();
+
+  private:
+    B3ThreadPlacement();
+    void DefineCommands();
+    void ReadTopology();
+
+    struct WorkerRun
+    {
+      G4int    node;
+      G4int    nofEvents;
+      G4double seconds;
+    };
+
+    static B3ThreadPlacement* fgInstance;
+    /// Node of the CPU the thread is pinned to, -1 if it is not pinned
+    static G4ThreadLocal G4int fgNode;
+    /// Version of the policy the thread is placed with, -1 if none yet
+    static G4ThreadLocal G4int fgPolicyVersion;
+
+    G4GenericMessenger* fMessenger;
+    G4String fPolicy;
+    G4int    fPolicyVersion;      // changed by each SetPolicy
+    G4int    fFirstThread;
+    cpu_set_t fProcessCpus;       // of the process, to release the threads
+    B3Topology fTopology;
+    G4bool   fTopologyRead;
+    std::vector<WorkerRun> fWorkerRuns;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,48 @@
+/// \file B3Topology.hh
+/// \brief Definition of the B3Topology class
+
+#ifndef B3Topology_h
+#define B3Topology_h 1
+
+#include <string>
+#include <vector>
+
+/// NUMA nodes and CPUs of the machine, as seen by the process
+///
+/// Read from /sys/devices/system/node/node<n>/cpulist, and restricted to
+/// the CPUs the process may run on (sched_getaffinity: batch slots,
+/// cgroups, taskset). Without the node directory (no NUMA kernel), all the
+/// CPUs are on node 0. It does not depend on Geant4.
+
+class B3Topology
+{
+  public:
+    enum Policy { kCompact, kScatter };
+
+    B3Topology();
+
+    /// Reads the topology; false if no CPU is found
+    bool Read(const std::string& nodeDirectory = "/sys/devices/system/node");
+
+    int NbNodes() const { return int(fNodeCpus.size()); }
+    int NbCpus() const { return int(fCpus.size()); }
+    const std::vector<int>& NodeCpus(int node) const { return fNodeCpus[node]; }
+    /// Node of a CPU, -1 if it is not one of the process
+    int NodeOf(int cpu) const;
+
+    /// CPU of the thread of a given index: compact fills the nodes one
+    /// after the other, scatter deals the threads to the nodes in turn.
+    /// Beyond the number of CPUs, the threads share them again in the same
+    /// order.
+    int CpuOf(Policy policy, int threadIndex) const;
+
+    /// Parses a Linux CPU list ("0-3,8,10-11")
+    static bool ParseCpuList(const std::string& list, std::vector<int>& cpus);
+
+  private:
+    std::vector<std::vector<int> > fNodeCpus;   // nodes with CPUs only
+    std::vector<int> fCpus;                     // compact order
+    std::vector<int> fNodeOfCpu;                // by CPU number
+};
+
+#endif
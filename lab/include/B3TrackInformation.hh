@@ -0,0 +1,48 @@
+/// \file B3TrackInformation.hh
+/// \brief Definition of the B3TrackInformation class
+
+#ifndef B3TrackInformation_h
+#define B3TrackInformation_h 1
+
+#include "G4VUserTrackInformation.hh"
+#include "G4Track.hh"
+#include "globals.hh"
+
+/// Index of the primary of a track, in the events with several primaries
+/// (see B3Batching), and branch of the track in the biased events (see
+/// B3ForcedInteraction). The tracks of the other events have no
+/// information, which stands for primary 0 and branch 0.
+
+class B3TrackInformation : public G4VUserTrackInformation
+{
+  public:
+    B3TrackInformation(G4int primaryIndex, G4int branch = 0);
+    virtual ~B3TrackInformation();
+
+    G4int GetPrimaryIndex() const { return fPrimaryIndex; }
+    G4int GetBranch() const { return fBranch; }
+    virtual void Print() const;
+
+    /// Index of the primary of a track, 0 without information
+    static G4int GetPrimaryIndex(const G4Track* track)
+    {
+      const G4VUserTrackInformation* info = track->GetUserInformation();
+      return info ? static_cast<const B3TrackInformation*>(info)->fPrimaryIndex : 0;
+    }
+    /// Branch of a track, 0 without information
+    static G4int GetBranch(const G4Track* track)
+    {
+      const G4VUserTrackInformation* info = track->GetUserInformation();
+      return info ? static_cast<const B3TrackInformation*>(info)->fBranch : 0;
+    }
+    /// Sets the branch of a track, adding the information if needed
+    static void SetBranch(const G4Track* track, G4int branch);
+
+  private:
+    G4int fPrimaryIndex;
+    G4int fBranch;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,27 @@
+/// \file B3TrackingAction.hh
+/// \brief Definition of the B3TrackingAction class
+
+#ifndef B3TrackingAction_h
+#define B3TrackingAction_h 1
+
+#include "G4UserTrackingAction.hh"
+#include "globals.hh"
+
+/// Tracking action class : in the events with several primaries (see
+/// B3Batching), gives each primary track its index, and passes it on to
+/// the secondaries with the branch of the biased events
+/// (B3TrackInformation)
+
+class B3TrackingAction : public G4UserTrackingAction
+{
+  public:
+    B3TrackingAction();
+    virtual ~B3TrackingAction();
+
+    virtual void PreUserTrackingAction(const G4Track*);
+    virtual void PostUserTrackingAction(const G4Track*);
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,76 @@
+/// \file B3Trigger.hh
+/// \brief Definition of the B3Trigger class
+
+#ifndef B3Trigger_h
+#define B3Trigger_h 1
+
+#include "globals.hh"
+
+class G4GenericMessenger;
+
+/// Trigger deciding which events are persisted (ntuple row, event file)
+///
+/// The conditions are applied in this order, the first one that fails
+/// being the reason of the rejection:
+///  - zero suppression: at least one crystal fired (/B3/trigger/dropEmpty);
+///  - total energy of at least minEnergy;
+///  - total energy in the window [windowLow, windowHigh], e.g. around the
+///    511 keV photopeak;
+///  - number of fired crystals (energy above crystalThreshold) between
+///    minMultiplicity and maxMultiplicity.
+/// One rejected event in prescale (0: none) is persisted all the same; the
+/// choice is made on the global event number, so it does not depend on the
+/// threads and the same trigger applied to a file finds these events again.
+///
+/// By default every condition is off and all events are persisted. The
+/// run accumulators and the energy histogram see all the events. The
+/// outputs of a run with a condition (or a prescale) are thus not
+/// comparable with validateB3, which refuses them.
+///
+///   /B3/trigger/dropEmpty true
+///   /B3/trigger/windowLow 460 keV
+///   /B3/trigger/windowHigh 562 keV
+///   /B3/trigger/prescale 100
+///
+/// There is a single instance, configured by the master and read by all
+/// the threads; the counters are kept in B3Run.
+
+class B3Trigger
+{
+  public:
+    enum Decision { kAccepted = 0, kEmpty, kBelowMinEnergy, kOutsideWindow,
+                    kMultiplicity, kNbDecisions };
+
+    static B3Trigger* Instance();
+    ~B3Trigger();
+
+    /// Decision for the crystal energies of an event (Geant4 units)
+    Decision Decide(const G4double edep[9], G4double totalEdep) const;
+    /// True if a rejected event is persisted by the prescale
+    G4bool IsPrescaled(G4long globalEventNumber) const
+    { return fPrescale > 0 && globalEventNumber % fPrescale == 0; }
+
+    /// Prints the counters of a run (counts[kNbDecisions], prescaled)
+    void Print(const G4long counts[kNbDecisions], G4long prescaled) const;
+    static const char* GetDecisionName(Decision decision);
+
+  private:
+    B3Trigger();
+    void DefineCommands();
+
+    static B3Trigger* fgInstance;
+
+    G4GenericMessenger* fMessenger;
+    G4bool   fDropEmpty;
+    G4double fMinEnergy;
+    G4double fWindowLow;
+    G4double fWindowHigh;
+    G4double fCrystalThreshold;
+    G4int    fMinMultiplicity;
+    G4int    fMaxMultiplicity;
+    G4int    fPrescale;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,51 @@
+/// \file B3WeightedTally.hh
+/// \brief Definition of the B3WeightedTally structure
+
+#ifndef B3WeightedTally_h
+#define B3WeightedTally_h 1
+
+#include "B3Tally.hh"
+
+#include <stdint.h>
+
+/// Run accumulators of the weighted events (see B3Biasing)
+///
+/// An event is made of branches, disjoint histories with their own weights
+/// and crystal energies. The total spectrum is filled with the weights of
+/// the branches; the photopeak efficiency is the mean over the events of
+/// x, the sum of the weights of the branches of the event whose total
+/// energy is in the window (same whole bins as B3Tally::CountTotal). Its
+/// error comes from the sums of x and x^2 over the events, as the events
+/// are independent but not their branches.
+
+struct B3WeightedTally
+{
+  B3WeightedTally();
+  /// Clears the tally; photopeak window [peakLow, peakHigh] in keV
+  void Reset(double peakLow = 0., double peakHigh = 0.);
+
+  void BeginEvent() { eventPeak = 0.; }
+  /// Adds a branch of the event; energies in keV
+  void AddBranch(double weight, const double edep[B3Tally::kNbCrystals]);
+  void EndEvent()
+  {
+    nEvents++;
+    sumPeak  += eventPeak;
+    sumPeak2 += eventPeak*eventPeak;
+  }
+  /// Adds another tally, with the same window
+  void Add(const B3WeightedTally& other);
+
+  /// Photopeak efficiency and its standard error
+  void PeakEfficiency(double& efficiency, double& error) const;
+
+  int peakLowBin;                         // window, in bins of the spectrum
+  int peakHighBin;
+  uint64_t nEvents;
+  double sumPeak;
+  double sumPeak2;
+  double totalSpectrum[B3Tally::kNbBins+1];
+  double eventPeak;                       // of the current event
+};
+
+#endif
@@ -0,0 +1,124 @@
+/// \file B3WoodcockModel.hh
+/// \brief Definition of the B3WoodcockModel class
+
+#ifndef B3WoodcockModel_h
+#define B3WoodcockModel_h 1
+
+#include "G4VFastSimulationModel.hh"
+#include "G4DynamicParticle.hh"
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+#include <cmath>
+#include <vector>
+
+class G4Material;
+class G4MaterialCutsCouple;
+class G4Region;
+class G4VEmProcess;
+
+/// Woodcock (delta) tracking of the photons in the voxelised phantom
+///
+/// Fast simulation model of the "Patient" region (see
+/// B3DetectorConstruction, /B3/phantom/woodcock true): a photon in the
+/// phantom flies distances sampled with the largest attenuation coefficient
+/// of the phantom materials at its energy, mu_max(E), whatever the voxels
+/// crossed. At each point reached, the material of the voxel is looked up
+/// and the interaction is real with probability mu(E)/mu_max(E), virtual
+/// (nothing happens) otherwise. A real interaction is done by the gamma
+/// process (photoelectric, Compton, ...) chosen with its share of mu(E):
+/// its PostStepDoIt is called for a photon in the material of the voxel,
+/// so the final states are those of standard tracking. The photon is
+/// followed until it is absorbed or leaves the phantom, where standard
+/// tracking takes over; it never stops at a voxel boundary.
+///
+/// The attenuation coefficients are tabulated per thread at the first
+/// photon, from the cross sections of the processes, on a log grid of
+/// energies; mu_max is the largest node value of the bin, so that the
+/// interpolated mu(E) never exceeds it. Photons out of the grid are left
+/// to standard tracking.
+///
+/// The secondaries start at their interaction points; the energy deposited
+/// locally by the processes (below the production cuts) is attributed to the
+/// volume where the photon entered the model.
+
+class B3WoodcockModel : public G4VFastSimulationModel
+{
+  public:
+    /// Counters of the thread, printed at the end of the local runs
+    struct Statistics
+    {
+      G4long nPhotons;            // fast steps
+      G4long nReal;               // real interactions
+      G4long nVirtual;            // rejected (virtual) interactions
+    };
+
+    B3WoodcockModel(const G4String& name, G4Region* envelope);
+    virtual ~B3WoodcockModel();
+
+    /// Sets the phantom filling the envelope: nb[3] voxels of voxelSize,
+    /// centred on it, with their indices in the materials; the tables are
+    /// built again at the next photon. Without indices, the model is off.
+    void SetPhantom(const G4int nb[3], const G4ThreeVector& voxelSize,
+                    const size_t* materialIndices,
+                    const std::vector<G4Material*>& materials);
+
+    virtual G4bool IsApplicable(const G4ParticleDefinition& particle);
+    virtual G4bool ModelTrigger(const G4FastTrack& fastTrack);
+    virtual void DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep);
+
+    static const Statistics& GetStatistics();
+    static void ResetStatistics();
+
+  private:
+    void BuildTables();
+    /// Energy bin and fraction for the interpolation in the tables
+    void Locate(G4double energy, size_t& bin, G4double& fraction) const
+    {
+      G4double u = (std::log(energy) - fLogEnergyMin)*fInverseLogStep;
+      bin = size_t(u);
+      if (bin > fNbNodes - 2) bin = fNbNodes - 2;
+      fraction = u - bin;
+    }
+    /// Interpolated value of a table of the nodes
+    G4double Interpolate(const std::vector<G4double>& table, size_t offset,
+                         size_t bin, G4double fraction) const
+    {
+      return table[offset + bin] + fraction*(table[offset + bin + 1] - table[offset + bin]);
+    }
+    /// Index in the materials of the voxel of a point of the envelope
+    size_t MaterialAt(const G4ThreeVector& local) const;
+
+    /// A secondary of the interactions, created at the end of the step
+    struct Secondary
+    {
+      G4DynamicParticle particle;
+      G4ThreeVector position;       // local
+      G4double time;
+    };
+
+    G4int fNb[3];
+    G4ThreeVector fVoxelSize;
+    G4ThreeVector fHalfSize;
+    const size_t* fMaterialIndices;
+    std::vector<G4Material*> fMaterials;
+    G4Region* fRegion;
+
+    // tables, built at the first photon
+    G4bool fTablesBuilt;
+    std::vector<G4VEmProcess*> fProcesses;
+    std::vector<const G4MaterialCutsCouple*> fCouples;   // per material
+    G4double fLogEnergyMin;
+    G4double fInverseLogStep;
+    size_t   fNbNodes;
+    std::vector<G4double> fMuMax;       // per bin
+    std::vector<G4double> fMu;          // [material][node]
+    std::vector<G4double> fSigma;       // [material][process][node]
+    std::vector<Secondary> fSecondaries;
+
+    static G4ThreadLocal Statistics fgStatistics;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
@@ -0,0 +1,27 @@
+/// \file B3WorkerThreadInitialization.hh
+/// \brief Definition of the B3WorkerThreadInitialization class
+
+#ifndef B3WorkerThreadInitialization_h
+#define B3WorkerThreadInitialization_h 1
+
+#include "G4UserWorkerThreadInitialization.hh"
+
+/// Worker thread initialization
+///
+/// Pins each worker thread to its CPU (see B3ThreadPlacement), and gives it
+/// its own B3PhiloxEngine when the master uses one (the kernel only knows
+/// how to clone the CLHEP engines). The engine is set up first of all in
+/// the thread, before its run manager is created.
+
+class B3WorkerThreadInitialization : public G4UserWorkerThreadInitialization
+{
+  public:
+    B3WorkerThreadInitialization();
+    virtual ~B3WorkerThreadInitialization();
+
+    virtual void SetupRNGEngine(const CLHEP::HepRandomEngine* masterEngine) const;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+#endif
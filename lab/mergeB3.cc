@@ -0,0 +1,432 @@
+/// \file mergeB3.cc
+/// \brief Parallel merge of the per-thread, per-shard and per-job outputs
+///
+/// Combines N inputs of the same kind into one output:
+///  - B3 event files (.b3e): the chunks of all inputs are copied, without
+///    being decoded, after a single file header, in the order of the inputs;
+///  - accumulator snapshots (.b3s), which include the energy spectra: the
+///    tallies are added (exactly: they are integer) and the event ranges
+///    are checked to be disjoint;
+///  - sinograms (.b3sg) with the same binning: the counts are added;
+///  - response matrices of beam scans (.b3rm) with the same grid: the
+///    histograms and the events per grid point are added;
+///  - dose maps (.b3dm) of the same phantom: the sums of the voxels are
+///    added.
+/// The inputs are read through mmap and copied by a pool of threads into
+/// the mmap-ed output. The ROOT analysis files are left to hadd.
+///
+/// Usage: mergeB3 -o <output> [-j <threads>] <input> [<input> ...]
+
+#include "B3DoseMap.hh"
+#include "B3EventFormat.hh"
+#include "B3MappedFile.hh"
+#include "B3ResponseMatrix.hh"
+#include "B3Sinogram.hh"
+#include "B3Snapshot.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace {
+
+typedef std::chrono::steady_clock MergeClock;
+
+const uint64_t kCopyBlock = 64ull << 20;   // bytes copied per task
+
+bool EndsWith(const std::string& name, const std::string& suffix)
+{
+  return name.size() >= suffix.size()
+      && name.compare(name.size()-suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/// Runs work(i) for i in [0, n) on nThreads threads
+template <class Work>
+void ParallelFor(size_t n, unsigned int nThreads, Work work)
+{
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  for (unsigned int t = 0; t < nThreads; t++) {
+    pool.push_back(std::thread([&next, n, &work]() {
+      for (size_t i = next++; i < n; i = next++) work(i);
+    }));
+  }
+  for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+/// Event file input: the mapping and the extent of its complete chunks
+struct EventInput
+{
+  B3MappedFile file;
+  uint64_t bodyEnd;       // end of the last complete chunk
+  uint64_t nChunks;
+  uint64_t nRows;
+  uint64_t outOffset;     // where the chunks go in the output
+  bool     valid;
+};
+
+void ScanEventInput(EventInput& input)
+{
+  using namespace B3EventFormat;
+  input.valid = false;
+  input.nChunks = 0;
+  input.nRows = 0;
+  input.bodyEnd = sizeof(FileHeader);
+
+  const char* data = input.file.Data();
+  uint64_t size = input.file.Size();
+  if (size < sizeof(FileHeader)
+      || !CheckFileHeader(*reinterpret_cast<const FileHeader*>(data))) return;
+
+  // Walk the chunk headers; a chunk cut by a crash ends the file
+  uint64_t offset = sizeof(FileHeader);
+  while (sizeof(ChunkHeader) <= size - offset) {
+    const ChunkHeader* chunk = reinterpret_cast<const ChunkHeader*>(data + offset);
+    if (chunk->magic != kChunkMagic
+        || chunk->storedBytes > size - offset - sizeof(ChunkHeader)) break;
+    uint64_t end = offset + sizeof(ChunkHeader) + chunk->storedBytes;
+    input.nChunks++;
+    input.nRows += chunk->nRows;
+    offset = end;
+  }
+  input.bodyEnd = offset;
+  input.valid = true;
+}
+
+int MergeEventFiles(const std::vector<std::string>& names,
+                    const std::string& outName, unsigned int nThreads)
+{
+  using namespace B3EventFormat;
+  MergeClock::time_point start = MergeClock::now();
+
+  std::vector<EventInput> inputs(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    if (!inputs[i].file.Open(names[i], B3MappedFile::kSequential)) {
+      std::cerr << "mergeB3: cannot map " << names[i] << std::endl;
+      return 1;
+    }
+  }
+  ParallelFor(inputs.size(), nThreads,
+              [&inputs](size_t i) { ScanEventInput(inputs[i]); });
+
+  uint64_t outSize = sizeof(FileHeader);
+  uint64_t nRows = 0;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if (!inputs[i].valid) {
+      std::cerr << "mergeB3: " << names[i] << " is not a B3 event file" << std::endl;
+      return 1;
+    }
+    if (inputs[i].bodyEnd != inputs[i].file.Size()) {
+      std::cerr << "mergeB3: warning: " << names[i] << " ends with an incomplete"
+                << " chunk, which is skipped" << std::endl;
+    }
+    inputs[i].outOffset = outSize;
+    outSize += inputs[i].bodyEnd - sizeof(FileHeader);
+    nRows += inputs[i].nRows;
+  }
+
+  int fd = open(outName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, off_t(outSize)) != 0) {
+    std::cerr << "mergeB3: cannot create " << outName << std::endl;
+    if (fd >= 0) close(fd);
+    return 1;
+  }
+  void* mapped = mmap(0, outSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    std::cerr << "mergeB3: cannot map " << outName << std::endl;
+    close(fd);
+    return 1;
+  }
+  char* out = static_cast<char*>(mapped);
+
+  FileHeader header;
+  InitFileHeader(header);
+  std::memcpy(out, &header, sizeof(header));
+
+  // Copy tasks of at most kCopyBlock bytes over all the inputs
+  struct CopyTask { size_t input; uint64_t offset, length; };
+  std::vector<CopyTask> tasks;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    for (uint64_t offset = sizeof(FileHeader); offset < inputs[i].bodyEnd; offset += kCopyBlock) {
+      CopyTask task = { i, offset, std::min(kCopyBlock, inputs[i].bodyEnd - offset) };
+      tasks.push_back(task);
+    }
+  }
+  ParallelFor(tasks.size(), nThreads, [&](size_t t) {
+    const CopyTask& task = tasks[t];
+    const EventInput& input = inputs[task.input];
+    std::memcpy(out + input.outOffset + (task.offset - sizeof(FileHeader)),
+                input.file.Data() + task.offset, task.length);
+  });
+
+  munmap(mapped, outSize);
+  close(fd);
+
+  double seconds = std::chrono::duration<double>(MergeClock::now() - start).count();
+  std::cout << "mergeB3: " << inputs.size() << " event files, " << nRows
+            << " events, " << outSize << " bytes -> " << outName << "\n"
+            << "mergeB3: " << seconds << " s, "
+            << (seconds > 0. ? outSize/seconds*1.e-9 : 0.) << " GB/s" << std::endl;
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int MergeSnapshots(const std::vector<std::string>& names,
+                   const std::string& outName, unsigned int nThreads)
+{
+  MergeClock::time_point start = MergeClock::now();
+
+  std::vector<B3Snapshot> snapshots(names.size());
+  std::vector<char> ok(names.size(), 0);
+  ParallelFor(names.size(), nThreads,
+              [&](size_t i) { ok[i] = snapshots[i].Read(names[i]); });
+
+  uint64_t bytes = 0;
+  std::vector<size_t> order;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (!ok[i]) {
+      std::cerr << "mergeB3: " << names[i] << " is not a B3 snapshot" << std::endl;
+      return 1;
+    }
+    if (snapshots[i].nextEvent != snapshots[i].endEvent) {
+      std::cerr << "mergeB3: warning: " << names[i] << " is incomplete (events "
+                << snapshots[i].firstEvent << " to " << snapshots[i].nextEvent
+                << " of " << snapshots[i].endEvent << ")" << std::endl;
+    }
+    bytes += sizeof(B3Tally);
+    order.push_back(i);
+  }
+
+  // The event ranges of the inputs must not overlap
+  std::sort(order.begin(), order.end(), [&snapshots](size_t a, size_t b)
+            { return snapshots[a].firstEvent < snapshots[b].firstEvent; });
+  for (size_t k = 1; k < order.size(); k++) {
+    const B3Snapshot& previous = snapshots[order[k-1]];
+    const B3Snapshot& current = snapshots[order[k]];
+    if (current.firstEvent < previous.endEvent) {
+      std::cerr << "mergeB3: " << names[order[k-1]] << " and " << names[order[k]]
+                << " cover the same events" << std::endl;
+      return 1;
+    }
+    if (current.firstEvent > previous.endEvent) {
+      std::cerr << "mergeB3: warning: events " << previous.endEvent << " to "
+                << current.firstEvent << " are missing" << std::endl;
+    }
+    if (current.seed != previous.seed) {
+      std::cerr << "mergeB3: warning: " << names[order[k]]
+                << " was produced with another seed" << std::endl;
+    }
+  }
+
+  B3Snapshot merged = snapshots[order[0]];
+  for (size_t k = 1; k < order.size(); k++) merged.Add(snapshots[order[k]]);
+  merged.shardIndex = 0;
+  merged.shardCount = 1;
+  if (!merged.Write(outName)) {
+    std::cerr << "mergeB3: cannot write " << outName << std::endl;
+    return 1;
+  }
+
+  double seconds = std::chrono::duration<double>(MergeClock::now() - start).count();
+  std::cout << "mergeB3: " << names.size() << " snapshots, events ["
+            << merged.firstEvent << ", " << merged.nextEvent << "), "
+            << merged.tally.nEvents << " events tallied -> " << outName << "\n"
+            << "mergeB3: " << seconds << " s, "
+            << (seconds > 0. ? bytes/seconds*1.e-9 : 0.) << " GB/s" << std::endl;
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int MergeSinograms(const std::vector<std::string>& names,
+                   const std::string& outName, unsigned int nThreads)
+{
+  MergeClock::time_point start = MergeClock::now();
+
+  std::vector<B3Sinogram> sinograms(names.size());
+  std::vector<char> ok(names.size(), 0);
+  ParallelFor(names.size(), nThreads,
+              [&](size_t i) { ok[i] = sinograms[i].Read(names[i]); });
+
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (!ok[i]) {
+      std::cerr << "mergeB3: " << names[i] << " is not a B3 sinogram" << std::endl;
+      return 1;
+    }
+    bytes += sinograms[i].counts.size()*sizeof(uint32_t);
+  }
+
+  B3Sinogram merged = sinograms[0];
+  for (size_t i = 1; i < names.size(); i++) {
+    if (!merged.Add(sinograms[i])) {
+      std::cerr << "mergeB3: " << names[i] << " has another binning than "
+                << names[0] << std::endl;
+      return 1;
+    }
+  }
+  if (!merged.Write(outName)) {
+    std::cerr << "mergeB3: cannot write " << outName << std::endl;
+    return 1;
+  }
+
+  double seconds = std::chrono::duration<double>(MergeClock::now() - start).count();
+  std::cout << "mergeB3: " << names.size() << " sinograms, " << merged.nCoincidences
+            << " coincidences -> " << outName << "\n"
+            << "mergeB3: " << seconds << " s, "
+            << (seconds > 0. ? bytes/seconds*1.e-9 : 0.) << " GB/s" << std::endl;
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int MergeResponses(const std::vector<std::string>& names,
+                   const std::string& outName, unsigned int nThreads)
+{
+  MergeClock::time_point start = MergeClock::now();
+
+  std::vector<B3ResponseMatrix> responses(names.size());
+  std::vector<char> ok(names.size(), 0);
+  ParallelFor(names.size(), nThreads,
+              [&](size_t i) { ok[i] = responses[i].Read(names[i]); });
+
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (!ok[i]) {
+      std::cerr << "mergeB3: " << names[i] << " is not a B3 response matrix" << std::endl;
+      return 1;
+    }
+    bytes += responses[i].counts.size()*sizeof(uint32_t);
+  }
+
+  B3ResponseMatrix merged = responses[0];
+  for (size_t i = 1; i < names.size(); i++) {
+    if (!merged.Add(responses[i])) {
+      std::cerr << "mergeB3: " << names[i] << " has another grid than "
+                << names[0] << std::endl;
+      return 1;
+    }
+  }
+  if (!merged.Write(outName)) {
+    std::cerr << "mergeB3: cannot write " << outName << std::endl;
+    return 1;
+  }
+
+  uint64_t nEvents = 0;
+  for (size_t i = 0; i < merged.events.size(); i++) nEvents += merged.events[i];
+  double seconds = std::chrono::duration<double>(MergeClock::now() - start).count();
+  std::cout << "mergeB3: " << names.size() << " response matrices, " << merged.NbPoints()
+            << " grid points, " << nEvents << " events -> " << outName << "\n"
+            << "mergeB3: " << seconds << " s, "
+            << (seconds > 0. ? bytes/seconds*1.e-9 : 0.) << " GB/s" << std::endl;
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int MergeDoseMaps(const std::vector<std::string>& names,
+                  const std::string& outName, unsigned int nThreads)
+{
+  MergeClock::time_point start = MergeClock::now();
+
+  std::vector<B3DoseMap> maps(names.size());
+  std::vector<char> ok(names.size(), 0);
+  ParallelFor(names.size(), nThreads,
+              [&](size_t i) { ok[i] = maps[i].Read(names[i]); });
+
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (!ok[i]) {
+      std::cerr << "mergeB3: " << names[i] << " is not a B3 dose map" << std::endl;
+      return 1;
+    }
+    bytes += 2*maps[i].dose.size()*sizeof(float);
+  }
+
+  B3DoseMap merged = maps[0];
+  for (size_t i = 1; i < names.size(); i++) {
+    if (!merged.Add(maps[i])) {
+      std::cerr << "mergeB3: " << names[i] << " has another phantom than "
+                << names[0] << std::endl;
+      return 1;
+    }
+  }
+  if (!merged.Write(outName)) {
+    std::cerr << "mergeB3: cannot write " << outName << std::endl;
+    return 1;
+  }
+
+  double seconds = std::chrono::duration<double>(MergeClock::now() - start).count();
+  std::cout << "mergeB3: " << names.size() << " dose maps, " << merged.NbVoxels()
+            << " voxels, " << merged.events << " events, total dose "
+            << merged.TotalDose() << " Gy -> " << outName << "\n"
+            << "mergeB3: " << seconds << " s, "
+            << (seconds > 0. ? bytes/seconds*1.e-9 : 0.) << " GB/s" << std::endl;
+  return 0;
+}
+
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  std::string outName;
+  unsigned int nThreads = std::thread::hardware_concurrency();
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-o" && i+1 < argc) outName = argv[++i];
+    else if (arg == "-j" && i+1 < argc) nThreads = std::atoi(argv[++i]);
+    else inputs.push_back(arg);
+  }
+  if (outName.empty() || inputs.empty()) {
+    std::cerr << "Usage: mergeB3 -o <output> [-j <threads>] <input> [<input> ...]"
+              << std::endl;
+    return 2;
+  }
+  if (nThreads == 0) nThreads = 1;
+
+  bool events = EndsWith(outName, ".b3e");
+  bool snapshots = EndsWith(outName, ".b3s");
+  bool sinograms = EndsWith(outName, ".b3sg");
+  bool responses = EndsWith(outName, ".b3rm");
+  bool doseMaps = EndsWith(outName, ".b3dm");
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if ((events && !EndsWith(inputs[i], ".b3e")) || (snapshots && !EndsWith(inputs[i], ".b3s"))
+        || (sinograms && !EndsWith(inputs[i], ".b3sg"))
+        || (responses && !EndsWith(inputs[i], ".b3rm"))
+        || (doseMaps && !EndsWith(inputs[i], ".b3dm"))) {
+      std::cerr << "mergeB3: " << inputs[i] << " is not of the kind of " << outName
+                << std::endl;
+      return 2;
+    }
+  }
+
+  if (events)    return MergeEventFiles(inputs, outName, nThreads);
+  if (snapshots) return MergeSnapshots(inputs, outName, nThreads);
+  if (sinograms) return MergeSinograms(inputs, outName, nThreads);
+  if (responses) return MergeResponses(inputs, outName, nThreads);
+  if (doseMaps)  return MergeDoseMaps(inputs, outName, nThreads);
+  std::cerr << "mergeB3: the output must be a .b3e, .b3s, .b3sg, .b3rm or .b3dm file"
+            << std::endl;
+  return 2;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
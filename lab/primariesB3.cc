@@ -0,0 +1,134 @@
+/// \file primariesB3.cc
+/// \brief Conversion of a text list of primary particles to a B3 primary event file
+///
+/// Usage: primariesB3 <input.txt> <output.b3p>
+///
+/// Each line of the input is one primary particle:
+///   event x y z t weight pdg energy dx dy dz
+/// with the position in mm, the time in ns and the kinetic energy in keV;
+/// empty lines and lines starting with # are skipped. The events are in
+/// increasing order; the consecutive particles of an event with the same
+/// position, time and weight share a vertex, and the missing event numbers
+/// are empty events. The file is read by B3PrimaryLibrary
+/// (/B3/primaries/file).
+
+#include "B3PrimaryFormat.hh"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  using namespace B3PrimaryFormat;
+
+  if (argc != 3) {
+    std::cerr << "Usage: primariesB3 <input.txt> <output.b3p>" << std::endl;
+    return 2;
+  }
+  std::ifstream input(argv[1]);
+  if (!input) {
+    std::cerr << "primariesB3: cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::vector<uint64_t> eventVertex(1, 0);
+  std::vector<Vertex> vertices;
+  std::vector<Particle> particles;
+  std::string line;
+  long lineNumber = 0;
+  int64_t lastEvent = -1;
+  while (std::getline(input, line)) {
+    lineNumber++;
+    std::string::size_type start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') continue;
+
+    std::istringstream fields(line);
+    int64_t event;
+    double x, y, z, t, weight, energy, dx, dy, dz;
+    int32_t pdg;
+    if (!(fields >> event >> x >> y >> z >> t >> weight >> pdg >> energy >> dx >> dy >> dz)
+        || event < lastEvent || energy < 0.) {
+      std::cerr << "primariesB3: " << argv[1] << ":" << lineNumber
+                << ": bad particle line" << std::endl;
+      return 1;
+    }
+    double norm = std::sqrt(dx*dx + dy*dy + dz*dz);
+    if (norm <= 0.) {
+      std::cerr << "primariesB3: " << argv[1] << ":" << lineNumber
+                << ": null direction" << std::endl;
+      return 1;
+    }
+
+    // close the events before this one (the missing ones are empty)
+    bool newEvent = event != lastEvent;
+    for (; lastEvent < event; lastEvent++) {
+      if (lastEvent >= 0) eventVertex.push_back(vertices.size());
+    }
+
+    Vertex vertex = Vertex();
+    vertex.time = t;
+    vertex.position[0] = float(x);
+    vertex.position[1] = float(y);
+    vertex.position[2] = float(z);
+    vertex.weight = float(weight);
+    vertex.firstParticle = particles.size();
+    if (newEvent || vertices.empty()
+        || vertices.back().time != vertex.time
+        || vertices.back().position[0] != vertex.position[0]
+        || vertices.back().position[1] != vertex.position[1]
+        || vertices.back().position[2] != vertex.position[2]
+        || vertices.back().weight != vertex.weight) {
+      vertices.push_back(vertex);
+    }
+    vertices.back().nParticles++;
+
+    Particle particle = Particle();
+    particle.pdg = pdg;
+    particle.energy = float(energy);
+    particle.direction[0] = float(dx/norm);
+    particle.direction[1] = float(dy/norm);
+    particle.direction[2] = float(dz/norm);
+    particles.push_back(particle);
+  }
+  if (lastEvent >= 0) eventVertex.push_back(vertices.size());
+
+  FileHeader header;
+  InitFileHeader(header);
+  header.nEvents = eventVertex.size() - 1;
+  header.nVertices = vertices.size();
+  header.nParticles = particles.size();
+
+  std::FILE* output = std::fopen(argv[2], "wb");
+  if (!output) {
+    std::cerr << "primariesB3: cannot create " << argv[2] << std::endl;
+    return 1;
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, output) == 1
+         && std::fwrite(&eventVertex[0], sizeof(uint64_t), eventVertex.size(), output)
+            == eventVertex.size()
+         && (vertices.empty()
+             || std::fwrite(&vertices[0], sizeof(Vertex), vertices.size(), output)
+                == vertices.size())
+         && (particles.empty()
+             || std::fwrite(&particles[0], sizeof(Particle), particles.size(), output)
+                == particles.size());
+  ok = std::fclose(output) == 0 && ok;
+  if (!ok) {
+    std::cerr << "primariesB3: cannot write " << argv[2] << std::endl;
+    return 1;
+  }
+
+  std::cout << argv[2] << ": " << header.nEvents << " events, "
+            << header.nVertices << " vertices, " << header.nParticles
+            << " particles, " << FileBytes(header) << " bytes" << std::endl;
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,358 @@
+/// \file reconB3.cc
+/// \brief OSEM image reconstruction of the list-mode or sinogram outputs
+///
+/// Usage: reconB3 [-o <image.raw>] [-n <iterations>] [-s <subsets>]
+///                [-j <threads>] [--voxels <nx> <ny> <nz>]
+///                [--voxel-size <dx> <dy> <dz>] [--tof <fwhm>]
+///                [--matrix <directory> [--matrix-only]]
+///                <file.b3lm> [<file.b3lm> ...] | <file.b3sg>
+///
+/// The scanner is the crystal table stored in the inputs (see
+/// B3ListModeFormat.hh and B3Sinogram.hh): the list-mode events lie on the
+/// lines between crystal centres, the sinogram bins on lines through the
+/// centres of their bins. By default the image covers the inside of the
+/// scanner, 64 x 64 voxels across and one voxel per ring along z. --tof
+/// uses the time differences of list-mode data with the given coincidence
+/// time resolution (FWHM, ps).
+///
+/// With --matrix, the projections use the system matrix of the scanner and
+/// image grid (B3SystemMatrix) cached in the directory, which is computed
+/// and added to the cache the first time; --matrix-only stops there, to
+/// fill the cache ahead of the reconstructions.
+///
+/// The image is written as raw 32-bit floats, x fastest (default
+/// "image.raw"); its grid and the iteration rate are printed.
+
+#include "B3ListModeReader.hh"
+#include "B3Osem.hh"
+#include "B3Sinogram.hh"
+#include "B3SystemMatrix.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace {
+
+using namespace B3ListModeFormat;
+
+/// Speed of light, mm/ps
+const double kLightSpeed = 0.299792458;
+
+bool EndsWith(const std::string& name, const std::string& suffix)
+{
+  return name.size() >= suffix.size()
+      && name.compare(name.size()-suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void Usage()
+{
+  std::cerr << "Usage: reconB3 [-o <image.raw>] [-n <iterations>] [-s <subsets>]\n"
+            << "               [-j <threads>] [--voxels <nx> <ny> <nz>]\n"
+            << "               [--voxel-size <dx> <dy> <dz>] [--tof <fwhm>]\n"
+            << "               [--matrix <directory> [--matrix-only]]\n"
+            << "               <file.b3lm> [<file.b3lm> ...] | <file.b3sg>" << std::endl;
+}
+
+/// Image inside the scanner: nVoxels across, one voxel per ring along z
+B3ImageGrid DefaultGrid(const std::vector<CrystalEntry>& crystals, size_t nRings)
+{
+  double inner = 0., outer = 0., zMin = 0., zMax = 0., zHalf = 0.;
+  for (size_t i = 0; i < crystals.size(); i++) {
+    const CrystalEntry& crystal = crystals[i];
+    double radius = std::sqrt(crystal.center[0]*crystal.center[0]
+                              + crystal.center[1]*crystal.center[1]);
+    double half = std::max(crystal.halfSize[0], crystal.halfSize[1]);
+    if (i == 0 || radius - half < inner) inner = radius - half;
+    if (i == 0 || radius > outer) outer = radius;
+    if (i == 0 || crystal.center[2] < zMin) zMin = crystal.center[2];
+    if (i == 0 || crystal.center[2] > zMax) zMax = crystal.center[2];
+    zHalf = std::max(zHalf, double(crystal.halfSize[2]));
+  }
+  if (inner <= 0.) inner = outer;
+  if (inner <= 0.) inner = 1.;
+
+  B3ImageGrid grid;
+  grid.n[0] = grid.n[1] = 64;
+  grid.n[2] = uint32_t(std::max<size_t>(nRings, 1));
+  grid.voxelSize[0] = grid.voxelSize[1] = float(2.*inner/grid.n[0]);
+  grid.voxelSize[2] = float((zMax - zMin + 2.*zHalf)/grid.n[2]);
+  if (grid.voxelSize[2] <= 0.f) grid.voxelSize[2] = grid.voxelSize[0];
+  grid.center[0] = grid.center[1] = 0.f;
+  grid.center[2] = float(0.5*(zMin + zMax));
+  return grid;
+}
+
+/// Distinct axial positions of the crystals
+size_t CountRings(const std::vector<CrystalEntry>& crystals)
+{
+  std::vector<float> z;
+  for (size_t i = 0; i < crystals.size(); i++) z.push_back(crystals[i].center[2]);
+  std::sort(z.begin(), z.end());
+  return std::unique(z.begin(), z.end()) - z.begin();
+}
+
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  std::string outName = "image.raw";
+  unsigned int nIterations = 4, nSubsets = 8;
+  unsigned int nThreads = std::thread::hardware_concurrency();
+  double tofFwhm = 0.;
+  int voxels[3] = { 0, 0, 0 };
+  double voxelSize[3] = { 0., 0., 0. };
+  std::string matrixDirectory;
+  bool matrixOnly = false;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-o" && i+1 < argc) outName = argv[++i];
+    else if (arg == "-n" && i+1 < argc) nIterations = std::atoi(argv[++i]);
+    else if (arg == "-s" && i+1 < argc) nSubsets = std::atoi(argv[++i]);
+    else if (arg == "-j" && i+1 < argc) nThreads = std::atoi(argv[++i]);
+    else if (arg == "--tof" && i+1 < argc) tofFwhm = std::atof(argv[++i]);
+    else if (arg == "--matrix" && i+1 < argc) matrixDirectory = argv[++i];
+    else if (arg == "--matrix-only") matrixOnly = true;
+    else if (arg == "--voxels" && i+3 < argc) {
+      for (int a = 0; a < 3; a++) voxels[a] = std::atoi(argv[++i]);
+    }
+    else if (arg == "--voxel-size" && i+3 < argc) {
+      for (int a = 0; a < 3; a++) voxelSize[a] = std::atof(argv[++i]);
+    }
+    else if (arg[0] == '-') {
+      Usage();
+      return 2;
+    }
+    else inputs.push_back(arg);
+  }
+  bool sinogramInput = !inputs.empty() && EndsWith(inputs[0], ".b3sg");
+  if (inputs.empty() || (sinogramInput && inputs.size() > 1)) {
+    Usage();
+    return 2;
+  }
+  if (nThreads == 0) nThreads = 1;
+  if (nSubsets == 0) nSubsets = 1;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  // Scanner and data
+  std::vector<CrystalEntry> crystals;
+  B3Sinogram sinogram;
+  std::vector<B3ListModeReader*> readers;
+  if (sinogramInput) {
+    if (!sinogram.Read(inputs[0])) {
+      std::cerr << "reconB3: " << inputs[0] << " is not a B3 sinogram" << std::endl;
+      return 1;
+    }
+    crystals = sinogram.crystals;
+    if (tofFwhm > 0.) {
+      std::cerr << "reconB3: warning: a sinogram has no time of flight, --tof ignored"
+                << std::endl;
+      tofFwhm = 0.;
+    }
+  }
+  else {
+    for (size_t f = 0; f < inputs.size(); f++) {
+      B3ListModeReader* reader = new B3ListModeReader;
+      readers.push_back(reader);
+      if (!reader->Open(inputs[f])) {
+        std::cerr << "reconB3: " << inputs[f] << " is not a B3 list-mode file" << std::endl;
+        return 1;
+      }
+      if (f == 0) crystals = reader->GetCrystals();
+      else if (reader->GetCrystals().size() != crystals.size()) {
+        std::cerr << "reconB3: " << inputs[f] << " has another scanner than "
+                  << inputs[0] << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  size_t nRings = sinogramInput ? sinogram.ringZ.size() : CountRings(crystals);
+  B3ImageGrid grid = DefaultGrid(crystals, nRings);
+  for (int a = 0; a < 3; a++) {
+    if (voxels[a] > 0) {
+      // the same field of view, unless the voxel size is given too
+      grid.voxelSize[a] *= float(grid.n[a])/voxels[a];
+      grid.n[a] = voxels[a];
+    }
+    if (voxelSize[a] > 0.) grid.voxelSize[a] = float(voxelSize[a]);
+  }
+
+  B3Osem osem(grid);
+  osem.SetThreads(nThreads);
+  osem.SetSubsets(nSubsets);
+  osem.SetTofResolution(tofFwhm);
+
+  // Lines of response: start and end points, and sensitivity weights
+  std::vector<double> lines;
+  std::vector<float> weights;
+  std::ostringstream kind;
+  double radius = 0.;
+  std::vector<int64_t> lineOfBin;
+  if (sinogramInput) {
+    // lines through the bins, weighted by the crystal pairs they collect
+    for (size_t i = 0; i < crystals.size(); i++) {
+      radius = std::max(radius, std::sqrt(double(crystals[i].center[0])*crystals[i].center[0]
+                                          + double(crystals[i].center[1])*crystals[i].center[1]));
+    }
+    if (radius == 0.) radius = 0.5*sinogram.nRadial*sinogram.radialBin;
+    std::vector<float> pairs(sinogram.NbBins(), crystals.empty() ? 1.f : 0.f);
+    if (!crystals.empty()) {
+      std::vector<int64_t> lookup;
+      sinogram.BuildLookup(crystals, lookup);
+      for (size_t p = 0; p < lookup.size(); p++) {
+        if (lookup[p] >= 0) pairs[lookup[p]] += 1.f;
+      }
+    }
+    lineOfBin.assign(sinogram.NbBins(), -1);
+    for (size_t bin = 0; bin < sinogram.NbBins(); bin++) {
+      if (pairs[bin] == 0.f) continue;
+      double ends[6];
+      sinogram.BinLine(bin, radius, ends, ends + 3);
+      lineOfBin[bin] = int64_t(weights.size());
+      lines.insert(lines.end(), ends, ends + 6);
+      weights.push_back(pairs[bin]);
+    }
+    kind << "sinogram " << sinogram.nRadial << " " << sinogram.nAngles << " "
+         << sinogram.radialBin << " " << sinogram.maxRingDifference << " " << radius;
+  }
+  else {
+    // lines between the crystal centres, for all the pairs: line = pair ID
+    uint32_t n = uint32_t(crystals.size());
+    for (uint32_t b = 1; b < n; b++) {
+      for (uint32_t a = 0; a < b; a++) {
+        lines.insert(lines.end(), crystals[a].center, crystals[a].center + 3);
+        lines.insert(lines.end(), crystals[b].center, crystals[b].center + 3);
+        weights.push_back(1.f);
+      }
+    }
+    kind << "pairs";
+  }
+  for (size_t l = 0; l < weights.size(); l++) osem.AddLine(&lines[6*l], &lines[6*l+3], weights[l]);
+
+  // Precomputed system matrix, from the cache or built
+  B3SystemMatrix matrix;
+  if (!matrixDirectory.empty()) {
+    uint64_t key = B3SystemMatrix::Key(crystals, grid, kind.str());
+    std::string matrixName = B3SystemMatrix::FileName(matrixDirectory, key);
+    bool cached = matrix.Open(matrixName, key);
+    if (!cached
+        && !matrix.Build(matrixName, key, grid, lines,
+                         sinogramInput ? std::vector<CrystalEntry>() : crystals, nThreads)) {
+      std::cerr << "reconB3: cannot write the system matrix " << matrixName << std::endl;
+      return 1;
+    }
+    const B3SystemMatrix::Statistics& stats = matrix.GetStatistics();
+    if (!cached) {
+      std::printf("reconB3: system matrix built in %.2f s, %u threads\n",
+                  stats.buildSeconds, nThreads);
+    }
+    std::printf("reconB3: system matrix %s: %llu lines, %llu rows stored,"
+                " %llu of %llu non-zeros (%u transaxial symmetries%s), %.1f MB\n",
+                matrixName.c_str(), (unsigned long long)stats.nLines, (unsigned long long)stats.nRows,
+                (unsigned long long)stats.nonZeros, (unsigned long long)stats.fullNonZeros,
+                stats.nTransaxial, stats.axial ? ", axial" : "",
+                stats.nonZeros*8.e-6);
+    osem.SetSystemMatrix(&matrix);
+    if (matrixOnly) return 0;
+  }
+
+  // Data
+  uint64_t nCounts = 0, nLost = 0;
+  if (sinogramInput) {
+    for (size_t bin = 0; bin < sinogram.NbBins(); bin++) {
+      if (sinogram.counts[bin] == 0) continue;
+      if (lineOfBin[bin] < 0) {
+        nLost += sinogram.counts[bin];
+        continue;
+      }
+      uint32_t angle = uint32_t((bin / sinogram.nRadial) % sinogram.nAngles);
+      osem.AddEvent(uint32_t(lineOfBin[bin]), float(sinogram.counts[bin]), 0.f, angle);
+      nCounts += sinogram.counts[bin];
+    }
+  }
+  else {
+    std::vector<uint64_t> records;
+    for (size_t f = 0; f < readers.size(); f++) {
+      float timeBin = readers[f]->GetHeader().timeBin;
+      for (size_t block = 0; block < readers[f]->GetNbBlocks(); block++) {
+        if (!readers[f]->ReadBlock(block, records)) {
+          std::cerr << "reconB3: warning: block " << block << " of " << inputs[f]
+                    << " is corrupted" << std::endl;
+          continue;
+        }
+        for (size_t r = 0; r < records.size(); r++) {
+          Coincidence coincidence = Unpack(records[r]);
+          if (coincidence.pair >= osem.GetNbLines()) {
+            nLost++;
+            continue;
+          }
+          // the second crystal is hit later: the annihilation is nearer the first
+          float tofCenter = float(-0.5*kLightSpeed*coincidence.timeDiff*timeBin);
+          osem.AddEvent(coincidence.pair, 1.f, tofCenter, uint32_t(nCounts));
+          nCounts++;
+        }
+      }
+      delete readers[f];
+    }
+    readers.clear();
+  }
+  if (nLost > 0) {
+    std::cerr << "reconB3: warning: " << nLost << " counts on no line of the scanner"
+              << std::endl;
+  }
+
+  double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::printf("reconB3: %zu crystals, %zu lines, %llu counts in %zu events (%.2f s)\n",
+              crystals.size(), osem.GetNbLines(), (unsigned long long)nCounts,
+              osem.GetNbEvents(), loadSeconds);
+  std::printf("reconB3: image %u x %u x %u voxels of %.3f x %.3f x %.3f mm, centre"
+              " (%.2f, %.2f, %.2f) mm\n",
+              grid.n[0], grid.n[1], grid.n[2],
+              grid.voxelSize[0], grid.voxelSize[1], grid.voxelSize[2],
+              grid.center[0], grid.center[1], grid.center[2]);
+
+  osem.Initialize();
+  std::printf("reconB3: sensitivity %.3f s, %u threads\n",
+              osem.GetStatistics().sensitivitySeconds, nThreads);
+  for (unsigned int it = 0; it < nIterations; it++) {
+    double before = osem.GetStatistics().seconds;
+    osem.Iterate();
+    std::printf("reconB3: iteration %u of %u, %u subsets%s, %.3f s\n", it+1, nIterations,
+                nSubsets, tofFwhm > 0. ? ", TOF" : "", osem.GetStatistics().seconds - before);
+  }
+
+  const B3Osem::Statistics& stats = osem.GetStatistics();
+  if (stats.iterations > 0) {
+    std::printf("reconB3: %.3f s, %.3f iterations/s, %.2f M events/s\n", stats.seconds,
+                stats.seconds > 0. ? stats.iterations/stats.seconds : 0.,
+                stats.seconds > 0. ? stats.linesTraced/stats.seconds*1.e-6 : 0.);
+  }
+
+  const std::vector<float>& image = osem.GetImage();
+  std::FILE* file = std::fopen(outName.c_str(), "wb");
+  if (!file || (!image.empty() && std::fwrite(&image[0], sizeof(float), image.size(), file)
+                                  != image.size())) {
+    std::cerr << "reconB3: cannot write " << outName << std::endl;
+    if (file) std::fclose(file);
+    return 1;
+  }
+  std::fclose(file);
+  std::printf("reconB3: image -> %s\n", outName.c_str());
+  return 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -32,6 +32,8 @@
 #include "B3PrimaryGeneratorAction.hh"
 #include "B3RunAction.hh"
 #include "B3StackingAction.hh"
+#include "B3SteppingAction.hh"
+#include "B3TrackingAction.hh"
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
@@ -58,6 +60,8 @@ void B3ActionInitialization::Build() const
   SetUserAction(new B3PrimaryGeneratorAction);
   SetUserAction(new B3RunAction);
   SetUserAction(new B3StackingAction);
+  SetUserAction(new B3SteppingAction);
+  SetUserAction(new B3TrackingAction);
 }  
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
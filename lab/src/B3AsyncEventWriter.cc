@@ -0,0 +1,433 @@
+/// \file B3AsyncEventWriter.cc
+/// \brief Implementation of the B3AsyncEventWriter class
+
+#include "B3AsyncEventWriter.hh"
+#include "B3EventFileWriter.hh"
+#include "B3RingBuffer.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace {
+
+typedef std::chrono::steady_clock WriterClock;
+
+double SecondsSince(WriterClock::time_point start)
+{
+  return std::chrono::duration<double>(WriterClock::now() - start).count();
+}
+
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+class B3AsyncEventWriter::Producer
+{
+  public:
+    Producer(uint32_t ringRows)
+     : ring(ringRows), rows(B3EventFormat::kChunkRows), nRows(0), closing(false),
+       pushed(0), stalls(0), stallSeconds(0.), highWater(0)
+    { }
+
+    // shared
+    B3RingBuffer<B3EventFormat::EventRecord> ring;
+    // packer thread
+    std::vector<B3EventFormat::EventRecord> rows;
+    uint32_t nRows;
+    // I/O thread
+    B3EventFileWriter file;
+    // set by the producer thread when it is done
+    std::atomic<bool> closing;
+    // producer thread
+    uint64_t pushed;
+    uint64_t stalls;
+    double   stallSeconds;
+    size_t   highWater;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+class B3AsyncEventWriter::SharedFile
+{
+  public:
+    // I/O thread
+    B3EventFileWriter file;
+};
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3AsyncEventWriter::B3AsyncEventWriter(uint32_t ringRows, int compressionLevel,
+                                       uint32_t queueBatches)
+ : fRingRows(ringRows),
+   fCompressionLevel(compressionLevel),
+   fClosing(0),
+   fStop(false),
+   fQueueBatches(queueBatches),
+   fIOStop(false)
+{
+  ResetStatistics();
+  for (int i = 0; i < 2; i++) fFreeBlocks.push_back(&fBlocks[i]);
+  fPacker = std::thread(&B3AsyncEventWriter::PackLoop, this);
+  fWriter = std::thread(&B3AsyncEventWriter::WriteLoop, this);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3AsyncEventWriter::~B3AsyncEventWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (size_t i = 0; i < fProducers.size(); i++) {
+      if (!fProducers[i]->closing.load()) {
+        fClosing++;
+        fProducers[i]->closing.store(true, std::memory_order_release);
+      }
+    }
+    fStop = true;
+  }
+  fWake.notify_one();
+  fPacker.join();
+
+  {
+    std::lock_guard<std::mutex> lock(fIOMutex);
+    fIOStop = true;
+  }
+  fIOReady.notify_one();
+  fWriter.join();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3AsyncEventWriter::Producer*
+B3AsyncEventWriter::Open(const std::string& fileName, bool append)
+{
+  Producer* producer = new Producer(fRingRows);
+  if (!producer->file.Open(fileName, append)) {
+    delete producer;
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(fMutex);
+  fProducers.push_back(producer);
+  if (producer->ring.Capacity() > fStatistics.ringCapacity) {
+    fStatistics.ringCapacity = producer->ring.Capacity();
+  }
+  return producer;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::Push(Producer* producer,
+                              const B3EventFormat::EventRecord& record)
+{
+  if (!producer->ring.Push(record)) {
+    // back-pressure: the packer is behind
+    WriterClock::time_point start = WriterClock::now();
+    producer->stalls++;
+    fWake.notify_one();
+    while (!producer->ring.Push(record)) std::this_thread::yield();
+    producer->stallSeconds += SecondsSince(start);
+  }
+  producer->pushed++;
+
+  size_t waiting = producer->ring.Size();
+  if (waiting > producer->highWater) producer->highWater = waiting;
+  // wake the packer well before the ring is full
+  if (waiting == producer->ring.Capacity()/2) fWake.notify_one();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::Close(Producer* producer)
+{
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fClosing++;
+  }
+  producer->closing.store(true, std::memory_order_release);
+  fWake.notify_one();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3AsyncEventWriter::SharedFile*
+B3AsyncEventWriter::OpenShared(const std::string& fileName, bool append)
+{
+  SharedFile* shared = new SharedFile;
+  if (!shared->file.Open(fileName, append)) {
+    delete shared;
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(fMutex);
+  fStatistics.queueCapacity = fQueueBatches;
+  return shared;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::Submit(SharedFile* shared,
+                                std::vector<B3EventFormat::EventRecord>& rows)
+{
+  if (rows.empty()) return;
+
+  size_t nRows = rows.size();
+  size_t waiting;
+  bool stalled = false;
+  double stallSeconds = 0.;
+  {
+    std::unique_lock<std::mutex> lock(fBatchMutex);
+    if (fBatches.size() >= fQueueBatches) {
+      // back-pressure: the packer is behind
+      WriterClock::time_point start = WriterClock::now();
+      stalled = true;
+      fWake.notify_one();
+      fBatchSpace.wait(lock, [this]() { return fBatches.size() < fQueueBatches; });
+      stallSeconds = SecondsSince(start);
+    }
+    fBatches.push_back(Batch());
+    Batch& batch = fBatches.back();
+    batch.shared = shared;
+    batch.close = false;
+    batch.rows.swap(rows);
+    if (!fFreeRows.empty()) {
+      rows.swap(fFreeRows.back());
+      fFreeRows.pop_back();
+    }
+    waiting = fBatches.size();
+  }
+  rows.clear();
+  fWake.notify_one();
+
+  std::lock_guard<std::mutex> lock(fMutex);
+  fStatistics.batches++;
+  fStatistics.rows += nRows;
+  if (waiting > fStatistics.queueHighWater) fStatistics.queueHighWater = waiting;
+  if (stalled) {
+    fStatistics.stalls++;
+    fStatistics.stallSeconds += stallSeconds;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::Close(SharedFile* shared)
+{
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fClosing++;
+  }
+  {
+    // queued after the last batches of the file; not bounded
+    std::lock_guard<std::mutex> lock(fBatchMutex);
+    fBatches.push_back(Batch());
+    fBatches.back().shared = shared;
+    fBatches.back().close = true;
+  }
+  fWake.notify_one();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::Sync()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  fSynced.wait(lock, [this]() { return fClosing == 0; });
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3AsyncEventWriter::Statistics B3AsyncEventWriter::GetStatistics() const
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  return fStatistics;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::ResetStatistics()
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  uint64_t ringCapacity = fStatistics.ringCapacity;
+  uint64_t queueCapacity = fStatistics.queueCapacity;
+  std::memset(&fStatistics, 0, sizeof(fStatistics));
+  fStatistics.ringCapacity = ringCapacity;
+  fStatistics.queueCapacity = queueCapacity;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::PackLoop()
+{
+  std::vector<Producer*> producers;
+  for (;;) {
+    bool stop;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      producers = fProducers;
+      stop = fStop;
+    }
+    bool busy = PackBatches();
+    if (stop && producers.empty() && !busy) break;
+
+    for (size_t i = 0; i < producers.size(); i++) {
+      Producer* producer = producers[i];
+      // read the flag first: once it is set, the ring gets no more rows
+      bool closing = producer->closing.load(std::memory_order_acquire);
+      uint32_t free = B3EventFormat::kChunkRows - producer->nRows;
+      size_t n = producer->ring.Pop(&producer->rows[producer->nRows], free);
+      if (n > 0) busy = true;
+      producer->nRows += uint32_t(n);
+      if (producer->nRows == B3EventFormat::kChunkRows) {
+        EmitChunk(&producer->file, &producer->rows[0], producer->nRows, false, 0, 0);
+        producer->nRows = 0;
+      }
+
+      if (closing && producer->ring.Size() == 0) {
+        {
+          std::lock_guard<std::mutex> lock(fMutex);
+          fProducers.erase(std::find(fProducers.begin(), fProducers.end(), producer));
+        }
+        EmitChunk(&producer->file, &producer->rows[0], producer->nRows, true, producer, 0);
+        busy = true;
+      }
+    }
+
+    if (!busy) {
+      std::unique_lock<std::mutex> lock(fMutex);
+      fWake.wait_for(lock, std::chrono::milliseconds(1));
+    }
+  }
+
+  // the I/O thread stops once the queue is empty
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3AsyncEventWriter::PackBatches()
+{
+  bool busy = false;
+  for (;;) {
+    Batch batch;
+    {
+      std::lock_guard<std::mutex> lock(fBatchMutex);
+      if (fBatches.empty()) break;
+      batch.shared = fBatches.front().shared;
+      batch.close = fBatches.front().close;
+      batch.rows.swap(fBatches.front().rows);
+      fBatches.pop_front();
+    }
+    fBatchSpace.notify_all();
+    busy = true;
+
+    SharedFile* shared = batch.shared;
+    EmitChunk(&shared->file, batch.rows.empty() ? 0 : &batch.rows[0],
+              uint32_t(batch.rows.size()), batch.close, 0, batch.close ? shared : 0);
+
+    if (batch.rows.capacity() > 0) {
+      batch.rows.clear();
+      std::lock_guard<std::mutex> lock(fBatchMutex);
+      fFreeRows.push_back(std::vector<B3EventFormat::EventRecord>());
+      fFreeRows.back().swap(batch.rows);
+    }
+  }
+  return busy;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::EmitChunk(B3EventFileWriter* file,
+                                   const B3EventFormat::EventRecord* rows,
+                                   uint32_t nRows, bool close,
+                                   Producer* producer, SharedFile* shared)
+{
+  Block* block = 0;
+  {
+    std::unique_lock<std::mutex> lock(fIOMutex);
+    if (fFreeBlocks.empty()) {
+      std::lock_guard<std::mutex> statLock(fMutex);
+      fStatistics.bufferWaits++;
+    }
+    fBlockFree.wait(lock, [this]() { return !fFreeBlocks.empty(); });
+    block = fFreeBlocks.back();
+    fFreeBlocks.pop_back();
+  }
+
+  block->file = file;
+  block->producer = producer;
+  block->shared = shared;
+  block->close = close;
+  block->header.nRows = 0;
+  if (nRows > 0) {
+    WriterClock::time_point start = WriterClock::now();
+    B3EventFormat::PackChunk(rows, nRows, block->header, block->payload);
+    B3EventFormat::CompressChunk(block->header, block->payload,
+                                 fCompressionLevel.load(), fWork);
+    double seconds = SecondsSince(start);
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStatistics.chunks++;
+    fStatistics.rawBytes += block->header.rawBytes;
+    fStatistics.storedBytes += block->header.storedBytes;
+    fStatistics.packSeconds += seconds;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(fIOMutex);
+    fIOQueue.push_back(block);
+  }
+  fIOReady.notify_one();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3AsyncEventWriter::WriteLoop()
+{
+  for (;;) {
+    Block* block = 0;
+    {
+      std::unique_lock<std::mutex> lock(fIOMutex);
+      fIOReady.wait(lock, [this]() { return !fIOQueue.empty() || fIOStop; });
+      if (fIOQueue.empty()) break;
+      block = fIOQueue.front();
+      fIOQueue.pop_front();
+    }
+
+    Producer* producer = block->producer;
+    bool ok = true;
+    WriterClock::time_point start = WriterClock::now();
+    if (block->header.nRows > 0) ok = block->file->WritePackedChunk(block->header, block->payload);
+    if (block->close) block->file->Close();
+    double seconds = SecondsSince(start);
+
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fStatistics.writeSeconds += seconds;
+      if (!ok) fStatistics.writeErrors++;
+      if (block->close && block->shared) {
+        delete block->shared;
+        fClosing--;
+      }
+      else if (block->close) {
+        fStatistics.rows += producer->pushed;
+        fStatistics.stalls += producer->stalls;
+        fStatistics.stallSeconds += producer->stallSeconds;
+        if (producer->highWater > fStatistics.ringHighWater) {
+          fStatistics.ringHighWater = producer->highWater;
+        }
+        delete producer;
+        fClosing--;
+      }
+    }
+    if (block->close) fSynced.notify_all();
+
+    {
+      std::lock_guard<std::mutex> lock(fIOMutex);
+      fFreeBlocks.push_back(block);
+    }
+    fBlockFree.notify_one();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
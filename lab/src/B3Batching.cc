@@ -0,0 +1,86 @@
+/// \file B3Batching.cc
+/// \brief Implementation of the B3Batching class
+
+#include "B3Batching.hh"
+#include "B3Biasing.hh"
+#include "B3BeamScan.hh"
+#include "B3PhaseSpace.hh"
+#include "B3PrimaryLibrary.hh"
+#include "B3RandomStreams.hh"
+
+#include "G4GenericMessenger.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Batching* B3Batching::fgInstance = 0;
+G4ThreadLocal G4int B3Batching::fgEventPrimaries = 1;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Batching* B3Batching::Instance()
+{
+  if (!fgInstance) fgInstance = new B3Batching;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Batching::B3Batching()
+ : fMessenger(0),
+   fNbPrimaries(1)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Batching::~B3Batching()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Batching::BeginOfRun()
+{
+  if (fNbPrimaries <= 1) return;
+
+  // the branches of a biased event are numbered from its single primary
+  if (B3Biasing::Instance()->IsEnabled()) {
+    G4Exception("B3Batching::BeginOfRun()", "B3Batch001", FatalException,
+                "The forced interactions need one primary per event");
+    return;
+  }
+  if (B3BeamScan::Instance()->IsEnabled() || B3PhaseSpace::Instance()->IsReplaying()
+      || B3PrimaryLibrary::Instance()->IsEnabled()) {
+    G4Exception("B3Batching::BeginOfRun()", "B3Batch002", JustWarning,
+                "Only the point source is batched: one source event per event");
+    return;
+  }
+  // the global event numbers of the run must fit in the sub-event numbers
+  G4long maxOffset = (G4long(1) << (62 - kPrimaryBits)) - (G4long(1) << 31);
+  if (B3RandomStreams::Instance()->GetEventOffset() > maxOffset) {
+    G4Exception("B3Batching::BeginOfRun()", "B3Batch003", FatalException,
+                "The global event numbers are too large for the sub-event numbers");
+    return;
+  }
+  G4cout << "\n Batching: " << fNbPrimaries << " primaries per event" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Batching::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/batch/",
+                                      "Several primaries per event");
+
+  G4GenericMessenger::Command& primariesCmd
+    = fMessenger->DeclareProperty("primaries", fNbPrimaries,
+                                  "Independent primaries per event of the point source.");
+  primariesCmd.SetParameterName("n", false);
+  primariesCmd.SetRange("n>=1 && n<=65536");
+  primariesCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
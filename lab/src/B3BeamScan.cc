@@ -0,0 +1,268 @@
+/// \file B3BeamScan.cc
+/// \brief Implementation of the B3BeamScan class
+
+#include "B3BeamScan.hh"
+#include "B3ListModeOutput.hh"
+#include "B3ShardManager.hh"
+#include "B3Sweep.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4Run.hh"
+#include "G4SystemOfUnits.hh"
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
+
+#include <algorithm>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  /// Distance before the face at which the beam starts
+  const G4double kStandoff = 1*mm;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3BeamScan* B3BeamScan::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3BeamScan* B3BeamScan::Instance()
+{
+  if (!fgInstance) fgInstance = new B3BeamScan;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3BeamScan::B3BeamScan()
+ : fMessenger(0),
+   fFileBase("none"),
+   fNbY(12),
+   fNbZ(9),
+   fNbTheta(1),
+   fMaxTheta(30*deg),
+   fNbPhi(1),
+   fNbEnergies(1),
+   fMinEnergy(511*keV),
+   fMaxEnergy(511*keV),
+   fEventsPerPoint(1000),
+   fNbBins(128),
+   fBinWidth(5*keV),
+   fSavedModulo(-1)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3BeamScan::~B3BeamScan()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3BeamScan::BeginOfRun(const G4Run* run)
+{
+  if (!IsEnabled()) return;
+
+  const std::vector<B3ListModeFormat::CrystalEntry>& crystals
+    = B3ListModeOutput::Instance()->GetCrystals();
+  if (crystals.empty()) {
+    G4Exception("B3BeamScan::BeginOfRun()", "B3Scan001", FatalException,
+                "No crystal table: the face of the crystals is unknown");
+    return;
+  }
+  fEmpty.Init(crystals, fNbY, fNbZ, fNbTheta, float(fMaxTheta/rad), fNbPhi,
+              fNbEnergies, float(fMinEnergy/keV), float(fMaxEnergy/keV),
+              fNbBins, float(fBinWidth/keV));
+
+#ifdef G4MULTITHREADED
+  // whole grid points per worker; the modulo of the job is restored at the
+  // end of the run
+  G4MTRunManager* runManager = G4MTRunManager::GetMasterRunManager();
+  if (runManager) {
+    fSavedModulo = runManager->GetEventModulo();
+    runManager->SetEventModulo(fEventsPerPoint);
+  }
+#endif
+
+  G4long needed = G4long(fEmpty.NbPoints())*fEventsPerPoint;
+  G4int nofEvents = run->GetNumberOfEventToBeProcessed();
+  if (nofEvents % needed != 0) {
+    G4ExceptionDescription msg;
+    msg << nofEvents << " events: the " << fEmpty.NbPoints() << " grid points of "
+        << fEventsPerPoint << " events need a multiple of " << needed;
+    G4Exception("B3BeamScan::BeginOfRun()", "B3Scan002", JustWarning, msg);
+  }
+
+  G4cout
+    << "\n Beam scan: " << fNbY << " x " << fNbZ << " entry points on x = "
+    << fEmpty.faceX << " mm, " << fNbTheta << " x " << fNbPhi << " directions, "
+    << fNbEnergies << " energies: " << fEmpty.NbPoints() << " points of "
+    << fEventsPerPoint << " events ("
+    << fEmpty.counts.size()*sizeof(uint32_t)/1.e6 << " MB per thread)"
+    << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3BeamScan::GetBeam(G4int eventID, G4ThreeVector& position,
+                         G4ThreeVector& direction, G4double& energy) const
+{
+  double entry[3], u[3], energyKeV;
+  fEmpty.Point(PointOfEvent(eventID), entry, u, energyKeV);
+  direction.set(u[0], u[1], u[2]);
+  position = G4ThreeVector(entry[0], entry[1], entry[2])*mm - kStandoff*direction;
+  energy = energyKeV*keV;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3BeamScan::Fill(B3ResponseMatrix& response, G4int eventID, const G4double* edep,
+                      G4int nCrystals) const
+{
+  if (!response.IsInitialized()) response = fEmpty;
+  double edep_keV[B3ListModeFormat::kMaxCrystals];
+  G4int n = std::min(nCrystals, G4int(response.crystals.size()));
+  for (G4int i = 0; i < n; i++) edep_keV[i] = edep[i]/keV;
+  response.Fill(PointOfEvent(eventID), edep_keV, n);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3BeamScan::EndOfRun(const B3ResponseMatrix& response)
+{
+#ifdef G4MULTITHREADED
+  G4MTRunManager* runManager = G4MTRunManager::GetMasterRunManager();
+  if (runManager && fSavedModulo >= 0) runManager->SetEventModulo(fSavedModulo);
+  fSavedModulo = -1;
+#endif
+  if (!IsEnabled()) return;
+
+  B3ShardManager* shards = B3ShardManager::Instance();
+  G4String fileName
+    = fFileBase + B3Sweep::GetPointTag() + B3ShardManager::GetOutputTag() + ".b3rm";
+  B3ResponseMatrix total = response.IsInitialized() ? response : fEmpty;
+
+  // the runs after the first one of the job, or after the checkpoint a
+  // shard is resumed from, are added to the file
+  if (!fWrittenFiles.insert(fileName).second || shards->IsRestored(fileName)) {
+    B3ResponseMatrix previous;
+    if (!previous.Read(fileName) || !total.Add(previous)) {
+      G4ExceptionDescription msg;
+      msg << "The response matrix of the previous runs in " << fileName
+          << " cannot be read or has another grid: it is replaced";
+      G4Exception("B3BeamScan::EndOfRun()", "B3Scan003", JustWarning, msg);
+    }
+  }
+
+  if (!total.Write(fileName)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the response matrix " << fileName;
+    G4Exception("B3BeamScan::EndOfRun()", "B3Scan004", JustWarning, msg);
+    return;
+  }
+  shards->AddOutput(fileName, true);
+  G4long nofEvents = 0;
+  for (size_t i = 0; i < response.events.size(); i++) nofEvents += response.events[i];
+  G4cout
+    << "\n Beam scan: " << nofEvents << " events over " << fEmpty.NbPoints()
+    << " grid points -> " << fileName
+    << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3BeamScan::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/scan/", "Beam scan of the crystals");
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileBase,
+                                  "Base name of the response matrix file (.b3rm); "
+                                  "\"none\" for the point source.");
+  fileCmd.SetParameterName("base", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& yCmd
+    = fMessenger->DeclareProperty("nY", fNbY, "Number of entry points along y.");
+  yCmd.SetParameterName("n", false);
+  yCmd.SetRange("n>=1");
+  yCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& zCmd
+    = fMessenger->DeclareProperty("nZ", fNbZ, "Number of entry points along z.");
+  zCmd.SetParameterName("n", false);
+  zCmd.SetRange("n>=1");
+  zCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& thetaCmd
+    = fMessenger->DeclareProperty("nTheta", fNbTheta,
+                                  "Number of polar angles, from 0 to maxTheta.");
+  thetaCmd.SetParameterName("n", false);
+  thetaCmd.SetRange("n>=1");
+  thetaCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& maxThetaCmd
+    = fMessenger->DeclarePropertyWithUnit("maxTheta", "deg", fMaxTheta,
+                                          "Largest polar angle to the face normal.");
+  maxThetaCmd.SetParameterName("theta", false);
+  maxThetaCmd.SetRange("theta>=0");
+  maxThetaCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& phiCmd
+    = fMessenger->DeclareProperty("nPhi", fNbPhi,
+                                  "Number of azimuths around the face normal.");
+  phiCmd.SetParameterName("n", false);
+  phiCmd.SetRange("n>=1");
+  phiCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& energiesCmd
+    = fMessenger->DeclareProperty("nEnergies", fNbEnergies,
+                                  "Number of energies, from minEnergy to maxEnergy.");
+  energiesCmd.SetParameterName("n", false);
+  energiesCmd.SetRange("n>=1");
+  energiesCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& minEnergyCmd
+    = fMessenger->DeclarePropertyWithUnit("minEnergy", "keV", fMinEnergy,
+                                          "Lowest beam energy.");
+  minEnergyCmd.SetParameterName("energy", false);
+  minEnergyCmd.SetRange("energy>0");
+  minEnergyCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& maxEnergyCmd
+    = fMessenger->DeclarePropertyWithUnit("maxEnergy", "keV", fMaxEnergy,
+                                          "Highest beam energy.");
+  maxEnergyCmd.SetParameterName("energy", false);
+  maxEnergyCmd.SetRange("energy>0");
+  maxEnergyCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& eventsCmd
+    = fMessenger->DeclareProperty("eventsPerPoint", fEventsPerPoint,
+                                  "Number of events of each grid point.");
+  eventsCmd.SetParameterName("n", false);
+  eventsCmd.SetRange("n>=1");
+  eventsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& binsCmd
+    = fMessenger->DeclareProperty("nBins", fNbBins,
+                                  "Number of energy bins of the crystal histograms.");
+  binsCmd.SetParameterName("n", false);
+  binsCmd.SetRange("n>=1");
+  binsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& widthCmd
+    = fMessenger->DeclarePropertyWithUnit("binWidth", "keV", fBinWidth,
+                                          "Width of the energy bins.");
+  widthCmd.SetParameterName("width", false);
+  widthCmd.SetRange("width>0");
+  widthCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,110 @@
+/// \file B3Biasing.cc
+/// \brief Implementation of the B3Biasing class
+
+#include "B3Biasing.hh"
+#include "B3Tally.hh"
+#include "B3WeightedTally.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cmath>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Biasing* B3Biasing::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Biasing* B3Biasing::Instance()
+{
+  if (!fgInstance) fgInstance = new B3Biasing;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Biasing::B3Biasing()
+ : fMessenger(0),
+   fPhysics(false),
+   fForceInteraction(false),
+   fPeakLow(460.*keV),
+   fPeakHigh(562.*keV)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Biasing::~B3Biasing()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Biasing::CheckPhysics() const
+{
+  if (fForceInteraction && !fPhysics) {
+    G4Exception("B3Biasing::CheckPhysics()", "B3Bias001", JustWarning,
+                "The processes of the photons are not wrapped for the "
+                "biasing: the interactions are not forced (start the job "
+                "with exampleB3 -b).");
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Biasing::Print(const B3Tally& tally, const B3WeightedTally& weighted) const
+{
+  G4double efficiency, error;
+  G4String mode;
+  if (weighted.nEvents > 0) {
+    weighted.PeakEfficiency(efficiency, error);
+    mode = "forced interactions";
+  }
+  else if (tally.nEvents > 0) {
+    G4double n = G4double(tally.nEvents);
+    efficiency = tally.CountTotal(fPeakLow/keV, fPeakHigh/keV)/n;
+    error = std::sqrt(efficiency*(1. - efficiency)/n);
+    mode = "analog";
+  }
+  else return;
+
+  G4cout << "\n Photopeak efficiency [" << fPeakLow/keV << ", " << fPeakHigh/keV
+         << "] keV : " << efficiency << " +- " << error << " (" << mode << ")"
+         << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Biasing::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/bias/",
+                                      "Forced interaction of the photons in the crystals");
+
+  G4GenericMessenger::Command& forceCmd
+    = fMessenger->DeclareProperty("forceInteraction", fForceInteraction,
+                                  "Force the interaction of the primary photons in the "
+                                  "crystals (then /run/reinitializeGeometry).");
+  forceCmd.SetParameterName("flag", true);
+  forceCmd.SetDefaultValue("true");
+  forceCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& lowCmd
+    = fMessenger->DeclarePropertyWithUnit("peakLow", "keV", fPeakLow,
+                                          "Lower edge of the photopeak window.");
+  lowCmd.SetParameterName("energy", false);
+  lowCmd.SetRange("energy>=0.");
+  lowCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& highCmd
+    = fMessenger->DeclarePropertyWithUnit("peakHigh", "keV", fPeakHigh,
+                                          "Upper edge of the photopeak window.");
+  highCmd.SetParameterName("energy", false);
+  highCmd.SetRange("energy>0.");
+  highCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
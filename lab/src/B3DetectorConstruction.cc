@@ -45,23 +45,72 @@
 #include "G4VisAttributes.hh"
 #include "G4PhysicalConstants.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4PVParameterised.hh"
+#include "G4PhantomParameterisation.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UIcmdWith3VectorAndUnit.hh"
+#include "G4Region.hh"
 #include "B3SensitiveDetector.hh"
+#include "B3PSEnergyDeposit.hh"
+#include "B3PSHitTime.hh"
+#include "B3ListModeOutput.hh"
+#include "B3WoodcockModel.hh"
+#include "B3DoseSD.hh"
+#include "B3Biasing.hh"
+#include "B3ForcedInteraction.hh"
+#include "B3PSBranchEnergy.hh"
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4ThreadLocal G4MultiFunctionalDetector* B3DetectorConstruction::fgCrystalDetector = 0;
+G4ThreadLocal G4VPrimitiveScorer* B3DetectorConstruction::fgBranchScorer = 0;
+G4ThreadLocal B3WoodcockModel* B3DetectorConstruction::fgWoodcockModel = 0;
+G4ThreadLocal B3ForcedInteraction* B3DetectorConstruction::fgForcedInteraction = 0;
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B3DetectorConstruction::B3DetectorConstruction()
 : G4VUserDetectorConstruction(),
-  fCheckOverlaps(true)
+  fCheckOverlaps(true),
+  fMessenger(0),
+  fCrystalMessenger(0),
+  fCrystalSize(22*mm, 4*mm, 3*mm),
+  fCrystalPitch(0.),
+  fPhantomFile("none"),
+  fPhantomNbX(256),
+  fPhantomNbY(256),
+  fPhantomNbZ(256),
+  fVoxelSize(0.1*mm, 0.1*mm, 0.1*mm),
+  fPhantomMass(0.),
+  fWoodcock(false),
+  fLogicPatient(0),
+  fPatientRegion(0),
+  fLogicCrystal(0)
 {
   // **Material definition**
   DefineMaterials();
+
+  // default materials of the phantom voxels
+  fPhantomMaterials.push_back("G4_AIR");
+  fPhantomMaterials.push_back("G4_TISSUE_SOFT_ICRP");
+  fPhantomMaterials.push_back("G4_BONE_COMPACT_ICRU");
+  fPhantomMaterials.push_back("G4_LUNG_ICRP");
+
+  DefineCommands();
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 B3DetectorConstruction::~B3DetectorConstruction()
-{ }
+{
+  delete fCrystalMessenger;
+  delete fMessenger;
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
@@ -99,8 +148,13 @@ void B3DetectorConstruction::DefineMaterials()
   LSO->AddElement(elO , 5);  
   //$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$
 
-  // Dump the Table of registered materials 
-  G4cout << *(G4Material::GetMaterialTable()) << G4endl;
+  // Names of the registered materials; the whole table is printed with
+  // /material/g4/printMaterial all
+  G4cout << "\n Materials:";
+  const G4MaterialTable* materials = G4Material::GetMaterialTable();
+  for (size_t m = 0; m < materials->size(); m++) {
+    G4cout << " " << (*materials)[m]->GetName();}
+  G4cout << G4endl;
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -109,9 +163,19 @@ G4VPhysicalVolume* B3DetectorConstruction::Construct()
 {   // Get nist material manager
   G4NistManager* nist = G4NistManager::Instance();
   
-  //Crystal parameters
+  //Crystal parameters: by default, the crystals of the array are side by
+  //side
   //
-  G4double cryst_dX = 22*mm, cryst_dY = 4*mm, cryst_dZ = 3*mm;
+  G4double cryst_dX = fCrystalSize.x(), cryst_dY = fCrystalSize.y(), cryst_dZ = fCrystalSize.z();
+  G4double pitch_dY = (fCrystalPitch > 0.) ? fCrystalPitch : cryst_dY;
+  G4double pitch_dZ = (fCrystalPitch > 0.) ? fCrystalPitch : cryst_dZ;
+  G4ExceptionDescription crystalMsg;
+  if (!CheckCrystals(crystalMsg)) {
+    G4Exception("B3DetectorConstruction::Construct()", "B3Crystal001",
+                FatalException, crystalMsg);
+  }
+  B3Biasing::Instance()->CheckPhysics();
+  G4double pos_dX = 3.8*cm;
 
   
    // **Retrieve Nist Materials** 
@@ -124,8 +188,15 @@ G4VPhysicalVolume* B3DetectorConstruction::Construct()
   //     
   // World
   //
-  G4double world_sizeX = 12*cm;
-  G4double world_sizeYZ  = 2*cm;
+  G4double world_sizeX = std::max(12*cm, 2*(pos_dX + 0.5*cryst_dX) + 2*mm);
+  G4double world_sizeYZ  = std::max(2*cm, 2*std::max(pitch_dY + 0.5*cryst_dY,
+                                                     pitch_dZ + 0.5*cryst_dZ) + 2*mm);
+  G4bool withPhantom = (fPhantomFile != "none");
+  if (withPhantom) {
+    // room for the phantom, centred on the source
+    world_sizeYZ = std::max(world_sizeYZ, std::max(fPhantomNbY*fVoxelSize.y(),
+                                                   fPhantomNbZ*fVoxelSize.z()) + 2*mm);
+  }
   G4Material* world_mat = nist->FindOrBuildMaterial("G4_AIR");
   
   G4Box* solidWorld =    
@@ -150,8 +221,6 @@ G4VPhysicalVolume* B3DetectorConstruction::Construct()
   //     
   // Crystal
   //
-  G4double pos_dX = 3.8*cm;
-  
   G4Box* solidCryst =    
     new G4Box("crystal",                    //its name
 	      0.5*cryst_dX, 0.5*cryst_dY, 0.5*cryst_dZ); //its size
@@ -160,6 +229,7 @@ G4VPhysicalVolume* B3DetectorConstruction::Construct()
     new G4LogicalVolume(solidCryst,            //its solid
                         cryst_mat,             //its material
                         "CrystalLV");         //its name
+  fLogicCrystal = logicCryst;
                
   
    //non-scoring crystals
@@ -175,15 +245,15 @@ G4VPhysicalVolume* B3DetectorConstruction::Construct()
   G4int nb_cryst = 9;
   
   G4ThreeVector positions[9] = {
-    G4ThreeVector(pos_dX,-cryst_dY,cryst_dZ),
-    G4ThreeVector(pos_dX,0,cryst_dZ),
-    G4ThreeVector(pos_dX,cryst_dY,cryst_dZ),
-    G4ThreeVector(pos_dX,-cryst_dY,0),
+    G4ThreeVector(pos_dX,-pitch_dY,pitch_dZ),
+    G4ThreeVector(pos_dX,0,pitch_dZ),
+    G4ThreeVector(pos_dX,pitch_dY,pitch_dZ),
+    G4ThreeVector(pos_dX,-pitch_dY,0),
     G4ThreeVector(pos_dX,0,0),
-    G4ThreeVector(pos_dX,cryst_dY,0),
-    G4ThreeVector(pos_dX,-cryst_dY,-cryst_dZ),
-    G4ThreeVector(pos_dX,0,-cryst_dZ),
-    G4ThreeVector(pos_dX,cryst_dY,-cryst_dZ)
+    G4ThreeVector(pos_dX,pitch_dY,0),
+    G4ThreeVector(pos_dX,-pitch_dY,-pitch_dZ),
+    G4ThreeVector(pos_dX,0,-pitch_dZ),
+    G4ThreeVector(pos_dX,pitch_dY,-pitch_dZ)
   };
     
 
@@ -198,6 +268,46 @@ G4VPhysicalVolume* B3DetectorConstruction::Construct()
                     icrys,                       //copy number
 		    checkOverlaps);          //overlaps checking
   }
+
+  //crystal table of the list-mode output: the crystal ID is the copy number
+  std::vector<B3ListModeFormat::CrystalEntry> crystals(nb_cryst);
+  for (G4int icrys = 0; icrys < nb_cryst; icrys++) {
+    for (G4int k = 0; k < 3; k++) {
+      crystals[icrys].center[k] = positions[icrys][k]/mm;}
+    crystals[icrys].halfSize[0] = 0.5*cryst_dX/mm;
+    crystals[icrys].halfSize[1] = 0.5*cryst_dY/mm;
+    crystals[icrys].halfSize[2] = 0.5*cryst_dZ/mm;
+  }
+  B3ListModeOutput::Instance()->SetCrystals(crystals);
+
+  //
+  // Patient
+  //
+  if (withPhantom) {
+    if (0.5*fPhantomNbX*fVoxelSize.x() >= pos_dX - 0.5*cryst_dX) {
+      G4ExceptionDescription msg;
+      msg << "The phantom (" << fPhantomNbX*fVoxelSize.x()/mm << " mm along x)"
+          << " overlaps the crystals, " << (pos_dX - 0.5*cryst_dX)/mm
+          << " mm from the source";
+      G4Exception("B3DetectorConstruction::Construct()", "B3Phantom001",
+                  FatalException, msg);
+    }
+    // the patient of the previous geometry is placed again if the phantom
+    // is the same: the voxels are neither read nor built again
+    if (fLogicPatient && PhantomDescription() == fBuiltPhantom) {
+      PlacePatient(logicWorld, fLogicPatient);
+    }
+    else ConstructPhantom(logicWorld);
+  }
+  else if (fLogicPatient) {
+    // the patient of a previous geometry
+    fPatientRegion->RemoveRootLogicalVolume(fLogicPatient);
+    fLogicPatient = 0;
+    fVoxelMaterials.clear();
+  }
+  fBuiltPhantom = fLogicPatient ? PhantomDescription() : G4String();
+  fBuiltGeometry = GeometryDescription();
+
   //always return the physical World
   //
   return physWorld;
@@ -205,6 +315,253 @@ G4VPhysicalVolume* B3DetectorConstruction::Construct()
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+G4bool B3DetectorConstruction::CheckCrystals(std::ostream& reason) const
+{
+  if (fCrystalPitch > 0.
+      && (fCrystalPitch < fCrystalSize.y() || fCrystalPitch < fCrystalSize.z())) {
+    reason << "The pitch " << fCrystalPitch/mm << " mm is smaller than the crystals ("
+           << fCrystalSize.y()/mm << " x " << fCrystalSize.z()/mm << " mm along y and z)";
+    return false;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3DetectorConstruction::PhantomDescription() const
+{
+  std::ostringstream description;
+  description << fPhantomFile << " " << fPhantomNbX << " " << fPhantomNbY << " "
+              << fPhantomNbZ << " " << fVoxelSize/mm;
+  for (size_t i = 0; i < fPhantomMaterials.size(); i++) {
+    description << " " << fPhantomMaterials[i];}
+  return description.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3DetectorConstruction::GeometryDescription() const
+{
+  std::ostringstream description;
+  description << fCrystalSize/mm << " " << fCrystalPitch/mm << " " << fWoodcock << " "
+              << B3Biasing::Instance()->IsEnabled() << " " << PhantomDescription();
+  return description.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3DetectorConstruction::IsGeometryModified() const
+{
+  return GeometryDescription() != fBuiltGeometry;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4VPhysicalVolume* B3DetectorConstruction::PlacePatient(G4LogicalVolume* logicWorld,
+                                                        G4LogicalVolume* logicPatient)
+{
+  return new G4PVPlacement(0,                       //no rotation
+                           G4ThreeVector(),         //at (0,0,0)
+                           logicPatient,            //its logical volume
+                           "Patient",               //its name
+                           logicWorld,              //its mother  volume
+                           false,                   //no boolean operation
+                           0,                       //copy number
+                           fCheckOverlaps);         //overlaps checking
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DetectorConstruction::ConstructPhantom(G4LogicalVolume* logicWorld)
+{
+  // materials of the indices
+  G4NistManager* nist = G4NistManager::Instance();
+  std::vector<G4Material*> materials;
+  for (size_t i = 0; i < fPhantomMaterials.size(); i++) {
+    G4Material* material = nist->FindOrBuildMaterial(fPhantomMaterials[i]);
+    if (!material) {
+      G4ExceptionDescription msg;
+      msg << "Unknown material " << fPhantomMaterials[i] << " of phantom index " << i;
+      G4Exception("B3DetectorConstruction::ConstructPhantom()", "B3Phantom002",
+                  FatalException, msg);
+      return;
+    }
+    materials.push_back(material);
+  }
+
+  // material index of each voxel, one byte per voxel
+  size_t nVoxels = size_t(fPhantomNbX)*fPhantomNbY*fPhantomNbZ;
+  std::vector<unsigned char> bytes(nVoxels);
+  std::ifstream file(fPhantomFile.c_str(), std::ios::binary);
+  file.read(reinterpret_cast<char*>(&bytes[0]), nVoxels);
+  if (!file || file.peek() != std::ifstream::traits_type::eof()) {
+    G4ExceptionDescription msg;
+    msg << fPhantomFile << " is not a phantom of " << fPhantomNbX << " x "
+        << fPhantomNbY << " x " << fPhantomNbZ << " voxels of one byte";
+    G4Exception("B3DetectorConstruction::ConstructPhantom()", "B3Phantom003",
+                FatalException, msg);
+    return;
+  }
+  // a new array: the old one is retired, not freed, since the
+  // parameterisation of a previous geometry still refers to it
+  std::vector<size_t> indices(nVoxels);
+  std::vector<size_t> nbOfMaterial(materials.size(), 0);
+  for (size_t i = 0; i < nVoxels; i++) {
+    if (bytes[i] >= materials.size()) {
+      G4ExceptionDescription msg;
+      msg << "Voxel " << i << " of " << fPhantomFile << " has material index "
+          << G4int(bytes[i]) << ", but only " << materials.size() << " materials are set";
+      G4Exception("B3DetectorConstruction::ConstructPhantom()", "B3Phantom004",
+                  FatalException, msg);
+      return;
+    }
+    indices[i] = bytes[i];
+    nbOfMaterial[bytes[i]]++;
+  }
+  if (!fMaterialIndices.empty()) {
+    fRetiredIndices.push_back(std::vector<size_t>());
+    fRetiredIndices.back().swap(fMaterialIndices);
+  }
+  fMaterialIndices.swap(indices);
+  fVoxelMaterials = materials;
+  fPhantomMass = 0.;
+  for (size_t m = 0; m < materials.size(); m++) {
+    fPhantomMass += nbOfMaterial[m]*materials[m]->GetDensity()
+                    *fVoxelSize.x()*fVoxelSize.y()*fVoxelSize.z();
+  }
+
+  // container of the voxels, filled exactly by them
+  G4ThreeVector halfVoxel = 0.5*fVoxelSize;
+  G4Box* solidPatient =
+    new G4Box("Patient", fPhantomNbX*halfVoxel.x(), fPhantomNbY*halfVoxel.y(),
+              fPhantomNbZ*halfVoxel.z());
+  G4LogicalVolume* logicPatient =
+    new G4LogicalVolume(solidPatient, materials[0], "PatientLV");
+  G4VPhysicalVolume* physPatient = PlacePatient(logicWorld, logicPatient);
+
+  // envelope of the Woodcock tracking, with the cuts of the world
+  if (!fPatientRegion) fPatientRegion = new G4Region("Patient");
+  if (fLogicPatient) fPatientRegion->RemoveRootLogicalVolume(fLogicPatient);
+  fPatientRegion->AddRootLogicalVolume(logicPatient);
+  fLogicPatient = logicPatient;
+
+  // the voxels: one parameterised volume, regular navigation
+  G4PhantomParameterisation* param = new G4PhantomParameterisation();
+  param->SetVoxelDimensions(halfVoxel.x(), halfVoxel.y(), halfVoxel.z());
+  param->SetNoVoxel(fPhantomNbX, fPhantomNbY, fPhantomNbZ);
+  param->SetMaterials(materials);
+  param->SetMaterialIndices(&fMaterialIndices[0]);
+  param->SetSkipEqualMaterials(true);
+  param->BuildContainerSolid(physPatient);
+  param->CheckVoxelsFillContainer(solidPatient->GetXHalfLength(),
+                                  solidPatient->GetYHalfLength(),
+                                  solidPatient->GetZHalfLength());
+
+  G4Box* solidVoxel = new G4Box("Voxel", halfVoxel.x(), halfVoxel.y(), halfVoxel.z());
+  G4LogicalVolume* logicVoxel = new G4LogicalVolume(solidVoxel, materials[0], "VoxelLV");
+  logicVoxel->SetVisAttributes(G4VisAttributes::Invisible);
+  G4PVParameterised* physVoxels =
+    new G4PVParameterised("Voxels", logicVoxel, logicPatient, kUndefined,
+                          G4int(nVoxels), param);
+  physVoxels->SetRegularStructureId(1);
+
+  G4cout << "\n Phantom: " << fPhantomNbX << " x " << fPhantomNbY << " x " << fPhantomNbZ
+         << " voxels of " << fVoxelSize.x()/mm << " x " << fVoxelSize.y()/mm << " x "
+         << fVoxelSize.z()/mm << " mm from " << fPhantomFile << G4endl;
+  for (size_t m = 0; m < materials.size(); m++) {
+    if (nbOfMaterial[m] == 0) continue;
+    G4cout << "   " << materials[m]->GetName() << ": " << nbOfMaterial[m] << " voxels"
+           << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DetectorConstruction::SetPhantomMaterial(G4int index, G4String name)
+{
+  if (index < 0 || index > 255) {
+    G4ExceptionDescription msg;
+    msg << "Phantom material index " << index << " is not in [0, 255]";
+    G4Exception("B3DetectorConstruction::SetPhantomMaterial()", "B3Phantom005",
+                JustWarning, msg);
+    return;
+  }
+  if (size_t(index) >= fPhantomMaterials.size()) fPhantomMaterials.resize(index + 1, "G4_AIR");
+  fPhantomMaterials[index] = name;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DetectorConstruction::DefineCommands()
+{
+  fCrystalMessenger = new G4GenericMessenger(this, "/B3/crystal/",
+                                             "Crystals of the array (then /run/reinitializeGeometry)");
+
+  G4GenericMessenger::Command& crystalSizeCmd
+    = fCrystalMessenger->DeclarePropertyWithUnit("size", "mm", fCrystalSize,
+                                                 "Size of the crystals along x, y and z.");
+  static_cast<G4UIcmdWith3VectorAndUnit*>(crystalSizeCmd.command)
+    ->SetParameterName("dX", "dY", "dZ", false);
+  crystalSizeCmd.SetRange("dX>0. && dY>0. && dZ>0.");
+  crystalSizeCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& pitchCmd
+    = fCrystalMessenger->DeclarePropertyWithUnit("pitch", "mm", fCrystalPitch,
+                                                 "Distance between the centres of the "
+                                                 "crystals along y and z; 0 for crystals "
+                                                 "side by side.");
+  pitchCmd.SetParameterName("pitch", false);
+  pitchCmd.SetRange("pitch>=0.");
+  pitchCmd.command->SetToBeBroadcasted(false);
+
+  fMessenger = new G4GenericMessenger(this, "/B3/phantom/",
+                                      "Voxelised patient phantom (then /run/reinitializeGeometry)");
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fPhantomFile,
+                                  "Raw file of the material indices of the voxels, "
+                                  "one byte each, x fastest; \"none\" for no phantom.");
+  fileCmd.SetParameterName("file", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& xCmd
+    = fMessenger->DeclareProperty("nX", fPhantomNbX, "Number of voxels along x.");
+  xCmd.SetParameterName("n", false);
+  xCmd.SetRange("n>=1");
+  xCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& yCmd
+    = fMessenger->DeclareProperty("nY", fPhantomNbY, "Number of voxels along y.");
+  yCmd.SetParameterName("n", false);
+  yCmd.SetRange("n>=1");
+  yCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& zCmd
+    = fMessenger->DeclareProperty("nZ", fPhantomNbZ, "Number of voxels along z.");
+  zCmd.SetParameterName("n", false);
+  zCmd.SetRange("n>=1");
+  zCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& sizeCmd
+    = fMessenger->DeclarePropertyWithUnit("voxelSize", "mm", fVoxelSize,
+                                          "Size of the voxels along x, y and z.");
+  sizeCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& materialCmd
+    = fMessenger->DeclareMethod("material", &B3DetectorConstruction::SetPhantomMaterial,
+                                "NIST material of the voxels of a material index.");
+  materialCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& woodcockCmd
+    = fMessenger->DeclareProperty("woodcock", fWoodcock,
+                                  "Woodcock tracking of the photons in the phantom.");
+  woodcockCmd.SetParameterName("flag", true);
+  woodcockCmd.SetDefaultValue("true");
+  woodcockCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
 void B3DetectorConstruction::ConstructSDandField()
 {
   //
@@ -216,13 +573,63 @@ void B3DetectorConstruction::ConstructSDandField()
   // declare crystal as a MultiFunctionalDetector scorer
   //  
   // Create a new scorer (G4MultiFunctionalDetector) and set its 
-  // "capability" to G4PSEnergyDeposit (will score total energy deposit)
-  G4MultiFunctionalDetector* cryst = new G4MultiFunctionalDetector("crystal");
-  G4VPrimitiveScorer* primitiv1 = new G4PSEnergyDeposit("edep");
-  cryst->RegisterPrimitive(primitiv1);
+  // "capability" to G4PSEnergyDeposit (will score total energy deposit),
+  // per primary of the event (see B3Batching). One scorer per thread is
+  // kept over the geometries: a new one would be registered again under
+  // the same name.
+  if (!fgCrystalDetector) {
+    fgCrystalDetector = new G4MultiFunctionalDetector("crystal");
+    G4VPrimitiveScorer* primitiv1 = new B3PSEnergyDeposit("edep", 9);
+    fgCrystalDetector->RegisterPrimitive(primitiv1);
+    // time of the first energy deposit, for the list-mode output
+    G4VPrimitiveScorer* primitiv2 = new B3PSHitTime("time", 9);
+    fgCrystalDetector->RegisterPrimitive(primitiv2);
+    G4SDManager::GetSDMpointer()->AddNewDetector(fgCrystalDetector);
+  }
+  // forced interactions: the energy deposits of each branch of the event,
+  // registered in the geometries with the forcing only, and the biasing
+  // operator, one per thread kept over the geometries. In the jobs with
+  // the biasing physics (exampleB3 -b), it is created at the first
+  // geometry whatever the setting, so that it is configured with the
+  // physics tables.
+  G4bool forceInteraction = B3Biasing::Instance()->IsEnabled();
+  if (!fgBranchScorer) fgBranchScorer = new B3PSBranchEnergy("branch", 9);
+  if (forceInteraction != (fgBranchScorer->GetMultiFunctionalDetector() != 0)) {
+    if (forceInteraction) fgCrystalDetector->RegisterPrimitive(fgBranchScorer);
+    else fgCrystalDetector->RemovePrimitive(fgBranchScorer);
+  }
+  if (!fgForcedInteraction && B3Biasing::Instance()->HasPhysics()) {
+    fgForcedInteraction = new B3ForcedInteraction("gamma");
+  }
+  if (forceInteraction) fgForcedInteraction->AttachTo(fLogicCrystal);
   // Attach the scorer to the logical volume
-  SetSensitiveDetector("CrystalLV",cryst);
-  
+  SetSensitiveDetector(fLogicCrystal,fgCrystalDetector);
+
+  // dose in the voxels of the patient, one scorer per thread kept over the
+  // geometries
+  G4int nb[3] = { fPhantomNbX, fPhantomNbY, fPhantomNbZ };
+  B3DoseSD* doseSD = B3DoseSD::Instance();
+  if (fLogicPatient) {
+    if (!doseSD) {
+      doseSD = new B3DoseSD("patient");
+      G4SDManager::GetSDMpointer()->AddNewDetector(doseSD);
+    }
+    doseSD->SetPhantom(nb, fVoxelSize, fPhantomMass);
+    SetSensitiveDetector(fLogicPatient->GetDaughter(0)->GetLogicalVolume(), doseSD);
+  }
+  if (doseSD) doseSD->Activate(fLogicPatient != 0);
+
+  // Woodcock tracking in the patient, one model per thread kept over the
+  // geometries
+  if (fPatientRegion && !fgWoodcockModel) {
+    fgWoodcockModel = new B3WoodcockModel("Woodcock", fPatientRegion);
+  }
+  if (fgWoodcockModel) {
+    G4bool active = fWoodcock && fLogicPatient;
+    fgWoodcockModel->SetPhantom(nb, fVoxelSize,
+                                active ? &fMaterialIndices[0] : 0, fVoxelMaterials);
+  }
+
   return;
 
 }
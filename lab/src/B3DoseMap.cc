@@ -0,0 +1,142 @@
+/// \file B3DoseMap.cc
+/// \brief Implementation of the B3DoseMap structure
+
+#include "B3DoseMap.hh"
+
+#include <algorithm>
+#include <cstdio>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  const uint32_t kDoseMagic   = 0x4D443342;   // "B3DM"
+  const uint32_t kDoseVersion = 1;
+  const double   kJoulePerKeV = 1.602176634e-16;
+
+  template <class T>
+  bool Put(std::FILE* file, const T& value)
+  { return std::fwrite(&value, sizeof(T), 1, file) == 1; }
+
+  template <class T>
+  bool Get(std::FILE* file, T& value)
+  { return std::fread(&value, sizeof(T), 1, file) == 1; }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3DoseMap::B3DoseMap()
+ : nX(0), nY(0), nZ(0), mass(0.), events(0), energy(0.)
+{
+  voxelSize[0] = voxelSize[1] = voxelSize[2] = 0.f;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DoseMap::Init(uint32_t x, uint32_t y, uint32_t z, const float voxel[3],
+                     double phantomMass)
+{
+  nX = x;
+  nY = y;
+  nZ = z;
+  for (int k = 0; k < 3; k++) voxelSize[k] = voxel[k];
+  mass = phantomMass;
+  events = 0;
+  energy = 0.;
+  dose.assign(NbVoxels(), 0.f);
+  dose2.assign(NbVoxels(), 0.f);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DoseMap::Clear()
+{
+  events = 0;
+  energy = 0.;
+  std::fill(dose.begin(), dose.end(), 0.f);
+  std::fill(dose2.begin(), dose2.end(), 0.f);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+double B3DoseMap::TotalDose() const
+{
+  return mass > 0. ? energy*kJoulePerKeV/mass : 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3DoseMap::Add(const B3DoseMap& other)
+{
+  if (other.nX != nX || other.nY != nY || other.nZ != nZ
+      || other.voxelSize[0] != voxelSize[0] || other.voxelSize[1] != voxelSize[1]
+      || other.voxelSize[2] != voxelSize[2] || other.mass != mass
+      || other.dose.size() != dose.size()) {
+    return false;
+  }
+
+  // plain loops over contiguous arrays: vectorised by the compiler
+  size_t n = dose.size();
+  if (n > 0) {
+    float* sum = &dose[0];
+    float* sum2 = &dose2[0];
+    const float* added = &other.dose[0];
+    const float* added2 = &other.dose2[0];
+    for (size_t i = 0; i < n; i++) sum[i] += added[i];
+    for (size_t i = 0; i < n; i++) sum2[i] += added2[i];
+  }
+  events += other.events;
+  energy += other.energy;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3DoseMap::Write(const std::string& fileName) const
+{
+  std::string tmpName = fileName + ".tmp";
+  std::FILE* file = std::fopen(tmpName.c_str(), "wb");
+  if (!file) return false;
+
+  bool ok = Put(file, kDoseMagic) && Put(file, kDoseVersion)
+         && Put(file, nX) && Put(file, nY) && Put(file, nZ)
+         && Put(file, voxelSize[0]) && Put(file, voxelSize[1]) && Put(file, voxelSize[2])
+         && Put(file, mass) && Put(file, events) && Put(file, energy);
+  ok = ok && (dose.empty()
+              || (std::fwrite(&dose[0], sizeof(float), dose.size(), file) == dose.size()
+                  && std::fwrite(&dose2[0], sizeof(float), dose2.size(), file) == dose2.size()));
+
+  ok = (std::fflush(file) == 0) && ok;
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok) {
+    std::remove(tmpName.c_str());
+    return false;
+  }
+  return std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3DoseMap::Read(const std::string& fileName)
+{
+  std::FILE* file = std::fopen(fileName.c_str(), "rb");
+  if (!file) return false;
+
+  uint32_t magic = 0, version = 0;
+  bool ok = Get(file, magic) && Get(file, version)
+         && magic == kDoseMagic && version == kDoseVersion
+         && Get(file, nX) && Get(file, nY) && Get(file, nZ)
+         && Get(file, voxelSize[0]) && Get(file, voxelSize[1]) && Get(file, voxelSize[2])
+         && Get(file, mass) && Get(file, events) && Get(file, energy);
+  if (ok) {
+    dose.resize(NbVoxels());
+    dose2.resize(NbVoxels());
+    ok = dose.empty()
+      || (std::fread(&dose[0], sizeof(float), dose.size(), file) == dose.size()
+          && std::fread(&dose2[0], sizeof(float), dose2.size(), file) == dose2.size());
+  }
+  std::fclose(file);
+  return ok;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,89 @@
+/// \file B3DoseOutput.cc
+/// \brief Implementation of the B3DoseOutput class
+
+#include "B3DoseOutput.hh"
+#include "B3ShardManager.hh"
+#include "B3Sweep.hh"
+
+#include "G4GenericMessenger.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3DoseOutput* B3DoseOutput::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3DoseOutput* B3DoseOutput::Instance()
+{
+  if (!fgInstance) fgInstance = new B3DoseOutput;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3DoseOutput::B3DoseOutput()
+ : fMessenger(0),
+   fFileBase("none")
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3DoseOutput::~B3DoseOutput()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DoseOutput::EndOfRun(const B3DoseMap& map)
+{
+  if (!IsEnabled() || !map.IsInitialized()) return;
+
+  B3ShardManager* shards = B3ShardManager::Instance();
+  G4String fileName
+    = fFileBase + B3Sweep::GetPointTag() + B3ShardManager::GetOutputTag() + ".b3dm";
+  B3DoseMap total = map;
+
+  // the runs after the first one of the job, or after the checkpoint a
+  // shard is resumed from, are added to the file
+  if (!fWrittenFiles.insert(fileName).second || shards->IsRestored(fileName)) {
+    B3DoseMap previous;
+    if (!previous.Read(fileName) || !total.Add(previous)) {
+      G4ExceptionDescription msg;
+      msg << "The dose map of the previous runs in " << fileName
+          << " cannot be read or has another phantom: it is replaced";
+      G4Exception("B3DoseOutput::EndOfRun()", "B3Dose001", JustWarning, msg);
+    }
+  }
+
+  if (!total.Write(fileName)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the dose map " << fileName;
+    G4Exception("B3DoseOutput::EndOfRun()", "B3Dose002", JustWarning, msg);
+    return;
+  }
+  shards->AddOutput(fileName, true);
+  G4cout
+    << "\n Dose map: " << map.nX << " x " << map.nY << " x " << map.nZ << " voxels, "
+    << map.events << " events -> " << fileName
+    << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DoseOutput::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/dose/", "Dose map of the phantom");
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileBase,
+                                  "Base name of the dose map file (.b3dm); "
+                                  "\"none\" to switch it off.");
+  fileCmd.SetParameterName("base", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
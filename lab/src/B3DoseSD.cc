@@ -0,0 +1,117 @@
+/// \file B3DoseSD.cc
+/// \brief Implementation of the B3DoseSD class
+
+#include "B3DoseSD.hh"
+
+#include "G4Step.hh"
+#include "G4VTouchable.hh"
+#include "G4Material.hh"
+#include "G4RegularNavigationHelper.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4ThreadLocal B3DoseSD* B3DoseSD::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3DoseSD::B3DoseSD(const G4String& name)
+ : G4VSensitiveDetector(name),
+   fVoxelVolume(0.),
+   fMass(0.),
+   fEventEnergy(0.)
+{
+  fNb[0] = fNb[1] = fNb[2] = 0;
+  fgInstance = this;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3DoseSD::~B3DoseSD()
+{
+  if (fgInstance == this) fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DoseSD::SetPhantom(const G4int nb[3], const G4ThreeVector& voxelSize,
+                          G4double mass)
+{
+  for (G4int k = 0; k < 3; k++) fNb[k] = nb[k];
+  fVoxelSize = voxelSize;
+  fVoxelVolume = voxelSize.x()*voxelSize.y()*voxelSize.z();
+  fMass = mass;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DoseSD::Initialize(G4HCofThisEvent*)
+{
+  // nothing left by an aborted event
+  fDeposits.clear();
+  fEventEnergy = 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3DoseSD::ProcessHits(G4Step* step, G4TouchableHistory*)
+{
+  // weighted with the forced interactions in the crystals (B3Biasing)
+  G4StepPoint* point = step->GetPreStepPoint();
+  G4double edep = step->GetTotalEnergyDeposit()*point->GetWeight();
+  if (edep == 0.) return false;
+
+  // the copy number of the parameterised voxel is its index
+  G4int voxel = point->GetTouchable()->GetReplicaNumber();
+  G4double density = point->GetMaterial()->GetDensity();
+  fEventEnergy += edep;
+
+  // the regular navigation skips the boundaries between voxels of the same
+  // material: the voxels crossed by the step, starting with the pre-step
+  // one, and their lengths are kept by G4RegularNavigationHelper, and the
+  // deposit is split over them in proportion (as G4PSDoseDeposit_RegNav)
+  const std::vector<std::pair<G4int, G4double> >& lengths
+    = G4RegularNavigationHelper::Instance()->GetStepLengths();
+  G4double totalLength = 0.;
+  for (size_t i = 0; i < lengths.size(); i++) totalLength += lengths[i].second;
+  if (lengths.size() < 2 || lengths[0].first != voxel || totalLength <= 0.) {
+    fDeposits.push_back(std::make_pair(voxel, edep/(density*fVoxelVolume)));
+    return true;
+  }
+  G4double dosePerLength = edep/(density*fVoxelVolume*totalLength);
+  for (size_t i = 0; i < lengths.size(); i++) {
+    if (lengths[i].second <= 0.) continue;
+    fDeposits.push_back(std::make_pair(lengths[i].first, dosePerLength*lengths[i].second));
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3DoseSD::Flush(B3DoseMap& map)
+{
+  if (!map.IsInitialized()) {
+    float voxel[3] = { float(fVoxelSize.x()/mm), float(fVoxelSize.y()/mm),
+                       float(fVoxelSize.z()/mm) };
+    map.Init(fNb[0], fNb[1], fNb[2], voxel, fMass/kg);
+  }
+
+  // each voxel once: the deposits are sorted by voxel and summed
+  std::sort(fDeposits.begin(), fDeposits.end());
+  size_t n = fDeposits.size();
+  for (size_t i = 0; i < n; ) {
+    G4int voxel = fDeposits[i].first;
+    G4double dose = 0.;
+    for (; i < n && fDeposits[i].first == voxel; i++) dose += fDeposits[i].second;
+    map.Fill(size_t(voxel), float(dose/gray));
+  }
+  map.events++;
+  map.energy += fEventEnergy/keV;
+
+  fDeposits.clear();
+  fEventEnergy = 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
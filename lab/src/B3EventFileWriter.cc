@@ -0,0 +1,109 @@
+/// \file B3EventFileWriter.cc
+/// \brief Implementation of the B3EventFileWriter class
+
+#include "B3EventFileWriter.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3EventFileWriter::B3EventFileWriter(uint32_t chunkRows, int compressionLevel)
+ : fFile(0),
+   fChunkRows(chunkRows),
+   fCompressionLevel(compressionLevel),
+   fSize(0)
+{
+  fRows.reserve(chunkRows);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3EventFileWriter::~B3EventFileWriter()
+{
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3EventFileWriter::Open(const std::string& fileName, bool append)
+{
+  Close();
+  fFileName = fileName;
+  fSize = 0;
+
+  if (append) {
+    std::FILE* existing = std::fopen(fileName.c_str(), "rb");
+    if (existing) {
+      B3EventFormat::FileHeader header;
+      bool empty = (std::fread(&header, sizeof(header), 1, existing) != 1);
+      std::fseek(existing, 0, SEEK_END);
+      long size = std::ftell(existing);
+      std::fclose(existing);
+      if (size > 0 && (empty || !B3EventFormat::CheckFileHeader(header))) {
+        return false;
+      }
+      fSize = uint64_t(size);
+    }
+  }
+
+  fFile = std::fopen(fileName.c_str(), (append && fSize > 0) ? "ab" : "wb");
+  if (!fFile) return false;
+
+  if (fSize == 0) {
+    B3EventFormat::FileHeader header;
+    B3EventFormat::InitFileHeader(header);
+    std::fwrite(&header, sizeof(header), 1, fFile);
+    fSize = sizeof(header);
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventFileWriter::Close()
+{
+  if (!fFile) return;
+  Flush();
+  std::fclose(fFile);
+  fFile = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventFileWriter::AddRow(const B3EventFormat::EventRecord& row)
+{
+  fRows.push_back(row);
+  if (fRows.size() >= fChunkRows) WriteChunk();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventFileWriter::Flush()
+{
+  if (!fFile) return;
+  if (!fRows.empty()) WriteChunk();
+  std::fflush(fFile);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventFileWriter::WriteChunk()
+{
+  B3EventFormat::ChunkHeader header;
+  B3EventFormat::PackChunk(&fRows[0], uint32_t(fRows.size()), header, fPayload);
+  B3EventFormat::CompressChunk(header, fPayload, fCompressionLevel, fWork);
+  WritePackedChunk(header, fPayload);
+  fRows.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3EventFileWriter::WritePackedChunk(const B3EventFormat::ChunkHeader& header,
+                                         const std::vector<char>& payload)
+{
+  if (!fFile) return false;
+  bool ok = std::fwrite(&header, sizeof(header), 1, fFile) == 1
+         && std::fwrite(&payload[0], 1, payload.size(), fFile) == payload.size();
+  fSize += sizeof(header) + payload.size();
+  return ok;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
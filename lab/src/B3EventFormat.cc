@@ -0,0 +1,146 @@
+/// \file B3EventFormat.cc
+/// \brief Implementation of the B3 event file layout helpers
+
+#include "B3EventFormat.hh"
+
+#include <cstdio>
+#include <cstring>
+
+#include <zlib.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventFormat::InitFileHeader(FileHeader& header)
+{
+  std::memset(&header, 0, sizeof(header));
+  header.magic    = kFileMagic;
+  header.version  = kVersion;
+  header.nColumns = kNbColumns;
+
+  std::strncpy(header.columns[kEvent].name, "event", 15);
+  header.columns[kEvent].type  = kUInt64;
+  header.columns[kEvent].width = sizeof(uint64_t);
+
+  std::strncpy(header.columns[kTotal].name, "total", 15);
+  header.columns[kTotal].type  = kFloat32;
+  header.columns[kTotal].width = sizeof(float);
+
+  for (int i = 0; i < kNbCrystals; i++) {
+    ColumnDesc& column = header.columns[kCrystal0+i];
+    std::snprintf(column.name, sizeof(column.name), "crystal%d", i);
+    column.type  = kFloat32;
+    column.width = sizeof(float);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3EventFormat::CheckFileHeader(const FileHeader& header)
+{
+  return header.magic == kFileMagic
+      && header.version <= kVersion
+      && header.nColumns == uint32_t(kNbColumns);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+size_t B3EventFormat::ColumnOffset(int column, uint32_t nRows)
+{
+  // the 8-byte event column comes first, the float columns follow
+  if (column == kEvent) return 0;
+  return size_t(nRows)*sizeof(uint64_t) + size_t(column-kTotal)*nRows*sizeof(float);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+size_t B3EventFormat::RawPayloadBytes(uint32_t nRows)
+{
+  // keep the next chunk header 8-byte aligned
+  size_t bytes = ColumnOffset(kNbColumns, nRows);
+  return (bytes + 7) & ~size_t(7);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventFormat::PackChunk(const EventRecord* rows, uint32_t nRows,
+                              ChunkHeader& header, std::vector<char>& payload)
+{
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kChunkMagic;
+  header.codec = kRaw;
+  header.nRows = nRows;
+  header.rawBytes = RawPayloadBytes(nRows);
+  header.storedBytes = header.rawBytes;
+
+  payload.assign(header.rawBytes, 0);
+  uint64_t* events = reinterpret_cast<uint64_t*>(&payload[0]);
+  float* columns[kNbColumns];
+  for (int c = kTotal; c < kNbColumns; c++) {
+    columns[c] = reinterpret_cast<float*>(&payload[ColumnOffset(c, nRows)]);
+  }
+
+  for (int c = 0; c < kNbColumns; c++) {
+    header.min[c] = 1.e300;
+    header.max[c] = -1.e300;
+  }
+  for (uint32_t r = 0; r < nRows; r++) {
+    const EventRecord& row = rows[r];
+    events[r] = row.event;
+    columns[kTotal][r] = row.total;
+    for (int i = 0; i < kNbCrystals; i++) columns[kCrystal0+i][r] = row.edep[i];
+  }
+  for (int c = 0; c < kNbColumns; c++) {
+    for (uint32_t r = 0; r < nRows; r++) {
+      double value = (c == kEvent) ? double(events[r]) : double(columns[c][r]);
+      if (value < header.min[c]) header.min[c] = value;
+      if (value > header.max[c]) header.max[c] = value;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventFormat::CompressChunk(ChunkHeader& header, std::vector<char>& payload,
+                                  int level, std::vector<char>& work)
+{
+  if (header.codec != kRaw || level <= 0 || payload.empty()) return;
+
+  uLongf bound = compressBound(uLong(payload.size()));
+  work.resize(bound + 8);
+  uLongf compressed = bound;
+  if (compress2(reinterpret_cast<Bytef*>(&work[0]), &compressed,
+                reinterpret_cast<const Bytef*>(&payload[0]), uLong(payload.size()),
+                level) != Z_OK) return;
+
+  // zlib ignores the padding after the end of its stream
+  size_t stored = (size_t(compressed) + 7) & ~size_t(7);
+  if (stored >= payload.size()) return;
+  std::memset(&work[compressed], 0, stored - compressed);
+  work.resize(stored);
+  payload.swap(work);
+  header.codec = kZlib;
+  header.storedBytes = stored;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3EventFormat::DecodeChunk(const ChunkHeader& header, const char* stored,
+                                std::vector<char>& raw)
+{
+  raw.resize(header.rawBytes);
+  if (header.codec == kRaw) {
+    if (header.storedBytes != header.rawBytes) return false;
+    if (header.rawBytes) std::memcpy(&raw[0], stored, header.rawBytes);
+    return true;
+  }
+  if (header.codec == kZlib) {
+    uLongf size = uLongf(header.rawBytes);
+    int status = uncompress(reinterpret_cast<Bytef*>(&raw[0]), &size,
+                            reinterpret_cast<const Bytef*>(stored), uLong(header.storedBytes));
+    // the padding after the end of the stream is not read
+    return status == Z_OK && size == header.rawBytes;
+  }
+  return false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
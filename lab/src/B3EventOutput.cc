@@ -0,0 +1,288 @@
+/// \file B3EventOutput.cc
+/// \brief Implementation of the B3EventOutput class
+
+#include "B3EventOutput.hh"
+#include "B3EventFileWriter.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace { G4Mutex outputMutex = G4MUTEX_INITIALIZER; }
+
+B3EventOutput* B3EventOutput::fgInstance = 0;
+G4ThreadLocal B3EventFileWriter* B3EventOutput::fgWriter = 0;
+G4ThreadLocal B3AsyncEventWriter::Producer* B3EventOutput::fgProducer = 0;
+G4ThreadLocal std::vector<B3EventFormat::EventRecord>* B3EventOutput::fgBatch = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3EventOutput* B3EventOutput::Instance()
+{
+  if (!fgInstance) fgInstance = new B3EventOutput;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3EventOutput::B3EventOutput()
+ : fMessenger(0),
+   fAnalysisFileName("B3"),
+   fAppend(false),
+   fNtuple(true),
+   fAsync(true),
+   fSingleFile(false),
+   fCompressionLevel(1),
+   fRingSize(16384),
+   fAsyncWriter(0),
+   fSharedFile(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3EventOutput::~B3EventOutput()
+{
+  EndOfRun();
+  delete fAsyncWriter;
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3EventOutput::ThreadFileName() const
+{
+  std::ostringstream name;
+  name << fEventFileBase;
+  G4int threadId = G4Threading::G4GetThreadId();
+  if (threadId >= 0 && !fSingleFile) name << "_t" << threadId;
+  name << ".b3e";
+  return name.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventOutput::AddEvent(const B3EventFormat::EventRecord& record)
+{
+  if (!fgWriter && !fgProducer && !fgBatch && !OpenWriter()) return;
+  if (fgProducer) fAsyncWriter->Push(fgProducer, record);
+  else if (fgWriter) fgWriter->AddRow(record);
+  else {
+    // single file: whole batches go to the writer of the master
+    fgBatch->push_back(record);
+    if (fgBatch->size() >= B3EventFormat::kChunkRows) fAsyncWriter->Submit(fSharedFile, *fgBatch);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3EventOutput::OpenWriter()
+{
+  G4String fileName = ThreadFileName();
+  G4bool append = fAppend;
+  G4bool opened = false;
+  {
+    // a file is replaced the first time it is used in the job only
+    G4AutoLock lock(&outputMutex);
+    if (!fOpenedFiles.insert(fileName).second) append = true;
+    if (fAsync || fSingleFile) {
+      if (!fAsyncWriter) fAsyncWriter = new B3AsyncEventWriter(fRingSize, fCompressionLevel);
+      fAsyncWriter->SetRingRows(fRingSize);
+      fAsyncWriter->SetCompressionLevel(fCompressionLevel);
+    }
+    // the single file is opened by the first thread with an event
+    if (fSingleFile) {
+      if (!fSharedFile) fSharedFile = fAsyncWriter->OpenShared(fileName, append);
+      opened = (fSharedFile != 0);
+    }
+  }
+
+  // the files of the previous run were completed by the master (EndOfRun)
+  // before this run started, so they can be appended to
+  if (fSingleFile) {
+    if (opened) {
+      fgBatch = new std::vector<B3EventFormat::EventRecord>;
+      fgBatch->reserve(B3EventFormat::kChunkRows);
+    }
+  }
+  else if (fAsync) {
+    fgProducer = fAsyncWriter->Open(fileName, append);
+    opened = (fgProducer != 0);
+  }
+  else {
+    fgWriter = new B3EventFileWriter(B3EventFormat::kChunkRows, fCompressionLevel);
+    opened = fgWriter->Open(fileName, append);
+  }
+
+  if (!opened) {
+    G4ExceptionDescription msg;
+    msg << "Cannot open the event file " << fileName;
+    G4Exception("B3EventOutput::OpenWriter()", "B3Output001",
+                FatalException, msg);
+  }
+  return opened;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventOutput::EndOfRun()
+{
+  if (fgWriter) {
+    fgWriter->Close();
+    delete fgWriter;
+    fgWriter = 0;
+  }
+  if (fgProducer) {
+    fAsyncWriter->Close(fgProducer);
+    fgProducer = 0;
+  }
+  if (fgBatch) {
+    fAsyncWriter->Submit(fSharedFile, *fgBatch);
+    delete fgBatch;
+    fgBatch = 0;
+  }
+
+  // the workers have ended their run before the master
+  if (fAsyncWriter && G4Threading::IsMasterThread()) {
+    if (fSharedFile) {
+      fAsyncWriter->Close(fSharedFile);
+      fSharedFile = 0;
+    }
+    fAsyncWriter->Sync();
+    PrintStatistics();
+    fAsyncWriter->ResetStatistics();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventOutput::PrintStatistics() const
+{
+  B3AsyncEventWriter::Statistics stats = fAsyncWriter->GetStatistics();
+  if (stats.rows == 0) return;
+
+  G4cout
+    << "\n Event files: " << stats.rows << " rows in " << stats.chunks << " chunks, "
+    << stats.rawBytes/1.e6 << " MB -> " << stats.storedBytes/1.e6 << " MB";
+  if (stats.batches > 0) {
+    G4cout
+      << "\n   single file: " << stats.batches << " batches, queue high water: "
+      << stats.queueHighWater << " of " << stats.queueCapacity << " batches";
+  }
+  else {
+    G4cout
+      << "\n   ring high water: " << stats.ringHighWater << " of "
+      << stats.ringCapacity << " rows";
+  }
+  G4cout
+    << "\n   producer stalls: " << stats.stalls << " (" << stats.stallSeconds << " s)"
+    << "\n   writer: pack " << stats.packSeconds << " s, write " << stats.writeSeconds
+    << " s, " << stats.bufferWaits << " waits for a free buffer"
+    << G4endl;
+
+  if (stats.writeErrors > 0) {
+    G4ExceptionDescription msg;
+    msg << stats.writeErrors << " chunks could not be written to the event files";
+    G4Exception("B3EventOutput::EndOfRun()", "B3Output002", JustWarning, msg);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+std::vector<B3OutputOffset> B3EventOutput::ListEventFiles(const G4String& base)
+{
+  std::vector<B3OutputOffset> files;
+
+  G4String dirName = ".";
+  G4String prefix = base;
+  size_t slash = base.rfind('/');
+  if (slash != std::string::npos) {
+    dirName = base.substr(0, slash);
+    prefix = base.substr(slash+1);
+  }
+
+  DIR* dir = opendir(dirName.c_str());
+  if (!dir) return files;
+  while (struct dirent* entry = readdir(dir)) {
+    G4String name = entry->d_name;
+    // <prefix>.b3e or <prefix>_t<n>.b3e
+    if (name.size() < prefix.size()+4 || name.compare(0, prefix.size(), prefix) != 0
+        || name.compare(name.size()-4, 4, ".b3e") != 0) continue;
+    G4String middle = name.substr(prefix.size(), name.size()-prefix.size()-4);
+    if (!middle.empty() && (middle.size() < 3 || middle.compare(0, 2, "_t") != 0
+        || middle.find_first_not_of("0123456789", 2) != std::string::npos)) continue;
+
+    B3OutputOffset file;
+    file.name = (slash != std::string::npos) ? dirName + "/" + name : name;
+    struct stat status;
+    if (stat(file.name.c_str(), &status) != 0) continue;
+    file.size = uint64_t(status.st_size);
+    files.push_back(file);
+  }
+  closedir(dir);
+  return files;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventOutput::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/output/", "Output control");
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("fileName", fAnalysisFileName,
+                                  "Name of the analysis (ntuple and histogram) file.");
+  fileCmd.SetParameterName("name", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& eventFileCmd
+    = fMessenger->DeclareProperty("eventFile", fEventFileBase,
+                                  "Base name of the binary event files (.b3e); "
+                                  "\"none\" to switch them off.");
+  eventFileCmd.SetParameterName("base", false);
+  eventFileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& ntupleCmd
+    = fMessenger->DeclareProperty("ntuple", fNtuple,
+                                  "Fill the ROOT ntuple (synchronous, in each thread).");
+  ntupleCmd.SetParameterName("ntuple", false);
+  ntupleCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& asyncCmd
+    = fMessenger->DeclareProperty("async", fAsync,
+                                  "Write the event files from a background thread.");
+  asyncCmd.SetParameterName("async", false);
+  asyncCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& singleCmd
+    = fMessenger->DeclareProperty("singleFile", fSingleFile,
+                                  "Write the events of all the threads to one "
+                                  "file, in batches, from the master.");
+  singleCmd.SetParameterName("single", false);
+  singleCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& compressionCmd
+    = fMessenger->DeclareProperty("compression", fCompressionLevel,
+                                  "zlib level of the event file chunks, 0 for none.");
+  compressionCmd.SetParameterName("level", false);
+  compressionCmd.SetRange("level>=0 && level<=9");
+  compressionCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& ringCmd
+    = fMessenger->DeclareProperty("ringSize", fRingSize,
+                                  "Rows buffered per thread by the asynchronous writer.");
+  ringCmd.SetParameterName("rows", false);
+  ringCmd.SetRange("rows>=64");
+  ringCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
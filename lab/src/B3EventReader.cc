@@ -0,0 +1,193 @@
+/// \file B3EventReader.cc
+/// \brief Implementation of the B3EventReader class
+
+#include "B3EventReader.hh"
+
+#include <cstring>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Span<uint64_t> B3EventReader::Batch::Events() const
+{
+  B3Span<uint64_t> span;
+  span.data = reinterpret_cast<const uint64_t*>(payload);
+  span.size = nRows;
+  return span;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Span<float> B3EventReader::Batch::Column(int column) const
+{
+  B3Span<float> span;
+  span.data = reinterpret_cast<const float*>(payload + B3EventFormat::ColumnOffset(column, nRows));
+  span.size = nRows;
+  return span;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3EventReader::B3EventReader()
+ : fNbRows(0),
+   fNextChunk(0),
+   fError(false)
+{
+  std::memset(&fHeader, 0, sizeof(fHeader));
+  std::memset(&fStatistics, 0, sizeof(fStatistics));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3EventReader::~B3EventReader()
+{
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3EventReader::Open(const std::string& fileName)
+{
+  using namespace B3EventFormat;
+  Close();
+  std::memset(&fStatistics, 0, sizeof(fStatistics));
+  if (!fFile.Open(fileName, B3MappedFile::kSequential)) return false;
+
+  const char* data = fFile.Data();
+  uint64_t size = fFile.Size();
+  if (size < sizeof(FileHeader)) {
+    Close();
+    return false;
+  }
+  std::memcpy(&fHeader, data, sizeof(fHeader));
+  if (!CheckFileHeader(fHeader)) {
+    Close();
+    return false;
+  }
+
+  // Index the chunks: only their headers are touched
+  uint64_t offset = sizeof(FileHeader);
+  while (sizeof(ChunkHeader) <= size - offset) {
+    const ChunkHeader* chunk = reinterpret_cast<const ChunkHeader*>(data + offset);
+    if (chunk->magic != kChunkMagic
+        || chunk->storedBytes > size - offset - sizeof(ChunkHeader)) break;
+    uint64_t end = offset + sizeof(ChunkHeader) + chunk->storedBytes;
+    fChunks.push_back(offset);
+    fNbRows += chunk->nRows;
+    offset = end;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventReader::Close()
+{
+  fFile.Close();
+  fChunks.clear();
+  fNbRows = 0;
+  fNextChunk = 0;
+  fError = false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int B3EventReader::FindColumn(const std::string& name) const
+{
+  for (uint32_t c = 0; c < fHeader.nColumns && c < uint32_t(B3EventFormat::kNbColumns); c++) {
+    if (name == fHeader.columns[c].name) return int(c);
+  }
+  return -1;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3EventReader::AddRange(int column, double lo, double hi)
+{
+  Range range = { column, lo, hi };
+  fRanges.push_back(range);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3EventReader::MayPass(const B3EventFormat::ChunkHeader& header) const
+{
+  for (size_t r = 0; r < fRanges.size(); r++) {
+    const Range& range = fRanges[r];
+    if (header.max[range.column] < range.lo || header.min[range.column] > range.hi) return false;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3EventReader::Next(Batch& batch)
+{
+  using namespace B3EventFormat;
+  while (fNextChunk < fChunks.size()) {
+    uint64_t offset = fChunks[fNextChunk++];
+    const ChunkHeader* header = reinterpret_cast<const ChunkHeader*>(fFile.Data() + offset);
+    fStatistics.chunks++;
+    if (!MayPass(*header)) {
+      fStatistics.chunksSkipped++;
+      continue;
+    }
+
+    const char* stored = fFile.Data() + offset + sizeof(ChunkHeader);
+    batch.nRows = header->nRows;
+    if (header->codec == kRaw) {
+      // in place: the mapping is 8-byte aligned at every payload
+      batch.payload = stored;
+    }
+    else {
+      if (!DecodeChunk(*header, stored, fDecoded)) {
+        fError = true;
+        return false;
+      }
+      batch.payload = fDecoded.empty() ? 0 : &fDecoded[0];
+      fStatistics.chunksDecoded++;
+    }
+    fStatistics.bytesRead += header->storedBytes;
+    fStatistics.rowsRead += header->nRows;
+
+    batch.nSelected = Select(batch);
+    batch.mask = fMask.empty() ? 0 : &fMask[0];
+    fStatistics.rowsSelected += batch.nSelected;
+    return true;
+  }
+  return false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+uint32_t B3EventReader::Select(const Batch& batch)
+{
+  uint32_t n = batch.nRows;
+  fMask.assign(n, 1);
+  uint8_t* mask = fMask.empty() ? 0 : &fMask[0];
+
+  for (size_t r = 0; r < fRanges.size(); r++) {
+    const Range& range = fRanges[r];
+    // branch-free, so that the compiler vectorizes the loops
+    if (range.column == B3EventFormat::kEvent) {
+      const uint64_t* values = batch.Events().data;
+      for (uint32_t i = 0; i < n; i++) {
+        double value = double(values[i]);
+        mask[i] &= uint8_t((value >= range.lo) & (value <= range.hi));
+      }
+    }
+    else {
+      const float* values = batch.Column(range.column).data;
+      float lo = float(range.lo);
+      float hi = float(range.hi);
+      for (uint32_t i = 0; i < n; i++) {
+        mask[i] &= uint8_t((values[i] >= lo) & (values[i] <= hi));
+      }
+    }
+  }
+
+  uint32_t selected = 0;
+  for (uint32_t i = 0; i < n; i++) selected += mask[i];
+  return selected;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
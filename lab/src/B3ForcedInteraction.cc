@@ -0,0 +1,129 @@
+/// \file B3ForcedInteraction.cc
+/// \brief Implementation of the B3ForcedInteraction class
+
+#include "B3ForcedInteraction.hh"
+#include "B3TrackInformation.hh"
+
+#include "G4BOptrForceCollision.hh"
+#include "G4BOptnForceFreeFlight.hh"
+#include "G4BiasingProcessInterface.hh"
+#include "G4VParticleChange.hh"
+#include "G4Track.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ForcedInteraction::B3ForcedInteraction(const G4String& particleName,
+                                         const G4String& name)
+ : G4VBiasingOperator(name),
+   fTrack(0),
+   fEligible(false),
+   fNbBranches(1)
+{
+  // not attached to any volume: it is called through this operator only
+  fForceCollision = new G4BOptrForceCollision(particleName, name + "_force");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ForcedInteraction::~B3ForcedInteraction()
+{
+  delete fForceCollision;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ForcedInteraction::StartTracking(const G4Track* track)
+{
+  // the copies are secondaries of the split photon, so they are tracked
+  // after it; a copy is forgotten when it starts
+  fTrack = track;
+  fEligible = (track->GetParentID() == 0) || (fCopies.erase(track) > 0);
+  if (track->GetParentID() == 0 && track->GetTrackID() == 1) {
+    fCopies.clear();
+    fNbBranches = 1;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4VBiasingOperation* B3ForcedInteraction::ProposeOccurenceBiasingOperation(
+  const G4Track* track, const G4BiasingProcessInterface* callingProcess)
+{
+  if (!fEligible) return 0;
+  return fForceCollision->GetProposedOccurenceBiasingOperation(track, callingProcess);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4VBiasingOperation* B3ForcedInteraction::ProposeFinalStateBiasingOperation(
+  const G4Track* track, const G4BiasingProcessInterface* callingProcess)
+{
+  if (!fEligible) return 0;
+  return fForceCollision->GetProposedFinalStateBiasingOperation(track, callingProcess);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4VBiasingOperation* B3ForcedInteraction::ProposeNonPhysicsBiasingOperation(
+  const G4Track* track, const G4BiasingProcessInterface* callingProcess)
+{
+  if (!fEligible) return 0;
+  return fForceCollision->GetProposedNonPhysicsBiasingOperation(track, callingProcess);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ForcedInteraction::OperationApplied(const G4BiasingProcessInterface* callingProcess,
+                                           G4BiasingAppliedCase biasingCase,
+                                           G4VBiasingOperation* operationApplied,
+                                           const G4VParticleChange* particleChangeProduced)
+{
+  fForceCollision->ReportOperationApplied(callingProcess, biasingCase, operationApplied,
+                                          particleChangeProduced);
+  if (!particleChangeProduced) return;
+  if (biasingCase == BAC_NonPhysics) {
+    // the split: its secondary is the copy to force. The copy and the
+    // photon, which crosses the crystal with no weight and leaves it with
+    // the weight of no interaction, start new branches
+    for (G4int i = 0; i < particleChangeProduced->GetNumberOfSecondaries(); i++) {
+      G4Track* copy = particleChangeProduced->GetSecondary(i);
+      fCopies.insert(copy);
+      copy->SetUserInformation(
+        new B3TrackInformation(B3TrackInformation::GetPrimaryIndex(fTrack), fNbBranches++));
+    }
+    B3TrackInformation::SetBranch(fTrack, fNbBranches++);
+  }
+  else if (!dynamic_cast<G4BOptnForceFreeFlight*>(operationApplied)) {
+    // an interaction, forced or not (the end of a free flight only restores
+    // the weight): the photon and its secondaries are not split again
+    fEligible = false;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ForcedInteraction::OperationApplied(const G4BiasingProcessInterface* callingProcess,
+                                           G4BiasingAppliedCase biasingCase,
+                                           G4VBiasingOperation* occurenceOperationApplied,
+                                           G4double weightForOccurenceInteraction,
+                                           G4VBiasingOperation* finalStateOperationApplied,
+                                           const G4VParticleChange* particleChangeProduced)
+{
+  fForceCollision->ReportOperationApplied(callingProcess, biasingCase,
+                                          occurenceOperationApplied,
+                                          weightForOccurenceInteraction,
+                                          finalStateOperationApplied,
+                                          particleChangeProduced);
+  // an interaction with the occurrence biasing
+  fEligible = false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ForcedInteraction::ExitBiasing(const G4Track* track,
+                                      const G4BiasingProcessInterface* callingProcess)
+{
+  fForceCollision->ExitingBiasing(track, callingProcess);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,180 @@
+/// \file B3ListModeFormat.cc
+/// \brief Implementation of the B3 list-mode file layout helpers
+
+#include "B3ListModeFormat.hh"
+
+#include <cmath>
+#include <cstring>
+
+#include <zlib.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace {
+
+int64_t Saturate(double value, int64_t lo, int64_t hi)
+{
+  double rounded = std::floor(value + 0.5);
+  if (rounded < double(lo)) return lo;
+  if (rounded > double(hi)) return hi;
+  return int64_t(rounded);
+}
+
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ListModeFormat::PairCrystals(uint32_t pair, uint32_t& first, uint32_t& second)
+{
+  // largest b with b(b-1)/2 <= pair
+  uint32_t b = uint32_t((1. + std::sqrt(1. + 8.*double(pair)))/2.);
+  while (b*(b-1)/2 > pair) b--;
+  while ((b+1)*b/2 <= pair) b++;
+  first = pair - b*(b-1)/2;
+  second = b;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+uint64_t B3ListModeFormat::Pack(uint32_t a, double timeA, double energyA,
+                                uint32_t b, double timeB, double energyB)
+{
+  if (a > b) {
+    uint32_t crystal = a; a = b; b = crystal;
+    double time = timeA; timeA = timeB; timeB = time;
+    double energy = energyA; energyA = energyB; energyB = energy;
+  }
+  const int64_t timeMax = (int64_t(1) << (kTimeBits-1)) - 1;
+  const int64_t energyMax = (int64_t(1) << kEnergyBits) - 1;
+
+  Coincidence coincidence;
+  coincidence.pair = PairId(a, b);
+  coincidence.timeDiff = int32_t(Saturate((timeB - timeA)/kTimeBin, -timeMax-1, timeMax));
+  coincidence.energy1 = uint32_t(Saturate(energyA/kEnergyBin, 0, energyMax));
+  coincidence.energy2 = uint32_t(Saturate(energyB/kEnergyBin, 0, energyMax));
+  return Pack(coincidence);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+uint64_t B3ListModeFormat::Pack(const Coincidence& coincidence)
+{
+  const uint64_t pairMask = (uint64_t(1) << kPairBits) - 1;
+  const uint64_t timeMask = (uint64_t(1) << kTimeBits) - 1;
+  const uint64_t energyMask = (uint64_t(1) << kEnergyBits) - 1;
+
+  uint64_t record = uint64_t(coincidence.pair) & pairMask;
+  record |= (uint64_t(uint32_t(coincidence.timeDiff)) & timeMask) << kPairBits;
+  record |= (uint64_t(coincidence.energy1) & energyMask) << (kPairBits + kTimeBits);
+  record |= (uint64_t(coincidence.energy2) & energyMask) << (kPairBits + kTimeBits + kEnergyBits);
+  return record;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ListModeFormat::Coincidence B3ListModeFormat::Unpack(uint64_t record)
+{
+  const uint64_t pairMask = (uint64_t(1) << kPairBits) - 1;
+  const uint64_t timeMask = (uint64_t(1) << kTimeBits) - 1;
+  const uint64_t energyMask = (uint64_t(1) << kEnergyBits) - 1;
+
+  Coincidence coincidence;
+  coincidence.pair = uint32_t(record & pairMask);
+  int32_t time = int32_t((record >> kPairBits) & timeMask);
+  // sign extension
+  if (time >= (1 << (kTimeBits-1))) time -= (1 << kTimeBits);
+  coincidence.timeDiff = time;
+  coincidence.energy1 = uint32_t((record >> (kPairBits + kTimeBits)) & energyMask);
+  coincidence.energy2 = uint32_t((record >> (kPairBits + kTimeBits + kEnergyBits)) & energyMask);
+  return coincidence;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ListModeFormat::InitFileHeader(FileHeader& header, uint32_t nCrystals)
+{
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kFileMagic;
+  header.version = kVersion;
+  header.nCrystals = nCrystals;
+  header.blockRecords = kBlockRecords;
+  header.timeBin = kTimeBin;
+  header.energyBin = kEnergyBin;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ListModeFormat::CheckFileHeader(const FileHeader& header)
+{
+  return header.magic == kFileMagic
+      && header.version <= kVersion
+      && header.nCrystals <= kMaxCrystals;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+size_t B3ListModeFormat::BlocksOffset(uint32_t nCrystals)
+{
+  // keep the blocks 8-byte aligned
+  size_t bytes = sizeof(FileHeader) + nCrystals*sizeof(CrystalEntry);
+  return (bytes + 7) & ~size_t(7);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ListModeFormat::PackBlock(const uint64_t* records, uint32_t nRecords,
+                                 uint64_t firstRecord, int level,
+                                 BlockHeader& header, std::vector<char>& payload)
+{
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kBlockMagic;
+  header.codec = kRaw;
+  header.nRecords = nRecords;
+  header.firstRecord = firstRecord;
+
+  size_t rawBytes = size_t(nRecords)*sizeof(uint64_t);
+  if (level > 0 && nRecords > 0) {
+    uLongf bound = compressBound(uLong(rawBytes));
+    payload.resize(bound + 8);
+    uLongf compressed = bound;
+    if (compress2(reinterpret_cast<Bytef*>(&payload[0]), &compressed,
+                  reinterpret_cast<const Bytef*>(records), uLong(rawBytes), level) == Z_OK) {
+      // zlib ignores the padding after the end of its stream
+      size_t stored = (size_t(compressed) + 7) & ~size_t(7);
+      if (stored < rawBytes) {
+        std::memset(&payload[compressed], 0, stored - compressed);
+        payload.resize(stored);
+        header.codec = kZlib;
+        header.storedBytes = stored;
+        return;
+      }
+    }
+  }
+  payload.resize(rawBytes);
+  if (rawBytes) std::memcpy(&payload[0], records, rawBytes);
+  header.storedBytes = rawBytes;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ListModeFormat::DecodeBlock(const BlockHeader& header, const char* stored,
+                                   std::vector<uint64_t>& records)
+{
+  size_t rawBytes = size_t(header.nRecords)*sizeof(uint64_t);
+  records.resize(header.nRecords);
+  if (header.nRecords == 0) return true;
+  if (header.codec == kRaw) {
+    if (header.storedBytes != rawBytes) return false;
+    std::memcpy(&records[0], stored, rawBytes);
+    return true;
+  }
+  if (header.codec == kZlib) {
+    uLongf size = uLongf(rawBytes);
+    int status = uncompress(reinterpret_cast<Bytef*>(&records[0]), &size,
+                            reinterpret_cast<const Bytef*>(stored), uLong(header.storedBytes));
+    return status == Z_OK && size == rawBytes;
+  }
+  return false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
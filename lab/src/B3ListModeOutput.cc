@@ -0,0 +1,217 @@
+/// \file B3ListModeOutput.cc
+/// \brief Implementation of the B3ListModeOutput class
+
+#include "B3ListModeOutput.hh"
+#include "B3ListModeWriter.hh"
+#include "B3ShardManager.hh"
+#include "B3Sweep.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace { G4Mutex listModeMutex = G4MUTEX_INITIALIZER; }
+
+B3ListModeOutput* B3ListModeOutput::fgInstance = 0;
+G4ThreadLocal B3ListModeWriter* B3ListModeOutput::fgWriter = 0;
+G4ThreadLocal B3ListModeOutput::Counters* B3ListModeOutput::fgCounters = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ListModeOutput* B3ListModeOutput::Instance()
+{
+  if (!fgInstance) fgInstance = new B3ListModeOutput;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ListModeOutput::B3ListModeOutput()
+ : fMessenger(0),
+   fFileBase("none"),
+   fEnergyThreshold(50*keV),
+   fTimeWindow(4*ns),
+   fCompressionLevel(1)
+{
+  std::memset(&fRunCounters, 0, sizeof(fRunCounters));
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ListModeOutput::~B3ListModeOutput()
+{
+  EndOfRun();
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3ListModeOutput::ThreadFileName() const
+{
+  std::ostringstream name;
+  name << fFileBase << B3Sweep::GetPointTag() << B3ShardManager::GetOutputTag();
+  G4int threadId = G4Threading::G4GetThreadId();
+  if (threadId >= 0) name << "_t" << threadId;
+  name << ".b3lm";
+  return name.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3ListModeOutput::OpenWriter()
+{
+  if (fCrystals.size() > B3ListModeFormat::kMaxCrystals) {
+    G4ExceptionDescription msg;
+    msg << fCrystals.size() << " crystals: the pairs of at most "
+        << B3ListModeFormat::kMaxCrystals << " fit in a list-mode record";
+    G4Exception("B3ListModeOutput::OpenWriter()", "B3ListMode001",
+                FatalException, msg);
+    return false;
+  }
+
+  G4String fileName = ThreadFileName();
+  B3ShardManager* shards = B3ShardManager::Instance();
+  G4bool append = shards->IsRestored(fileName);
+  {
+    // a file is replaced the first time it is used in the job only, unless
+    // it was restored at the checkpoint a shard is resumed from
+    G4AutoLock lock(&listModeMutex);
+    if (!fOpenedFiles.insert(fileName).second) append = true;
+  }
+  shards->AddOutput(fileName, false);
+
+  fgWriter = new B3ListModeWriter(fCompressionLevel);
+  if (!fgWriter->Open(fileName, append, fCrystals)) {
+    delete fgWriter;
+    fgWriter = 0;
+    G4ExceptionDescription msg;
+    msg << "Cannot open the list-mode file " << fileName;
+    G4Exception("B3ListModeOutput::OpenWriter()", "B3ListMode002",
+                FatalException, msg);
+    return false;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3ListModeOutput::AddEvent(const G4double* edep, const G4double* time,
+                                  G4int nCrystals, G4bool persist,
+                                  G4int& first, G4int& second)
+{
+  if (!fgCounters) {
+    fgCounters = new Counters;
+    std::memset(fgCounters, 0, sizeof(Counters));
+  }
+  fgCounters->events++;
+
+  // the two most energetic crystals above threshold
+  first = -1;
+  second = -1;
+  G4int nSingles = 0;
+  for (G4int i = 0; i < nCrystals; i++) {
+    if (edep[i] <= 0. || edep[i] < fEnergyThreshold) continue;
+    nSingles++;
+    if (first < 0 || edep[i] > edep[first]) { second = first; first = i; }
+    else if (second < 0 || edep[i] > edep[second]) second = i;
+  }
+  if (nSingles == 1) fgCounters->singles++;
+  if (nSingles < 2) return false;
+  if (std::fabs(time[first] - time[second]) > fTimeWindow) {
+    fgCounters->outOfWindow++;
+    return false;
+  }
+  if (nSingles > 2) fgCounters->multiples++;
+  fgCounters->coincidences++;
+
+  if (persist && IsEnabled() && (fgWriter || OpenWriter())) {
+    fgWriter->Add(B3ListModeFormat::Pack(first, time[first]/picosecond, edep[first]/keV,
+                                         second, time[second]/picosecond, edep[second]/keV));
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ListModeOutput::EndOfRun()
+{
+  if (fgWriter) {
+    if (!fgWriter->Close()) {
+      G4ExceptionDescription msg;
+      msg << "Cannot write the list-mode file " << fgWriter->GetFileName();
+      G4Exception("B3ListModeOutput::EndOfRun()", "B3ListMode003",
+                  FatalException, msg);
+    }
+    delete fgWriter;
+    fgWriter = 0;
+  }
+
+  G4AutoLock lock(&listModeMutex);
+  if (fgCounters) {
+    fRunCounters.events       += fgCounters->events;
+    fRunCounters.singles      += fgCounters->singles;
+    fRunCounters.coincidences += fgCounters->coincidences;
+    fRunCounters.multiples    += fgCounters->multiples;
+    fRunCounters.outOfWindow  += fgCounters->outOfWindow;
+    delete fgCounters;
+    fgCounters = 0;
+  }
+
+  // the workers have ended their run before the master
+  if (G4Threading::IsMasterThread() && fRunCounters.events > 0) {
+    G4cout
+      << "\n Coincidences: " << fRunCounters.events << " events, "
+      << fRunCounters.singles << " singles, "
+      << fRunCounters.coincidences << " coincidences ("
+      << fRunCounters.multiples << " from multiple hits), "
+      << fRunCounters.outOfWindow << " outside the time window"
+      << G4endl;
+    std::memset(&fRunCounters, 0, sizeof(fRunCounters));
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ListModeOutput::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/listmode/", "List-mode output");
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileBase,
+                                  "Base name of the list-mode files (.b3lm); "
+                                  "\"none\" to switch them off.");
+  fileCmd.SetParameterName("base", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& thresholdCmd
+    = fMessenger->DeclarePropertyWithUnit("energyThreshold", "keV", fEnergyThreshold,
+                                          "Smallest energy of a single.");
+  thresholdCmd.SetParameterName("energy", false);
+  thresholdCmd.SetRange("energy>=0");
+  thresholdCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& windowCmd
+    = fMessenger->DeclarePropertyWithUnit("timeWindow", "ns", fTimeWindow,
+                                          "Largest time difference of a coincidence.");
+  windowCmd.SetParameterName("window", false);
+  windowCmd.SetRange("window>=0");
+  windowCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& compressionCmd
+    = fMessenger->DeclareProperty("compression", fCompressionLevel,
+                                  "zlib level of the list-mode blocks, 0 for none.");
+  compressionCmd.SetParameterName("level", false);
+  compressionCmd.SetRange("level>=0 && level<=9");
+  compressionCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
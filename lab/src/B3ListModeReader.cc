@@ -0,0 +1,141 @@
+/// \file B3ListModeReader.cc
+/// \brief Implementation of the B3ListModeReader class
+
+#include "B3ListModeReader.hh"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace B3ListModeFormat;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ListModeReader::B3ListModeReader()
+ : fNbRecords(0)
+{
+  std::memset(&fHeader, 0, sizeof(fHeader));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ListModeReader::Open(const std::string& fileName)
+{
+  Close();
+  if (!fFile.Open(fileName, B3MappedFile::kRandom)) return false;
+
+  const char* data = fFile.Data();
+  uint64_t size = fFile.Size();
+  if (size < sizeof(FileHeader)) {
+    Close();
+    return false;
+  }
+  std::memcpy(&fHeader, data, sizeof(fHeader));
+  uint64_t offset = BlocksOffset(fHeader.nCrystals);
+  if (!CheckFileHeader(fHeader) || offset > size) {
+    Close();
+    return false;
+  }
+  fCrystals.resize(fHeader.nCrystals);
+  if (!fCrystals.empty()) {
+    std::memcpy(&fCrystals[0], data + sizeof(FileHeader), fCrystals.size()*sizeof(CrystalEntry));
+  }
+
+  // Index from the trailer of a closed file...
+  Trailer trailer;
+  std::memset(&trailer, 0, sizeof(trailer));
+  if (size >= offset + sizeof(trailer)) {
+    std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+  }
+  // (the sizes are compared by subtraction, so that corrupted counts
+  // cannot wrap around)
+  if (trailer.magic == kTrailerMagic
+      && trailer.indexOffset >= offset
+      && trailer.indexOffset <= size - sizeof(trailer)
+      && trailer.nBlocks == (size - sizeof(trailer) - trailer.indexOffset)/sizeof(IndexEntry)
+      && (size - sizeof(trailer) - trailer.indexOffset)%sizeof(IndexEntry) == 0) {
+    fIndex.resize(trailer.nBlocks);
+    if (!fIndex.empty()) {
+      std::memcpy(&fIndex[0], data + trailer.indexOffset, fIndex.size()*sizeof(IndexEntry));
+    }
+    for (size_t i = 0; i < fIndex.size(); i++) {
+      uint64_t blockOffset = fIndex[i].offset;
+      if (blockOffset < offset || blockOffset > trailer.indexOffset
+          || sizeof(BlockHeader) > trailer.indexOffset - blockOffset
+          || reinterpret_cast<const BlockHeader*>(data + blockOffset)->storedBytes
+             > trailer.indexOffset - blockOffset - sizeof(BlockHeader)) {
+        Close();
+        return false;
+      }
+    }
+  }
+  // ... or from the block headers
+  else {
+    while (sizeof(BlockHeader) <= size - offset) {
+      const BlockHeader* block = reinterpret_cast<const BlockHeader*>(data + offset);
+      if (block->magic != kBlockMagic
+          || block->storedBytes > size - offset - sizeof(BlockHeader)) break;
+      IndexEntry entry;
+      entry.offset = offset;
+      entry.firstRecord = block->firstRecord;
+      entry.nRecords = block->nRecords;
+      entry.reserved = 0;
+      fIndex.push_back(entry);
+      offset += sizeof(BlockHeader) + block->storedBytes;
+    }
+  }
+
+  for (size_t i = 0; i < fIndex.size(); i++) fNbRecords += fIndex[i].nRecords;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ListModeReader::Close()
+{
+  fFile.Close();
+  fCrystals.clear();
+  fIndex.clear();
+  fNbRecords = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ListModeReader::ReadBlock(size_t block, std::vector<uint64_t>& records) const
+{
+  const char* data = fFile.Data() + fIndex[block].offset;
+  const BlockHeader* header = reinterpret_cast<const BlockHeader*>(data);
+  if (header->magic != kBlockMagic) return false;
+  return DecodeBlock(*header, data + sizeof(BlockHeader), records);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ListModeReader::Read(uint64_t first, uint64_t count,
+                            std::vector<uint64_t>& records) const
+{
+  records.clear();
+  if (fIndex.empty()) return true;
+
+  // last block starting at or before the first record
+  size_t block = 0;
+  size_t lo = 0, hi = fIndex.size();
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi)/2;
+    if (fIndex[mid].firstRecord <= first) lo = mid;
+    else hi = mid;
+  }
+  block = lo;
+
+  std::vector<uint64_t> decoded;
+  uint64_t end = first + count;
+  for (; block < fIndex.size() && fIndex[block].firstRecord < end; block++) {
+    if (!ReadBlock(block, decoded)) return false;
+    uint64_t blockFirst = fIndex[block].firstRecord;
+    uint64_t from = std::max(first, blockFirst) - blockFirst;
+    uint64_t to = std::min(end, blockFirst + decoded.size()) - blockFirst;
+    if (from < to) records.insert(records.end(), decoded.begin() + from, decoded.begin() + to);
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
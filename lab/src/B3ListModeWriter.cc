@@ -0,0 +1,162 @@
+/// \file B3ListModeWriter.cc
+/// \brief Implementation of the B3ListModeWriter class
+
+#include "B3ListModeWriter.hh"
+
+#include <cstring>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+using namespace B3ListModeFormat;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ListModeWriter::B3ListModeWriter(int compressionLevel, uint32_t blockRecords)
+ : fFile(0),
+   fCompressionLevel(compressionLevel),
+   fBlockRecords(blockRecords),
+   fOffset(0),
+   fNbRecords(0),
+   fError(false)
+{
+  fRecords.reserve(blockRecords);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ListModeWriter::~B3ListModeWriter()
+{
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ListModeWriter::Open(const std::string& fileName, bool append,
+                            const std::vector<CrystalEntry>& crystals)
+{
+  Close();
+  fFileName = fileName;
+  fError = false;
+  fIndex.clear();
+  fRecords.clear();
+  fNbRecords = 0;
+  fOffset = BlocksOffset(uint32_t(crystals.size()));
+
+  if (append) {
+    std::FILE* existing = std::fopen(fileName.c_str(), "r+b");
+    if (existing) {
+      if (!ReadIndex(existing, crystals)) {
+        std::fclose(existing);
+        return false;
+      }
+      // the new blocks replace the index and the trailer
+      if (ftruncate(fileno(existing), off_t(fOffset)) != 0
+          || std::fseek(existing, long(fOffset), SEEK_SET) != 0) {
+        std::fclose(existing);
+        return false;
+      }
+      fFile = existing;
+      return true;
+    }
+  }
+
+  fFile = std::fopen(fileName.c_str(), "wb");
+  if (!fFile) return false;
+
+  FileHeader header;
+  InitFileHeader(header, uint32_t(crystals.size()));
+  header.blockRecords = fBlockRecords;
+  bool ok = std::fwrite(&header, sizeof(header), 1, fFile) == 1
+         && (crystals.empty()
+             || std::fwrite(&crystals[0], sizeof(CrystalEntry), crystals.size(), fFile)
+                == crystals.size());
+  // padding up to the first block
+  long padding = long(fOffset) - std::ftell(fFile);
+  for (long i = 0; ok && i < padding; i++) ok = std::fputc(0, fFile) != EOF;
+  if (!ok) {
+    std::fclose(fFile);
+    fFile = 0;
+  }
+  return ok;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ListModeWriter::ReadIndex(std::FILE* file, const std::vector<CrystalEntry>& crystals)
+{
+  FileHeader header;
+  if (std::fread(&header, sizeof(header), 1, file) != 1
+      || !CheckFileHeader(header) || header.nCrystals != crystals.size()) return false;
+  std::vector<CrystalEntry> table(header.nCrystals);
+  if (!table.empty()
+      && (std::fread(&table[0], sizeof(CrystalEntry), table.size(), file) != table.size()
+          || std::memcmp(&table[0], &crystals[0], table.size()*sizeof(CrystalEntry)) != 0)) {
+    return false;
+  }
+
+  Trailer trailer;
+  if (std::fseek(file, -long(sizeof(trailer)), SEEK_END) != 0
+      || std::fread(&trailer, sizeof(trailer), 1, file) != 1
+      || trailer.magic != kTrailerMagic) return false;
+
+  fIndex.resize(trailer.nBlocks);
+  if (trailer.nBlocks > 0
+      && (std::fseek(file, long(trailer.indexOffset), SEEK_SET) != 0
+          || std::fread(&fIndex[0], sizeof(IndexEntry), fIndex.size(), file) != fIndex.size())) {
+    return false;
+  }
+  fOffset = trailer.indexOffset;
+  for (size_t i = 0; i < fIndex.size(); i++) fNbRecords += fIndex[i].nRecords;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ListModeWriter::Close()
+{
+  if (!fFile) return !fError;
+  if (!fRecords.empty()) WriteBlock();
+
+  Trailer trailer;
+  trailer.indexOffset = fOffset;
+  trailer.nBlocks = uint32_t(fIndex.size());
+  trailer.magic = kTrailerMagic;
+  bool ok = !fError
+         && (fIndex.empty()
+             || std::fwrite(&fIndex[0], sizeof(IndexEntry), fIndex.size(), fFile)
+                == fIndex.size())
+         && std::fwrite(&trailer, sizeof(trailer), 1, fFile) == 1;
+
+  ok = (std::fclose(fFile) == 0) && ok;
+  fFile = 0;
+  fError = !ok;
+  return ok;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ListModeWriter::WriteBlock()
+{
+  BlockHeader header;
+  PackBlock(&fRecords[0], uint32_t(fRecords.size()), fNbRecords, fCompressionLevel,
+            header, fPayload);
+  if (std::fwrite(&header, sizeof(header), 1, fFile) != 1
+      || (!fPayload.empty()
+          && std::fwrite(&fPayload[0], 1, fPayload.size(), fFile) != fPayload.size())) {
+    fError = true;
+  }
+
+  IndexEntry entry;
+  entry.offset = fOffset;
+  entry.firstRecord = fNbRecords;
+  entry.nRecords = header.nRecords;
+  entry.reserved = 0;
+  fIndex.push_back(entry);
+
+  fOffset += sizeof(header) + fPayload.size();
+  fNbRecords += fRecords.size();
+  fRecords.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
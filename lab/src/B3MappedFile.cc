@@ -0,0 +1,80 @@
+/// \file B3MappedFile.cc
+/// \brief Implementation of the B3MappedFile class
+
+#include "B3MappedFile.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3MappedFile::B3MappedFile()
+ : fData(0), fSize(0), fOpen(false)
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3MappedFile::~B3MappedFile()
+{
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3MappedFile::Open(const std::string& fileName, Access access)
+{
+  Close();
+
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    return false;
+  }
+
+  fFileName = fileName;
+  fSize = uint64_t(status.st_size);
+  if (fSize > 0) {
+    void* data = mmap(0, fSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      fSize = 0;
+      return false;
+    }
+    fData = static_cast<const char*>(data);
+    if (access == kSequential) madvise(data, fSize, MADV_SEQUENTIAL);
+    else if (access == kRandom) madvise(data, fSize, MADV_RANDOM);
+  }
+  // the mapping stays valid once the descriptor is closed
+  close(fd);
+  fOpen = true;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3MappedFile::Close()
+{
+  if (fData) munmap(const_cast<char*>(fData), fSize);
+  fData = 0;
+  fSize = 0;
+  fOpen = false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3MappedFile::WillNeed(uint64_t offset, uint64_t length) const
+{
+  if (!fData || offset >= fSize) return;
+  // madvise wants a page-aligned start
+  uint64_t page = uint64_t(sysconf(_SC_PAGESIZE));
+  uint64_t start = offset - offset%page;
+  if (offset + length > fSize) length = fSize - offset;
+  madvise(const_cast<char*>(fData) + start, length + (offset-start), MADV_WILLNEED);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,249 @@
+/// \file B3Osem.cc
+/// \brief Implementation of the B3Osem class
+
+#include "B3Osem.hh"
+#include "B3SystemMatrix.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  typedef std::chrono::steady_clock OsemClock;
+
+  /// Speed of light, mm/ps
+  const double kLightSpeed = 0.299792458;
+  /// The TOF kernel is cut at this number of standard deviations
+  const double kTofCut = 3.;
+
+  /// Runs work(t) for t in [0, nThreads) on nThreads threads
+  template <class Work>
+  void RunThreads(unsigned int nThreads, Work work)
+  {
+    if (nThreads == 1) {
+      work(0u);
+      return;
+    }
+    std::vector<std::thread> pool;
+    for (unsigned int t = 0; t < nThreads; t++) pool.push_back(std::thread(work, t));
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+  }
+
+  /// Part t of nParts of the range [begin, end)
+  inline size_t PartBegin(size_t begin, size_t end, unsigned int t, unsigned int nParts)
+  { return begin + (end - begin)*t/nParts; }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Osem::B3Osem(const B3ImageGrid& grid)
+ : fGrid(grid),
+   fNbThreads(1),
+   fNbSubsets(1),
+   fTofFwhm(0.),
+   fMatrix(0)
+{
+  std::memset(&fStatistics, 0, sizeof(fStatistics));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+uint32_t B3Osem::AddLine(const double start[3], const double end[3], float weight)
+{
+  Line line;
+  for (int a = 0; a < 3; a++) {
+    line.start[a] = start[a];
+    line.end[a] = end[a];
+  }
+  line.weight = weight;
+  fLines.push_back(line);
+  return uint32_t(fLines.size() - 1);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Osem::AddEvent(uint32_t line, float counts, float tofCenter, uint32_t key)
+{
+  Event event = { line, counts, tofCenter, key };
+  fEvents.push_back(event);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Osem::TraceLine(uint32_t index, float tofCenter, bool tof, Trace& trace) const
+{
+  const Line& line = fLines[index];
+  double entry = 0.;
+  size_t n;
+  if (fMatrix) {
+    trace.voxels.clear();
+    trace.lengths.clear();
+    fMatrix->GetRow(index, trace.voxels, trace.lengths);
+    n = trace.voxels.size();
+  }
+  else n = B3Siddon::Trace(fGrid, line.start, line.end, trace.voxels, trace.lengths, &entry);
+  if (!tof || fTofFwhm <= 0. || n == 0) return;
+
+  double sigma = fTofFwhm/(2.*std::sqrt(2.*std::log(2.)))*0.5*kLightSpeed;
+  double direction[3], lineLength = 0.;
+  for (int a = 0; a < 3; a++) {
+    direction[a] = line.end[a] - line.start[a];
+    lineLength += direction[a]*direction[a];
+  }
+  lineLength = std::sqrt(lineLength);
+  for (int a = 0; a < 3; a++) direction[a] /= lineLength;
+  double half = 0.5*lineLength;
+  size_t nx = fGrid.n[0], nxy = size_t(fGrid.n[0])*fGrid.n[1];
+
+  // weight the lengths by the kernel, dropping the voxels outside its cut
+  size_t kept = 0;
+  double position = entry;
+  for (size_t i = 0; i < n; i++) {
+    double length = trace.lengths[i];
+    double middle;
+    if (fMatrix) {
+      // the rows of a matrix are not in the order of the line: projection
+      // of the voxel centre
+      size_t voxel = trace.voxels[i];
+      size_t index3[3] = { voxel % nx, (voxel / nx) % fGrid.n[1], voxel / nxy };
+      middle = 0.;
+      for (int a = 0; a < 3; a++) {
+        double centre = fGrid.Lower(a) + (index3[a] + 0.5)*fGrid.voxelSize[a];
+        middle += (centre - line.start[a])*direction[a];
+      }
+    }
+    else middle = position + 0.5*length;
+    double distance = (middle - half - tofCenter)/sigma;
+    position += length;
+    if (std::fabs(distance) > kTofCut) continue;
+    trace.voxels[kept] = trace.voxels[i];
+    trace.lengths[kept] = float(length*std::exp(-0.5*distance*distance));
+    kept++;
+  }
+  trace.voxels.resize(kept);
+  trace.lengths.resize(kept);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Osem::AddImages(std::vector<float>& sum)
+{
+  size_t nVoxels = fGrid.NbVoxels();
+  sum.assign(nVoxels, 0.f);
+  RunThreads(fNbThreads, [this, &sum, nVoxels](unsigned int t) {
+    size_t begin = PartBegin(0, nVoxels, t, fNbThreads);
+    size_t end = PartBegin(0, nVoxels, t+1, fNbThreads);
+    float* total = &sum[0];
+    for (size_t image = 0; image < fThreadImages.size(); image++) {
+      const float* part = &fThreadImages[image][0];
+      for (size_t j = begin; j < end; j++) total[j] += part[j];
+    }
+  });
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Osem::Initialize()
+{
+  OsemClock::time_point start = OsemClock::now();
+  size_t nVoxels = fGrid.NbVoxels();
+
+  // events sorted by subset
+  unsigned int nSubsets = fNbSubsets;
+  std::stable_sort(fEvents.begin(), fEvents.end(),
+                   [nSubsets](const Event& a, const Event& b)
+                   { return a.key % nSubsets < b.key % nSubsets; });
+  fSubsetBegin.assign(nSubsets + 1, fEvents.size());
+  for (size_t i = fEvents.size(); i-- > 0; ) fSubsetBegin[fEvents[i].key % nSubsets] = i;
+  for (unsigned int k = nSubsets; k-- > 0; ) {
+    if (fSubsetBegin[k] > fSubsetBegin[k+1]) fSubsetBegin[k] = fSubsetBegin[k+1];
+  }
+
+  fThreadImages.assign(fNbThreads, std::vector<float>(nVoxels, 0.f));
+
+  // sensitivity: back-projection of all the lines, without TOF
+  RunThreads(fNbThreads, [this](unsigned int t) {
+    std::vector<float>& image = fThreadImages[t];
+    Trace trace;
+    size_t end = PartBegin(0, fLines.size(), t+1, fNbThreads);
+    for (size_t l = PartBegin(0, fLines.size(), t, fNbThreads); l < end; l++) {
+      const Line& line = fLines[l];
+      if (line.weight == 0.f) continue;
+      TraceLine(uint32_t(l), 0.f, false, trace);
+      size_t n = trace.voxels.size();
+      const uint32_t* voxels = n ? &trace.voxels[0] : 0;
+      const float* lengths = n ? &trace.lengths[0] : 0;
+      for (size_t i = 0; i < n; i++) image[voxels[i]] += line.weight*lengths[i];
+    }
+  });
+  AddImages(fSensitivity);
+
+  fImage.assign(nVoxels, 0.f);
+  for (size_t j = 0; j < nVoxels; j++) fImage[j] = (fSensitivity[j] > 0.f) ? 1.f : 0.f;
+
+  fStatistics.sensitivitySeconds
+    = std::chrono::duration<double>(OsemClock::now() - start).count();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Osem::UpdateSubset(size_t begin, size_t end)
+{
+  // forward and back projection of the events of the subset
+  RunThreads(fNbThreads, [this, begin, end](unsigned int t) {
+    std::vector<float>& correction = fThreadImages[t];
+    std::fill(correction.begin(), correction.end(), 0.f);
+    const float* image = &fImage[0];
+    Trace trace;
+    size_t last = PartBegin(begin, end, t+1, fNbThreads);
+    for (size_t e = PartBegin(begin, end, t, fNbThreads); e < last; e++) {
+      const Event& event = fEvents[e];
+      TraceLine(event.line, event.tofCenter, true, trace);
+      size_t n = trace.voxels.size();
+      if (n == 0) continue;
+      const uint32_t* voxels = &trace.voxels[0];
+      const float* lengths = &trace.lengths[0];
+
+      float projection = 0.f;
+      for (size_t i = 0; i < n; i++) projection += image[voxels[i]]*lengths[i];
+      if (projection <= 0.f) continue;
+      float ratio = event.counts/projection;
+      for (size_t i = 0; i < n; i++) correction[voxels[i]] += lengths[i]*ratio;
+    }
+  });
+
+  // multiplicative update, with the sensitivity of one subset
+  size_t nVoxels = fGrid.NbVoxels();
+  float nSubsets = float(fNbSubsets);
+  RunThreads(fNbThreads, [this, nVoxels, nSubsets](unsigned int t) {
+    size_t first = PartBegin(0, nVoxels, t, fNbThreads);
+    size_t last = PartBegin(0, nVoxels, t+1, fNbThreads);
+    float* image = &fImage[0];
+    const float* sensitivity = &fSensitivity[0];
+    for (size_t j = first; j < last; j++) {
+      float correction = 0.f;
+      for (size_t part = 0; part < fThreadImages.size(); part++) correction += fThreadImages[part][j];
+      image[j] = (sensitivity[j] > 0.f) ? image[j]*correction*nSubsets/sensitivity[j] : 0.f;
+    }
+  });
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Osem::Iterate()
+{
+  OsemClock::time_point start = OsemClock::now();
+  for (unsigned int k = 0; k < fNbSubsets; k++) {
+    if (fSubsetBegin[k] < fSubsetBegin[k+1]) UpdateSubset(fSubsetBegin[k], fSubsetBegin[k+1]);
+  }
+  fStatistics.iterations++;
+  fStatistics.linesTraced += fEvents.size();
+  fStatistics.seconds += std::chrono::duration<double>(OsemClock::now() - start).count();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,98 @@
+/// \file B3PSBranchEnergy.cc
+/// \brief Implementation of the B3PSBranchEnergy class
+
+#include "B3PSBranchEnergy.hh"
+#include "B3TrackInformation.hh"
+
+#include "G4Step.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4UnitsTable.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PSBranchEnergy::B3PSBranchEnergy(G4String name, G4int nbCopies, G4int depth)
+ : G4VPrimitiveScorer(name, depth),
+   fHCID(-1),
+   fNbCopies(nbCopies),
+   fEvtMap(0)
+{
+  CheckAndSetUnit("MeV", "Energy");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PSBranchEnergy::~B3PSBranchEnergy()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3PSBranchEnergy::ProcessHits(G4Step* aStep, G4TouchableHistory*)
+{
+  G4double edep = aStep->GetTotalEnergyDeposit();
+  G4double weight = aStep->GetPreStepPoint()->GetWeight();
+  if (edep == 0. || weight == 0.) return false;
+
+  // a few branches per event: a linear search
+  G4int id = B3TrackInformation::GetBranch(aStep->GetTrack());
+  G4int branch = 0;
+  G4int nbBranches = G4int(fBranchIds.size());
+  while (branch < nbBranches && fBranchIds[branch] != id) branch++;
+  if (branch == nbBranches) {
+    fBranchIds.push_back(id);
+    fEvtMap->set(-1 - branch, weight);
+  }
+  fEvtMap->add(branch*fNbCopies + GetIndex(aStep), edep);
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSBranchEnergy::Initialize(G4HCofThisEvent* HCE)
+{
+  fEvtMap = new G4THitsMap<G4double>(GetMultiFunctionalDetector()->GetName(), GetName());
+  if (fHCID < 0) fHCID = GetCollectionID(0);
+  HCE->AddHitsCollection(fHCID, fEvtMap);
+  fBranchIds.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSBranchEnergy::EndOfEvent(G4HCofThisEvent*)
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSBranchEnergy::clear()
+{
+  fEvtMap->clear();
+  fBranchIds.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSBranchEnergy::DrawAll()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSBranchEnergy::PrintAll()
+{
+  G4cout << " MultiFunctionalDet  " << detector->GetName() << G4endl;
+  G4cout << " PrimitiveScorer " << GetName() << G4endl;
+  G4cout << " Number of entries " << fEvtMap->entries() << G4endl;
+  std::map<G4int,G4double*>::iterator itr = fEvtMap->GetMap()->begin();
+  for (; itr != fEvtMap->GetMap()->end(); itr++) {
+    if (itr->first < 0) {
+      G4cout << "  branch: " << -1 - itr->first
+             << "  weight: " << *(itr->second) << G4endl;
+    }
+    else {
+      G4cout << "  branch: " << itr->first/fNbCopies
+             << "  copy no.: " << itr->first%fNbCopies
+             << "  energy deposit: " << *(itr->second)/GetUnitValue()
+             << " [" << GetUnit() << "]" << G4endl;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
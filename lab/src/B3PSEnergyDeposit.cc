@@ -0,0 +1,29 @@
+/// \file B3PSEnergyDeposit.cc
+/// \brief Implementation of the B3PSEnergyDeposit class
+
+#include "B3PSEnergyDeposit.hh"
+#include "B3TrackInformation.hh"
+
+#include "G4Step.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PSEnergyDeposit::B3PSEnergyDeposit(G4String name, G4int nbCopies, G4int depth)
+ : G4PSEnergyDeposit(name, depth),
+   fNbCopies(nbCopies)
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PSEnergyDeposit::~B3PSEnergyDeposit()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4int B3PSEnergyDeposit::GetIndex(G4Step* aStep)
+{
+  return B3TrackInformation::GetPrimaryIndex(aStep->GetTrack())*fNbCopies
+       + G4PSEnergyDeposit::GetIndex(aStep);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,89 @@
+/// \file B3PSHitTime.cc
+/// \brief Implementation of the B3PSHitTime class
+
+#include "B3PSHitTime.hh"
+#include "B3TrackInformation.hh"
+
+#include "G4Step.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4UnitsTable.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PSHitTime::B3PSHitTime(G4String name, G4int nbCopies, G4int depth)
+ : G4VPrimitiveScorer(name, depth),
+   fHCID(-1),
+   fNbCopies(nbCopies),
+   fEvtMap(0)
+{
+  CheckAndSetUnit("ns", "Time");
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PSHitTime::~B3PSHitTime()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3PSHitTime::ProcessHits(G4Step* aStep, G4TouchableHistory*)
+{
+  if (aStep->GetTotalEnergyDeposit() == 0.) return false;
+
+  G4double time = aStep->GetPreStepPoint()->GetGlobalTime();
+  G4int index = GetIndex(aStep);
+  G4double* first = (*fEvtMap)[index];
+  if (!first || time < *first) fEvtMap->set(index, time);
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4int B3PSHitTime::GetIndex(G4Step* aStep)
+{
+  return B3TrackInformation::GetPrimaryIndex(aStep->GetTrack())*fNbCopies
+       + G4VPrimitiveScorer::GetIndex(aStep);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSHitTime::Initialize(G4HCofThisEvent* HCE)
+{
+  fEvtMap = new G4THitsMap<G4double>(GetMultiFunctionalDetector()->GetName(), GetName());
+  if (fHCID < 0) fHCID = GetCollectionID(0);
+  HCE->AddHitsCollection(fHCID, fEvtMap);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSHitTime::EndOfEvent(G4HCofThisEvent*)
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSHitTime::clear()
+{
+  fEvtMap->clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSHitTime::DrawAll()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PSHitTime::PrintAll()
+{
+  G4cout << " MultiFunctionalDet  " << detector->GetName() << G4endl;
+  G4cout << " PrimitiveScorer " << GetName() << G4endl;
+  G4cout << " Number of entries " << fEvtMap->entries() << G4endl;
+  std::map<G4int,G4double*>::iterator itr = fEvtMap->GetMap()->begin();
+  for (; itr != fEvtMap->GetMap()->end(); itr++) {
+    G4cout << "  copy no.: " << itr->first
+           << "  first hit time: " << *(itr->second)/GetUnitValue()
+           << " [" << GetUnit() << "]" << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
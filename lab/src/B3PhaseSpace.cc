@@ -0,0 +1,377 @@
+/// \file B3PhaseSpace.cc
+/// \brief Implementation of the B3PhaseSpace class
+
+#include "B3PhaseSpace.hh"
+#include "B3PhaseSpaceWriter.hh"
+#include "B3MappedFile.hh"
+#include "B3RandomStreams.hh"
+#include "B3ShardManager.hh"
+#include "B3Sweep.hh"
+
+#include "G4Event.hh"
+#include "G4GenericMessenger.hh"
+#include "G4IonTable.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4ParticleTable.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4Run.hh"
+#include "G4RunManager.hh"
+#include "G4Step.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <sstream>
+
+#include <glob.h>
+
+using namespace B3PhaseSpaceFormat;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace { G4Mutex phaseSpaceMutex = G4MUTEX_INITIALIZER; }
+
+B3PhaseSpace* B3PhaseSpace::fgInstance = 0;
+G4ThreadLocal B3PhaseSpaceWriter* B3PhaseSpace::fgWriter = 0;
+G4ThreadLocal std::vector<size_t>* B3PhaseSpace::fgCursors = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhaseSpace* B3PhaseSpace::Instance()
+{
+  if (!fgInstance) fgInstance = new B3PhaseSpace;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhaseSpace::B3PhaseSpace()
+ : fMessenger(0),
+   fRecordBase("none"),
+   fReplayBase("none"),
+   fCenter(38*mm, 0., 0.),
+   fHalfSize(12*mm, 7*mm, 5.5*mm),
+   fRunFirstEvent(0),
+   fRunEndEvent(0),
+   fSourceFirstEvent(0),
+   fNbSourceEvents(0),
+   fRecycleWarned(false)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhaseSpace::~B3PhaseSpace()
+{
+  EndOfRun();
+  CloseReplayFiles();
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3PhaseSpace::ThreadFileName() const
+{
+  std::ostringstream name;
+  name << fRecordBase << B3Sweep::GetPointTag() << B3ShardManager::GetOutputTag();
+  G4int threadId = G4Threading::G4GetThreadId();
+  if (threadId >= 0) name << "_t" << threadId;
+  name << ".b3ps";
+  return name.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpace::BeginOfRun(const G4Run* run)
+{
+  if (IsRecording() && IsReplaying()) {
+    G4Exception("B3PhaseSpace::BeginOfRun()", "B3PhaseSpace001", FatalException,
+                "The phase space cannot be recorded and replayed in the same run");
+    return;
+  }
+
+  // the events of the run, in the header of the files
+  B3RandomStreams* streams = B3RandomStreams::Instance();
+  fRunFirstEvent = streams->GetGlobalEventNumber(0);
+  fRunEndEvent = fRunFirstEvent + run->GetNumberOfEventToBeProcessed();
+
+  CloseReplayFiles();
+  if (IsReplaying()) OpenReplayFiles();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpace::EndOfRun()
+{
+  if (fgWriter) {
+    if (!fgWriter->Close()) {
+      G4ExceptionDescription msg;
+      msg << "Cannot write the phase-space file " << fgWriter->GetFileName();
+      G4Exception("B3PhaseSpace::EndOfRun()", "B3PhaseSpace007", FatalException, msg);
+    }
+    delete fgWriter;
+    fgWriter = 0;
+  }
+  delete fgCursors;
+  fgCursors = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3PhaseSpace::OpenWriter()
+{
+  G4String fileName = ThreadFileName();
+  B3ShardManager* shards = B3ShardManager::Instance();
+  G4bool append = shards->IsRestored(fileName);
+  {
+    // a file is replaced the first time it is used in the job only, unless
+    // it was restored at the checkpoint a shard is resumed from
+    G4AutoLock lock(&phaseSpaceMutex);
+    if (!fOpenedFiles.insert(fileName).second) append = true;
+  }
+  shards->AddOutput(fileName, false);
+
+  FileHeader header;
+  InitFileHeader(header);
+  header.firstEvent = fRunFirstEvent;
+  header.endEvent = fRunEndEvent;
+  for (G4int k = 0; k < 3; k++) {
+    header.center[k] = fCenter[k]/mm;
+    header.halfSize[k] = fHalfSize[k]/mm;
+  }
+
+  fgWriter = new B3PhaseSpaceWriter;
+  if (!fgWriter->Open(fileName, append, header)) {
+    delete fgWriter;
+    fgWriter = 0;
+    G4ExceptionDescription msg;
+    msg << "Cannot open the phase-space file " << fileName;
+    G4Exception("B3PhaseSpace::OpenWriter()", "B3PhaseSpace002", FatalException, msg);
+    return false;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3PhaseSpace::Enters(const G4ThreeVector& start, const G4ThreeVector& move,
+                            G4double& t) const
+{
+  // slabs of the box: the segment is inside all of them for [tIn, tOut]
+  G4double tIn = 0., tOut = 1.;
+  for (G4int k = 0; k < 3; k++) {
+    if (move[k] == 0.) {
+      if (std::fabs(start[k]) >= fHalfSize[k]) return false;
+      continue;
+    }
+    G4double t1 = (-fHalfSize[k] - start[k])/move[k];
+    G4double t2 = ( fHalfSize[k] - start[k])/move[k];
+    if (t1 > t2) std::swap(t1, t2);
+    tIn = std::max(tIn, t1);
+    tOut = std::min(tOut, t2);
+    if (tIn > tOut) return false;
+  }
+  t = tIn;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpace::RecordStep(const G4Step* step)
+{
+  const G4StepPoint* pre = step->GetPreStepPoint();
+  if (IsInside(pre->GetPosition())) return;
+  const G4StepPoint* post = step->GetPostStepPoint();
+  G4ThreeVector move = post->GetPosition() - pre->GetPosition();
+  G4double t;
+  if (!Enters(pre->GetPosition() - fCenter, move, t)) return;
+
+  // the particle at the crossing point, with its state at the start of the
+  // step (a straight line for the photons)
+  G4Track* track = step->GetTrack();
+  G4ThreeVector position = pre->GetPosition() + t*move;
+  G4ThreeVector direction = pre->GetMomentumDirection();
+  Record record;
+  record.event = B3RandomStreams::Instance()->GetGlobalEventNumber(
+    G4RunManager::GetRunManager()->GetCurrentEvent()->GetEventID());
+  record.pdg = track->GetDefinition()->GetPDGEncoding();
+  record.energy = pre->GetKineticEnergy()/keV;
+  for (G4int k = 0; k < 3; k++) {
+    record.position[k] = position[k]/mm;
+    record.direction[k] = direction[k];
+  }
+  record.time = (pre->GetGlobalTime()
+                 + t*(post->GetGlobalTime() - pre->GetGlobalTime()))/ns;
+  record.weight = pre->GetWeight();
+
+  if (fgWriter || OpenWriter()) fgWriter->Add(record);
+  track->SetTrackStatus(fStopAndKill);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpace::OpenReplayFiles()
+{
+  std::vector<G4String> names;
+  G4String patterns[3] = { fReplayBase + ".b3ps", fReplayBase + "_t*.b3ps",
+                           fReplayBase + "_shard*.b3ps" };
+  for (G4int p = 0; p < 3; p++) {
+    glob_t found;
+    if (glob(patterns[p].c_str(), 0, 0, &found) == 0) {
+      for (size_t i = 0; i < found.gl_pathc; i++) names.push_back(found.gl_pathv[i]);
+    }
+    globfree(&found);
+  }
+
+  G4long endEvent = 0;
+  G4long nbRecords = 0;
+  fSourceFirstEvent = -1;
+  for (size_t i = 0; i < names.size(); i++) {
+    B3MappedFile* file = new B3MappedFile;
+    const FileHeader* header = 0;
+    if (file->Open(names[i], B3MappedFile::kSequential) && file->Size() >= sizeof(FileHeader)) {
+      header = reinterpret_cast<const FileHeader*>(file->Data());
+    }
+    if (!header || !CheckFileHeader(*header)) {
+      delete file;
+      G4ExceptionDescription msg;
+      msg << names[i] << " is not a phase-space file";
+      G4Exception("B3PhaseSpace::OpenReplayFiles()", "B3PhaseSpace003", FatalException, msg);
+      return;
+    }
+    // the records of the whole file, closed or not
+    ReplayFile replay;
+    replay.file = file;
+    replay.begin = reinterpret_cast<const Record*>(file->Data() + sizeof(FileHeader));
+    replay.end = replay.begin + (file->Size() - sizeof(FileHeader))/sizeof(Record);
+    fReplayFiles.push_back(replay);
+
+    // the search of the events (LowerBound) needs the records in the order
+    // of the events
+    for (const Record* record = replay.begin + 1; record < replay.end; record++) {
+      if (record->event < (record - 1)->event) {
+        G4ExceptionDescription msg;
+        msg << "The records of " << names[i] << " are not in the order of the events";
+        G4Exception("B3PhaseSpace::OpenReplayFiles()", "B3PhaseSpace008", FatalException, msg);
+        return;
+      }
+    }
+
+    if (fSourceFirstEvent < 0 || G4long(header->firstEvent) < fSourceFirstEvent) {
+      fSourceFirstEvent = header->firstEvent;
+    }
+    endEvent = std::max(endEvent, G4long(header->endEvent));
+    nbRecords += replay.end - replay.begin;
+  }
+  fNbSourceEvents = endEvent - fSourceFirstEvent;
+  fRecycleWarned = false;
+
+  if (fReplayFiles.empty() || fNbSourceEvents <= 0) {
+    G4ExceptionDescription msg;
+    msg << "No phase space of source events in " << patterns[0] << " or " << patterns[1];
+    G4Exception("B3PhaseSpace::OpenReplayFiles()", "B3PhaseSpace004", FatalException, msg);
+    return;
+  }
+  G4cout << "\n Phase space: " << nbRecords << " particles of " << fNbSourceEvents
+         << " source events in " << fReplayFiles.size() << " files " << fReplayBase
+         << "*.b3ps" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpace::CloseReplayFiles()
+{
+  for (size_t i = 0; i < fReplayFiles.size(); i++) delete fReplayFiles[i].file;
+  fReplayFiles.clear();
+  fNbSourceEvents = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpace::GeneratePrimaries(G4Event* event)
+{
+  if (fNbSourceEvents <= 0) return;
+  G4long replayed = B3RandomStreams::Instance()->GetGlobalEventNumber(event->GetEventID());
+  if (replayed >= fNbSourceEvents && !fRecycleWarned) {
+    G4AutoLock lock(&phaseSpaceMutex);
+    if (!fRecycleWarned) {
+      fRecycleWarned = true;
+      G4ExceptionDescription msg;
+      msg << "All the " << fNbSourceEvents << " source events of the phase space "
+          << "are replayed: it is reused from the start";
+      G4Exception("B3PhaseSpace::GeneratePrimaries()", "B3PhaseSpace005", JustWarning, msg);
+    }
+  }
+  uint64_t source = fSourceFirstEvent + replayed % fNbSourceEvents;
+
+  // the events of a thread come in increasing order: the search of each file
+  // starts where the previous event of the thread stopped
+  if (!fgCursors) fgCursors = new std::vector<size_t>(fReplayFiles.size(), 0);
+  G4ParticleTable* particleTable = G4ParticleTable::GetParticleTable();
+  for (size_t f = 0; f < fReplayFiles.size(); f++) {
+    const Record* begin = fReplayFiles[f].begin;
+    const Record* end = fReplayFiles[f].end;
+    const Record* from = begin + (*fgCursors)[f];
+    if (from != begin && (from - 1)->event >= source) from = begin;
+    const Record* record = LowerBound(from, end, source);
+    for (; record != end && record->event == source; record++) {
+      G4ParticleDefinition* particle = particleTable->FindParticle(record->pdg);
+      if (!particle) particle = G4IonTable::GetIonTable()->GetIon(record->pdg);
+      if (!particle) {
+        G4ExceptionDescription msg;
+        msg << "Unknown particle " << record->pdg << " in the phase space";
+        G4Exception("B3PhaseSpace::GeneratePrimaries()", "B3PhaseSpace006", JustWarning, msg);
+        continue;
+      }
+      G4PrimaryParticle* primary = new G4PrimaryParticle(particle);
+      primary->SetKineticEnergy(record->energy*keV);
+      primary->SetMomentumDirection(G4ThreeVector(record->direction[0], record->direction[1],
+                                                  record->direction[2]));
+      primary->SetWeight(record->weight);
+      G4PrimaryVertex* vertex
+        = new G4PrimaryVertex(G4ThreeVector(record->position[0], record->position[1],
+                                            record->position[2])*mm, record->time*ns);
+      vertex->SetPrimary(primary);
+      event->AddPrimaryVertex(vertex);
+    }
+    (*fgCursors)[f] = record - begin;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpace::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/phasespace/",
+                                      "Phase space at a surface around the crystals");
+
+  G4GenericMessenger::Command& recordCmd
+    = fMessenger->DeclareProperty("record", fRecordBase,
+                                  "Base name of the phase-space files (.b3ps) to record; "
+                                  "\"none\" to switch the recording off.");
+  recordCmd.SetParameterName("base", false);
+  recordCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& replayCmd
+    = fMessenger->DeclareProperty("replay", fReplayBase,
+                                  "Base name of the phase-space files to replay as the "
+                                  "source; \"none\" for the standard source.");
+  replayCmd.SetParameterName("base", false);
+  replayCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& centerCmd
+    = fMessenger->DeclarePropertyWithUnit("center", "mm", fCenter,
+                                          "Centre of the box of the surface.");
+  centerCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& sizeCmd
+    = fMessenger->DeclarePropertyWithUnit("halfSize", "mm", fHalfSize,
+                                          "Half lengths of the box of the surface.");
+  sizeCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,43 @@
+/// \file B3PhaseSpaceFormat.cc
+/// \brief Helpers of the B3 phase-space files
+
+#include "B3PhaseSpaceFormat.hh"
+
+#include <cstring>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpaceFormat::InitFileHeader(FileHeader& header)
+{
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kFileMagic;
+  header.version = kVersion;
+  header.recordBytes = sizeof(Record);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3PhaseSpaceFormat::CheckFileHeader(const FileHeader& header)
+{
+  return header.magic == kFileMagic && header.version == kVersion
+      && header.recordBytes == sizeof(Record);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const B3PhaseSpaceFormat::Record*
+B3PhaseSpaceFormat::LowerBound(const Record* begin, const Record* end, uint64_t event)
+{
+  size_t count = end - begin;
+  while (count > 0) {
+    size_t half = count/2;
+    if (begin[half].event < event) {
+      begin += half + 1;
+      count -= half + 1;
+    }
+    else count = half;
+  }
+  return begin;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,97 @@
+/// \file B3PhaseSpaceWriter.cc
+/// \brief Implementation of the B3PhaseSpaceWriter class
+
+#include "B3PhaseSpaceWriter.hh"
+
+#include <cstring>
+
+using namespace B3PhaseSpaceFormat;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhaseSpaceWriter::B3PhaseSpaceWriter(uint32_t bufferRecords)
+ : fFile(0),
+   fBufferRecords(bufferRecords),
+   fError(false)
+{
+  InitFileHeader(fHeader);
+  fRecords.reserve(bufferRecords);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhaseSpaceWriter::~B3PhaseSpaceWriter()
+{
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3PhaseSpaceWriter::Open(const std::string& fileName, bool append,
+                              const FileHeader& header)
+{
+  Close();
+  fFileName = fileName;
+  fError = false;
+  fRecords.clear();
+  fHeader = header;
+
+  if (append) {
+    std::FILE* existing = std::fopen(fileName.c_str(), "r+b");
+    if (existing) {
+      FileHeader previous;
+      if (std::fread(&previous, sizeof(previous), 1, existing) != 1
+          || !CheckFileHeader(previous)
+          || std::memcmp(previous.center, header.center, sizeof(header.center)) != 0
+          || std::memcmp(previous.halfSize, header.halfSize, sizeof(header.halfSize)) != 0
+          || std::fseek(existing, 0, SEEK_END) != 0) {
+        std::fclose(existing);
+        return false;
+      }
+      // the events of the previous runs, and the records of the whole file
+      fHeader.firstEvent = previous.firstEvent;
+      fHeader.nRecords = (uint64_t(std::ftell(existing)) - sizeof(FileHeader))/sizeof(Record);
+      fFile = existing;
+      return true;
+    }
+  }
+
+  fFile = std::fopen(fileName.c_str(), "wb");
+  if (!fFile) return false;
+  fHeader.nRecords = 0;
+  if (std::fwrite(&fHeader, sizeof(fHeader), 1, fFile) != 1) {
+    std::fclose(fFile);
+    fFile = 0;
+    return false;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhaseSpaceWriter::Flush()
+{
+  if (!fRecords.empty()) {
+    size_t written = std::fwrite(&fRecords[0], sizeof(Record), fRecords.size(), fFile);
+    if (written != fRecords.size()) fError = true;
+    fHeader.nRecords += written;
+    fRecords.clear();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3PhaseSpaceWriter::Close()
+{
+  if (!fFile) return !fError;
+  Flush();
+  bool ok = !fError
+         && std::fseek(fFile, 0, SEEK_SET) == 0
+         && std::fwrite(&fHeader, sizeof(fHeader), 1, fFile) == 1;
+  ok = (std::fclose(fFile) == 0) && ok;
+  fFile = 0;
+  fError = !ok;
+  return ok;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,197 @@
+/// \file B3PhiloxEngine.cc
+/// \brief Implementation of the B3PhiloxEngine class
+
+#include "B3PhiloxEngine.hh"
+
+#include <fstream>
+#include <iostream>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  const uint32_t kPhiloxM0 = 0xD2511F53;
+  const uint32_t kPhiloxM1 = 0xCD9E8D57;
+  const uint32_t kPhiloxW0 = 0x9E3779B9;
+  const uint32_t kPhiloxW1 = 0xBB67AE85;
+
+  inline uint32_t MulHiLo(uint32_t a, uint32_t b, uint32_t& hi)
+  {
+    uint64_t product = uint64_t(a)*b;
+    hi = uint32_t(product >> 32);
+    return uint32_t(product);
+  }
+
+  /// Philox-4x32 with 10 rounds
+  void Philox4x32(const uint32_t in[4], uint32_t k0, uint32_t k1, uint32_t out[4])
+  {
+    uint32_t c0 = in[0], c1 = in[1], c2 = in[2], c3 = in[3];
+    for (int round = 0; round < 10; round++) {
+      uint32_t hi0, hi1;
+      uint32_t lo0 = MulHiLo(kPhiloxM0, c0, hi0);
+      uint32_t lo1 = MulHiLo(kPhiloxM1, c2, hi1);
+      c0 = hi1^c1^k0;
+      c1 = lo1;
+      c2 = hi0^c3^k1;
+      c3 = lo0;
+      k0 += kPhiloxW0;
+      k1 += kPhiloxW1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+  }
+
+  // 2^-53
+  const double kTwoToMinus53 = 1./9007199254740992.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhiloxEngine::B3PhiloxEngine(long seed)
+ : CLHEP::HepRandomEngine(),
+   fKey(0), fStream(0), fCounter(0), fBlockIndex(4)
+{
+  setSeed(seed);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhiloxEngine::~B3PhiloxEngine()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhiloxEngine::SetStream(uint64_t key, uint64_t stream)
+{
+  fKey = key;
+  fStream = stream;
+  fCounter = 0;
+  fBlockIndex = 4;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhiloxEngine::NextBlock()
+{
+  uint32_t counter[4] = { uint32_t(fCounter), uint32_t(fCounter >> 32),
+                          uint32_t(fStream),  uint32_t(fStream >> 32) };
+  Philox4x32(counter, uint32_t(fKey), uint32_t(fKey >> 32), fBlock);
+  fCounter++;
+  fBlockIndex = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+double B3PhiloxEngine::flat()
+{
+  // 52 random bits n from two words; (2n+1)/2^53 is exact in a double, so
+  // that the result is strictly inside (0,1) as required by CLHEP
+  if (fBlockIndex > 2) NextBlock();
+  uint32_t hi = fBlock[fBlockIndex++] >> 6;
+  uint32_t lo = fBlock[fBlockIndex++] >> 6;
+  return (2.*(double(hi)*67108864. + double(lo)) + 1.)*kTwoToMinus53;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhiloxEngine::flatArray(const int size, double* vect)
+{
+  for (int i = 0; i < size; i++) vect[i] = flat();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhiloxEngine::setSeed(long seed, int)
+{
+  theSeed = seed;
+  SetStream(uint64_t(seed), 0);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhiloxEngine::setSeeds(const long* seeds, int)
+{
+  // The first two seeds (as set by /random/setSeeds) form the 64-bit key
+  if (!seeds || seeds[0] == 0) return;
+  theSeeds = seeds;
+  theSeed = seeds[0];
+  uint64_t key = uint32_t(seeds[0]);
+  if (seeds[1] != 0) key |= uint64_t(uint32_t(seeds[1])) << 32;
+  SetStream(key, 0);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhiloxEngine::saveStatus(const char filename[]) const
+{
+  std::ofstream out(filename, std::ios::out);
+  if (!out.bad()) put(out);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhiloxEngine::restoreStatus(const char filename[])
+{
+  std::ifstream in(filename, std::ios::in);
+  if (!in) {
+    std::cerr << "  -- Engine state remains unchanged" << std::endl;
+    return;
+  }
+  get(in);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhiloxEngine::showStatus() const
+{
+  std::cout << std::endl
+            << "------- B3PhiloxEngine engine status -------" << std::endl
+            << " Key     = " << fKey << std::endl
+            << " Stream  = " << fStream << std::endl
+            << " Counter = " << fCounter << " (word " << fBlockIndex << ")" << std::endl
+            << "--------------------------------------------" << std::endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+std::string B3PhiloxEngine::name() const
+{
+  return engineName();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+std::ostream& B3PhiloxEngine::put(std::ostream& os) const
+{
+  // The state is fully defined by the key, the stream and the position in
+  // the stream: the current block is regenerated on restore
+  os << engineName() << "-begin " << fKey << " " << fStream << " "
+     << fCounter << " " << fBlockIndex << " " << engineName() << "-end\n";
+  return os;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+std::istream& B3PhiloxEngine::get(std::istream& is)
+{
+  std::string begin, end;
+  uint64_t key, stream, counter;
+  int blockIndex;
+  is >> begin >> key >> stream >> counter >> blockIndex >> end;
+  if (!is || begin != engineName()+"-begin" || end != engineName()+"-end") {
+    std::cerr << "  -- B3PhiloxEngine: invalid state, engine unchanged" << std::endl;
+    is.clear(std::ios::badbit | is.rdstate());
+    return is;
+  }
+  SetStream(key, stream);
+  if (blockIndex < 4 && counter > 0) {
+    fCounter = counter - 1;
+    NextBlock();
+    fBlockIndex = blockIndex;
+  }
+  else {
+    fCounter = counter;
+  }
+  return is;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -29,10 +29,16 @@
 /// \brief Implementation of the B3PhysicsList class
 
 #include "B3PhysicsList.hh"
+#include "B3PhysicsTableCache.hh"
+#include "B3Biasing.hh"
 
 #include "G4DecayPhysics.hh"
 #include "G4RadioactiveDecayPhysics.hh"
 #include "G4EmStandardPhysics.hh"
+#include "G4GenericBiasingPhysics.hh"
+#include "G4FastSimulationManagerProcess.hh"
+#include "G4Gamma.hh"
+#include "G4ProcessManager.hh"
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
@@ -54,6 +60,16 @@ B3PhysicsList::B3PhysicsList()
 
   // Standard EM Physics
   RegisterPhysics(new G4EmStandardPhysics());
+
+  // Biasing of the photons: the physics is fixed before the macros, so the
+  // processes are wrapped in the jobs started with exampleB3 -b only; the
+  // forcing itself is switched on with /B3/bias/forceInteraction (see
+  // B3Biasing)
+  if (B3Biasing::Instance()->HasPhysics()) {
+    G4GenericBiasingPhysics* biasingPhysics = new G4GenericBiasingPhysics();
+    biasingPhysics->Bias("gamma");
+    RegisterPhysics(biasingPhysics);
+  }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -64,9 +80,27 @@ B3PhysicsList::~B3PhysicsList()
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
+void B3PhysicsList::ConstructProcess()
+{
+  G4VModularPhysicsList::ConstructProcess();
+
+  // Fast simulation of the photons in the envelopes of the mass geometry;
+  // nothing is done outside them. As a discrete process, its ordering
+  // does not matter.
+  G4FastSimulationManagerProcess* fastSimulation
+    = new G4FastSimulationManagerProcess("fastSimProcess_massGeom");
+  G4Gamma::Gamma()->GetProcessManager()->AddDiscreteProcess(fastSimulation);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
 void B3PhysicsList::SetCuts()
 {
   // The method SetCuts() is mandatory in the interface. Here, one just use 
   // the default SetCuts() provided by the base class.
   G4VUserPhysicsList::SetCuts();
+
+  // The materials and the cuts are known: the tables are retrieved from
+  // the cache if they are in it (see B3PhysicsTableCache)
+  B3PhysicsTableCache::Instance()->Prepare(this);
 }  
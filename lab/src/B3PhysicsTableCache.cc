@@ -0,0 +1,292 @@
+/// \file B3PhysicsTableCache.cc
+/// \brief Implementation of the B3PhysicsTableCache class
+
+#include "B3PhysicsTableCache.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4VModularPhysicsList.hh"
+#include "G4VPhysicsConstructor.hh"
+#include "G4Material.hh"
+#include "G4Element.hh"
+#include "G4IonisParamMat.hh"
+#include "G4RegionStore.hh"
+#include "G4Region.hh"
+#include "G4ProductionCuts.hh"
+#include "G4Threading.hh"
+#include "G4Version.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace {
+
+  // FNV-1a hash of the description
+  unsigned long long Hash(const G4String& text)
+  {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < text.size(); i++) {
+      hash ^= static_cast<unsigned char>(text[i]);
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  G4String ReadFile(const G4String& fileName)
+  {
+    std::ifstream file(fileName.c_str());
+    if (!file) return "";
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+  }
+
+  // removes a directory of files (the physics tables are not in
+  // subdirectories)
+  void RemoveDirectory(const G4String& path)
+  {
+    DIR* directory = opendir(path.c_str());
+    if (directory) {
+      while (dirent* entry = readdir(directory)) {
+        G4String name = entry->d_name;
+        if (name != "." && name != "..") std::remove((path + "/" + name).c_str());
+      }
+      closedir(directory);
+    }
+    rmdir(path.c_str());
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhysicsTableCache* B3PhysicsTableCache::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhysicsTableCache* B3PhysicsTableCache::Instance()
+{
+  if (!fgInstance) fgInstance = new B3PhysicsTableCache;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhysicsTableCache::B3PhysicsTableCache()
+ : fMessenger(0),
+   fDirectory("none"),
+   fPhysicsList(0),
+   fBuilt(false),
+   fRetrieved(false),
+   fStored(false),
+   fReported(false),
+   fInitializationTime(-1.)
+{
+  // the startup is timed from the creation of the instance, at the
+  // beginning of main()
+  fStartupTimer.Start();
+  fInitializationTimer.Start();
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PhysicsTableCache::~B3PhysicsTableCache()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhysicsTableCache::SetDirectory(G4String directory)
+{
+  fDirectory = directory;
+  if (fBuilt && IsEnabled()) {
+    G4ExceptionDescription msg;
+    msg << "The physics tables are already built: they are stored in " << fDirectory
+        << ", not retrieved from it (set the cache with exampleB3 -c " << fDirectory << ")";
+    G4Exception("B3PhysicsTableCache::SetDirectory()", "B3Physics002", JustWarning, msg);
+    return;
+  }
+  if (fPhysicsList) Prepare(fPhysicsList);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhysicsTableCache::Prepare(G4VModularPhysicsList* physicsList)
+{
+  if (!G4Threading::IsMasterThread()) return;
+  fPhysicsList = physicsList;
+  // the tables built are not retrieved again
+  if (fBuilt) return;
+  if (fRetrieved) physicsList->ResetPhysicsTableRetrieved();
+  fRetrieved = false;
+  fPath = "";
+  if (!IsEnabled()) return;
+
+  G4String description = Describe();
+  fPath = CachePath(description);
+  if (ReadFile(fPath + "/key.txt") == description) {
+    physicsList->SetPhysicsTableRetrieved(fPath);
+    fRetrieved = true;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhysicsTableCache::EndOfInitialization()
+{
+  fInitializationTimer.Stop();
+  fInitializationTime = fInitializationTimer.GetRealElapsed();
+  // G4MTRunManager::Initialize() has run a run of no event on the master
+  if (G4Threading::IsMultithreadedApplication()) fBuilt = true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhysicsTableCache::BeginOfRun()
+{
+  // Geant4 builds the tables when it cannot retrieve them
+  fBuilt = true;
+  if (fRetrieved && !fPhysicsList->IsPhysicsTableRetrieved()) fRetrieved = false;
+  if (IsEnabled() && fPhysicsList && !fRetrieved && !fStored) Store();
+
+  if (fReported) return;
+  fReported = true;
+  fStartupTimer.Stop();
+  G4cout << "\n Startup: ";
+  if (fInitializationTime >= 0.) {
+    G4cout << fInitializationTime << " s for the kernel initialization, ";
+  }
+  G4cout << fStartupTimer.GetRealElapsed() << " s up to the first run" << G4endl;
+  if (!IsEnabled()) {
+    G4cout << "   physics tables built (no table cache)" << G4endl;
+  }
+  else if (fRetrieved) {
+    G4cout << "   physics tables retrieved from " << fPath << G4endl;
+  }
+  else {
+    G4cout << "   physics tables built";
+    if (fStored) G4cout << ", stored in " << fPath;
+    G4cout << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3PhysicsTableCache::Describe() const
+{
+  std::ostringstream description;
+  description << std::setprecision(12);
+  description << "geant4 " << G4VERSION_NUMBER << "\n";
+
+  for (G4int i = 0; fPhysicsList->GetPhysics(i); i++) {
+    const G4VPhysicsConstructor* physics = fPhysicsList->GetPhysics(i);
+    description << "physics " << physics->GetPhysicsName() << " "
+                << physics->GetPhysicsType() << "\n";
+  }
+
+  const G4MaterialTable* materials = G4Material::GetMaterialTable();
+  for (size_t m = 0; m < materials->size(); m++) {
+    const G4Material* material = (*materials)[m];
+    description << "material " << material->GetName() << " "
+                << material->GetDensity()/(g/cm3) << " " << material->GetState() << " "
+                << material->GetTemperature()/kelvin << " "
+                << material->GetPressure()/atmosphere << " "
+                << material->GetIonisation()->GetMeanExcitationEnergy()/eV;
+    const G4double* fractions = material->GetFractionVector();
+    for (size_t e = 0; e < material->GetNumberOfElements(); e++) {
+      const G4Element* element = material->GetElement(e);
+      description << " " << element->GetZ() << ":" << element->GetA()/(g/mole)
+                  << ":" << fractions[e];
+    }
+    description << "\n";
+  }
+
+  description << "cut " << fPhysicsList->GetDefaultCutValue()/mm << "\n";
+  G4RegionStore* regions = G4RegionStore::GetInstance();
+  for (size_t r = 0; r < regions->size(); r++) {
+    const G4Region* region = (*regions)[r];
+    description << "region " << region->GetName();
+    G4ProductionCuts* cuts = region->GetProductionCuts();
+    if (!cuts) description << " default";
+    else {
+      for (G4int p = 0; p < 4; p++) description << " " << cuts->GetProductionCut(p)/mm;
+    }
+    description << "\n";
+  }
+  return description.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3PhysicsTableCache::CachePath(const G4String& description) const
+{
+  std::ostringstream path;
+  path << fDirectory << "/" << std::hex << std::setw(16) << std::setfill('0')
+       << Hash(description);
+  return path.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhysicsTableCache::Store()
+{
+  fStored = true;
+
+  // the description of the tables built, with the cuts of this run
+  G4String description = Describe();
+  fPath = CachePath(description);
+  std::ostringstream tmpPath;
+  tmpPath << fPath << ".tmp" << getpid();
+  G4String tmp = tmpPath.str();
+
+  mkdir(fDirectory.c_str(), 0755);
+  G4bool ok = mkdir(tmp.c_str(), 0755) == 0 && fPhysicsList->StorePhysicsTable(tmp);
+  if (ok) {
+    std::ofstream key((tmp + "/key.txt").c_str());
+    key << description;
+    key.close();
+    ok = !key.fail();
+  }
+  // an other job may have stored the same tables in the meantime
+  if (ok && std::rename(tmp.c_str(), fPath.c_str()) != 0) {
+    RemoveDirectory(tmp);
+    if (ReadFile(fPath + "/key.txt") != description) ok = false;
+  }
+  else if (!ok) RemoveDirectory(tmp);
+
+  if (!ok) {
+    fStored = false;
+    G4ExceptionDescription msg;
+    msg << "Cannot store the physics tables in " << fPath;
+    G4Exception("B3PhysicsTableCache::Store()", "B3Physics001", JustWarning, msg);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PhysicsTableCache::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/physics/",
+                                      "Cache of the physics tables");
+
+  G4GenericMessenger::Command& cacheCmd
+    = fMessenger->DeclareMethod("tableCache", &B3PhysicsTableCache::SetDirectory,
+                                "Directory of the cache of the physics tables; "
+                                "\"none\" to build them. Retrieved only if set "
+                                "before they are built (exampleB3 -c).");
+  cacheCmd.SetParameterName("dir", false);
+  cacheCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
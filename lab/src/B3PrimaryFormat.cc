@@ -0,0 +1,57 @@
+/// \file B3PrimaryFormat.cc
+/// \brief Helpers of the B3 primary event files
+
+#include "B3PrimaryFormat.hh"
+
+#include <cstring>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PrimaryFormat::InitFileHeader(FileHeader& header)
+{
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kFileMagic;
+  header.version = kVersion;
+  header.vertexBytes = sizeof(Vertex);
+  header.particleBytes = sizeof(Particle);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+uint64_t B3PrimaryFormat::FileBytes(const FileHeader& header)
+{
+  return sizeof(FileHeader) + (header.nEvents + 1)*sizeof(uint64_t)
+       + header.nVertices*sizeof(Vertex) + header.nParticles*sizeof(Particle);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3PrimaryFormat::MapSections(const char* data, uint64_t size, Sections& sections)
+{
+  if (size < sizeof(FileHeader)) return false;
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+  if (header->magic != kFileMagic || header->version != kVersion
+      || header->vertexBytes != sizeof(Vertex) || header->particleBytes != sizeof(Particle)
+      || header->nEvents >= size/sizeof(uint64_t) || header->nVertices > size/sizeof(Vertex)
+      || header->nParticles > size/sizeof(Particle)
+      || FileBytes(*header) != size) return false;
+
+  sections.header = header;
+  data += sizeof(FileHeader);
+  sections.eventVertex = reinterpret_cast<const uint64_t*>(data);
+  data += (header->nEvents + 1)*sizeof(uint64_t);
+  sections.vertices = reinterpret_cast<const Vertex*>(data);
+  data += header->nVertices*sizeof(Vertex);
+  sections.particles = reinterpret_cast<const Particle*>(data);
+
+  // the index goes up from 0 to the number of vertices, so that the
+  // vertices of every event are in the file
+  if (sections.eventVertex[0] != 0
+      || sections.eventVertex[header->nEvents] != header->nVertices) return false;
+  for (uint64_t i = 0; i < header->nEvents; i++) {
+    if (sections.eventVertex[i + 1] < sections.eventVertex[i]) return false;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
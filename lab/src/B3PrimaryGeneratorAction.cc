@@ -29,6 +29,11 @@
 /// \brief Implementation of the B3PrimaryGeneratorAction class
 
 #include "B3PrimaryGeneratorAction.hh"
+#include "B3RandomStreams.hh"
+#include "B3BeamScan.hh"
+#include "B3PhaseSpace.hh"
+#include "B3PrimaryLibrary.hh"
+#include "B3Batching.hh"
 
 #include "G4RunManager.hh"
 #include "G4Event.hh"
@@ -71,6 +76,43 @@ B3PrimaryGeneratorAction::~B3PrimaryGeneratorAction()
 
 void B3PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
 {
+  // Select the random stream of this event before anything is sampled
+  B3RandomStreams::Instance()->BeginOfEvent(anEvent);
+  B3Batching::SetEventPrimaries(1);
+
+  // Phase-space replay: the particles recorded at the surface around the
+  // crystals for the source event of this event
+  B3PhaseSpace* phaseSpace = B3PhaseSpace::Instance();
+  if (phaseSpace->IsReplaying()) {
+    phaseSpace->GeneratePrimaries(anEvent);
+    return;
+  }
+
+  // Primary event library: the vertices of the library event of this event
+  B3PrimaryLibrary* library = B3PrimaryLibrary::Instance();
+  if (library->IsEnabled()) {
+    library->GeneratePrimaries(anEvent);
+    return;
+  }
+
+  // Beam scan: pencil beam of the grid point of the event, the settings of
+  // the gun being restored afterwards
+  B3BeamScan* scan = B3BeamScan::Instance();
+  if (scan->IsEnabled()) {
+    G4ThreeVector position, direction;
+    G4double energy;
+    scan->GetBeam(anEvent->GetEventID(), position, direction, energy);
+    G4ThreeVector gunDirection = fParticleGun->GetParticleMomentumDirection();
+    G4double gunEnergy = fParticleGun->GetParticleEnergy();
+    fParticleGun->SetParticlePosition(position);
+    fParticleGun->SetParticleMomentumDirection(direction);
+    fParticleGun->SetParticleEnergy(energy);
+    fParticleGun->GeneratePrimaryVertex(anEvent);
+    fParticleGun->SetParticleMomentumDirection(gunDirection);
+    fParticleGun->SetParticleEnergy(gunEnergy);
+    return;
+  }
+
   G4double x0  = 0*cm, y0  = 0*cm, z0  = 0*cm;
   // G4double dx0 = 4*mm, dy0 = 4*mm, dz0 = 4*mm;
   // x0 += dx0*(G4UniformRand()-0.5);
@@ -85,9 +127,13 @@ void B3PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
   //uz = std::cos(Theta);
 
   // fParticleGun->SetParticleMomentumDirection(G4ThreeVector(ux,uy,uz));          
-  //create vertex
+  //create vertex, one per primary of the event (see B3Batching)
   //
-  fParticleGun->GeneratePrimaryVertex(anEvent);
+  G4int nbPrimaries = B3Batching::Instance()->GetNbPrimaries();
+  B3Batching::SetEventPrimaries(nbPrimaries);
+  for (G4int k = 0; k < nbPrimaries; k++) {
+    fParticleGun->GeneratePrimaryVertex(anEvent);
+  }
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,199 @@
+/// \file B3PrimaryLibrary.cc
+/// \brief Implementation of the B3PrimaryLibrary class
+
+#include "B3PrimaryLibrary.hh"
+#include "B3MappedFile.hh"
+#include "B3PhaseSpace.hh"
+#include "B3RandomStreams.hh"
+
+#include "G4Event.hh"
+#include "G4GenericMessenger.hh"
+#include "G4IonTable.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4ParticleTable.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+
+using namespace B3PrimaryFormat;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace { G4Mutex primaryLibraryMutex = G4MUTEX_INITIALIZER; }
+
+B3PrimaryLibrary* B3PrimaryLibrary::fgInstance = 0;
+G4ThreadLocal G4long B3PrimaryLibrary::fgPrefetched = -1;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PrimaryLibrary* B3PrimaryLibrary::Instance()
+{
+  if (!fgInstance) fgInstance = new B3PrimaryLibrary;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PrimaryLibrary::B3PrimaryLibrary()
+ : fMessenger(0),
+   fFileName("none"),
+   fPrefetchEvents(1000),
+   fFile(0),
+   fNbEvents(0),
+   fRecycleWarned(false)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3PrimaryLibrary::~B3PrimaryLibrary()
+{
+  delete fFile;
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PrimaryLibrary::BeginOfRun()
+{
+  delete fFile;
+  fFile = 0;
+  fNbEvents = 0;
+  if (!IsEnabled()) return;
+  if (B3PhaseSpace::Instance()->IsReplaying()) {
+    G4Exception("B3PrimaryLibrary::BeginOfRun()", "B3Primaries006", FatalException,
+                "The primary event library and the phase-space replay are both set");
+    return;
+  }
+
+  fFile = new B3MappedFile;
+  if (!fFile->Open(fFileName, B3MappedFile::kRandom)
+      || !MapSections(fFile->Data(), fFile->Size(), fSections)) {
+    delete fFile;
+    fFile = 0;
+    G4ExceptionDescription msg;
+    msg << fFileName << " is not a primary event file";
+    G4Exception("B3PrimaryLibrary::BeginOfRun()", "B3Primaries001", FatalException, msg);
+    return;
+  }
+  fNbEvents = fSections.header->nEvents;
+  fRecycleWarned = false;
+  if (fNbEvents == 0) {
+    G4ExceptionDescription msg;
+    msg << "No event in the primary event file " << fFileName;
+    G4Exception("B3PrimaryLibrary::BeginOfRun()", "B3Primaries002", FatalException, msg);
+    return;
+  }
+  G4cout << "\n Primary events: " << fNbEvents << " events, "
+         << fSections.header->nVertices << " vertices, "
+         << fSections.header->nParticles << " particles in " << fFileName << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PrimaryLibrary::Prefetch(G4long block)
+{
+  G4long first = block*fPrefetchEvents;
+  G4long end = std::min(first + fPrefetchEvents, fNbEvents);
+  uint64_t firstVertex = fSections.eventVertex[first];
+  uint64_t endVertex = fSections.eventVertex[end];
+  const char* data = fFile->Data();
+  fFile->WillNeed(reinterpret_cast<const char*>(fSections.vertices + firstVertex) - data,
+                  (endVertex - firstVertex)*sizeof(Vertex));
+  if (endVertex > firstVertex) {
+    const Vertex& last = fSections.vertices[endVertex - 1];
+    uint64_t firstParticle = fSections.vertices[firstVertex].firstParticle;
+    uint64_t endParticle = last.firstParticle + last.nParticles;
+    if (firstParticle < endParticle && endParticle <= fSections.header->nParticles) {
+      fFile->WillNeed(reinterpret_cast<const char*>(fSections.particles + firstParticle) - data,
+                      (endParticle - firstParticle)*sizeof(Particle));
+    }
+  }
+  fgPrefetched = block;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PrimaryLibrary::GeneratePrimaries(G4Event* event)
+{
+  if (fNbEvents <= 0) return;
+  G4long global = B3RandomStreams::Instance()->GetGlobalEventNumber(event->GetEventID());
+  if (global >= fNbEvents && !fRecycleWarned) {
+    G4AutoLock lock(&primaryLibraryMutex);
+    if (!fRecycleWarned) {
+      fRecycleWarned = true;
+      G4ExceptionDescription msg;
+      msg << "All the " << fNbEvents << " events of " << fFileName
+          << " are used: the library is reused from the start";
+      G4Exception("B3PrimaryLibrary::GeneratePrimaries()", "B3Primaries003", JustWarning, msg);
+    }
+  }
+  G4long index = global % fNbEvents;
+  if (index/fPrefetchEvents != fgPrefetched) Prefetch(index/fPrefetchEvents);
+
+  G4ParticleTable* particleTable = G4ParticleTable::GetParticleTable();
+  uint64_t nParticles = fSections.header->nParticles;
+  uint64_t endVertex = fSections.eventVertex[index + 1];
+  for (uint64_t v = fSections.eventVertex[index]; v < endVertex; v++) {
+    const Vertex& entry = fSections.vertices[v];
+    if (entry.firstParticle + entry.nParticles > nParticles) {
+      G4ExceptionDescription msg;
+      msg << "Vertex " << v << " of " << fFileName << " is out of the particles";
+      G4Exception("B3PrimaryLibrary::GeneratePrimaries()", "B3Primaries004",
+                  FatalException, msg);
+      return;
+    }
+    G4PrimaryVertex* vertex
+      = new G4PrimaryVertex(G4ThreeVector(entry.position[0], entry.position[1],
+                                          entry.position[2])*mm, entry.time*ns);
+    vertex->SetWeight(entry.weight);
+    for (uint32_t p = 0; p < entry.nParticles; p++) {
+      const Particle& particleEntry = fSections.particles[entry.firstParticle + p];
+      G4ParticleDefinition* particle = particleTable->FindParticle(particleEntry.pdg);
+      if (!particle) particle = G4IonTable::GetIonTable()->GetIon(particleEntry.pdg);
+      if (!particle) {
+        G4ExceptionDescription msg;
+        msg << "Unknown particle " << particleEntry.pdg << " in " << fFileName;
+        G4Exception("B3PrimaryLibrary::GeneratePrimaries()", "B3Primaries005",
+                    JustWarning, msg);
+        continue;
+      }
+      G4PrimaryParticle* primary = new G4PrimaryParticle(particle);
+      primary->SetKineticEnergy(particleEntry.energy*keV);
+      primary->SetMomentumDirection(G4ThreeVector(particleEntry.direction[0],
+                                                  particleEntry.direction[1],
+                                                  particleEntry.direction[2]));
+      vertex->SetPrimary(primary);
+    }
+    event->AddPrimaryVertex(vertex);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3PrimaryLibrary::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/primaries/",
+                                      "Source of precomputed primary events");
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileName,
+                                  "Primary event file (.b3p) of the source; \"none\" "
+                                  "for the particle gun.");
+  fileCmd.SetParameterName("file", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& prefetchCmd
+    = fMessenger->DeclareProperty("prefetchEvents", fPrefetchEvents,
+                                  "Events of the library read ahead by a thread.");
+  prefetchCmd.SetParameterName("n", false);
+  prefetchCmd.SetRange("n>=1");
+  prefetchCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
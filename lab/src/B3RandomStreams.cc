@@ -0,0 +1,106 @@
+/// \file B3RandomStreams.cc
+/// \brief Implementation of the B3RandomStreams class
+
+#include "B3RandomStreams.hh"
+#include "B3PhiloxEngine.hh"
+
+#include "G4Event.hh"
+#include "G4GenericMessenger.hh"
+#include "Randomize.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3RandomStreams* B3RandomStreams::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3RandomStreams* B3RandomStreams::Instance()
+{
+  if (!fgInstance) fgInstance = new B3RandomStreams;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3RandomStreams::B3RandomStreams()
+ : fMessenger(0),
+   fActive(false),
+   fRunSeed(0),
+   fEventOffset(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3RandomStreams::~B3RandomStreams()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3RandomStreams::BeginOfRun()
+{
+  B3PhiloxEngine* engine = dynamic_cast<B3PhiloxEngine*>(G4Random::getTheEngine());
+  fActive = (engine != 0);
+  if (!fActive) return;
+
+  fRunSeed = G4long(engine->GetKey());
+  G4cout << " Per-event random streams: seed " << fRunSeed
+         << ", first global event " << fEventOffset << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3RandomStreams::BeginOfEvent(G4Event* event)
+{
+  if (!fActive) return;
+
+  // In multi-threaded mode the kernel has just reseeded the worker engine
+  // from the master seed queue: the stream of the event replaces it
+  B3PhiloxEngine* engine = static_cast<B3PhiloxEngine*>(G4Random::getTheEngine());
+  engine->SetStream(uint64_t(fRunSeed),
+                    uint64_t(GetGlobalEventNumber(event->GetEventID())));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3RandomStreams::EndOfRun(G4int nofEvents)
+{
+  fEventOffset += nofEvents;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3RandomStreams::ReplayEvent(G4long eventNumber)
+{
+  fEventOffset = eventNumber;
+  G4cout << " The next run starts at global event " << eventNumber
+         << ": /run/beamOn 1 replays it" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3RandomStreams::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/random/",
+                                      "Per-event random streams");
+
+  G4GenericMessenger::Command& offsetCmd
+    = fMessenger->DeclareProperty("eventOffset", fEventOffset,
+                                  "Global event number of the first event of the next run.");
+  offsetCmd.SetParameterName("offset", false);
+  offsetCmd.SetRange("offset>=0");
+  offsetCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& replayCmd
+    = fMessenger->DeclareMethod("replayEvent", &B3RandomStreams::ReplayEvent,
+                                "Start the next run at the given global event number.");
+  replayCmd.SetParameterName("event", false);
+  replayCmd.SetRange("event>=0");
+  replayCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,199 @@
+/// \file B3ResponseMatrix.cc
+/// \brief Implementation of the B3ResponseMatrix structure
+
+#include "B3ResponseMatrix.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  const uint32_t kResponseMagic   = 0x4D523342;   // "B3RM"
+  const uint32_t kResponseVersion = 1;
+
+  template <class T>
+  bool Put(std::FILE* file, const T& value)
+  { return std::fwrite(&value, sizeof(T), 1, file) == 1; }
+
+  template <class T>
+  bool Get(std::FILE* file, T& value)
+  { return std::fread(&value, sizeof(T), 1, file) == 1; }
+
+  /// i-th of n values from lo to hi included
+  double Step(uint32_t i, uint32_t n, double lo, double hi)
+  { return n > 1 ? lo + (hi - lo)*i/(n - 1) : lo; }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ResponseMatrix::B3ResponseMatrix()
+ : nY(0), nZ(0), nTheta(0), nPhi(0), nEnergies(0),
+   faceX(0.f), yMin(0.f), yMax(0.f), zMin(0.f), zMax(0.f), maxTheta(0.f),
+   energyMin(0.f), energyMax(0.f), nBins(0), binWidth(0.f)
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ResponseMatrix::Init(const std::vector<B3ListModeFormat::CrystalEntry>& scanner,
+                            uint32_t yCells, uint32_t zCells, uint32_t thetaSteps,
+                            float thetaMax, uint32_t phiSteps, uint32_t energySteps,
+                            float energyLo, float energyHi, uint32_t bins, float width)
+{
+  crystals = scanner;
+  nY = yCells;
+  nZ = zCells;
+  nTheta = thetaSteps;
+  maxTheta = thetaMax;
+  nPhi = phiSteps;
+  nEnergies = energySteps;
+  energyMin = energyLo;
+  energyMax = energyHi;
+  nBins = bins;
+  binWidth = width;
+
+  // face of the crystals seen from the source side
+  for (size_t i = 0; i < crystals.size(); i++) {
+    const B3ListModeFormat::CrystalEntry& c = crystals[i];
+    float x = c.center[0] - c.halfSize[0];
+    float y0 = c.center[1] - c.halfSize[1], y1 = c.center[1] + c.halfSize[1];
+    float z0 = c.center[2] - c.halfSize[2], z1 = c.center[2] + c.halfSize[2];
+    if (i == 0) {
+      faceX = x;
+      yMin = y0; yMax = y1;
+      zMin = z0; zMax = z1;
+      continue;
+    }
+    faceX = std::min(faceX, x);
+    yMin = std::min(yMin, y0); yMax = std::max(yMax, y1);
+    zMin = std::min(zMin, z0); zMax = std::max(zMax, z1);
+  }
+
+  events.assign(NbPoints(), 0);
+  counts.assign(NbPoints()*crystals.size()*nBins, 0);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ResponseMatrix::Clear()
+{
+  std::fill(events.begin(), events.end(), 0);
+  std::fill(counts.begin(), counts.end(), 0);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ResponseMatrix::Point(size_t point, double position[3], double direction[3],
+                             double& energy) const
+{
+  uint32_t j = uint32_t(point % nY);
+  point /= nY;
+  uint32_t k = uint32_t(point % nZ);
+  point /= nZ;
+  uint32_t p = uint32_t(point % nPhi);
+  point /= nPhi;
+  uint32_t t = uint32_t(point % nTheta);
+  uint32_t e = uint32_t(point / nTheta);
+
+  position[0] = faceX;
+  position[1] = yMin + (j + 0.5)*(yMax - yMin)/nY;
+  position[2] = zMin + (k + 0.5)*(zMax - zMin)/nZ;
+
+  double theta = Step(t, nTheta, 0., maxTheta);
+  double phi = 2.*M_PI*p/nPhi;
+  direction[0] = std::cos(theta);
+  direction[1] = std::sin(theta)*std::cos(phi);
+  direction[2] = std::sin(theta)*std::sin(phi);
+
+  energy = Step(e, nEnergies, energyMin, energyMax);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ResponseMatrix::Add(const B3ResponseMatrix& other)
+{
+  if (other.nY != nY || other.nZ != nZ || other.nTheta != nTheta || other.nPhi != nPhi
+      || other.nEnergies != nEnergies || other.faceX != faceX
+      || other.yMin != yMin || other.yMax != yMax || other.zMin != zMin || other.zMax != zMax
+      || other.maxTheta != maxTheta || other.energyMin != energyMin
+      || other.energyMax != energyMax || other.nBins != nBins || other.binWidth != binWidth
+      || other.crystals.size() != crystals.size() || other.counts.size() != counts.size()) {
+    return false;
+  }
+
+  // plain loops over contiguous arrays: vectorised by the compiler
+  uint32_t* sum = counts.empty() ? 0 : &counts[0];
+  const uint32_t* added = other.counts.empty() ? 0 : &other.counts[0];
+  size_t n = counts.size();
+  for (size_t i = 0; i < n; i++) sum[i] += added[i];
+  for (size_t i = 0; i < events.size(); i++) events[i] += other.events[i];
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ResponseMatrix::Write(const std::string& fileName) const
+{
+  std::string tmpName = fileName + ".tmp";
+  std::FILE* file = std::fopen(tmpName.c_str(), "wb");
+  if (!file) return false;
+
+  uint32_t nCrystals = uint32_t(crystals.size());
+  bool ok = Put(file, kResponseMagic) && Put(file, kResponseVersion)
+         && Put(file, nY) && Put(file, nZ) && Put(file, nTheta) && Put(file, nPhi)
+         && Put(file, nEnergies) && Put(file, nBins) && Put(file, nCrystals)
+         && Put(file, faceX) && Put(file, yMin) && Put(file, yMax)
+         && Put(file, zMin) && Put(file, zMax) && Put(file, maxTheta)
+         && Put(file, energyMin) && Put(file, energyMax) && Put(file, binWidth);
+  ok = ok && (nCrystals == 0
+              || std::fwrite(&crystals[0], sizeof(crystals[0]), nCrystals, file) == nCrystals);
+  ok = ok && (events.empty()
+              || std::fwrite(&events[0], sizeof(uint64_t), events.size(), file) == events.size());
+  ok = ok && (counts.empty()
+              || std::fwrite(&counts[0], sizeof(uint32_t), counts.size(), file) == counts.size());
+
+  ok = (std::fflush(file) == 0) && ok;
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok) {
+    std::remove(tmpName.c_str());
+    return false;
+  }
+  return std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3ResponseMatrix::Read(const std::string& fileName)
+{
+  std::FILE* file = std::fopen(fileName.c_str(), "rb");
+  if (!file) return false;
+
+  uint32_t magic = 0, version = 0, nCrystals = 0;
+  bool ok = Get(file, magic) && Get(file, version)
+         && magic == kResponseMagic && version == kResponseVersion
+         && Get(file, nY) && Get(file, nZ) && Get(file, nTheta) && Get(file, nPhi)
+         && Get(file, nEnergies) && Get(file, nBins) && Get(file, nCrystals)
+         && Get(file, faceX) && Get(file, yMin) && Get(file, yMax)
+         && Get(file, zMin) && Get(file, zMax) && Get(file, maxTheta)
+         && Get(file, energyMin) && Get(file, energyMax) && Get(file, binWidth)
+         && nCrystals <= B3ListModeFormat::kMaxCrystals;
+  if (ok) {
+    crystals.resize(nCrystals);
+    ok = (nCrystals == 0
+          || std::fread(&crystals[0], sizeof(crystals[0]), nCrystals, file) == nCrystals);
+  }
+  if (ok) {
+    events.resize(NbPoints());
+    counts.resize(NbPoints()*nCrystals*nBins);
+    ok = (events.empty()
+          || std::fread(&events[0], sizeof(uint64_t), events.size(), file) == events.size())
+      && (counts.empty()
+          || std::fread(&counts[0], sizeof(uint32_t), counts.size(), file) == counts.size());
+  }
+  std::fclose(file);
+  return ok;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
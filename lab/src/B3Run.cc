@@ -30,6 +30,15 @@
 
 #include "B3Run.hh"
 #include "B3Hits.hh"
+#include "B3EventOutput.hh"
+#include "B3ListModeOutput.hh"
+#include "B3SinogramOutput.hh"
+#include "B3BeamScan.hh"
+#include "B3DoseSD.hh"
+#include "B3RandomStreams.hh"
+#include "B3Trigger.hh"
+#include "B3Biasing.hh"
+#include "B3Batching.hh"
 
 #include "G4RunManager.hh"
 #include "G4Event.hh"
@@ -46,8 +55,16 @@
 B3Run::B3Run()
  : G4Run(), 
    fCollID_cryst(-1),
-   fPrintModulo(10000)
-{ }
+   fCollID_time(-1),
+   fCollID_branch(-1),
+   fPrintModulo(10000),
+   fNbPrescaled(0)
+{
+  for (G4int d = 0 ; d < B3Trigger::kNbDecisions ; d++){
+    fTriggerCounts[d] = 0;}
+  B3Biasing* biasing = B3Biasing::Instance();
+  fWeightedTally.Reset(biasing->GetPeakLow()/keV, biasing->GetPeakHigh()/keV);
+}
 
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -68,6 +85,10 @@ void B3Run::RecordEvent(const G4Event* event)
    fCollID_cryst 
      = G4SDManager::GetSDMpointer()->GetCollectionID("crystal/edep");
    G4cout << " fCollID_cryst: " << fCollID_cryst << G4endl;   
+   fCollID_time
+     = G4SDManager::GetSDMpointer()->GetCollectionID("crystal/time");
+   fCollID_branch
+     = G4SDManager::GetSDMpointer()->GetCollectionID("crystal/branch");
   }
 
   G4int evtNb = event->GetEventID();
@@ -75,6 +96,10 @@ void B3Run::RecordEvent(const G4Event* event)
   if (evtNb%fPrintModulo == 0) { 
     G4cout << "\n---> end of event: " << evtNb << G4endl;
   }      
+
+  //Dose in the phantom voxels, for all events
+  B3DoseSD* doseSD = B3DoseSD::Instance();
+  if (doseSD && doseSD->isActive()) doseSD->Flush(fDose);
   
   //Hits collections
   //  
@@ -83,54 +108,177 @@ void B3Run::RecordEvent(const G4Event* event)
   // crystals. They are created in the UserGeometry.
   G4HCofThisEvent* HCE = event->GetHCofThisEvent();
   if(!HCE) return;
+
+  //Forced interactions: the branches of the event, with their weights, fill
+  //the weighted tally. The other outputs need analog events. The branch
+  //scorer exists only in the geometries with the forcing.
+  G4THitsMap<G4double>* branchMap = (fCollID_branch < 0) ? 0 :
+    static_cast<G4THitsMap<G4double>*>(HCE->GetHC(fCollID_branch));
+  if (branchMap) {
+    RecordBranches(branchMap);
+    G4Run::RecordEvent(event);
+    return;
+  }
                
   //Energy in the crystal
   
    
   //ok, let's start the game: retrieve the hits-collection in the crystals.
   //This comes from a Geant4 multiscorer of type "G4PSEnergyDeposit", which scores 
-  //energy deposit.
+  //energy deposit, per primary of the event (see B3Batching): the key is
+  //primary*9 + copyNb.
   G4THitsMap<G4double>* evtMap = 
     static_cast<G4THitsMap<G4double>*>(HCE->GetHC(fCollID_cryst));
                
   std::map<G4int,G4double*>::iterator itr;
 
+  G4int nbPrimaries = B3Batching::GetEventPrimaries();
+  G4int nbKeys = nbPrimaries*9;
+  fPrimaryEdep.assign(nbKeys, 0.);
+  for (itr = evtMap->GetMap()->begin(); itr != evtMap->GetMap()->end(); itr++) {
+    //these are the ID's of the detectors fired, per primary
+    G4int key = itr->first;
+    if (key < nbKeys) fPrimaryEdep[key] = *(itr->second);
+  }
+
+  //First-hit times of the crystals, for the coincidences
+  const G4double* time_arr = 0;
+  if (B3ListModeOutput::Instance()->IsEnabled() || B3SinogramOutput::Instance()->IsEnabled()) {
+    fPrimaryTime.assign(nbKeys, 0.);
+    G4THitsMap<G4double>* timeMap =
+      static_cast<G4THitsMap<G4double>*>(HCE->GetHC(fCollID_time));
+    for (itr = timeMap->GetMap()->begin(); itr != timeMap->GetMap()->end(); itr++) {
+      if (itr->first < nbKeys) fPrimaryTime[itr->first] = *(itr->second);}
+    time_arr = &fPrimaryTime[0];
+  }
+
+  //each primary is a sub-event of the event
+  G4long globalEvtNb = B3RandomStreams::Instance()->GetGlobalEventNumber(evtNb);
+  for (G4int k = 0 ; k < nbPrimaries ; k++){
+    RecordPrimary(evtNb, globalEvtNb, k, &fPrimaryEdep[k*9],
+                  time_arr ? time_arr + k*9 : 0);}
+
+  G4Run::RecordEvent(event);   
+}  
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Run::RecordPrimary(G4int evtNb, G4long globalEvtNb, G4int primary,
+                          const G4double* edep_arr, const G4double* time_arr)
+{
   //Store the total energy in a variable
   G4double totEdep = 0.;
   G4AnalysisManager* man = G4AnalysisManager::Instance();
 
-  G4double edep_arr[9];
-  
+  //Sum the energy deposited in all crystals, irrespectively of threshold.
   for (G4int i = 0 ; i < 9 ; i++){
-    edep_arr[i] = 0.0; }
+    totEdep += edep_arr[i];}
+
+  //Run accumulators, for all events, in keV
+  G4double edep_keV[9];
+  for (G4int i = 0 ; i < 9 ; i++){
+    edep_keV[i] = edep_arr[i]/keV;}
+  fTally.Fill(edep_keV);
+  man->FillH1(1,totEdep/keV);
+
+  //Response of the crystals to the beam of the scan grid point, for all
+  //events
+  B3BeamScan* scan = B3BeamScan::Instance();
+  if (scan->IsEnabled()) scan->Fill(fResponse, evtNb, edep_arr, 9);
+
+  //Trigger: only the selected events are persisted
+  B3Trigger::Decision decision = B3Trigger::Instance()->Decide(edep_arr, totEdep);
+  fTriggerCounts[decision]++;
+  G4bool persist = (decision == B3Trigger::kAccepted);
+  //the prescale counts the primaries in the order of the run
+  G4int nbPrimaries = B3Batching::GetEventPrimaries();
+  if (!persist && B3Trigger::Instance()->IsPrescaled(globalEvtNb*nbPrimaries + primary)) {
+    persist = true;
+    fNbPrescaled++;
+  }
+
+  B3EventOutput* output = B3EventOutput::Instance();
+  if (persist && output->IsNtupleEnabled()) {
+    for (G4int i = 0 ; i < 9 ; i++){
+      man->FillNtupleDColumn(i, edep_arr[i]/keV);}
   
-  for (itr = evtMap->GetMap()->begin(); itr != evtMap->GetMap()->end(); itr++) {
-    G4double edep = *(itr->second);
+    man->AddNtupleRow();
+  }
 
-    //Sum the energy deposited in all crystals, irrespectively of threshold.
-    totEdep += edep;
+  //Binary event file, in keV
+  if (persist && output->IsEventFileEnabled()) {
+    B3EventFormat::EventRecord record;
+    record.event = (nbPrimaries > 1) ? B3Batching::SubEventNumber(globalEvtNb, primary)
+                                     : globalEvtNb;
+    record.total = totEdep/keV;
+    for (G4int i = 0 ; i < 9 ; i++){
+      record.edep[i] = edep_keV[i];}
+    output->AddEvent(record);
+  }
 
-    //these are the ID's of the detectors fired. 
-    G4int copyNb  = (itr->first);
+  //Coincidences, from the first-hit times of the crystals: list-mode
+  //records of the persisted events, and sinogram of all the events
+  B3ListModeOutput* listMode = B3ListModeOutput::Instance();
+  B3SinogramOutput* sinogram = B3SinogramOutput::Instance();
+  if (time_arr) {
+    G4int first, second;
+    if (listMode->AddEvent(edep_arr, time_arr, 9, persist, first, second)
+        && sinogram->IsEnabled()) {
+      sinogram->Fill(fSinogram, first, second);
+    }
+  }
+}
 
-    edep_arr[copyNb] = edep;
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-    //G4cout << "\n  cryst" << copyNb << ": " << edep/keV << " keV ";
+void B3Run::RecordBranches(G4THitsMap<G4double>* branchMap)
+{
+  //keys -1-b: weight of branch b; b*9+copyNb: its energy in the crystal
+  fBranchWeights.clear();
+  fBranchEdep.clear();
+  std::map<G4int,G4double*>::iterator itr;
+  for (itr = branchMap->GetMap()->begin(); itr != branchMap->GetMap()->end(); itr++) {
+    G4int key = itr->first;
+    if (key < 0) {
+      size_t branch = -1 - key;
+      if (fBranchWeights.size() <= branch) fBranchWeights.resize(branch + 1, 0.);
+      fBranchWeights[branch] = *(itr->second);
+    }
+    else {
+      if (fBranchEdep.size() < size_t(key/9 + 1)*9) fBranchEdep.resize((key/9 + 1)*9, 0.);
+      fBranchEdep[key] = *(itr->second)/keV;
+    }
   }
+  fBranchEdep.resize(fBranchWeights.size()*9, 0.);
 
-  for (G4int i = 0 ; i < 9 ; i++){
-    man->FillNtupleDColumn(i, edep_arr[i]/keV);}
-  
-  man->AddNtupleRow();
-  man->FillH1(1,totEdep/keV);
-  G4Run::RecordEvent(event);   
-}  
+  fWeightedTally.BeginEvent();
+  for (size_t b = 0; b < fBranchWeights.size(); b++) {
+    fWeightedTally.AddBranch(fBranchWeights[b], &fBranchEdep[b*9]);}
+  fWeightedTally.EndEvent();
+}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 void B3Run::Merge(const G4Run* aRun)
 {
   const B3Run* localRun = static_cast<const B3Run*>(aRun);
+  fTally.Add(localRun->fTally);
+  fWeightedTally.Add(localRun->fWeightedTally);
+  for (G4int d = 0 ; d < B3Trigger::kNbDecisions ; d++){
+    fTriggerCounts[d] += localRun->fTriggerCounts[d];}
+  fNbPrescaled += localRun->fNbPrescaled;
+  if (localRun->fSinogram.IsInitialized()) {
+    if (!fSinogram.IsInitialized()) fSinogram = localRun->fSinogram;
+    else fSinogram.Add(localRun->fSinogram);
+  }
+  if (localRun->fResponse.IsInitialized()) {
+    if (!fResponse.IsInitialized()) fResponse = localRun->fResponse;
+    else fResponse.Add(localRun->fResponse);
+  }
+  if (localRun->fDose.IsInitialized()) {
+    if (!fDose.IsInitialized()) fDose = localRun->fDose;
+    else fDose.Add(localRun->fDose);
+  }
 
   G4Run::Merge(aRun); 
 } 
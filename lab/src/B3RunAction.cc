@@ -31,6 +31,22 @@
 #include "B3RunAction.hh"
 #include "B3PrimaryGeneratorAction.hh"
 #include "B3Run.hh"
+#include "B3RandomStreams.hh"
+#include "B3EventOutput.hh"
+#include "B3ListModeOutput.hh"
+#include "B3SinogramOutput.hh"
+#include "B3BeamScan.hh"
+#include "B3DoseOutput.hh"
+#include "B3ShardManager.hh"
+#include "B3Trigger.hh"
+#include "B3Biasing.hh"
+#include "B3PhaseSpace.hh"
+#include "B3PrimaryLibrary.hh"
+#include "B3Batching.hh"
+#include "B3ThreadPlacement.hh"
+#include "B3PhysicsTableCache.hh"
+#include "B3Sweep.hh"
+#include "B3WoodcockModel.hh"
 
 #include "G4Run.hh"
 #include "G4RunManager.hh"
@@ -100,10 +116,23 @@ void B3RunAction::BeginOfRunAction(const G4Run* run)
   analysisManager->CreateH1("h1","energy", 100, 0., 1000.);
 
   // Create a new output file
-  analysisManager->OpenFile("B3");
+  analysisManager->OpenFile(B3EventOutput::Instance()->GetAnalysisFileName());
 
-  //inform the runManager to save random number seed
+  //no need to save the random number seeds: every event can be
+  //reproduced from the run seed and its global event number
   G4RunManager::GetRunManager()->SetRandomNumberStore(false);
+  if (IsMaster()) {
+    B3PhysicsTableCache::Instance()->BeginOfRun();
+    B3RandomStreams::Instance()->BeginOfRun();
+    B3SinogramOutput::Instance()->BeginOfRun();
+    B3BeamScan::Instance()->BeginOfRun(run);
+    B3PhaseSpace::Instance()->BeginOfRun(run);
+    B3PrimaryLibrary::Instance()->BeginOfRun();
+    B3Batching::Instance()->BeginOfRun();
+    B3ThreadPlacement::Instance()->BeginOfRun();
+  }
+  B3ThreadPlacement::Instance()->BeginOfThreadRun();
+  fTimer.Start();
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -113,6 +142,27 @@ void B3RunAction::EndOfRunAction(const G4Run* run)
   //retrieve the number of events produced in the run
   G4int nofEvents = run->GetNumberOfEvent();
 
+  //throughput of the thread, reported per NUMA node by the master
+  fTimer.Stop();
+  if (!IsMaster()) B3ThreadPlacement::Instance()->AddWorkerRun(nofEvents, fTimer.GetRealElapsed());
+
+  //the next run continues the sequence of per-event random streams
+  if (IsMaster()) B3RandomStreams::Instance()->EndOfRun(nofEvents);
+
+  //close the event, list-mode and phase-space files of this thread; the
+  //master writes the sinogram, the response matrix and the dose map, then
+  //checkpoints the shard or records the sweep point
+  B3EventOutput::Instance()->EndOfRun();
+  B3ListModeOutput::Instance()->EndOfRun();
+  B3PhaseSpace::Instance()->EndOfRun();
+  if (IsMaster()) {
+    B3SinogramOutput::Instance()->EndOfRun(static_cast<const B3Run*>(run)->GetSinogram());
+    B3BeamScan::Instance()->EndOfRun(static_cast<const B3Run*>(run)->GetResponse());
+    B3DoseOutput::Instance()->EndOfRun(static_cast<const B3Run*>(run)->GetDose());
+    B3ShardManager::Instance()->EndOfRun(static_cast<const B3Run*>(run));
+    B3Sweep::Instance()->EndOfRun(static_cast<const B3Run*>(run));
+  }
+
   //do nothing, if no events were processed
   if (nofEvents == 0) return;
   
@@ -162,6 +212,27 @@ void B3RunAction::EndOfRunAction(const G4Run* run)
      << " \n The run was " << nofEvents << " "<< partName;
   } 
 
+  if (IsMaster()) {
+    B3Trigger::Instance()->Print(b3Run->GetTriggerCounts(), b3Run->GetNbPrescaled());
+    B3Biasing::Instance()->Print(b3Run->GetTally(), b3Run->GetWeightedTally());
+    B3ThreadPlacement::Instance()->EndOfRun();
+    if (b3Run->GetDose().IsInitialized()) {
+      G4cout
+        << "\n Total dose in patient : " << G4BestUnit(b3Run->GetDose().TotalDose()*gray, "Dose")
+        << G4endl;
+    }
+  }
+
+  //photons of this thread transported by the Woodcock tracking
+  const B3WoodcockModel::Statistics& woodcock = B3WoodcockModel::GetStatistics();
+  if (woodcock.nPhotons > 0) {
+    G4cout
+      << "\n Woodcock tracking: " << woodcock.nPhotons << " photons, "
+      << woodcock.nReal << " real and " << woodcock.nVirtual << " virtual interactions"
+      << G4endl;
+    B3WoodcockModel::ResetStatistics();
+  }
+
   //save histograms
   G4AnalysisManager* man = G4AnalysisManager::Instance();
   man->Write();
@@ -0,0 +1,474 @@
+/// \file B3ShardManager.cc
+/// \brief Implementation of the B3ShardManager class
+
+#include "B3ShardManager.hh"
+#include "B3EventOutput.hh"
+#include "B3RandomStreams.hh"
+#include "B3Run.hh"
+#include "B3ThreadPlacement.hh"
+
+#include "G4RunManager.hh"
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
+#include "G4GenericMessenger.hh"
+#include "G4AutoLock.hh"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  G4Mutex shardMutex = G4MUTEX_INITIALIZER;
+
+  // Copy through a temporary file renamed at the end, as the snapshots
+  G4bool CopyFile(const G4String& from, const G4String& to)
+  {
+    std::ifstream input(from.c_str(), std::ios::binary);
+    if (!input) return false;
+    G4String tmpName = to + ".tmp";
+    std::ofstream output(tmpName.c_str(), std::ios::binary);
+    if (input.peek() != std::ifstream::traits_type::eof()) output << input.rdbuf();
+    output.close();
+    if (!output || std::rename(tmpName.c_str(), to.c_str()) != 0) {
+      std::remove(tmpName.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  // Copy of an accumulated output at the checkpoint of the event: a copy
+  // made for a checkpoint that was not written does not replace the one of
+  // the last checkpoint
+  G4String CopyName(const G4String& fileName, uint64_t event)
+  {
+    std::ostringstream name;
+    name << fileName << "." << event << ".ckpt";
+    return name.str();
+  }
+}
+
+B3ShardManager* B3ShardManager::fgInstance = 0;
+G4String B3ShardManager::fgOutputTag;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ShardManager* B3ShardManager::Instance()
+{
+  if (!fgInstance) fgInstance = new B3ShardManager;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ShardManager::B3ShardManager()
+ : fMessenger(0),
+   fIndex(0),
+   fCount(1),
+   fDirectory("."),
+   fCheckpointEvery(100000),
+   fNbProcesses(1),
+   fProcess(-1),
+   fActive(false)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ShardManager::~B3ShardManager()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3ShardManager::ShardName() const
+{
+  std::ostringstream name;
+  name << "shard" << fIndex;
+  if (fProcess >= 0) name << "_p" << fProcess;
+  return name.str();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4String B3ShardManager::ShardBase() const
+{
+  return fDirectory + "/" + ShardName();
+}
+
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ShardManager::Run(G4long nofEvents)
+{
+  if (fIndex < 0 || fIndex >= fCount || nofEvents <= 0 || fCheckpointEvery <= 0) {
+    G4ExceptionDescription msg;
+    msg << "Invalid shard " << fIndex << " of " << fCount << " for "
+        << nofEvents << " events, checkpoint every " << fCheckpointEvery;
+    G4Exception("B3ShardManager::Run()", "B3Shard001", JustWarning, msg);
+    return;
+  }
+  mkdir(fDirectory.c_str(), 0755);
+
+  if (fNbProcesses > 1 && CanFork()) ForkProcesses(nofEvents);
+  else ProcessShard(nofEvents);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ShardManager::ProcessShard(G4long nofEvents)
+{
+  // Event range of the shard, or of the part of a forked process: the
+  // shard i of n is the parts i*m ... i*m + m-1 of n*m
+  uint64_t part = fIndex, nbParts = fCount;
+  if (fProcess >= 0) {
+    part = uint64_t(fIndex)*fNbProcesses + fProcess;
+    nbParts = uint64_t(fCount)*fNbProcesses;
+  }
+  fCheckpoint = B3Snapshot();
+  fCheckpoint.shardIndex = uint32_t(part);
+  fCheckpoint.shardCount = uint32_t(nbParts);
+  fCheckpoint.firstEvent = uint64_t(nofEvents)*part/nbParts;
+  fCheckpoint.endEvent   = uint64_t(nofEvents)*(part+1)/nbParts;
+  fCheckpoint.nextEvent  = fCheckpoint.firstEvent;
+
+  fOutputs.clear();
+  G4bool resumed = Resume();
+  RestoreOutputs();
+
+  G4cout << "\n Shard " << fIndex << " of " << fCount;
+  if (fProcess >= 0) G4cout << ", process " << fProcess << " of " << fNbProcesses;
+  G4cout << ": events [" << fCheckpoint.firstEvent << ", " << fCheckpoint.endEvent << ")";
+  if (resumed) G4cout << ", resumed at event " << fCheckpoint.nextEvent;
+  G4cout << G4endl;
+
+  B3EventOutput* output = B3EventOutput::Instance();
+  G4String analysisFileName = output->GetAnalysisFileName();
+  G4String eventFileBase = output->GetEventFileBase();
+  output->SetEventFileBase(ShardBase());
+  output->SetAppend(true);
+
+  fgOutputTag = "_" + ShardName();
+  fActive = true;
+  while (fCheckpoint.nextEvent < fCheckpoint.endEvent) {
+    uint64_t next = fCheckpoint.nextEvent;
+    uint64_t nofRunEvents = fCheckpoint.endEvent - next;
+    if (nofRunEvents > uint64_t(fCheckpointEvery)) nofRunEvents = fCheckpointEvery;
+
+    std::ostringstream runFileName;
+    runFileName << ShardBase() << "_" << next;
+    output->SetAnalysisFileName(runFileName.str());
+    B3RandomStreams::Instance()->SetEventOffset(G4long(next));
+
+    G4RunManager::GetRunManager()->BeamOn(G4int(nofRunEvents));
+
+    if (fCheckpoint.nextEvent == next) {
+      G4Exception("B3ShardManager::Run()", "B3Shard002", JustWarning,
+                  "Run not completed: the shard stops at the last checkpoint.");
+      break;
+    }
+  }
+  fActive = false;
+  fgOutputTag = "";
+  fRestored.clear();
+
+  output->SetAnalysisFileName(analysisFileName);
+  output->SetEventFileBase(eventFileBase);
+  output->SetAppend(false);
+
+  if (fCheckpoint.nextEvent == fCheckpoint.endEvent) {
+    fCheckpoint.Write(ShardBase() + ".b3s");
+    G4cout << " Shard " << fIndex << " complete: " << ShardBase() << ".b3s" << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3ShardManager::CanFork() const
+{
+  if (fProcess >= 0) return false;
+#ifdef G4MULTITHREADED
+  // a forked process has only the thread that forked it: the worker threads
+  // of the job, started with the kernel, would be missing
+  if (dynamic_cast<G4MTRunManager*>(G4RunManager::GetRunManager())) {
+    G4Exception("B3ShardManager::Run()", "B3Shard006", JustWarning,
+                "The kernel is multi-threaded: the shard is processed by this "
+                "job, without forking (start the job with exampleB3 -p).");
+    return false;
+  }
+#endif
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ShardManager::ForkProcesses(G4long nofEvents)
+{
+  // A run of no event builds the physics tables of the sequential kernel:
+  // the processes share them with the job
+  G4RunManager::GetRunManager()->BeamOn(0);
+
+  G4cout << "\n Shard " << fIndex << " of " << fCount << ": " << fNbProcesses
+         << " processes" << G4endl;
+  std::cout.flush();
+  std::cerr.flush();
+
+  std::vector<pid_t> processes;
+  for (G4int p = 0; p < fNbProcesses; p++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      // the process stops at the end of its part, without returning to the
+      // macro of the job
+      fProcess = p;
+      B3ThreadPlacement::Instance()->SetFirstThread(p);
+      ProcessShard(nofEvents);
+      G4bool complete = (fCheckpoint.nextEvent == fCheckpoint.endEvent);
+      std::cout.flush();
+      std::cerr.flush();
+      _exit(complete ? 0 : 1);
+    }
+    if (pid < 0) {
+      G4ExceptionDescription msg;
+      msg << "Cannot fork the process " << p << " of shard " << fIndex;
+      G4Exception("B3ShardManager::ForkProcesses()", "B3Shard007", JustWarning, msg);
+      break;
+    }
+    processes.push_back(pid);
+  }
+
+  G4int nbFailed = fNbProcesses - G4int(processes.size());
+  for (size_t p = 0; p < processes.size(); p++) {
+    int status = 0;
+    if (waitpid(processes[p], &status, 0) != processes[p]
+        || !WIFEXITED(status) || WEXITSTATUS(status) != 0) nbFailed++;
+  }
+  // the next runs of the job follow the events of the shard, as after a
+  // shard processed in the job
+  B3RandomStreams::Instance()->SetEventOffset(G4long(uint64_t(nofEvents)*(fIndex+1)/fCount));
+  if (nbFailed > 0) {
+    G4ExceptionDescription msg;
+    msg << nbFailed << " of the " << fNbProcesses << " processes of shard " << fIndex
+        << " did not complete: run the macro again to resume them.";
+    G4Exception("B3ShardManager::ForkProcesses()", "B3Shard008", JustWarning, msg);
+    return;
+  }
+
+  // Tally of the shard, from the snapshots of the processes, which are
+  // then removed: mergeB3 adds the shards of the run
+  std::vector<G4String> fileNames;
+  B3Snapshot shard;
+  for (G4int p = 0; p < fNbProcesses; p++) {
+    fProcess = p;
+    fileNames.push_back(ShardBase() + ".b3s");
+    fProcess = -1;
+    const G4String& fileName = fileNames.back();
+    B3Snapshot snapshot;
+    if (!snapshot.Read(fileName)) {
+      G4ExceptionDescription msg;
+      msg << "Cannot read the snapshot " << fileName;
+      G4Exception("B3ShardManager::ForkProcesses()", "B3Shard009", JustWarning, msg);
+      return;
+    }
+    if (p == 0) shard = snapshot;
+    else shard.Add(snapshot);
+  }
+  shard.shardIndex = fIndex;
+  shard.shardCount = fCount;
+  if (!shard.Write(ShardBase() + ".b3s")) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the snapshot " << ShardBase() << ".b3s";
+    G4Exception("B3ShardManager::ForkProcesses()", "B3Shard010", JustWarning, msg);
+    return;
+  }
+  for (size_t p = 0; p < fileNames.size(); p++) std::remove(fileNames[p].c_str());
+  G4cout << "\n Shard " << fIndex << " complete: " << ShardBase() << ".b3s, "
+         << shard.tally.nEvents << " events in " << fNbProcesses << " processes" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3ShardManager::Resume()
+{
+  B3Snapshot checkpoint;
+  if (!checkpoint.Read(ShardBase() + ".ckpt")) return false;
+
+  if (checkpoint.shardIndex != fCheckpoint.shardIndex
+      || checkpoint.shardCount != fCheckpoint.shardCount
+      || checkpoint.firstEvent != fCheckpoint.firstEvent
+      || checkpoint.endEvent != fCheckpoint.endEvent) {
+    G4ExceptionDescription msg;
+    msg << "The checkpoint " << ShardBase() << ".ckpt belongs to another "
+        << "splitting of the run: remove it to start the shard again.";
+    G4Exception("B3ShardManager::Resume()", "B3Shard003", FatalException, msg);
+    return false;
+  }
+  fCheckpoint = checkpoint;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ShardManager::RestoreOutputs()
+{
+  // Bring the event files back to their state at the checkpoint: what was
+  // written after it (or by a previous attempt) is discarded
+  std::set<G4String> eventFiles;
+  std::vector<B3OutputOffset> files = B3EventOutput::ListEventFiles(ShardBase());
+  for (size_t i = 0; i < files.size(); i++) {
+    uint64_t size = 0;
+    for (size_t j = 0; j < fCheckpoint.outputs.size(); j++) {
+      if (fCheckpoint.outputs[j].name == files[i].name) size = fCheckpoint.outputs[j].size;
+    }
+    if (size == 0) std::remove(files[i].name.c_str());
+    else if (size != files[i].size) truncate(files[i].name.c_str(), off_t(size));
+    eventFiles.insert(files[i].name);
+  }
+
+  // The other outputs are copied back, or truncated; the files of the
+  // shard not in the checkpoint are replaced when they are written again
+  fRestored.clear();
+  for (size_t j = 0; j < fCheckpoint.outputs.size(); j++) {
+    const B3OutputOffset& checkpointed = fCheckpoint.outputs[j];
+    if (eventFiles.count(checkpointed.name)) continue;
+    G4String copyName = CopyName(checkpointed.name, fCheckpoint.nextEvent);
+    struct stat info;
+    G4bool restored = (stat(copyName.c_str(), &info) == 0)
+      ? CopyFile(copyName, checkpointed.name)
+      : (stat(checkpointed.name.c_str(), &info) == 0
+         && uint64_t(info.st_size) >= checkpointed.size
+         && truncate(checkpointed.name.c_str(), off_t(checkpointed.size)) == 0);
+    if (!restored) {
+      G4ExceptionDescription msg;
+      msg << "Cannot restore " << checkpointed.name << " at the checkpoint "
+          << ShardBase() << ".ckpt: remove the checkpoint to start the shard again.";
+      G4Exception("B3ShardManager::RestoreOutputs()", "B3Shard011", FatalException, msg);
+      continue;
+    }
+    fRestored.insert(checkpointed.name);
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ShardManager::AddOutput(const G4String& fileName, G4bool accumulated)
+{
+  if (!fActive) return;
+  G4AutoLock lock(&shardMutex);
+  fOutputs[fileName] = accumulated;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ShardManager::EndOfRun(const B3Run* run)
+{
+  if (!fActive) return;
+
+  // Only complete runs are checkpointed: with several threads the events
+  // done in an aborted run are not a contiguous range
+  if (run->GetNumberOfEvent() != run->GetNumberOfEventToBeProcessed()) return;
+
+  G4long seed = B3RandomStreams::Instance()->GetRunSeed();
+  if (fCheckpoint.nextEvent > fCheckpoint.firstEvent && fCheckpoint.seed != uint64_t(seed)) {
+    G4ExceptionDescription msg;
+    msg << "Shard " << fIndex << " was started with seed " << fCheckpoint.seed
+        << " and is continued with seed " << seed;
+    G4Exception("B3ShardManager::EndOfRun()", "B3Shard004", FatalException, msg);
+  }
+  uint64_t previousEvent = fCheckpoint.nextEvent;
+  fCheckpoint.seed = uint64_t(seed);
+  fCheckpoint.nextEvent += run->GetNumberOfEvent();
+  fCheckpoint.tally.Add(run->GetTally());
+  fCheckpoint.outputs = B3EventOutput::ListEventFiles(ShardBase());
+
+  // The other outputs of the shard, closed or written by now
+  std::map<G4String, G4bool>::const_iterator output;
+  for (output = fOutputs.begin(); output != fOutputs.end(); ++output) {
+    struct stat info;
+    if (stat(output->first.c_str(), &info) != 0) continue;
+    if (output->second
+        && !CopyFile(output->first, CopyName(output->first, fCheckpoint.nextEvent))) {
+      G4ExceptionDescription msg;
+      msg << "Cannot copy " << output->first << " for the checkpoint: the shard "
+          << "would resume at the previous one";
+      G4Exception("B3ShardManager::EndOfRun()", "B3Shard012", JustWarning, msg);
+      return;
+    }
+    B3OutputOffset checkpointed;
+    checkpointed.name = output->first;
+    checkpointed.size = uint64_t(info.st_size);
+    fCheckpoint.outputs.push_back(checkpointed);
+  }
+
+  if (!fCheckpoint.Write(ShardBase() + ".ckpt")) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the checkpoint " << ShardBase() << ".ckpt";
+    G4Exception("B3ShardManager::EndOfRun()", "B3Shard005", JustWarning, msg);
+    return;
+  }
+  // the copies of the previous checkpoint are not needed any more
+  for (output = fOutputs.begin(); output != fOutputs.end(); ++output) {
+    if (output->second) std::remove(CopyName(output->first, previousEvent).c_str());
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ShardManager::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/shard/",
+                                      "Sharded and resumable runs");
+
+  G4GenericMessenger::Command& indexCmd
+    = fMessenger->DeclareProperty("index", fIndex, "Index of this shard.");
+  indexCmd.SetParameterName("index", false);
+  indexCmd.SetRange("index>=0");
+  indexCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& countCmd
+    = fMessenger->DeclareProperty("count", fCount, "Number of shards of the run.");
+  countCmd.SetParameterName("count", false);
+  countCmd.SetRange("count>0");
+  countCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& dirCmd
+    = fMessenger->DeclareProperty("dir", fDirectory,
+                                  "Directory of the shard outputs and checkpoints.");
+  dirCmd.SetParameterName("dir", false);
+  dirCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& everyCmd
+    = fMessenger->DeclareProperty("checkpointEvery", fCheckpointEvery,
+                                  "Number of events between checkpoints.");
+  everyCmd.SetParameterName("events", false);
+  everyCmd.SetRange("events>0");
+  everyCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& processesCmd
+    = fMessenger->DeclareProperty("processes", fNbProcesses,
+                                  "Number of processes forked to process the shard.");
+  processesCmd.SetParameterName("processes", false);
+  processesCmd.SetRange("processes>0");
+  processesCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& runCmd
+    = fMessenger->DeclareMethod("run", &B3ShardManager::Run,
+                                "Process (or resume) this shard of a run of "
+                                "the given number of events.");
+  runCmd.SetParameterName("events", false);
+  runCmd.SetRange("events>0");
+  runCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,89 @@
+/// \file B3Siddon.cc
+/// \brief Implementation of the Siddon ray tracer
+
+#include "B3Siddon.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+size_t B3Siddon::Trace(const B3ImageGrid& grid, const double start[3], const double end[3],
+                       std::vector<uint32_t>& voxels, std::vector<float>& lengths,
+                       double* entry)
+{
+  voxels.clear();
+  lengths.clear();
+
+  const double infinity = std::numeric_limits<double>::infinity();
+  double delta[3];
+  double alphaMin = 0., alphaMax = 1.;
+  for (int a = 0; a < 3; a++) {
+    delta[a] = end[a] - start[a];
+    double lower = grid.Lower(a);
+    double upper = lower + grid.n[a]*grid.voxelSize[a];
+    if (delta[a] == 0.) {
+      if (start[a] < lower || start[a] >= upper) return 0;
+      continue;
+    }
+    double alpha0 = (lower - start[a])/delta[a];
+    double alpha1 = (upper - start[a])/delta[a];
+    if (alpha0 > alpha1) std::swap(alpha0, alpha1);
+    if (alpha0 > alphaMin) alphaMin = alpha0;
+    if (alpha1 < alphaMax) alphaMax = alpha1;
+  }
+  if (alphaMin >= alphaMax) return 0;
+
+  double length = std::sqrt(delta[0]*delta[0] + delta[1]*delta[1] + delta[2]*delta[2]);
+  if (entry) *entry = alphaMin*length;
+
+  // voxel of the entry point and next crossing along each axis
+  int64_t index[3], step[3];
+  double alphaNext[3], alphaStep[3];
+  double alphaMid = 0.5*(alphaMin + alphaMax);
+  for (int a = 0; a < 3; a++) {
+    double lower = grid.Lower(a);
+    double size = grid.voxelSize[a];
+    // the entry voxel is taken a little inside the segment, to be robust
+    // against the rounding at the image boundary
+    double inside = start[a] + (alphaMin + 1.e-9*(alphaMid - alphaMin))*delta[a];
+    index[a] = int64_t(std::floor((inside - lower)/size));
+    if (index[a] < 0) index[a] = 0;
+    if (index[a] >= int64_t(grid.n[a])) index[a] = grid.n[a] - 1;
+    if (delta[a] > 0.) {
+      step[a] = 1;
+      alphaNext[a] = (lower + (index[a]+1)*size - start[a])/delta[a];
+      alphaStep[a] = size/delta[a];
+    }
+    else if (delta[a] < 0.) {
+      step[a] = -1;
+      alphaNext[a] = (lower + index[a]*size - start[a])/delta[a];
+      alphaStep[a] = -size/delta[a];
+    }
+    else {
+      step[a] = 0;
+      alphaNext[a] = infinity;
+      alphaStep[a] = infinity;
+    }
+  }
+
+  double alpha = alphaMin;
+  while (alpha < alphaMax) {
+    int a = (alphaNext[0] < alphaNext[1]) ? 0 : 1;
+    if (alphaNext[2] < alphaNext[a]) a = 2;
+    double next = (alphaNext[a] < alphaMax) ? alphaNext[a] : alphaMax;
+    if (next > alpha) {
+      voxels.push_back(uint32_t(grid.Index(uint32_t(index[0]), uint32_t(index[1]),
+                                           uint32_t(index[2]))));
+      lengths.push_back(float((next - alpha)*length));
+    }
+    alpha = next;
+    index[a] += step[a];
+    alphaNext[a] += alphaStep[a];
+    if (index[a] < 0 || index[a] >= int64_t(grid.n[a])) break;
+  }
+  return voxels.size();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
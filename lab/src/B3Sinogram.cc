@@ -0,0 +1,230 @@
+/// \file B3Sinogram.cc
+/// \brief Implementation of the B3Sinogram structure
+
+#include "B3Sinogram.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  const uint32_t kSinogramMagic   = 0x47533342;   // "B3SG"
+  const uint32_t kSinogramVersion = 2;   // 2: crystal table
+  /// Crystals closer than this along z (mm) are in the same ring
+  const float kRingTolerance = 1.e-3f;
+
+  template <class T>
+  bool Put(std::FILE* file, const T& value)
+  { return std::fwrite(&value, sizeof(T), 1, file) == 1; }
+
+  template <class T>
+  bool Get(std::FILE* file, T& value)
+  { return std::fread(&value, sizeof(T), 1, file) == 1; }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Sinogram::B3Sinogram()
+ : nRadial(0), nAngles(0), radialBin(0.f), maxRingDifference(-1),
+   nCoincidences(0), nOutside(0)
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Sinogram::Init(const std::vector<B3ListModeFormat::CrystalEntry>& scanner,
+                      uint32_t radialBins, uint32_t angleBins, float binSize,
+                      int32_t ringDifference)
+{
+  crystals = scanner;
+  nRadial = radialBins;
+  nAngles = angleBins;
+  radialBin = binSize;
+  maxRingDifference = ringDifference;
+
+  ringZ.clear();
+  for (size_t i = 0; i < crystals.size(); i++) ringZ.push_back(crystals[i].center[2]);
+  std::sort(ringZ.begin(), ringZ.end());
+  std::vector<float> rings;
+  for (size_t i = 0; i < ringZ.size(); i++) {
+    if (rings.empty() || ringZ[i] - rings.back() > kRingTolerance) rings.push_back(ringZ[i]);
+  }
+  ringZ.swap(rings);
+
+  counts.assign(NbBins(), 0);
+  nCoincidences = 0;
+  nOutside = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Sinogram::Clear()
+{
+  std::fill(counts.begin(), counts.end(), 0);
+  nCoincidences = 0;
+  nOutside = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int64_t B3Sinogram::Bin(const B3ListModeFormat::CrystalEntry& a,
+                        const B3ListModeFormat::CrystalEntry& b) const
+{
+  double dx = double(b.center[0]) - a.center[0];
+  double dy = double(b.center[1]) - a.center[1];
+  if (dx == 0. && dy == 0.) return -1;
+
+  // fold the direction into [0, pi): the LOR then starts from the first
+  // crystal of the Michelogram plane
+  const B3ListModeFormat::CrystalEntry* start = &a;
+  const B3ListModeFormat::CrystalEntry* end = &b;
+  double phi = std::atan2(dy, dx);
+  if (phi < 0.) {
+    phi += M_PI;
+    start = &b;
+    end = &a;
+  }
+  if (phi >= M_PI) {
+    // horizontal LOR towards -x: the same order as the other directions
+    phi = 0.;
+    start = &b;
+    end = &a;
+  }
+
+  double s = -start->center[0]*std::sin(phi) + start->center[1]*std::cos(phi);
+  int64_t radial = int64_t(std::floor(s/radialBin + 0.5*nRadial));
+  int64_t angle = int64_t(phi/M_PI*nAngles);
+  if (radial < 0 || radial >= int64_t(nRadial) || angle >= int64_t(nAngles)) return -1;
+
+  int64_t r1 = std::lower_bound(ringZ.begin(), ringZ.end(), start->center[2] - kRingTolerance)
+             - ringZ.begin();
+  int64_t r2 = std::lower_bound(ringZ.begin(), ringZ.end(), end->center[2] - kRingTolerance)
+             - ringZ.begin();
+  if (r1 >= int64_t(ringZ.size()) || r2 >= int64_t(ringZ.size())) return -1;
+  if (maxRingDifference >= 0 && std::abs(r1 - r2) > maxRingDifference) return -1;
+
+  return int64_t(Index(uint32_t(r1*ringZ.size() + r2), uint32_t(angle), uint32_t(radial)));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Sinogram::BuildLookup(const std::vector<B3ListModeFormat::CrystalEntry>& table,
+                             std::vector<int64_t>& lookup) const
+{
+  uint32_t n = uint32_t(table.size());
+  lookup.assign(n > 1 ? B3ListModeFormat::NbPairs(n) : 0, -1);
+  for (uint32_t b = 1; b < n; b++) {
+    for (uint32_t a = 0; a < b; a++) {
+      lookup[B3ListModeFormat::PairId(a, b)] = Bin(table[a], table[b]);
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Sinogram::BinLine(size_t bin, double radius, double start[3], double end[3]) const
+{
+  size_t radial = bin % nRadial;
+  size_t angle = (bin / nRadial) % nAngles;
+  size_t plane = bin / (size_t(nRadial)*nAngles);
+  size_t nRings = ringZ.size();
+
+  double phi = (angle + 0.5)*M_PI/nAngles;
+  double s = (radial + 0.5 - 0.5*nRadial)*radialBin;
+  double t = (radius > std::fabs(s)) ? std::sqrt(radius*radius - s*s) : 0.;
+  double cx = -s*std::sin(phi), cy = s*std::cos(phi);
+  start[0] = cx - t*std::cos(phi);
+  start[1] = cy - t*std::sin(phi);
+  start[2] = ringZ[plane / nRings];
+  end[0] = cx + t*std::cos(phi);
+  end[1] = cy + t*std::sin(phi);
+  end[2] = ringZ[plane % nRings];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3Sinogram::Add(const B3Sinogram& other)
+{
+  if (other.nRadial != nRadial || other.nAngles != nAngles
+      || other.radialBin != radialBin || other.maxRingDifference != maxRingDifference
+      || other.ringZ != ringZ || other.counts.size() != counts.size()) return false;
+
+  // plain loop over contiguous arrays: vectorised by the compiler
+  uint32_t* sum = counts.empty() ? 0 : &counts[0];
+  const uint32_t* added = other.counts.empty() ? 0 : &other.counts[0];
+  size_t n = counts.size();
+  for (size_t i = 0; i < n; i++) sum[i] += added[i];
+
+  nCoincidences += other.nCoincidences;
+  nOutside += other.nOutside;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3Sinogram::Write(const std::string& fileName) const
+{
+  std::string tmpName = fileName + ".tmp";
+  std::FILE* file = std::fopen(tmpName.c_str(), "wb");
+  if (!file) return false;
+
+  uint32_t nRings = uint32_t(ringZ.size());
+  bool ok = Put(file, kSinogramMagic) && Put(file, kSinogramVersion)
+         && Put(file, nRadial) && Put(file, nAngles) && Put(file, nRings)
+         && Put(file, radialBin) && Put(file, maxRingDifference)
+         && Put(file, nCoincidences) && Put(file, nOutside);
+  ok = ok && (nRings == 0 || std::fwrite(&ringZ[0], sizeof(float), nRings, file) == nRings);
+  uint32_t nCrystals = uint32_t(crystals.size());
+  ok = ok && Put(file, nCrystals)
+     && (nCrystals == 0 || std::fwrite(&crystals[0], sizeof(crystals[0]), nCrystals, file) == nCrystals);
+  ok = ok && (counts.empty()
+              || std::fwrite(&counts[0], sizeof(uint32_t), counts.size(), file) == counts.size());
+
+  ok = (std::fflush(file) == 0) && ok;
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok) {
+    std::remove(tmpName.c_str());
+    return false;
+  }
+  return std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3Sinogram::Read(const std::string& fileName)
+{
+  std::FILE* file = std::fopen(fileName.c_str(), "rb");
+  if (!file) return false;
+
+  uint32_t magic = 0, version = 0, nRings = 0, nCrystals = 0;
+  bool ok = Get(file, magic) && Get(file, version)
+         && magic == kSinogramMagic && version >= 1 && version <= kSinogramVersion
+         && Get(file, nRadial) && Get(file, nAngles) && Get(file, nRings)
+         && Get(file, radialBin) && Get(file, maxRingDifference)
+         && Get(file, nCoincidences) && Get(file, nOutside)
+         && nRings <= B3ListModeFormat::kMaxCrystals;
+  if (ok) {
+    ringZ.resize(nRings);
+    ok = (nRings == 0 || std::fread(&ringZ[0], sizeof(float), nRings, file) == nRings);
+  }
+  crystals.clear();
+  if (ok && version >= 2) {
+    ok = Get(file, nCrystals) && nCrystals <= B3ListModeFormat::kMaxCrystals;
+    if (ok) {
+      crystals.resize(nCrystals);
+      ok = (nCrystals == 0
+            || std::fread(&crystals[0], sizeof(crystals[0]), nCrystals, file) == nCrystals);
+    }
+  }
+  if (ok) {
+    counts.resize(NbBins());
+    ok = (counts.empty()
+          || std::fread(&counts[0], sizeof(uint32_t), counts.size(), file) == counts.size());
+  }
+  std::fclose(file);
+  return ok;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,149 @@
+/// \file B3SinogramOutput.cc
+/// \brief Implementation of the B3SinogramOutput class
+
+#include "B3SinogramOutput.hh"
+#include "B3ListModeOutput.hh"
+#include "B3ShardManager.hh"
+#include "B3Sweep.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3SinogramOutput* B3SinogramOutput::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3SinogramOutput* B3SinogramOutput::Instance()
+{
+  if (!fgInstance) fgInstance = new B3SinogramOutput;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3SinogramOutput::B3SinogramOutput()
+ : fMessenger(0),
+   fFileBase("none"),
+   fNbAngles(96),
+   fNbRadial(128),
+   fRadialBin(1*mm),
+   fMaxRingDifference(-1)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3SinogramOutput::~B3SinogramOutput()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3SinogramOutput::BeginOfRun()
+{
+  if (!IsEnabled()) return;
+
+  const std::vector<B3ListModeFormat::CrystalEntry>& crystals
+    = B3ListModeOutput::Instance()->GetCrystals();
+  if (crystals.size() > B3ListModeFormat::kMaxCrystals) {
+    G4ExceptionDescription msg;
+    msg << crystals.size() << " crystals: the pairs of at most "
+        << B3ListModeFormat::kMaxCrystals << " can be binned";
+    G4Exception("B3SinogramOutput::BeginOfRun()", "B3Sinogram001",
+                FatalException, msg);
+    return;
+  }
+  fEmpty.Init(crystals, fNbRadial, fNbAngles, float(fRadialBin/mm), fMaxRingDifference);
+  fEmpty.BuildLookup(crystals, fLookup);
+
+  G4cout
+    << "\n Sinogram: " << fEmpty.ringZ.size() << " rings, " << fEmpty.NbPlanes()
+    << " planes x " << fNbAngles << " angles x " << fNbRadial << " radial bins ("
+    << fEmpty.NbBins()*sizeof(uint32_t)/1.e6 << " MB per thread)"
+    << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3SinogramOutput::EndOfRun(const B3Sinogram& sinogram)
+{
+  if (!IsEnabled()) return;
+
+  B3ShardManager* shards = B3ShardManager::Instance();
+  G4String fileName
+    = fFileBase + B3Sweep::GetPointTag() + B3ShardManager::GetOutputTag() + ".b3sg";
+  B3Sinogram total = sinogram.IsInitialized() ? sinogram : fEmpty;
+
+  // the runs after the first one of the job, or after the checkpoint a
+  // shard is resumed from, are added to the file
+  if (!fWrittenFiles.insert(fileName).second || shards->IsRestored(fileName)) {
+    B3Sinogram previous;
+    if (!previous.Read(fileName) || !total.Add(previous)) {
+      G4ExceptionDescription msg;
+      msg << "The sinogram of the previous runs in " << fileName
+          << " cannot be read or has another binning: it is replaced";
+      G4Exception("B3SinogramOutput::EndOfRun()", "B3Sinogram002", JustWarning, msg);
+    }
+  }
+
+  if (!total.Write(fileName)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the sinogram " << fileName;
+    G4Exception("B3SinogramOutput::EndOfRun()", "B3Sinogram003", JustWarning, msg);
+    return;
+  }
+  shards->AddOutput(fileName, true);
+  G4cout
+    << "\n Sinogram: " << sinogram.nCoincidences << " coincidences binned, "
+    << sinogram.nOutside << " outside -> " << fileName
+    << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3SinogramOutput::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/sinogram/", "Sinogram accumulation");
+
+  G4GenericMessenger::Command& fileCmd
+    = fMessenger->DeclareProperty("file", fFileBase,
+                                  "Base name of the sinogram file (.b3sg); "
+                                  "\"none\" to switch it off.");
+  fileCmd.SetParameterName("base", false);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& anglesCmd
+    = fMessenger->DeclareProperty("nAngles", fNbAngles,
+                                  "Number of angular bins, over 180 degrees.");
+  anglesCmd.SetParameterName("n", false);
+  anglesCmd.SetRange("n>=1");
+  anglesCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& radialCmd
+    = fMessenger->DeclareProperty("nRadial", fNbRadial,
+                                  "Number of radial bins, centred on the axis.");
+  radialCmd.SetParameterName("n", false);
+  radialCmd.SetRange("n>=1");
+  radialCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& binCmd
+    = fMessenger->DeclarePropertyWithUnit("radialBin", "mm", fRadialBin,
+                                          "Width of the radial bins.");
+  binCmd.SetParameterName("width", false);
+  binCmd.SetRange("width>0");
+  binCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& ringCmd
+    = fMessenger->DeclareProperty("maxRingDifference", fMaxRingDifference,
+                                  "Largest ring difference binned, -1 for all.");
+  ringCmd.SetParameterName("rings", false);
+  ringCmd.SetRange("rings>=-1");
+  ringCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
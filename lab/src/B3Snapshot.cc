@@ -0,0 +1,104 @@
+/// \file B3Snapshot.cc
+/// \brief Implementation of the B3Snapshot structure
+
+#include "B3Snapshot.hh"
+
+#include <cstdio>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  const uint32_t kSnapshotMagic   = 0x4E533342;   // "B3SN"
+  const uint32_t kSnapshotVersion = 1;
+
+  template <class T>
+  bool Put(std::FILE* file, const T& value)
+  { return std::fwrite(&value, sizeof(T), 1, file) == 1; }
+
+  template <class T>
+  bool Get(std::FILE* file, T& value)
+  { return std::fread(&value, sizeof(T), 1, file) == 1; }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Snapshot::B3Snapshot()
+ : shardIndex(0), shardCount(1),
+   firstEvent(0), endEvent(0), nextEvent(0), seed(0)
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3Snapshot::Write(const std::string& fileName) const
+{
+  std::string tmpName = fileName + ".tmp";
+  std::FILE* file = std::fopen(tmpName.c_str(), "wb");
+  if (!file) return false;
+
+  bool ok = Put(file, kSnapshotMagic) && Put(file, kSnapshotVersion)
+         && Put(file, shardIndex) && Put(file, shardCount)
+         && Put(file, firstEvent) && Put(file, endEvent)
+         && Put(file, nextEvent)  && Put(file, seed)
+         && Put(file, tally);
+
+  uint32_t nOutputs = uint32_t(outputs.size());
+  ok = ok && Put(file, nOutputs);
+  for (uint32_t i = 0; ok && i < nOutputs; i++) {
+    uint32_t length = uint32_t(outputs[i].name.size());
+    ok = Put(file, length)
+      && std::fwrite(outputs[i].name.data(), 1, length, file) == length
+      && Put(file, outputs[i].size);
+  }
+
+  ok = (std::fflush(file) == 0) && ok;
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok) {
+    std::remove(tmpName.c_str());
+    return false;
+  }
+  return std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3Snapshot::Read(const std::string& fileName)
+{
+  std::FILE* file = std::fopen(fileName.c_str(), "rb");
+  if (!file) return false;
+
+  uint32_t magic = 0, version = 0, nOutputs = 0;
+  bool ok = Get(file, magic) && Get(file, version)
+         && magic == kSnapshotMagic && version == kSnapshotVersion
+         && Get(file, shardIndex) && Get(file, shardCount)
+         && Get(file, firstEvent) && Get(file, endEvent)
+         && Get(file, nextEvent)  && Get(file, seed)
+         && Get(file, tally)      && Get(file, nOutputs);
+
+  outputs.clear();
+  for (uint32_t i = 0; ok && i < nOutputs; i++) {
+    uint32_t length = 0;
+    ok = Get(file, length) && length < 4096;
+    if (!ok) break;
+    B3OutputOffset output;
+    output.name.resize(length);
+    ok = (length == 0 || std::fread(&output.name[0], 1, length, file) == length)
+      && Get(file, output.size);
+    outputs.push_back(output);
+  }
+  std::fclose(file);
+  return ok;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Snapshot::Add(const B3Snapshot& other)
+{
+  if (other.firstEvent < firstEvent) firstEvent = other.firstEvent;
+  if (other.endEvent > endEvent)     endEvent = other.endEvent;
+  if (other.nextEvent > nextEvent)   nextEvent = other.nextEvent;
+  tally.Add(other.tally);
+  outputs.insert(outputs.end(), other.outputs.begin(), other.outputs.end());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
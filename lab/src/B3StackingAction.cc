@@ -29,6 +29,7 @@
 /// \brief Implementation of the B3StackingAction class
 
 #include "B3StackingAction.hh"
+#include "B3PhaseSpace.hh"
 
 #include "G4Track.hh"
 #include "G4NeutrinoE.hh"
@@ -52,6 +53,12 @@ B3StackingAction::ClassifyNewTrack(const G4Track* track)
   if (track->GetDefinition() == G4NeutrinoE::NeutrinoE() && 
       track->GetParentID()>0) 
     return fKill;
+  //secondaries inside the phase-space surface, while it is recorded: the
+  //particles entering it are killed
+  B3PhaseSpace* phaseSpace = B3PhaseSpace::Instance();
+  if (phaseSpace->IsRecording() && track->GetParentID() > 0
+      && phaseSpace->IsInside(track->GetPosition()))
+    return fKill;
   //otherwise, return what Geant4 would have returned by itself
   else 
     return G4UserStackingAction::ClassifyNewTrack(track);
@@ -0,0 +1,174 @@
+/// \file B3Statistics.cc
+/// \brief Implementation of the B3Statistics namespace
+
+#include "B3Statistics.hh"
+
+#include <algorithm>
+#include <cmath>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  // Series representation of P(a,x), valid for x < a+1
+  G4double GammaPSeries(G4double a, G4double x)
+  {
+    G4double sum = 1./a;
+    G4double term = sum;
+    for (G4int n = 1; n < 1000; n++) {
+      term *= x/(a+n);
+      sum += term;
+      if (std::fabs(term) < std::fabs(sum)*1.e-15) break;
+    }
+    return sum*std::exp(-x + a*std::log(x) - std::lgamma(a));
+  }
+
+  // Continued fraction representation of Q(a,x), valid for x >= a+1
+  // (modified Lentz method)
+  G4double GammaQContinuedFraction(G4double a, G4double x)
+  {
+    const G4double tiny = 1.e-300;
+    G4double b = x + 1. - a;
+    G4double c = 1./tiny;
+    G4double d = 1./b;
+    G4double h = d;
+    for (G4int i = 1; i < 1000; i++) {
+      G4double an = -i*(i-a);
+      b += 2.;
+      d = an*d + b;
+      if (std::fabs(d) < tiny) d = tiny;
+      c = b + an/c;
+      if (std::fabs(c) < tiny) c = tiny;
+      d = 1./d;
+      G4double del = d*c;
+      h *= del;
+      if (std::fabs(del-1.) < 1.e-15) break;
+    }
+    return std::exp(-x + a*std::log(x) - std::lgamma(a))*h;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B3Statistics::GammaQ(G4double a, G4double x)
+{
+  if (x <= 0.) return 1.;
+  if (x < a+1.) return 1. - GammaPSeries(a, x);
+  return GammaQContinuedFraction(a, x);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B3Statistics::ChiSquareProb(G4double chi2, G4int ndf)
+{
+  if (ndf <= 0) return 1.;
+  return GammaQ(0.5*ndf, 0.5*chi2);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4double B3Statistics::KolmogorovProb(G4double lambda)
+{
+  if (lambda < 0.2) return 1.;
+  G4double sum = 0.;
+  G4double sign = 1.;
+  for (G4int j = 1; j <= 100; j++) {
+    G4double term = sign*std::exp(-2.*j*j*lambda*lambda);
+    sum += term;
+    if (std::fabs(term) < 1.e-12*std::fabs(sum)) break;
+    sign = -sign;
+  }
+  return std::min(1., std::max(0., 2.*sum));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Statistics::TestResult
+B3Statistics::ChiSquareTest(const std::vector<G4double>& counts1,
+                            const std::vector<G4double>& counts2)
+{
+  TestResult result = { 0., 0, 1. };
+
+  G4double sum1 = 0., sum2 = 0.;
+  size_t nbins = std::min(counts1.size(), counts2.size());
+  for (size_t i = 0; i < nbins; i++) { sum1 += counts1[i]; sum2 += counts2[i]; }
+  if (sum1 <= 0. || sum2 <= 0.) return result;
+
+  // Statistic for two histograms with different normalisation
+  // (see e.g. NIST Dataplot, "chi-square two sample")
+  G4double k1 = std::sqrt(sum2/sum1);
+  G4double k2 = std::sqrt(sum1/sum2);
+  for (size_t i = 0; i < nbins; i++) {
+    G4double n = counts1[i] + counts2[i];
+    if (n <= 0.) continue;
+    G4double diff = k1*counts1[i] - k2*counts2[i];
+    result.statistic += diff*diff/n;
+    result.ndf++;
+  }
+  // one constraint from the normalisation
+  result.ndf -= 1;
+  result.pValue = ChiSquareProb(result.statistic, result.ndf);
+  return result;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Statistics::TestResult
+B3Statistics::KolmogorovTest(std::vector<G4double>& sample1,
+                             std::vector<G4double>& sample2)
+{
+  TestResult result = { 0., 0, 1. };
+  size_t n1 = sample1.size(), n2 = sample2.size();
+  if (n1 == 0 || n2 == 0) return result;
+
+  std::sort(sample1.begin(), sample1.end());
+  std::sort(sample2.begin(), sample2.end());
+
+  // Walk both empirical distribution functions; ties are consumed
+  // together so that discrete values (e.g. zero energy) are handled
+  size_t i1 = 0, i2 = 0;
+  G4double dmax = 0.;
+  while (i1 < n1 && i2 < n2) {
+    G4double x = std::min(sample1[i1], sample2[i2]);
+    while (i1 < n1 && sample1[i1] <= x) i1++;
+    while (i2 < n2 && sample2[i2] <= x) i2++;
+    G4double d = std::fabs(G4double(i1)/n1 - G4double(i2)/n2);
+    if (d > dmax) dmax = d;
+  }
+
+  G4double ne = G4double(n1)*n2/(n1+n2);
+  G4double sqrtNe = std::sqrt(ne);
+  result.statistic = dmax;
+  result.pValue = KolmogorovProb((sqrtNe + 0.12 + 0.11/sqrtNe)*dmax);
+  return result;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Statistics::Efficiency(G4double k, G4double n,
+                              G4double& eff, G4double& error)
+{
+  if (n <= 0.) { eff = 0.; error = 0.; return; }
+  eff = k/n;
+  error = std::sqrt(eff*(1.-eff)/n);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Statistics::TestResult
+B3Statistics::EfficiencyTest(G4double k1, G4double n1,
+                             G4double k2, G4double n2)
+{
+  TestResult result = { 0., 0, 1. };
+  if (n1 <= 0. || n2 <= 0.) return result;
+
+  G4double p = (k1+k2)/(n1+n2);
+  G4double sigma = std::sqrt(p*(1.-p)*(1./n1 + 1./n2));
+  if (sigma <= 0.) return result;
+
+  result.statistic = (k1/n1 - k2/n2)/sigma;
+  result.pValue = std::erfc(std::fabs(result.statistic)/std::sqrt(2.));
+  return result;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,26 @@
+/// \file B3SteppingAction.cc
+/// \brief Implementation of the B3SteppingAction class
+
+#include "B3SteppingAction.hh"
+#include "B3PhaseSpace.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3SteppingAction::B3SteppingAction()
+ : G4UserSteppingAction(),
+   fPhaseSpace(B3PhaseSpace::Instance())
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3SteppingAction::~B3SteppingAction()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3SteppingAction::UserSteppingAction(const G4Step* step)
+{
+  if (fPhaseSpace->IsRecording()) fPhaseSpace->RecordStep(step);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,250 @@
+/// \file B3Sweep.cc
+/// \brief Implementation of the B3Sweep class
+
+#include "B3Sweep.hh"
+#include "B3DetectorConstruction.hh"
+#include "B3EventOutput.hh"
+#include "B3RandomStreams.hh"
+#include "B3Biasing.hh"
+#include "B3Run.hh"
+
+#include "G4RunManager.hh"
+#include "G4UImanager.hh"
+#include "G4GenericMessenger.hh"
+#include "G4Timer.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <fstream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Sweep* B3Sweep::fgInstance = 0;
+G4String B3Sweep::fgPointTag;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Sweep* B3Sweep::Instance()
+{
+  if (!fgInstance) fgInstance = new B3Sweep;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Sweep::B3Sweep()
+ : fMessenger(0),
+   fNbEvents(10000),
+   fDirectory("sweep"),
+   fActive(false)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Sweep::~B3Sweep()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Sweep::Run(G4String fileName)
+{
+  if (fActive) {
+    G4Exception("B3Sweep::Run()", "B3Sweep001", JustWarning,
+                "A sweep cannot be started by the commands of a sweep point.");
+    return;
+  }
+  std::vector<Point> points;
+  if (!ReadPoints(fileName, points)) return;
+
+  mkdir(fDirectory.c_str(), 0755);
+  G4String summaryName = fDirectory + "/sweep.txt";
+  std::ofstream summary(summaryName.c_str());
+  summary << "# tag events geometry seconds peak_events mean_edep_0..8_keV\n";
+
+  fActive = true;
+  size_t nbDone = 0;
+  for (size_t p = 0; p < points.size(); p++) {
+    if (RunPoint(points[p], summary)) nbDone++;
+    summary.flush();
+  }
+  fActive = false;
+
+  G4cout << "\n Sweep " << fileName << ": " << nbDone << " of " << points.size()
+         << " points done, results in " << summaryName << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3Sweep::ReadPoints(const G4String& fileName, std::vector<Point>& points) const
+{
+  std::ifstream file(fileName.c_str());
+  if (!file) {
+    G4ExceptionDescription msg;
+    msg << "Cannot open the sweep file " << fileName;
+    G4Exception("B3Sweep::ReadPoints()", "B3Sweep002", JustWarning, msg);
+    return false;
+  }
+  std::string line;
+  G4int lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    std::string::size_type start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') continue;
+    std::string::size_type end = line.find_last_not_of(" \t\r");
+    G4String text = line.substr(start, end + 1 - start);
+
+    if (text.compare(0, 6, "point ") == 0 || text == "point") {
+      Point point;
+      std::string::size_type tagStart = text.find_first_not_of(" \t", 5);
+      if (tagStart != std::string::npos) point.tag = text.substr(tagStart);
+      if (point.tag.empty() || point.tag.find_first_of(" \t/") != std::string::npos) {
+        G4ExceptionDescription msg;
+        msg << fileName << ":" << lineNumber << ": the tag of a point is one word";
+        G4Exception("B3Sweep::ReadPoints()", "B3Sweep002", JustWarning, msg);
+        return false;
+      }
+      points.push_back(point);
+    }
+    else if (points.empty()) {
+      G4ExceptionDescription msg;
+      msg << fileName << ":" << lineNumber << ": command before the first point";
+      G4Exception("B3Sweep::ReadPoints()", "B3Sweep002", JustWarning, msg);
+      return false;
+    }
+    else points.back().commands.push_back(text);
+  }
+  if (points.empty()) {
+    G4ExceptionDescription msg;
+    msg << "No point in the sweep file " << fileName;
+    G4Exception("B3Sweep::ReadPoints()", "B3Sweep002", JustWarning, msg);
+    return false;
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3Sweep::RunPoint(const Point& point, std::ostream& summary)
+{
+  G4Timer timer;
+  timer.Start();
+
+  G4UImanager* UImanager = G4UImanager::GetUIpointer();
+  for (size_t c = 0; c < point.commands.size(); c++) {
+    G4int status = UImanager->ApplyCommand(point.commands[c]);
+    if (status != fCommandSucceeded) {
+      G4ExceptionDescription msg;
+      msg << "Command \"" << point.commands[c] << "\" of the point " << point.tag
+          << " failed (status " << status << "): the point is skipped";
+      G4Exception("B3Sweep::RunPoint()", "B3Sweep003", JustWarning, msg);
+      return false;
+    }
+  }
+
+  // only the geometry changed by the commands is built again, if the
+  // crystals set fit in the array
+  G4RunManager* runManager = G4RunManager::GetRunManager();
+  const B3DetectorConstruction* detector
+    = static_cast<const B3DetectorConstruction*>(runManager->GetUserDetectorConstruction());
+  G4ExceptionDescription crystalMsg;
+  if (!detector->CheckCrystals(crystalMsg)) {
+    G4ExceptionDescription msg;
+    msg << crystalMsg.str() << " at the point " << point.tag << ": the point is skipped";
+    G4Exception("B3Sweep::RunPoint()", "B3Sweep006", JustWarning, msg);
+    return false;
+  }
+  G4bool rebuild = detector->IsGeometryModified();
+  if (rebuild) UImanager->ApplyCommand("/run/reinitializeGeometry");
+
+  // tagged outputs
+  fgPointTag = "_" + point.tag;
+  B3EventOutput* output = B3EventOutput::Instance();
+  G4String analysisFileName = output->GetAnalysisFileName();
+  G4String eventFileBase = output->GetEventFileBase();
+  output->SetAnalysisFileName(analysisFileName + fgPointTag);
+  if (output->IsEventFileEnabled()) output->SetEventFileBase(eventFileBase + fgPointTag);
+
+  // the same events for every point
+  fResult = B3Snapshot();
+  fResult.endEvent = uint64_t(fNbEvents);
+  B3RandomStreams::Instance()->SetEventOffset(0);
+
+  runManager->BeamOn(fNbEvents);
+
+  output->SetAnalysisFileName(analysisFileName);
+  output->SetEventFileBase(eventFileBase);
+  fgPointTag = "";
+  timer.Stop();
+
+  if (fResult.nextEvent != fResult.endEvent) {
+    G4ExceptionDescription msg;
+    msg << "The run of the point " << point.tag << " was not completed";
+    G4Exception("B3Sweep::RunPoint()", "B3Sweep004", JustWarning, msg);
+    return false;
+  }
+  G4String resultName = fDirectory + "/" + point.tag + ".b3s";
+  if (!fResult.Write(resultName)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the result of the point " << point.tag << " to " << resultName;
+    G4Exception("B3Sweep::RunPoint()", "B3Sweep005", JustWarning, msg);
+  }
+
+  const B3Tally& tally = fResult.tally;
+  B3Biasing* biasing = B3Biasing::Instance();
+  summary << point.tag << " " << tally.nEvents << " " << (rebuild ? "rebuilt" : "kept")
+          << " " << timer.GetRealElapsed() << " "
+          << tally.CountTotal(biasing->GetPeakLow()/keV, biasing->GetPeakHigh()/keV);
+  for (G4int i = 0; i < B3Tally::kNbCrystals; i++) {
+    summary << " " << tally.MeanEdep(i);}
+  summary << "\n";
+
+  G4cout << "\n Sweep point " << point.tag << ": " << tally.nEvents << " events, geometry "
+         << (rebuild ? "rebuilt" : "kept") << ", " << timer.GetRealElapsed() << " s"
+         << G4endl;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Sweep::EndOfRun(const B3Run* run)
+{
+  if (!fActive) return;
+  fResult.seed = uint64_t(B3RandomStreams::Instance()->GetRunSeed());
+  fResult.nextEvent += run->GetNumberOfEvent();
+  fResult.tally.Add(run->GetTally());
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Sweep::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/sweep/",
+                                      "Parameter sweep in one job");
+
+  G4GenericMessenger::Command& eventsCmd
+    = fMessenger->DeclareProperty("events", fNbEvents, "Number of events of each point.");
+  eventsCmd.SetParameterName("events", false);
+  eventsCmd.SetRange("events>0");
+  eventsCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& dirCmd
+    = fMessenger->DeclareProperty("dir", fDirectory,
+                                  "Directory of the results of the points.");
+  dirCmd.SetParameterName("dir", false);
+  dirCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& runCmd
+    = fMessenger->DeclareMethod("run", &B3Sweep::Run,
+                                "Run the points of a sweep file.");
+  runCmd.SetParameterName("file", false);
+  runCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
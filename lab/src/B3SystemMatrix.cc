@@ -0,0 +1,447 @@
+/// \file B3SystemMatrix.cc
+/// \brief Implementation of the B3SystemMatrix class
+
+#include "B3SystemMatrix.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  typedef B3ListModeFormat::CrystalEntry CrystalEntry;
+
+  const uint32_t kMatrixMagic   = 0x4D533342;   // "B3SM"
+  const uint32_t kMatrixVersion = 1;
+  /// Positions closer than this (mm) are the same
+  const double kTolerance = 1.e-3;
+  /// Lines whose expanded row is checked against a direct trace
+  const size_t kNbChecked = 256;
+
+  /// Transaxial symmetry codes: x/y swap first, then the flips
+  enum { kFlipX = 1, kFlipY = 2, kSwap = 4 };
+
+  void ApplyCode(uint32_t code, double& x, double& y)
+  {
+    if (code & kSwap) std::swap(x, y);
+    if (code & kFlipX) x = -x;
+    if (code & kFlipY) y = -y;
+  }
+
+  /// Runs work(i) for i in [0, n) on nThreads threads
+  template <class Work>
+  void ParallelFor(size_t n, unsigned int nThreads, Work work)
+  {
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+    for (unsigned int t = 0; t < nThreads; t++) {
+      pool.push_back(std::thread([&next, n, &work]() {
+        for (size_t i = next++; i < n; i = next++) work(i);
+      }));
+    }
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+  }
+
+  /// Crystal at a position, -1 if none
+  int64_t FindCrystal(const std::vector<CrystalEntry>& crystals, double x, double y, double z)
+  {
+    for (size_t c = 0; c < crystals.size(); c++) {
+      if (std::fabs(crystals[c].center[0] - x) < kTolerance
+          && std::fabs(crystals[c].center[1] - y) < kTolerance
+          && std::fabs(crystals[c].center[2] - z) < kTolerance) return int64_t(c);
+    }
+    return -1;
+  }
+
+  void Hash(uint64_t& hash, const void* data, size_t size)
+  {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3SystemMatrix::B3SystemMatrix()
+ : fNbLines(0), fNbVoxels(0),
+   fLineTable(0), fRowOffsets(0), fColumns(0), fValues(0)
+{
+  std::memset(&fGrid, 0, sizeof(fGrid));
+  std::memset(&fStatistics, 0, sizeof(fStatistics));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3SystemMatrix::~B3SystemMatrix()
+{
+  Close();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+uint64_t B3SystemMatrix::Key(const std::vector<CrystalEntry>& crystals,
+                             const B3ImageGrid& grid, const std::string& lines)
+{
+  uint64_t hash = 14695981039346656037ull;
+  Hash(hash, &kMatrixVersion, sizeof(kMatrixVersion));
+  if (!crystals.empty()) Hash(hash, &crystals[0], crystals.size()*sizeof(CrystalEntry));
+  Hash(hash, grid.n, sizeof(grid.n));
+  Hash(hash, grid.voxelSize, sizeof(grid.voxelSize));
+  Hash(hash, grid.center, sizeof(grid.center));
+  Hash(hash, lines.data(), lines.size());
+  return hash;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+std::string B3SystemMatrix::FileName(const std::string& directory, uint64_t key)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.b3sm", (unsigned long long)key);
+  return directory.empty() ? std::string(name) : directory + "/" + name;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3SystemMatrix::Build(const std::string& fileName, uint64_t key, const B3ImageGrid& grid,
+                           const std::vector<double>& lines,
+                           const std::vector<CrystalEntry>& crystals,
+                           unsigned int nThreads)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  Close();
+  if (nThreads == 0) nThreads = 1;
+  uint64_t nLines = lines.size()/6;
+  uint32_t nCrystals = uint32_t(crystals.size());
+  bool pairs = nCrystals > 1 && nLines == B3ListModeFormat::NbPairs(nCrystals);
+
+  // Transaxial symmetries of the grid and of the crystal table
+  std::vector<uint32_t> codes(1, 0);
+  std::vector<std::vector<uint32_t> > mapped(1);   // crystal permutations
+  for (uint32_t c = 0; c < nCrystals; c++) mapped[0].push_back(c);
+  for (uint32_t code = 1; pairs && code < 8; code++) {
+    if ((code & kFlipX) && grid.center[0] != 0.f) continue;
+    if ((code & kFlipY) && grid.center[1] != 0.f) continue;
+    if ((code & kSwap) && (grid.n[0] != grid.n[1] || grid.voxelSize[0] != grid.voxelSize[1]
+                           || grid.center[0] != grid.center[1])) continue;
+    std::vector<uint32_t> permutation(nCrystals);
+    bool valid = true;
+    for (uint32_t c = 0; valid && c < nCrystals; c++) {
+      double x = crystals[c].center[0], y = crystals[c].center[1];
+      ApplyCode(code, x, y);
+      int64_t image = FindCrystal(crystals, x, y, crystals[c].center[2]);
+      valid = (image >= 0);
+      if (valid) permutation[c] = uint32_t(image);
+    }
+    if (!valid) continue;
+    codes.push_back(code);
+    mapped.push_back(permutation);
+  }
+
+  // Axial translations: equally spaced rings of the same crystals, a whole
+  // number of voxels apart, inside the image
+  std::vector<float> rings;
+  for (uint32_t c = 0; c < nCrystals; c++) rings.push_back(crystals[c].center[2]);
+  std::sort(rings.begin(), rings.end());
+  rings.erase(std::unique(rings.begin(), rings.end()), rings.end());
+  std::vector<uint32_t> ringOf(nCrystals, 0);
+  std::vector<int64_t> down(nCrystals, -1);        // same crystal one ring lower
+  int32_t ringShift = 0;                           // voxels per ring
+  bool axial = pairs && rings.size() > 1;
+  if (axial) {
+    double pitch = rings[1] - rings[0];
+    double voxels = pitch/grid.voxelSize[2];
+    ringShift = int32_t(std::floor(voxels + 0.5));
+    axial = ringShift > 0 && std::fabs(voxels - ringShift) < 1.e-4*voxels
+         && grid.Lower(2) <= rings.front() + kTolerance
+         && grid.Lower(2) + grid.n[2]*grid.voxelSize[2] >= rings.back() - kTolerance;
+    for (size_t r = 2; axial && r < rings.size(); r++) {
+      axial = std::fabs(rings[r] - rings[r-1] - pitch) < kTolerance;
+    }
+    for (uint32_t c = 0; axial && c < nCrystals; c++) {
+      ringOf[c] = uint32_t(std::lower_bound(rings.begin(), rings.end(), crystals[c].center[2])
+                           - rings.begin());
+      if (ringOf[c] == 0) continue;
+      down[c] = FindCrystal(crystals, crystals[c].center[0], crystals[c].center[1],
+                            crystals[c].center[2] - pitch);
+      axial = (down[c] >= 0);
+    }
+  }
+
+  // Canonical line of each line: shifted to the lowest ring, then the
+  // smallest pair ID over the symmetries
+  std::vector<LineEntry> table(nLines);
+  std::vector<uint64_t> rowLines;                  // canonical line of each row
+  if (pairs && (codes.size() > 1 || axial)) {
+    // inverse of each symmetry, in the list of codes
+    std::vector<uint16_t> inverse(codes.size(), 0);
+    for (size_t g = 0; g < codes.size(); g++) {
+      for (size_t h = 0; h < codes.size(); h++) {
+        double x = 1., y = 2.;
+        ApplyCode(codes[h], x, y);
+        ApplyCode(codes[g], x, y);
+        if (x == 1. && y == 2.) inverse[g] = uint16_t(h);
+      }
+    }
+    std::vector<int64_t> rowOfPair(nLines, -1);
+    for (uint32_t b = 1; b < nCrystals; b++) {
+      for (uint32_t a = 0; a < b; a++) {
+        uint32_t a0 = a, b0 = b, shift = 0;
+        if (axial) {
+          shift = std::min(ringOf[a], ringOf[b]);
+          for (uint32_t s = 0; s < shift; s++) {
+            a0 = uint32_t(down[a0]);
+            b0 = uint32_t(down[b0]);
+          }
+        }
+        uint32_t best = 0, bestCode = 0;
+        for (size_t g = 0; g < codes.size(); g++) {
+          uint32_t id = B3ListModeFormat::PairId(mapped[g][a0], mapped[g][b0]);
+          if (g == 0 || id < best) { best = id; bestCode = uint32_t(g); }
+        }
+        if (rowOfPair[best] < 0) {
+          rowOfPair[best] = int64_t(rowLines.size());
+          rowLines.push_back(best);
+        }
+        LineEntry& entry = table[B3ListModeFormat::PairId(a, b)];
+        entry.row = uint32_t(rowOfPair[best]);
+        entry.symmetry = inverse[bestCode];
+        entry.shift = int16_t(shift*ringShift);
+      }
+    }
+  }
+  else {
+    codes.assign(1, 0);
+    axial = false;
+    for (uint64_t l = 0; l < nLines; l++) {
+      table[l].row = uint32_t(l);
+      table[l].symmetry = 0;
+      table[l].shift = 0;
+      rowLines.push_back(l);
+    }
+  }
+
+  // Rows of the canonical lines
+  std::vector<std::vector<uint32_t> > rowVoxels(rowLines.size());
+  std::vector<std::vector<float> > rowValues(rowLines.size());
+  ParallelFor(rowLines.size(), nThreads, [&](size_t r) {
+    const double* line = &lines[6*rowLines[r]];
+    B3Siddon::Trace(grid, line, line + 3, rowVoxels[r], rowValues[r]);
+  });
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kMatrixMagic;
+  header.version = kMatrixVersion;
+  header.key = key;
+  header.nLines = nLines;
+  header.nRows = rowLines.size();
+  for (int a = 0; a < 3; a++) {
+    header.n[a] = grid.n[a];
+    header.voxelSize[a] = grid.voxelSize[a];
+    header.center[a] = grid.center[a];
+  }
+  header.nSymmetries = uint32_t(codes.size());
+  header.axial = axial ? 1 : 0;
+  for (size_t g = 0; g < codes.size(); g++) header.codes[g] = codes[g];
+  std::vector<uint64_t> offsets(rowLines.size() + 1, 0);
+  for (size_t r = 0; r < rowLines.size(); r++) offsets[r+1] = offsets[r] + rowVoxels[r].size();
+  header.nonZeros = offsets.back();
+  for (uint64_t l = 0; l < nLines; l++) header.fullNonZeros += rowVoxels[table[l].row].size();
+
+  // unique to the process: jobs sharing a cache directory may build the
+  // same matrix at the same time
+  std::ostringstream tmpStream;
+  tmpStream << fileName << ".tmp" << getpid();
+  std::string tmpName = tmpStream.str();
+  std::FILE* file = std::fopen(tmpName.c_str(), "wb");
+  if (!file) return false;
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+         && (nLines == 0 || std::fwrite(&table[0], sizeof(LineEntry), nLines, file) == nLines)
+         && std::fwrite(&offsets[0], sizeof(uint64_t), offsets.size(), file) == offsets.size();
+  for (size_t r = 0; ok && r < rowLines.size(); r++) {
+    size_t n = rowVoxels[r].size();
+    ok = (n == 0 || std::fwrite(&rowVoxels[r][0], sizeof(uint32_t), n, file) == n);
+  }
+  for (size_t r = 0; ok && r < rowLines.size(); r++) {
+    size_t n = rowValues[r].size();
+    ok = (n == 0 || std::fwrite(&rowValues[r][0], sizeof(float), n, file) == n);
+  }
+  ok = (std::fclose(file) == 0) && ok;
+  if (!ok || std::rename(tmpName.c_str(), fileName.c_str()) != 0) {
+    std::remove(tmpName.c_str());
+    return false;
+  }
+  if (!Open(fileName, key)) return false;
+
+  // Check of the symmetries on a sample of the lines
+  if (codes.size() > 1 || axial) {
+    bool same = true;
+    std::vector<uint32_t> voxels, direct;
+    std::vector<float> values, directValues;
+    uint64_t step = std::max<uint64_t>(1, nLines/kNbChecked);
+    for (uint64_t l = 0; same && l < nLines; l += step) {
+      voxels.clear();
+      values.clear();
+      GetRow(l, voxels, values);
+      B3Siddon::Trace(grid, &lines[6*l], &lines[6*l] + 3, direct, directValues);
+      std::vector<std::pair<uint32_t, float> > expanded, traced;
+      for (size_t i = 0; i < voxels.size(); i++) expanded.push_back(std::make_pair(voxels[i], values[i]));
+      for (size_t i = 0; i < direct.size(); i++) traced.push_back(std::make_pair(direct[i], directValues[i]));
+      std::sort(expanded.begin(), expanded.end());
+      std::sort(traced.begin(), traced.end());
+      same = (expanded.size() == traced.size());
+      for (size_t i = 0; same && i < expanded.size(); i++) {
+        same = expanded[i].first == traced[i].first
+            && std::fabs(expanded[i].second - traced[i].second) < kTolerance;
+      }
+    }
+    if (!same) {
+      Close();
+      return Build(fileName, key, grid, lines, std::vector<CrystalEntry>(), nThreads);
+    }
+  }
+
+  fStatistics.buildSeconds
+    = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3SystemMatrix::Open(const std::string& fileName, uint64_t key)
+{
+  Close();
+  if (!fFile.Open(fileName, B3MappedFile::kRandom)) return false;
+
+  FileHeader header;
+  if (fFile.Size() < sizeof(header)) {
+    Close();
+    return false;
+  }
+  std::memcpy(&header, fFile.Data(), sizeof(header));
+  // the counts are bounded by the file size before the size is computed
+  uint64_t fileSize = fFile.Size();
+  if (header.magic != kMatrixMagic || header.version != kMatrixVersion || header.key != key
+      || header.nSymmetries < 1 || header.nSymmetries > 8 || header.nLines > fileSize
+      || header.nRows >= fileSize || header.nonZeros > fileSize) {
+    Close();
+    return false;
+  }
+  uint64_t size = sizeof(header) + header.nLines*sizeof(LineEntry)
+                + (header.nRows + 1)*sizeof(uint64_t)
+                + header.nonZeros*(sizeof(uint32_t) + sizeof(float));
+  uint64_t nbVoxels = uint64_t(header.n[0])*header.n[1]*header.n[2];
+  bool valid = (size == fileSize && nbVoxels > 0 && nbVoxels <= 0xFFFFFFFFULL);
+  for (uint32_t g = 0; valid && g < header.nSymmetries; g++) {
+    valid = header.codes[g] < 8 && (!(header.codes[g] & kSwap) || header.n[0] == header.n[1]);
+  }
+  if (!valid) {
+    Close();
+    return false;
+  }
+
+  for (int a = 0; a < 3; a++) {
+    fGrid.n[a] = header.n[a];
+    fGrid.voxelSize[a] = header.voxelSize[a];
+    fGrid.center[a] = header.center[a];
+  }
+  fNbVoxels = fGrid.NbVoxels();
+  fNbLines = header.nLines;
+  const char* data = fFile.Data() + sizeof(header);
+  fLineTable = reinterpret_cast<const LineEntry*>(data);
+  data += header.nLines*sizeof(LineEntry);
+  fRowOffsets = reinterpret_cast<const uint64_t*>(data);
+  data += (header.nRows + 1)*sizeof(uint64_t);
+  fColumns = reinterpret_cast<const uint32_t*>(data);
+  data += header.nonZeros*sizeof(uint32_t);
+  fValues = reinterpret_cast<const float*>(data);
+
+  // GetRow reads the file without checks: the row offsets, the columns and
+  // the line table are checked once here. The z range of each row bounds
+  // the shifts of its lines.
+  uint64_t sliceVoxels = uint64_t(header.n[0])*header.n[1];
+  std::vector<uint32_t> zMin(header.nRows, header.n[2]), zMax(header.nRows, 0);
+  valid = (fRowOffsets[0] == 0 && fRowOffsets[header.nRows] == header.nonZeros);
+  for (uint64_t r = 0; valid && r < header.nRows; r++) {
+    valid = fRowOffsets[r] <= fRowOffsets[r + 1] && fRowOffsets[r + 1] <= header.nonZeros;
+    for (uint64_t n = fRowOffsets[r]; valid && n < fRowOffsets[r + 1]; n++) {
+      valid = fColumns[n] < nbVoxels;
+      uint32_t z = uint32_t(fColumns[n]/sliceVoxels);
+      zMin[r] = std::min(zMin[r], z);
+      zMax[r] = std::max(zMax[r], z);
+    }
+  }
+  for (uint64_t l = 0; valid && l < header.nLines; l++) {
+    const LineEntry& entry = fLineTable[l];
+    valid = entry.row < header.nRows && entry.symmetry < header.nSymmetries;
+    if (valid && fRowOffsets[entry.row] < fRowOffsets[entry.row + 1]) {
+      valid = int64_t(zMin[entry.row]) + entry.shift >= 0
+           && int64_t(zMax[entry.row]) + entry.shift < int64_t(header.n[2]);
+    }
+  }
+  if (!valid) {
+    Close();
+    return false;
+  }
+
+  BuildPermutations(std::vector<uint32_t>(header.codes, header.codes + header.nSymmetries));
+
+  fStatistics.nLines = header.nLines;
+  fStatistics.nRows = header.nRows;
+  fStatistics.nonZeros = header.nonZeros;
+  fStatistics.fullNonZeros = header.fullNonZeros;
+  fStatistics.nTransaxial = header.nSymmetries;
+  fStatistics.axial = (header.axial != 0);
+  fStatistics.buildSeconds = 0.;
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3SystemMatrix::Close()
+{
+  fFile.Close();
+  fNbLines = 0;
+  fLineTable = 0;
+  fRowOffsets = 0;
+  fColumns = 0;
+  fValues = 0;
+  fPermutations.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3SystemMatrix::BuildPermutations(const std::vector<uint32_t>& codes)
+{
+  uint32_t nx = fGrid.n[0], ny = fGrid.n[1], nz = fGrid.n[2];
+  fPermutations.resize(codes.size()*fNbVoxels);
+  for (size_t g = 0; g < codes.size(); g++) {
+    uint32_t* permutation = &fPermutations[g*fNbVoxels];
+    for (uint32_t k = 0; k < nz; k++) {
+      for (uint32_t j = 0; j < ny; j++) {
+        for (uint32_t i = 0; i < nx; i++) {
+          uint32_t x = i, y = j;
+          if (codes[g] & kSwap) std::swap(x, y);
+          if (codes[g] & kFlipX) x = nx - 1 - x;
+          if (codes[g] & kFlipY) y = ny - 1 - y;
+          permutation[fGrid.Index(i, j, k)] = uint32_t(fGrid.Index(x, y, k));
+        }
+      }
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
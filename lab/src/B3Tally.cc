@@ -0,0 +1,112 @@
+/// \file B3Tally.cc
+/// \brief Implementation of the B3Tally structure
+
+#include "B3Tally.hh"
+
+#include <cmath>
+#include <cstring>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const double B3Tally::kBinWidth = 10.;
+
+namespace
+{
+  inline void Add128(uint64_t& hi, uint64_t& lo, uint64_t addHi, uint64_t addLo)
+  {
+    lo += addLo;
+    hi += addHi + (lo < addLo ? 1 : 0);
+  }
+
+  inline int Bin(double energy)
+  {
+    if (energy < 0.) return 0;
+    int bin = int(energy/B3Tally::kBinWidth);
+    return (bin < B3Tally::kNbBins) ? bin : B3Tally::kNbBins;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Tally::B3Tally()
+{
+  Reset();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Tally::Reset()
+{
+  nEvents = 0;
+  std::memset(nFired, 0, sizeof(nFired));
+  std::memset(sumEdep, 0, sizeof(sumEdep));
+  std::memset(sumEdep2Hi, 0, sizeof(sumEdep2Hi));
+  std::memset(sumEdep2Lo, 0, sizeof(sumEdep2Lo));
+  std::memset(totalSpectrum, 0, sizeof(totalSpectrum));
+  std::memset(crystalSpectrum, 0, sizeof(crystalSpectrum));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Tally::Fill(const double edep[kNbCrystals])
+{
+  nEvents++;
+  double total = 0.;
+  for (int i = 0; i < kNbCrystals; i++) {
+    if (edep[i] <= 0.) continue;
+    total += edep[i];
+    uint64_t eV = uint64_t(std::floor(edep[i]*1000. + 0.5));
+    nFired[i]++;
+    sumEdep[i] += eV;
+    Add128(sumEdep2Hi[i], sumEdep2Lo[i], 0, eV*eV);
+    crystalSpectrum[i][Bin(edep[i])]++;
+  }
+  totalSpectrum[Bin(total)]++;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Tally::Add(const B3Tally& other)
+{
+  nEvents += other.nEvents;
+  for (int i = 0; i < kNbCrystals; i++) {
+    nFired[i]  += other.nFired[i];
+    sumEdep[i] += other.sumEdep[i];
+    Add128(sumEdep2Hi[i], sumEdep2Lo[i], other.sumEdep2Hi[i], other.sumEdep2Lo[i]);
+    for (int b = 0; b <= kNbBins; b++) crystalSpectrum[i][b] += other.crystalSpectrum[i][b];
+  }
+  for (int b = 0; b <= kNbBins; b++) totalSpectrum[b] += other.totalSpectrum[b];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+double B3Tally::MeanEdep(int crystal) const
+{
+  if (nFired[crystal] == 0) return 0.;
+  return 1.e-3*double(sumEdep[crystal])/nFired[crystal];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+double B3Tally::RmsEdep(int crystal) const
+{
+  if (nFired[crystal] == 0) return 0.;
+  double sum2 = std::ldexp(double(sumEdep2Hi[crystal]), 64) + double(sumEdep2Lo[crystal]);
+  double mean = MeanEdep(crystal);
+  double var = 1.e-6*sum2/nFired[crystal] - mean*mean;
+  return (var > 0.) ? std::sqrt(var) : 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+uint64_t B3Tally::CountTotal(double lo, double hi) const
+{
+  uint64_t count = 0;
+  for (int b = 0; b < kNbBins; b++) {
+    double center = (b + 0.5)*kBinWidth;
+    if (center >= lo && center < hi) count += totalSpectrum[b];
+  }
+  return count;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,180 @@
+/// \file B3ThreadPlacement.cc
+/// \brief Implementation of the B3ThreadPlacement class
+
+#include "B3ThreadPlacement.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4Threading.hh"
+#include "G4AutoLock.hh"
+
+#include <algorithm>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace { G4Mutex threadPlacementMutex = G4MUTEX_INITIALIZER; }
+
+B3ThreadPlacement* B3ThreadPlacement::fgInstance = 0;
+G4ThreadLocal G4int B3ThreadPlacement::fgNode = -1;
+G4ThreadLocal G4int B3ThreadPlacement::fgPolicyVersion = -1;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ThreadPlacement* B3ThreadPlacement::Instance()
+{
+  if (!fgInstance) fgInstance = new B3ThreadPlacement;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ThreadPlacement::B3ThreadPlacement()
+ : fMessenger(0),
+   fPolicy("none"),
+   fPolicyVersion(0),
+   fFirstThread(0),
+   fTopologyRead(false)
+{
+  // created by main(), before any thread is pinned
+  CPU_ZERO(&fProcessCpus);
+  sched_getaffinity(0, sizeof(fProcessCpus), &fProcessCpus);
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3ThreadPlacement::~B3ThreadPlacement()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ThreadPlacement::ReadTopology()
+{
+  if (fTopologyRead) return;
+  fTopologyRead = true;
+  fTopology.Read();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ThreadPlacement::SetPolicy(G4String policy)
+{
+  fPolicy = policy;
+  fPolicyVersion++;
+  ReadTopology();
+  if (fPolicy != "none" && fTopology.NbCpus() > 0) {
+    G4cout << "\n Thread placement: " << fPolicy << " on " << fTopology.NbCpus()
+           << " CPUs of " << fTopology.NbNodes() << " NUMA nodes" << G4endl;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ThreadPlacement::BeginOfRun()
+{
+  // the nodes of the unpinned threads are reported too
+  ReadTopology();
+  G4AutoLock lock(&threadPlacementMutex);
+  fWorkerRuns.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ThreadPlacement::BeginOfThreadRun()
+{
+  // the master of a multi-threaded kernel runs no event
+  if (G4Threading::IsMultithreadedApplication() && G4Threading::IsMasterThread()) return;
+  if (fgPolicyVersion != fPolicyVersion) PinWorker();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ThreadPlacement::PinWorker()
+{
+  fgPolicyVersion = fPolicyVersion;
+  G4int threadId = G4Threading::G4GetThreadId();
+  if (fPolicy == "none") {
+    // released to the CPUs of the process, if it was pinned
+    if (fgNode >= 0) sched_setaffinity(0, sizeof(fProcessCpus), &fProcessCpus);
+    fgNode = -1;
+    return;
+  }
+  if (fTopology.NbCpus() == 0) return;
+
+  // the thread of a sequential kernel is the thread 0 of its process
+  B3Topology::Policy policy
+    = (fPolicy == "scatter") ? B3Topology::kScatter : B3Topology::kCompact;
+  G4int cpu = fTopology.CpuOf(policy, fFirstThread + std::max(threadId, 0));
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    G4ExceptionDescription msg;
+    msg << "Cannot pin the thread " << threadId << " to the CPU " << cpu;
+    G4Exception("B3ThreadPlacement::PinWorker()", "B3Affinity001", JustWarning, msg);
+    return;
+  }
+  fgNode = fTopology.NodeOf(cpu);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ThreadPlacement::AddWorkerRun(G4int nofEvents, G4double seconds)
+{
+  WorkerRun run;
+  run.node = (fgNode >= 0) ? fgNode : fTopology.NodeOf(sched_getcpu());
+  run.nofEvents = nofEvents;
+  run.seconds = seconds;
+  G4AutoLock lock(&threadPlacementMutex);
+  fWorkerRuns.push_back(run);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ThreadPlacement::EndOfRun()
+{
+  G4AutoLock lock(&threadPlacementMutex);
+  if (fWorkerRuns.size() < 2) return;
+
+  // unknown nodes (CPUs outside the topology) are printed as node -1
+  G4int nbNodes = fTopology.NbNodes();
+  std::vector<G4int> threads(nbNodes + 1, 0);
+  std::vector<G4long> events(nbNodes + 1, 0);
+  std::vector<G4double> rates(nbNodes + 1, 0.);
+  for (size_t i = 0; i < fWorkerRuns.size(); i++) {
+    const WorkerRun& run = fWorkerRuns[i];
+    size_t slot = (run.node >= 0 && run.node < nbNodes) ? run.node + 1 : 0;
+    threads[slot]++;
+    events[slot] += run.nofEvents;
+    if (run.seconds > 0.) rates[slot] += run.nofEvents/run.seconds;
+  }
+
+  G4cout << "\n Throughput per NUMA node (" << fPolicy << " placement):" << G4endl;
+  for (G4int slot = 0; slot <= nbNodes; slot++) {
+    if (threads[slot] == 0) continue;
+    G4cout << "  node " << slot - 1 << ": " << threads[slot] << " threads, "
+           << events[slot] << " events, " << rates[slot] << " events/s" << G4endl;
+  }
+  fWorkerRuns.clear();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3ThreadPlacement::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/affinity/",
+                                      "Placement of the worker threads");
+
+  G4GenericMessenger::Command& policyCmd
+    = fMessenger->DeclareMethod("policy", &B3ThreadPlacement::SetPolicy,
+                                "Pinning of the worker threads from the next run: "
+                                "none, compact (fill the NUMA nodes in turn) or "
+                                "scatter (deal the threads to the nodes).");
+  policyCmd.SetParameterName("policy", false);
+  policyCmd.SetCandidates("none compact scatter");
+  policyCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
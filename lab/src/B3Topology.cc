@@ -0,0 +1,117 @@
+/// \file B3Topology.cc
+/// \brief Implementation of the B3Topology class
+
+#include "B3Topology.hh"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <sched.h>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Topology::B3Topology()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3Topology::ParseCpuList(const std::string& list, std::vector<int>& cpus)
+{
+  cpus.clear();
+  std::istringstream ranges(list);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    if (range.empty() || range == "\n") continue;
+    char* end;
+    long first = std::strtol(range.c_str(), &end, 10);
+    long last = first;
+    if (*end == '-') last = std::strtol(end + 1, &end, 10);
+    if (end == range.c_str() || (*end != '\0' && *end != '\n') || first < 0 || last < first) {
+      return false;
+    }
+    for (long cpu = first; cpu <= last; cpu++) cpus.push_back(int(cpu));
+  }
+  return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool B3Topology::Read(const std::string& nodeDirectory)
+{
+  fNodeCpus.clear();
+  fCpus.clear();
+  fNodeOfCpu.clear();
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  bool restricted = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+
+  // the node numbers may have holes (offline or memory-only nodes)
+  std::vector<std::vector<int> > nodes;
+  for (int node = 0, missing = 0; missing < 64; node++) {
+    std::ostringstream name;
+    name << nodeDirectory << "/node" << node << "/cpulist";
+    std::ifstream file(name.str().c_str());
+    std::string list;
+    if (!file || !std::getline(file, list)) {
+      missing++;
+      continue;
+    }
+    missing = 0;
+    std::vector<int> cpus;
+    if (!ParseCpuList(list, cpus)) continue;
+    nodes.push_back(std::vector<int>());
+    for (size_t i = 0; i < cpus.size(); i++) {
+      if (!restricted || (cpus[i] < CPU_SETSIZE && CPU_ISSET(cpus[i], &allowed))) {
+        nodes.back().push_back(cpus[i]);
+      }
+    }
+    if (nodes.back().empty()) nodes.pop_back();
+  }
+  if (nodes.empty() && restricted) {
+    nodes.push_back(std::vector<int>());
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) nodes.back().push_back(cpu);
+    }
+    if (nodes.back().empty()) nodes.pop_back();
+  }
+
+  fNodeCpus = nodes;
+  for (size_t node = 0; node < fNodeCpus.size(); node++) {
+    for (size_t i = 0; i < fNodeCpus[node].size(); i++) {
+      int cpu = fNodeCpus[node][i];
+      fCpus.push_back(cpu);
+      if (int(fNodeOfCpu.size()) <= cpu) fNodeOfCpu.resize(cpu + 1, -1);
+      fNodeOfCpu[cpu] = int(node);
+    }
+  }
+  return !fCpus.empty();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int B3Topology::NodeOf(int cpu) const
+{
+  return (cpu >= 0 && cpu < int(fNodeOfCpu.size())) ? fNodeOfCpu[cpu] : -1;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int B3Topology::CpuOf(Policy policy, int threadIndex) const
+{
+  if (fCpus.empty() || threadIndex < 0) return -1;
+  if (policy == kCompact) return fCpus[threadIndex % fCpus.size()];
+
+  // scatter: thread t goes to node t % n; the rounds skip the nodes whose
+  // CPUs are all taken, then start again from the first CPUs
+  int index = threadIndex % int(fCpus.size());
+  for (int round = 0; ; round++) {
+    for (size_t node = 0; node < fNodeCpus.size(); node++) {
+      if (round >= int(fNodeCpus[node].size())) continue;
+      if (index-- == 0) return fNodeCpus[node][round];
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
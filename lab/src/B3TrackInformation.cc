@@ -0,0 +1,35 @@
+/// \file B3TrackInformation.cc
+/// \brief Implementation of the B3TrackInformation class
+
+#include "B3TrackInformation.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3TrackInformation::B3TrackInformation(G4int primaryIndex, G4int branch)
+ : G4VUserTrackInformation("B3TrackInformation"),
+   fPrimaryIndex(primaryIndex),
+   fBranch(branch)
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3TrackInformation::~B3TrackInformation()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3TrackInformation::Print() const
+{
+  G4cout << " Primary index: " << fPrimaryIndex << ", branch: " << fBranch << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3TrackInformation::SetBranch(const G4Track* track, G4int branch)
+{
+  G4VUserTrackInformation* info = track->GetUserInformation();
+  if (info) static_cast<B3TrackInformation*>(info)->fBranch = branch;
+  else track->SetUserInformation(new B3TrackInformation(0, branch));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
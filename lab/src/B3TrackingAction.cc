@@ -0,0 +1,51 @@
+/// \file B3TrackingAction.cc
+/// \brief Implementation of the B3TrackingAction class
+
+#include "B3TrackingAction.hh"
+#include "B3Batching.hh"
+#include "B3TrackInformation.hh"
+
+#include "G4Track.hh"
+#include "G4TrackingManager.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3TrackingAction::B3TrackingAction()
+ : G4UserTrackingAction()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3TrackingAction::~B3TrackingAction()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3TrackingAction::PreUserTrackingAction(const G4Track* track)
+{
+  // the primaries of a batched event have one particle per vertex, so that
+  // their track IDs are 1 ... n in the order of the primaries
+  if (B3Batching::GetEventPrimaries() > 1 && track->GetParentID() == 0
+      && !track->GetUserInformation()) {
+    track->SetUserInformation(new B3TrackInformation(track->GetTrackID() - 1));
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3TrackingAction::PostUserTrackingAction(const G4Track* track)
+{
+  if (!track->GetUserInformation()) return;
+  G4int primaryIndex = B3TrackInformation::GetPrimaryIndex(track);
+  G4int branch = B3TrackInformation::GetBranch(track);
+  G4TrackVector* secondaries = fpTrackingManager->GimmeSecondaries();
+  if (!secondaries) return;
+  for (size_t i = 0; i < secondaries->size(); i++) {
+    G4Track* secondary = (*secondaries)[i];
+    if (!secondary->GetUserInformation()) {
+      secondary->SetUserInformation(new B3TrackInformation(primaryIndex, branch));
+    }
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
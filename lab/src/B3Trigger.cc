@@ -0,0 +1,162 @@
+/// \file B3Trigger.cc
+/// \brief Implementation of the B3Trigger class
+
+#include "B3Trigger.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <iomanip>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Trigger* B3Trigger::fgInstance = 0;
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Trigger* B3Trigger::Instance()
+{
+  if (!fgInstance) fgInstance = new B3Trigger;
+  return fgInstance;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Trigger::B3Trigger()
+ : fMessenger(0),
+   fDropEmpty(false),
+   fMinEnergy(0.),
+   fWindowLow(0.),
+   fWindowHigh(0.),
+   fCrystalThreshold(0.),
+   fMinMultiplicity(0),
+   fMaxMultiplicity(9),
+   fPrescale(0)
+{
+  DefineCommands();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Trigger::~B3Trigger()
+{
+  delete fMessenger;
+  fgInstance = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3Trigger::Decision B3Trigger::Decide(const G4double edep[9], G4double totalEdep) const
+{
+  G4int fired = 0;
+  G4int multiplicity = 0;
+  for (G4int i = 0 ; i < 9 ; i++) {
+    fired += (edep[i] > 0.);
+    multiplicity += (edep[i] > fCrystalThreshold);
+  }
+
+  if (fDropEmpty && fired == 0) return kEmpty;
+  if (totalEdep < fMinEnergy) return kBelowMinEnergy;
+  // the window is off until its upper edge is set
+  if (fWindowHigh > 0. && (totalEdep < fWindowLow || totalEdep > fWindowHigh)) {
+    return kOutsideWindow;
+  }
+  if (multiplicity < fMinMultiplicity || multiplicity > fMaxMultiplicity) return kMultiplicity;
+  return kAccepted;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const char* B3Trigger::GetDecisionName(Decision decision)
+{
+  static const char* names[kNbDecisions]
+    = { "accepted", "empty", "below min energy", "outside window", "multiplicity" };
+  return names[decision];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Trigger::Print(const G4long counts[kNbDecisions], G4long prescaled) const
+{
+  G4long total = 0;
+  for (G4int d = 0; d < kNbDecisions; d++) total += counts[d];
+  if (total == 0) return;
+
+  G4cout << "\n Trigger: " << counts[kAccepted] + prescaled << " of " << total
+         << " events persisted (" << prescaled << " prescaled)" << G4endl;
+  for (G4int d = 0; d < kNbDecisions; d++) {
+    G4cout << "   " << std::setw(18) << std::left << GetDecisionName(Decision(d))
+           << std::right << std::setw(12) << counts[d]
+           << std::setw(9) << std::fixed << std::setprecision(2)
+           << 100.*counts[d]/total << " %" << G4endl;
+  }
+  G4cout.unsetf(std::ios::fixed);
+  G4cout << std::setprecision(6);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3Trigger::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/B3/trigger/",
+                                      "Selection of the persisted events");
+
+  G4GenericMessenger::Command& emptyCmd
+    = fMessenger->DeclareProperty("dropEmpty", fDropEmpty,
+                                  "Drop the events where no crystal fired.");
+  emptyCmd.SetParameterName("drop", false);
+  emptyCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& minCmd
+    = fMessenger->DeclarePropertyWithUnit("minEnergy", "keV", fMinEnergy,
+                                          "Minimum total energy in the crystals.");
+  minCmd.SetParameterName("energy", false);
+  minCmd.SetRange("energy>=0.");
+  minCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& lowCmd
+    = fMessenger->DeclarePropertyWithUnit("windowLow", "keV", fWindowLow,
+                                          "Lower edge of the total energy window.");
+  lowCmd.SetParameterName("energy", false);
+  lowCmd.SetRange("energy>=0.");
+  lowCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& highCmd
+    = fMessenger->DeclarePropertyWithUnit("windowHigh", "keV", fWindowHigh,
+                                          "Upper edge of the total energy window "
+                                          "(0 switches the window off).");
+  highCmd.SetParameterName("energy", false);
+  highCmd.SetRange("energy>=0.");
+  highCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& thresholdCmd
+    = fMessenger->DeclarePropertyWithUnit("crystalThreshold", "keV", fCrystalThreshold,
+                                          "Energy above which a crystal counts in "
+                                          "the multiplicity.");
+  thresholdCmd.SetParameterName("energy", false);
+  thresholdCmd.SetRange("energy>=0.");
+  thresholdCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& minMultCmd
+    = fMessenger->DeclareProperty("minMultiplicity", fMinMultiplicity,
+                                  "Minimum number of fired crystals.");
+  minMultCmd.SetParameterName("crystals", false);
+  minMultCmd.SetRange("crystals>=0 && crystals<=9");
+  minMultCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& maxMultCmd
+    = fMessenger->DeclareProperty("maxMultiplicity", fMaxMultiplicity,
+                                  "Maximum number of fired crystals.");
+  maxMultCmd.SetParameterName("crystals", false);
+  maxMultCmd.SetRange("crystals>=0 && crystals<=9");
+  maxMultCmd.command->SetToBeBroadcasted(false);
+
+  G4GenericMessenger::Command& prescaleCmd
+    = fMessenger->DeclareProperty("prescale", fPrescale,
+                                  "Persist one rejected event in prescale (0: none).");
+  prescaleCmd.SetParameterName("prescale", false);
+  prescaleCmd.SetRange("prescale>=0");
+  prescaleCmd.command->SetToBeBroadcasted(false);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,84 @@
+/// \file B3WeightedTally.cc
+/// \brief Implementation of the B3WeightedTally structure
+
+#include "B3WeightedTally.hh"
+
+#include <cmath>
+#include <cstring>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  // same binning as B3Tally
+  inline int Bin(double energy)
+  {
+    if (energy < 0.) return 0;
+    int bin = int(energy/B3Tally::kBinWidth);
+    return (bin < B3Tally::kNbBins) ? bin : B3Tally::kNbBins;
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3WeightedTally::B3WeightedTally()
+{
+  Reset();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WeightedTally::Reset(double peakLow, double peakHigh)
+{
+  // the bins whose centre is in [peakLow, peakHigh), as B3Tally::CountTotal
+  peakLowBin = B3Tally::kNbBins;
+  peakHighBin = 0;
+  for (int b = 0; b < B3Tally::kNbBins; b++) {
+    double center = (b + 0.5)*B3Tally::kBinWidth;
+    if (center < peakLow || center >= peakHigh) continue;
+    if (b < peakLowBin) peakLowBin = b;
+    peakHighBin = b + 1;
+  }
+  nEvents = 0;
+  sumPeak = 0.;
+  sumPeak2 = 0.;
+  std::memset(totalSpectrum, 0, sizeof(totalSpectrum));
+  eventPeak = 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WeightedTally::AddBranch(double weight, const double edep[B3Tally::kNbCrystals])
+{
+  double total = 0.;
+  for (int i = 0; i < B3Tally::kNbCrystals; i++) {
+    if (edep[i] > 0.) total += edep[i];
+  }
+  int bin = Bin(total);
+  totalSpectrum[bin] += weight;
+  if (bin >= peakLowBin && bin < peakHighBin) eventPeak += weight;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WeightedTally::Add(const B3WeightedTally& other)
+{
+  nEvents  += other.nEvents;
+  sumPeak  += other.sumPeak;
+  sumPeak2 += other.sumPeak2;
+  for (int b = 0; b <= B3Tally::kNbBins; b++) totalSpectrum[b] += other.totalSpectrum[b];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WeightedTally::PeakEfficiency(double& efficiency, double& error) const
+{
+  efficiency = error = 0.;
+  if (nEvents == 0) return;
+  double n = double(nEvents);
+  efficiency = sumPeak/n;
+  double var = sumPeak2/n - efficiency*efficiency;
+  error = (var > 0.) ? std::sqrt(var/n) : 0.;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
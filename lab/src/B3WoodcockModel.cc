@@ -0,0 +1,312 @@
+/// \file B3WoodcockModel.cc
+/// \brief Implementation of the B3WoodcockModel class
+
+#include "B3WoodcockModel.hh"
+
+#include "G4BiasingProcessInterface.hh"
+#include "G4FastStep.hh"
+#include "G4FastTrack.hh"
+#include "G4Gamma.hh"
+#include "G4Material.hh"
+#include "G4MaterialCutsCouple.hh"
+#include "G4ParticleChangeForGamma.hh"
+#include "G4ProcessManager.hh"
+#include "G4ProcessVector.hh"
+#include "G4ProductionCutsTable.hh"
+#include "G4Region.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4VEmProcess.hh"
+#include "G4VSolid.hh"
+#include "G4GeometryTolerance.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace
+{
+  /// Energy grid of the tables
+  const G4double kEnergyMin = 1*keV;
+  const G4double kEnergyMax = 10*MeV;
+  const G4int    kNodesPerDecade = 32;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4ThreadLocal B3WoodcockModel::Statistics B3WoodcockModel::fgStatistics = { 0, 0, 0 };
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3WoodcockModel::B3WoodcockModel(const G4String& name, G4Region* envelope)
+ : G4VFastSimulationModel(name, envelope),
+   fMaterialIndices(0),
+   fRegion(envelope),
+   fTablesBuilt(false),
+   fLogEnergyMin(std::log(kEnergyMin)),
+   fInverseLogStep(kNodesPerDecade/std::log(10.)),
+   fNbNodes(size_t(std::log10(kEnergyMax/kEnergyMin)*kNodesPerDecade + 0.5) + 1)
+{
+  fNb[0] = fNb[1] = fNb[2] = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3WoodcockModel::~B3WoodcockModel()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WoodcockModel::SetPhantom(const G4int nb[3], const G4ThreeVector& voxelSize,
+                                 const size_t* materialIndices,
+                                 const std::vector<G4Material*>& materials)
+{
+  for (G4int i = 0; i < 3; i++) fNb[i] = nb[i];
+  fVoxelSize = voxelSize;
+  fHalfSize = 0.5*G4ThreeVector(nb[0]*voxelSize.x(), nb[1]*voxelSize.y(),
+                                nb[2]*voxelSize.z());
+  fMaterialIndices = materialIndices;
+  fMaterials = materials;
+  fTablesBuilt = false;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3WoodcockModel::IsApplicable(const G4ParticleDefinition& particle)
+{
+  return &particle == G4Gamma::GammaDefinition();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+G4bool B3WoodcockModel::ModelTrigger(const G4FastTrack& fastTrack)
+{
+  if (!fMaterialIndices) return false;
+  G4double energy = fastTrack.GetPrimaryTrack()->GetKineticEnergy();
+  if (energy < kEnergyMin || energy >= kEnergyMax) return false;
+
+  // a photon on the surface of the envelope, going out, is left to the
+  // transportation: the model would give it back at the same point
+  G4double out = fastTrack.GetEnvelopeSolid()->DistanceToOut(
+    fastTrack.GetPrimaryTrackLocalPosition(), fastTrack.GetPrimaryTrackLocalDirection());
+  return out > G4GeometryTolerance::GetInstance()->GetSurfaceTolerance();
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+size_t B3WoodcockModel::MaterialAt(const G4ThreeVector& local) const
+{
+  G4int i[3];
+  for (G4int k = 0; k < 3; k++) {
+    i[k] = G4int((local[k] + fHalfSize[k])/fVoxelSize[k]);
+    i[k] = std::min(std::max(i[k], 0), fNb[k] - 1);
+  }
+  return fMaterialIndices[i[0] + size_t(fNb[0])*(i[1] + size_t(fNb[1])*i[2])];
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WoodcockModel::BuildTables()
+{
+  // the discrete processes of the photons of this thread, wrapped by the
+  // generic biasing (see B3PhysicsList)
+  fProcesses.clear();
+  G4ProcessVector* processes
+    = G4Gamma::Gamma()->GetProcessManager()->GetPostStepProcessVector();
+  for (G4int i = 0; i < processes->entries(); i++) {
+    G4VProcess* process = (*processes)[i];
+    G4BiasingProcessInterface* wrapper = dynamic_cast<G4BiasingProcessInterface*>(process);
+    if (wrapper) process = wrapper->GetWrappedProcess();
+    G4VEmProcess* emProcess = dynamic_cast<G4VEmProcess*>(process);
+    if (emProcess) fProcesses.push_back(emProcess);
+  }
+  if (fProcesses.empty()) {
+    G4Exception("B3WoodcockModel::BuildTables()", "B3Woodcock002",
+                FatalException, "No electromagnetic process of the photons");
+    return;
+  }
+
+  // the materials with the cuts of the envelope
+  G4ProductionCutsTable* cutsTable = G4ProductionCutsTable::GetProductionCutsTable();
+  fCouples.clear();
+  for (size_t m = 0; m < fMaterials.size(); m++) {
+    const G4MaterialCutsCouple* couple
+      = cutsTable->GetMaterialCutsCouple(fMaterials[m], fRegion->GetProductionCuts());
+    if (!couple) {
+      G4ExceptionDescription msg;
+      msg << "No material-cuts couple of " << fMaterials[m]->GetName()
+          << " in the region " << fRegion->GetName();
+      G4Exception("B3WoodcockModel::BuildTables()", "B3Woodcock001",
+                  FatalException, msg);
+      return;
+    }
+    fCouples.push_back(couple);
+  }
+
+  size_t nProcesses = fProcesses.size();
+  size_t nMaterials = fMaterials.size();
+  fSigma.assign(nMaterials*nProcesses*fNbNodes, 0.);
+  fMu.assign(nMaterials*fNbNodes, 0.);
+  for (size_t m = 0; m < nMaterials; m++) {
+    for (size_t p = 0; p < nProcesses; p++) {
+      for (size_t n = 0; n < fNbNodes; n++) {
+        G4double energy = std::exp(fLogEnergyMin + n/fInverseLogStep);
+        G4double sigma = fProcesses[p]->CrossSectionPerVolume(energy, fCouples[m]);
+        fSigma[(m*nProcesses + p)*fNbNodes + n] = sigma;
+        fMu[m*fNbNodes + n] += sigma;
+      }
+    }
+  }
+
+  // majorant of each bin: the interpolation stays between the node values
+  fMuMax.assign(fNbNodes - 1, 0.);
+  for (size_t m = 0; m < nMaterials; m++) {
+    const G4double* mu = &fMu[m*fNbNodes];
+    for (size_t b = 0; b + 1 < fNbNodes; b++) {
+      fMuMax[b] = std::max(fMuMax[b], std::max(mu[b], mu[b + 1]));
+    }
+  }
+  fTablesBuilt = true;
+
+  size_t bin;
+  G4double fraction;
+  Locate(511*keV, bin, fraction);
+  G4cout
+    << "\n Woodcock tracking: " << nProcesses << " processes, " << nMaterials
+    << " materials, mu_max(511 keV) = " << fMuMax[bin]*cm << " /cm" << G4endl;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WoodcockModel::DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep)
+{
+  if (!fTablesBuilt) BuildTables();
+  fgStatistics.nPhotons++;
+
+  const G4Track* primary = fastTrack.GetPrimaryTrack();
+  const G4VSolid* envelope = fastTrack.GetEnvelopeSolid();
+  G4ThreeVector position = fastTrack.GetPrimaryTrackLocalPosition();
+  G4ThreeVector direction = fastTrack.GetPrimaryTrackLocalDirection();
+  G4double energy = primary->GetKineticEnergy();
+  G4double time0 = primary->GetGlobalTime();
+  G4double path = 0.;
+  G4double edep = 0.;
+  G4bool alive = true;
+  fSecondaries.clear();
+
+  // the photon given to the processes at the real interactions
+  G4Track photon(new G4DynamicParticle(G4Gamma::Gamma(), direction, energy),
+                 time0, position);
+  G4Step step;
+  photon.SetStep(&step);
+  photon.SetTouchableHandle(primary->GetTouchableHandle());
+  step.SetTrack(&photon);
+  G4StepPoint* point = step.GetPreStepPoint();
+
+  size_t nProcesses = fProcesses.size();
+  G4double out = envelope->DistanceToOut(position, direction);
+  for (;;) {
+    size_t bin;
+    G4double fraction;
+    Locate(energy, bin, fraction);
+    G4double muMax = fMuMax[bin];
+
+    // flight to the next interaction, real or virtual, or out of the phantom
+    G4double distance = -std::log(G4UniformRand())/muMax;
+    if (distance >= out) {
+      position += out*direction;
+      path += out;
+      break;
+    }
+    position += distance*direction;
+    path += distance;
+    out -= distance;
+
+    size_t m = MaterialAt(position);
+    G4double mu = Interpolate(fMu, m*fNbNodes, bin, fraction);
+    if (G4UniformRand()*muMax >= mu) {
+      fgStatistics.nVirtual++;
+      continue;
+    }
+    fgStatistics.nReal++;
+
+    // the process of the real interaction
+    G4double r = G4UniformRand()*mu;
+    size_t p = 0;
+    for (; p + 1 < nProcesses; p++) {
+      r -= Interpolate(fSigma, (m*nProcesses + p)*fNbNodes, bin, fraction);
+      if (r < 0.) break;
+    }
+
+    G4double time = time0 + path/c_light;
+    photon.SetPosition(position);
+    photon.SetGlobalTime(time);
+    G4DynamicParticle* particle = const_cast<G4DynamicParticle*>(photon.GetDynamicParticle());
+    particle->SetKineticEnergy(energy);
+    particle->SetMomentumDirection(direction);
+    point->SetMaterial(fMaterials[m]);
+    point->SetMaterialCutsCouple(fCouples[m]);
+
+    G4ForceCondition condition;
+    fProcesses[p]->PostStepGetPhysicalInteractionLength(photon, 0., &condition);
+    // the particle change of the EM processes
+    G4ParticleChangeForGamma* change
+      = static_cast<G4ParticleChangeForGamma*>(fProcesses[p]->PostStepDoIt(photon, step));
+
+    edep += change->GetLocalEnergyDeposit();
+    for (G4int i = 0; i < change->GetNumberOfSecondaries(); i++) {
+      G4Track* track = change->GetSecondary(i);
+      Secondary secondary = { *track->GetDynamicParticle(), position, time };
+      fSecondaries.push_back(secondary);
+      delete track;
+    }
+    change->Clear();
+
+    if (change->GetTrackStatus() == fStopAndKill
+        || change->GetProposedKineticEnergy() <= 0.) {
+      alive = false;
+      break;
+    }
+    energy = change->GetProposedKineticEnergy();
+    direction = change->GetProposedMomentumDirection();
+    // below or above the tables: back to standard tracking
+    if (energy < kEnergyMin || energy >= kEnergyMax) break;
+    out = envelope->DistanceToOut(position, direction);
+  }
+
+  fastStep.SetNumberOfSecondaryTracks(G4int(fSecondaries.size()));
+  for (size_t i = 0; i < fSecondaries.size(); i++) {
+    fastStep.CreateSecondaryTrack(fSecondaries[i].particle, fSecondaries[i].position,
+                                  fSecondaries[i].time);
+  }
+  fastStep.ProposePrimaryTrackFinalPosition(position);
+  fastStep.ProposePrimaryTrackFinalTime(time0 + path/c_light);
+  fastStep.ProposePrimaryTrackPathLength(path);
+  fastStep.ProposeTotalEnergyDeposited(edep);
+  if (alive) {
+    fastStep.ProposePrimaryTrackFinalKineticEnergyAndDirection(energy, direction);
+  } else {
+    fastStep.KillPrimaryTrack();
+  }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+const B3WoodcockModel::Statistics& B3WoodcockModel::GetStatistics()
+{
+  return fgStatistics;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WoodcockModel::ResetStatistics()
+{
+  fgStatistics.nPhotons = 0;
+  fgStatistics.nReal = 0;
+  fgStatistics.nVirtual = 0;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
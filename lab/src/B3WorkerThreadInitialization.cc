@@ -0,0 +1,38 @@
+/// \file B3WorkerThreadInitialization.cc
+/// \brief Implementation of the B3WorkerThreadInitialization class
+
+#include "B3WorkerThreadInitialization.hh"
+#include "B3PhiloxEngine.hh"
+#include "B3ThreadPlacement.hh"
+
+#include "Randomize.hh"
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3WorkerThreadInitialization::B3WorkerThreadInitialization()
+ : G4UserWorkerThreadInitialization()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+B3WorkerThreadInitialization::~B3WorkerThreadInitialization()
+{ }
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void B3WorkerThreadInitialization::SetupRNGEngine(
+  const CLHEP::HepRandomEngine* masterEngine) const
+{
+  // First thing the worker does: its allocations are then on its node
+  B3ThreadPlacement::Instance()->PinWorker();
+
+  const B3PhiloxEngine* philox = dynamic_cast<const B3PhiloxEngine*>(masterEngine);
+  if (!philox) {
+    G4UserWorkerThreadInitialization::SetupRNGEngine(masterEngine);
+    return;
+  }
+  // The key is set again at each event by B3RandomStreams
+  G4Random::setTheEngine(new B3PhiloxEngine(philox->getSeed()));
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -0,0 +1,260 @@
+/// \file validateB3.cc
+/// \brief Statistical physics-equivalence check between two runs of exampleB3
+///
+/// Compares a reference and a candidate output of exampleB3 (for example a
+/// run with the standard settings and one with a faster mode switched on):
+///  - chi-square test of the "h1" total energy spectrum,
+///  - Kolmogorov-Smirnov test of the event-by-event total energy,
+///  - chi-square test of the energy spectrum of each crystal,
+///  - comparison of the photopeak efficiency with its uncertainty.
+/// The tests are combined with a Bonferroni correction: the comparison
+/// passes if every p-value is above alpha/(number of tests).
+///
+/// Both runs should be produced with the same fixed seeds (see
+/// validate.mac) so that a given configuration is reproducible, and
+/// without trigger conditions (B3Trigger): an output whose ntuple has fewer
+/// rows than h1 has entries is refused.
+///
+/// Usage: validateB3 <reference> <candidate> [--alpha a] [--window lo hi]
+///                   [--report file]
+/// where <reference> and <candidate> are output base names (e.g. "ref/B3"):
+/// "h1" is read from <base>.root, the "B3" ntuple from <base>.root or, for
+/// multi-threaded runs, from the per-thread files <base>_t0.root, ...
+///
+/// The exit code is 0 if the runs are compatible, 1 if not, 2 on error.
+
+#include "B3Statistics.hh"
+
+#include "globals.hh"
+#include "B3Analysis.hh"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+namespace {
+
+const G4int kNbCrystals = 9;
+const G4int kNbSpectrumBins = 100;
+const G4double kSpectrumMax = 1000.; // keV
+
+/// Content of one run output needed for the comparison
+struct RunData
+{
+  G4String base;
+  std::vector<G4double> h1;               // "h1" bin entries
+  G4double nEvents;                       // "h1" entries
+  std::vector<G4double> total;            // per-event total energy (keV)
+  std::vector<std::vector<G4double> > crystalSpectrum;
+};
+
+G4bool FileExists(const G4String& name)
+{
+  std::ifstream file(name.c_str());
+  return file.good();
+}
+
+void FillSpectrum(std::vector<G4double>& spectrum, G4double value)
+{
+  if (value < 0. || value >= kSpectrumMax) return;
+  spectrum[G4int(value/kSpectrumMax*kNbSpectrumBins)] += 1.;
+}
+
+G4int ReadNtupleFile(const G4String& fileName, RunData& data)
+{
+  G4AnalysisReader* reader = G4AnalysisReader::Instance();
+  G4int ntupleId = reader->GetNtuple("B3", fileName);
+  if (ntupleId < 0) return 0;
+
+  G4double edep[kNbCrystals];
+  for (G4int i = 0; i < kNbCrystals; i++) {
+    std::ostringstream column;
+    column << "crystal" << i;
+    reader->SetNtupleDColumn(ntupleId, column.str(), edep[i]);
+  }
+
+  G4int nRows = 0;
+  while (reader->GetNtupleRow(ntupleId)) {
+    G4double total = 0.;
+    for (G4int i = 0; i < kNbCrystals; i++) {
+      total += edep[i];
+      if (edep[i] > 0.) FillSpectrum(data.crystalSpectrum[i], edep[i]);
+    }
+    data.total.push_back(total);
+    nRows++;
+  }
+  return nRows;
+}
+
+G4bool ReadRun(const G4String& base, RunData& data)
+{
+  data.base = base;
+  data.crystalSpectrum.assign(kNbCrystals, std::vector<G4double>(kNbSpectrumBins, 0.));
+
+  G4AnalysisReader* reader = G4AnalysisReader::Instance();
+  G4String fileName = base + ".root";
+  if (!FileExists(fileName)) {
+    G4cerr << "validateB3: cannot open " << fileName << G4endl;
+    return false;
+  }
+
+  G4int h1Id = reader->ReadH1("h1", fileName);
+  tools::histo::h1d* h1 = (h1Id >= 0) ? reader->GetH1(h1Id) : 0;
+  if (!h1) {
+    G4cerr << "validateB3: no histogram h1 in " << fileName << G4endl;
+    return false;
+  }
+  for (unsigned int i = 0; i < h1->axis().bins(); i++) {
+    data.h1.push_back(h1->bin_entries(i));
+  }
+  data.nEvents = h1->all_entries();
+
+  // Sequential runs keep the ntuple in the main file, multi-threaded runs
+  // write one file per worker thread
+  if (ReadNtupleFile(fileName, data) == 0) {
+    for (G4int thread = 0; ; thread++) {
+      std::ostringstream threadFile;
+      threadFile << base << "_t" << thread << ".root";
+      if (!FileExists(threadFile.str())) break;
+      ReadNtupleFile(threadFile.str(), data);
+    }
+  }
+  if (data.total.empty()) {
+    G4cerr << "validateB3: no ntuple rows found for " << base << G4endl;
+    return false;
+  }
+  // h1 sees all the events, the ntuple only those persisted by the
+  // trigger: the tests (and the efficiency, counted in the ntuple over the
+  // h1 entries) need the same events in both
+  if (G4double(data.total.size()) != data.nEvents) {
+    G4cerr << "validateB3: " << base << " has " << data.total.size()
+           << " ntuple rows for " << data.nEvents << " events in h1: the events"
+           << " were filtered by the trigger (/B3/trigger/); compare runs"
+           << " without trigger conditions" << G4endl;
+    return false;
+  }
+  return true;
+}
+
+G4double CountInWindow(const std::vector<G4double>& values,
+                       G4double lo, G4double hi)
+{
+  G4double k = 0.;
+  for (size_t i = 0; i < values.size(); i++) {
+    if (values[i] >= lo && values[i] <= hi) k += 1.;
+  }
+  return k;
+}
+
+/// One line of the report
+struct ReportLine
+{
+  G4String name;
+  B3Statistics::TestResult test;
+};
+
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+int main(int argc, char** argv)
+{
+  if (argc < 3) {
+    G4cerr << "Usage: validateB3 <reference> <candidate> [--alpha a]"
+           << " [--window lo hi] [--report file]" << G4endl;
+    return 2;
+  }
+
+  G4double alpha = 0.01;
+  G4double windowLo = 460., windowHi = 562.;   // keV, around 511 keV
+  G4String reportName;
+  for (G4int i = 3; i < argc; i++) {
+    G4String arg = argv[i];
+    if (arg == "--alpha" && i+1 < argc) alpha = std::atof(argv[++i]);
+    else if (arg == "--window" && i+2 < argc) {
+      windowLo = std::atof(argv[++i]);
+      windowHi = std::atof(argv[++i]);
+    }
+    else if (arg == "--report" && i+1 < argc) reportName = argv[++i];
+    else {
+      G4cerr << "validateB3: unknown option " << arg << G4endl;
+      return 2;
+    }
+  }
+
+  G4AnalysisReader* reader = G4AnalysisReader::Instance();
+  reader->SetVerboseLevel(0);
+
+  RunData ref, cand;
+  if (!ReadRun(argv[1], ref) || !ReadRun(argv[2], cand)) return 2;
+
+  std::vector<ReportLine> lines;
+  ReportLine line;
+
+  line.name = "h1 total energy (chi2)";
+  line.test = B3Statistics::ChiSquareTest(ref.h1, cand.h1);
+  lines.push_back(line);
+
+  line.name = "total energy (Kolmogorov)";
+  line.test = B3Statistics::KolmogorovTest(ref.total, cand.total);
+  lines.push_back(line);
+
+  for (G4int i = 0; i < kNbCrystals; i++) {
+    std::ostringstream name;
+    name << "crystal" << i << " spectrum (chi2)";
+    line.name = name.str();
+    line.test = B3Statistics::ChiSquareTest(ref.crystalSpectrum[i],
+                                            cand.crystalSpectrum[i]);
+    lines.push_back(line);
+  }
+
+  G4double kRef  = CountInWindow(ref.total,  windowLo, windowHi);
+  G4double kCand = CountInWindow(cand.total, windowLo, windowHi);
+  line.name = "photopeak efficiency (z)";
+  line.test = B3Statistics::EfficiencyTest(kRef, ref.nEvents, kCand, cand.nEvents);
+  lines.push_back(line);
+
+  // Bonferroni correction for the number of tests performed
+  G4double threshold = alpha/lines.size();
+  G4bool pass = true;
+
+  std::ostringstream report;
+  report << "\n--------------------validateB3 report----------------------\n"
+         << " reference: " << ref.base  << " (" << ref.nEvents  << " events)\n"
+         << " candidate: " << cand.base << " (" << cand.nEvents << " events)\n"
+         << " alpha = " << alpha << ", per-test threshold = " << threshold << "\n\n";
+  for (size_t i = 0; i < lines.size(); i++) {
+    const ReportLine& l = lines[i];
+    G4bool ok = (l.test.pValue >= threshold);
+    pass = pass && ok;
+    report << "  " << std::setw(30) << std::left << l.name << std::right
+           << " stat = " << std::setw(10) << std::setprecision(4) << l.test.statistic;
+    if (l.test.ndf > 0) report << " ndf = " << std::setw(4) << l.test.ndf;
+    else                report << "           ";
+    report << " p = " << std::setw(10) << std::setprecision(4) << l.test.pValue
+           << (ok ? "   ok" : "   FAIL") << "\n";
+  }
+
+  G4double effRef, errRef, effCand, errCand;
+  B3Statistics::Efficiency(kRef,  ref.nEvents,  effRef,  errRef);
+  B3Statistics::Efficiency(kCand, cand.nEvents, effCand, errCand);
+  report << "\n  photopeak window [" << windowLo << ", " << windowHi << "] keV\n"
+         << "  efficiency reference = " << effRef  << " +- " << errRef  << "\n"
+         << "  efficiency candidate = " << effCand << " +- " << errCand << "\n"
+         << "\n Result: " << (pass ? "PASS" : "FAIL") << "\n"
+         << "------------------------------------------------------------\n";
+
+  G4cout << report.str() << G4endl;
+  if (!reportName.empty()) {
+    std::ofstream out(reportName.c_str());
+    out << report.str();
+  }
+
+  return pass ? 0 : 1;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......